@@ -120,6 +120,9 @@ else ()
   set(CMAKE_CXX_STANDARD 17)
 endif ()
 
+# std::thread support, used for the parallel apps
+find_package( Threads REQUIRED )
+
 # First try to find the header directly without relying on CMake package
 find_path(NLOHMANN_JSON_INCLUDE_DIR NAMES nlohmann/json.hpp
           PATHS /usr/include /usr/local/include ${CMAKE_PREFIX_PATH})
@@ -25,6 +25,7 @@ print_help(){
   echo "  -o|--output-folder <dir>    Output folder (default: from json). Overrides json."
   echo "  --max-files <n>             Maximum number of files to process. Overrides json."
   echo "  --skip-files <n>            Number of files to skip at start. Overrides json."
+  echo "  -t|--threads <n>            Number of threads backtracking files and events in parallel (default: 1)"
   echo "  -f|--override               Force reprocessing even if output already exists (default: false)"
   echo "  -v|--verbose                Enable verbose mode"
   echo "  -h|--help                   Print this help message."
@@ -38,6 +39,7 @@ override=false
 verbose=false
 max_files=""
 skip_files=""
+threads=""
 # output_folder="" # a default could be data/
 
 while [[ $# -gt 0 ]]; do
@@ -47,6 +49,7 @@ while [[ $# -gt 0 ]]; do
     -o|--output-folder) output_folder="$2"; shift 2;;
     --max-files) max_files="$2"; shift 2;;
     --skip-files) skip_files="$2"; shift 2;;
+    -t|--threads) threads="$2"; shift 2;;
     --no-compile) noCompile=true; shift;;
     --clean-compile) cleanCompile=true; shift;;        
     -f|--override)
@@ -115,6 +118,9 @@ fi
 if [ ! -z "$skip_files" ]; then
   backtrack_cmd="$backtrack_cmd --skip-files $skip_files"
 fi
+if [ ! -z "$threads" ]; then
+  backtrack_cmd="$backtrack_cmd --threads $threads"
+fi
 if [ "$override" = true ]; then
   backtrack_cmd="$backtrack_cmd --override"
 fi
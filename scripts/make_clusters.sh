@@ -11,6 +11,7 @@ print_help(){
   echo "  -o|--output-folder <dir>  Output folder (overrides the one in JSON file)"
   echo "  -s|--skip <num>           Number of files to skip at start (overrides JSON)"
   echo "  -m|--max <num>            Maximum number of files to process (overrides JSON)"
+  echo "  -t|--threads <num>        Number of threads clustering in parallel (default: 1)"
   echo "  --no-compile              Do not recompile the code"
   echo "  --clean-compile           Clean and recompile the code"
   echo "  -f|--override [true|false] Force reprocessing even if output already exists (useful for debugging)"
@@ -28,6 +29,7 @@ inputFile=""
 output_folder=""
 skip_files=""
 max_files=""
+threads=""
 # output_folder="data" # no standard
 
 while [[ $# -gt 0 ]]; do
@@ -37,6 +39,7 @@ while [[ $# -gt 0 ]]; do
     -o|--output-folder) output_folder="$2"; shift 2;;
   -s|--skip|--skip-files) skip_files="$2"; shift 2;;
   -m|--max|--max-files) max_files="$2"; shift 2;;
+  -t|--threads) threads="$2"; shift 2;;
     --no-compile) noCompile=true; shift;;
     --clean-compile) cleanCompile=true; shift;;        
     -f|--override)
@@ -84,6 +87,9 @@ fi
 if [ ! -z "$max_files" ]; then
   cmd+=" -m $max_files"
 fi
+if [ ! -z "$threads" ]; then
+  cmd+=" --threads $threads"
+fi
 if [ "$override" = true ]; then
   cmd+=" -f"
 fi
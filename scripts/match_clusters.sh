@@ -14,6 +14,7 @@ print_help(){
   echo "  --no-compile              Do not recompile the code"
   echo "  --clean-compile           Clean and recompile the code"
   echo "  -f|--override [true|false] Force reprocessing even if output already exists (useful for debugging)"
+  echo "  --all-clusters            Match every X cluster, not only the main ones (no truth needed)"
   echo "  -v|--verbose              Enable verbose output"
   echo "  -d|--debug                Enable debug mode"
   echo "  -h|--help                 Print this help message."
@@ -28,6 +29,7 @@ inputFile=""
 output_folder=""
 skip_files=""
 max_files=""
+all_clusters=false
 
 while [[ $# -gt 0 ]]; do
   case "$1" in
@@ -38,6 +40,7 @@ while [[ $# -gt 0 ]]; do
     -m|--max|--max-files) max_files="$2"; shift 2;;
     --no-compile) noCompile=true; shift;;
     --clean-compile) cleanCompile=true; shift;;        
+    --all-clusters) all_clusters=true; shift;;
     -f|--override)
       if [[ $2 == "true" || $2 == "false" ]]; then
       override=$2
@@ -86,6 +89,9 @@ fi
 if [ "$override" = true ]; then
   cmd+=" -f"
 fi
+if [ "$all_clusters" = true ]; then
+  cmd+=" --all-clusters"
+fi
 if [ "$verbose" = true ]; then
   cmd+=" -v"
 fi
@@ -1,5 +1,6 @@
 #include "Backtracking.h"
 #include "Clustering.h"
+#include "BackgroundLibrary.h"
 #include <random>
 
 LoggerInit([]{
@@ -46,6 +47,7 @@ int main(int argc, char* argv[]) {
     clp.addOption("json",    {"-j", "--json"}, "JSON file containing the configuration");
     clp.addOption("skip_files", {"-s", "--skip", "--skip-files"}, "Number of files to skip at start (overrides JSON)", -1);
     clp.addOption("max_files", {"-m", "--max", "--max-files"}, "Maximum number of files to process (overrides JSON)", -1);
+    clp.addOption("threads", {"-t", "--threads"}, "Number of signal files processed in parallel, sharing the background library (default: 1)", 1);
     clp.addTriggerOption("verboseMode", {"-v", "--verbose"}, "Run in verbose mode");
     clp.addTriggerOption("debugMode", {"-d", "--debug"}, "Run in debug mode (more detailed than verbose)");
     clp.addTriggerOption("override", {"-f", "--override"}, "Override existing output files");
@@ -76,8 +78,13 @@ int main(int argc, char* argv[]) {
     std::string signal_type = j.value("signal_type", std::string("cc")); // "cc" or "es", just in case...
     bool around_vertex_only = j.value("around_vertex_only", false);
     double vertex_radius = j.value("vertex_radius", 100.0); // cm, used if around_vertex_only=true
+    std::string bkg_selection = j.value("background_selection", std::string("sequential")); // "sequential" or "random"
+    LogThrowIf(bkg_selection != "sequential" && bkg_selection != "random",
+               "Invalid background_selection '" << bkg_selection << "' (expected sequential or random).");
     int max_files = j.value("max_files", -1); // -1 means no limit
     int skip_files = j.value("skip_files", 0); // number of files to skip at start
+    const std::string tps_extension = getTpsFileExtension(j); // format of the merged TP files
+    const RootOutputSettings output_settings = getRootOutputSettings(j, "tps");
     
     // CLI overrides JSON
     if (clp.isOptionTriggered("skip_files")) {
@@ -114,6 +121,8 @@ int main(int argc, char* argv[]) {
     LogInfo << " - Background folder (base): " << bg_folder_cfg << std::endl;
     LogInfo << " - Output folder (merged TPs): " << output_folder << std::endl;
     LogInfo << " - Override existing output files: " << (overrideMode ? "YES" : "NO") << std::endl;
+    LogInfo << " - Output TP format: " << (tps_extension == ".tpb" ? "binary" : "root " + output_settings.get_description()) << std::endl;
+    LogInfo << " - Background event selection: " << bkg_selection << std::endl;
     LogInfo << " - Add backgrounds around vertex only: " << (around_vertex_only ? "YES" : "NO") << std::endl;
     if (around_vertex_only) {
         LogInfo << " - Vertex radius: " << vertex_radius << " cm" << std::endl;
@@ -134,223 +143,174 @@ int main(int argc, char* argv[]) {
     LogInfo << "Found " << bkg_files.size() << " background files" << std::endl;
     LogThrowIf(bkg_files.empty(), "No background files found in bg_folder.");
 
-    // Random starting point for background files, then sequential access
+    // All the background events, indexed once and shared read-only by the workers.
+    // The cache sits next to the background input so it is shared by every signal type and output folder.
+    std::string bkg_cache_folder = j.value("bg_cache_folder", std::string(""));
+    if (bkg_cache_folder.empty()) bkg_cache_folder = resolveFolderAgainstTpstream(j, bg_folder_cfg, true) + "/bkg_cache";
+    else bkg_cache_folder = resolveFolderAgainstTpstream(j, bkg_cache_folder, true);
+    LogInfo << "Loading background library (cache: " << bkg_cache_folder << ")..." << std::endl;
+    const BackgroundLibrary bkg_library(bkg_files, bkg_cache_folder);
+    LogThrowIf(bkg_library.empty(), "No background events found in the background files.");
+    LogInfo << "Background library: " << bkg_library.get_n_events() << " events from " << bkg_library.get_n_files() << " files" << std::endl;
+
+    // Sequential: every signal event takes the next library event, from a random start (no event reused
+    // before the library is exhausted). Random: every signal event draws a library event independently
+    const bool random_selection = bkg_selection == "random";
     std::random_device rd;
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<size_t> file_dist(0, bkg_files.size() - 1);
-    size_t bkg_file_idx = file_dist(rng);  // Random starting file
-    size_t bkg_event_idx = 0;
-    
-    // Current background file data (cached)
-    std::map<int, std::vector<TriggerPrimitive>> current_bkg_tps;
-    std::map<int, std::vector<TrueParticle>> current_bkg_true;
-    std::map<int, std::vector<Neutrino>> current_bkg_nu;
-    std::vector<int> current_event_ids;
-    
-    // Load first background file
-    read_tps(bkg_files[bkg_file_idx], current_bkg_tps, current_bkg_true, current_bkg_nu);
-    for (const auto& kv : current_bkg_tps) {
-        current_event_ids.push_back(kv.first);
+    std::atomic<size_t> next_bkg_event(std::uniform_int_distribution<size_t>(0, bkg_library.get_n_events() - 1)(rd));
+
+    int n_threads = 1;
+    if (clp.isOptionTriggered("threads")) {
+        n_threads = std::max(1, clp.getOptionVal<int>("threads"));
     }
-    
-    if (verboseMode) {
-        LogInfo << "Starting with random background file " << (bkg_file_idx + 1) << "/" << bkg_files.size()
-                << ": " << std::filesystem::path(bkg_files[bkg_file_idx]).filename().string() << std::endl;
+    n_threads = std::min<int>(n_threads, signal_files.size());
+    if (n_threads > 1) {
+        ROOT::EnableThreadSafety();
+        LogInfo << "Using " << n_threads << " threads, one signal file each" << std::endl;
     }
-    
-    // Lambda to get next sequential background event (cycling through files)
-    auto get_next_bkg_event = [&]() -> std::tuple<int, std::vector<TriggerPrimitive>> {
-        // Check if we need to load next background file
-        if (bkg_event_idx >= current_event_ids.size()) {
-            bkg_event_idx = 0;
-            bkg_file_idx = (bkg_file_idx + 1) % bkg_files.size();  // Wrap around
-            
-            current_bkg_tps.clear();
-            current_bkg_true.clear();
-            current_bkg_nu.clear();
-            current_event_ids.clear();
-            
-            read_tps(bkg_files[bkg_file_idx], current_bkg_tps, current_bkg_true, current_bkg_nu);
-            for (const auto& kv : current_bkg_tps) {
-                current_event_ids.push_back(kv.first);
-            }
-            
-            if (current_bkg_tps.empty()) {
-                LogWarning << "Background file " << bkg_files[bkg_file_idx] << " has no events!" << std::endl;
-                return {-1, {}};
-            }
-        }
-        
-        int event_id = current_event_ids[bkg_event_idx];
-        auto bkg_tps = current_bkg_tps.at(event_id);
-        
-        if (verboseMode) {
-            LogInfo << "Using background: file " << std::filesystem::path(bkg_files[bkg_file_idx]).filename().string()
-                    << " event " << event_id << " (file " << (bkg_file_idx + 1) << "/" << bkg_files.size()
-                    << ", event " << (bkg_event_idx + 1) << "/" << current_event_ids.size() << ")" << std::endl;
-        }
-        
-        bkg_event_idx++;
-        return {event_id, bkg_tps};
-    };
 
     // Process signal files (skip/max already applied via tpstream basenames)
+    std::vector<std::string> output_files_by_signal(signal_files.size());
+    std::atomic<int> next_file(0);
+    std::atomic<int> n_skipped(0);
+    std::atomic<long> n_events_without_vertex(0); // around_vertex_only: events with no MARLEY TP, which get all the background
     int done_files = 0;
-    std::vector<std::string> output_files;
-    
-    for (const auto& signal_file : signal_files) {
-        done_files++;
-        if (!verboseMode) {
-            GenericToolbox::displayProgressBar(done_files, (int)signal_files.size(), "Adding backgrounds...");
-        }
-        if (verboseMode) LogInfo << "\nProcessing signal file: " << signal_file << std::endl;
-        
-        // Read signal TPs
-        std::map<int, std::vector<TriggerPrimitive>> signal_tps_by_event;
-        std::map<int, std::vector<TrueParticle>> signal_true_by_event;
-        std::map<int, std::vector<Neutrino>> signal_nu_by_event;
-        read_tps(signal_file, signal_tps_by_event, signal_true_by_event, signal_nu_by_event);
-        
-        // Prepare output file name
-        std::filesystem::path signal_path(signal_file);
-        
-        // Get base filename without _tps.root suffix
-        std::string base_name = signal_path.stem().string();
-        if (base_name.size() > 4 && base_name.substr(base_name.size() - 4) == "_tps") {
-            base_name = base_name.substr(0, base_name.size() - 4);
-        }
-        
-        std::string output_filename = output_folder + "/" + base_name;
-        if (around_vertex_only) {
-            output_filename += "_bg_vtx" + std::to_string((int)vertex_radius) + "_tps.root";
-        } else {
-            output_filename += "_bg_tps.root";
-        }
-        if (verboseMode) LogInfo << "Output file: " << output_filename << std::endl;
-        
-        // Check if output file already exists
-        if (std::filesystem::exists(output_filename) && !overrideMode) {
-            done_files--;
-            if (verboseMode) LogInfo << "Output file already exists, skipping (use --override to overwrite)" << std::endl;
-            continue;
-        }
-        
-        // Prepare merged data structures
-        std::vector<std::vector<TriggerPrimitive>> merged_tps_vec;
-        std::vector<std::vector<TrueParticle>> merged_true_vec;
-        std::vector<std::vector<Neutrino>> merged_nu_vec;
-        
-        // Track signal TP counts for each event (for diagnostics)
-        std::vector<int> signal_tp_counts;
-        
-        // Process each event in the signal file
-        for (const auto& kv : signal_tps_by_event) {
-            int event_id = kv.first;
-            const auto& signal_tps = kv.second;
-            
-            // Get neutrino vertex position if around_vertex_only is enabled
-            TVector3 vertex_pos(0, 0, 0);
-            bool has_vertex = false;
-            if (around_vertex_only && signal_nu_by_event.count(event_id) > 0) {
-                const auto& neutrinos = signal_nu_by_event.at(event_id);
-                if (!neutrinos.empty()) {
-                    vertex_pos.SetXYZ(neutrinos[0].GetX(), neutrinos[0].GetY(), neutrinos[0].GetZ());
-                    has_vertex = true;
-                    if (debugMode) {
-                        LogInfo << "Event " << event_id << " vertex at ("
-                                << vertex_pos.X() << ", " << vertex_pos.Y() << ", " << vertex_pos.Z() << ")" << std::endl;
-                    }
+    std::mutex progress_mutex;
+
+    auto process_files = [&](unsigned int seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> event_dist(0, bkg_library.get_n_events() - 1);
+        // Reused for every event: the background event columns, the rows kept and their TPs
+        TPStore bkg_scratch;
+        std::vector<uint32_t> bkg_rows;
+        std::vector<TriggerPrimitive> bkg_tps;
+
+        for (int iFile = next_file++; iFile < (int)signal_files.size(); iFile = next_file++) {
+            const std::string& signal_file = signal_files[iFile];
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                done_files++;
+                if (!verboseMode) {
+                    GenericToolbox::displayProgressBar(done_files, (int)signal_files.size(), "Adding backgrounds...");
                 }
             }
+            if (verboseMode) LogInfo << "\nProcessing signal file: " << signal_file << std::endl;
             
-            // Start with signal TPs
-            std::vector<TriggerPrimitive> merged_tps = signal_tps;
+            // Prepare output file name
+            std::filesystem::path signal_path(signal_file);
             
-            // Vectors to hold merged truth info for this event (kept for backward compatibility)
-            std::vector<TrueParticle> merged_true;
-            std::vector<Neutrino> merged_nu;
+            // Get base filename without _tps.root suffix
+            std::string base_name = signal_path.stem().string();
+            if (base_name.size() > 4 && base_name.substr(base_name.size() - 4) == "_tps") {
+                base_name = base_name.substr(0, base_name.size() - 4);
+            }
             
-            // Get random background event
-            auto [bkg_event_id, bkg_tps] = get_next_bkg_event();
+            std::string output_filename = output_folder + "/" + base_name;
+            if (around_vertex_only) {
+                output_filename += "_bg_vtx" + std::to_string((int)vertex_radius) + "_tps" + tps_extension;
+            } else {
+                output_filename += "_bg_tps" + tps_extension;
+            }
+            if (verboseMode) LogInfo << "Output file: " << output_filename << std::endl;
             
-            if (bkg_event_id >= 0 && !bkg_tps.empty()) {
-                int bkg_added = 0;
-                int bkg_truth_linked = 0;
-                int bkg_unknown_filtered = 0;
-                
-                // Add background TPs, copying embedded truth directly
-                for (const auto& bkg_tp : bkg_tps) {
-                    // Filter out UNKNOWN background TPs (noise already present in signal files)
-                    std::string gen_name = bkg_tp.GetGeneratorName();
-                    if (gen_name == "UNKNOWN") {
-                        bkg_unknown_filtered++;
-                        continue;  // Skip UNKNOWN TPs from background
-                    }
-                    
-                    TriggerPrimitive tp = bkg_tp;
-                    
-                    // Update the event number to match the signal event (CRITICAL BUG FIX)
-                    tp.SetEvent(event_id);
-                    
-                    // Truth is already embedded in the TP - no pointer relinking needed
-                    bkg_truth_linked++;  // Count as linked since truth is embedded
-                    
-                    merged_tps.push_back(tp);
-                    bkg_added++;
+            // Check if output file already exists
+            if (std::filesystem::exists(output_filename) && !overrideMode) {
+                n_skipped++;
+                if (verboseMode) LogInfo << "Output file already exists, skipping (use --override to overwrite)" << std::endl;
+                continue;
+            }
+            
+            // Signal events are streamed, merged and written one at a time
+            TpsReader signal_reader(signal_file);
+            if (!signal_reader.is_open()) {
+                LogError << "Cannot read signal file " << signal_file << ", skipping it" << std::endl;
+                continue;
+            }
+            
+            try {
+                TpsWriter writer(output_filename, output_settings);
+                if (!writer.is_open()) {
+                    LogError << "Error writing output file " << output_filename << ", skipping it" << std::endl;
+                    continue;
                 }
                 
-                if (around_vertex_only && has_vertex) {
-                    LogWarning << "around_vertex_only is enabled but TP position filtering not yet implemented. Adding all background TPs." << std::endl;
-                }
+                // UNKNOWN background TPs are dropped: that noise is already present in the signal files.
+                // With around_vertex_only, so are the TPs outside the readout window of the vertex.
+                // Both are tested on the columns of the background event, before any TriggerPrimitive is built
+                const VertexWindow* window = nullptr;
+                const auto keep_bkg_row = [&window](const TPStore& store, size_t row) {
+                    return store.get_truth(row).generator_id != interned::unknown_generator_id && (!window || window->contains(store, row));
+                };
+                std::vector<TPMergeInput> merge_inputs(2);
+                std::vector<const TriggerPrimitive*> merged_tps; // reused for every event
+                while (signal_reader.next()) {
+                    int event_id = signal_reader.get_event();
+                    const auto& signal_tps = signal_reader.get_tps();
                 
-                if (verboseMode) {
-                    LogInfo << "Signal event " << event_id << ": " << signal_tps.size() << " signal TPs + "
-                            << bkg_added << " background TPs (truth linked: " << bkg_truth_linked
-                            << ", filtered UNKNOWN: " << bkg_unknown_filtered << ") = "
-                            << merged_tps.size() << " total TPs" << std::endl;
-                }
+                    std::unique_ptr<VertexWindow> vertex_window;
+                    if (around_vertex_only) {
+                        vertex_window.reset(new VertexWindow(signal_tps, vertex_radius));
+                        if (!vertex_window->is_valid()) {
+                            vertex_window.reset();
+                            n_events_without_vertex++;
+                        }
+                    }
+                    window = vertex_window.get();
+
+                    // Get next background event, only its kept TPs built
+                    const size_t bkg_event = random_selection ? event_dist(rng) : next_bkg_event++ % bkg_library.get_n_events();
+                    bkg_library.get_event_tps(bkg_event, bkg_scratch, bkg_rows, bkg_tps, keep_bkg_row);
+                    if (verboseMode) {
+                        LogInfo << "Using background: file " << std::filesystem::path(bkg_library.get_filename(bkg_event)).filename().string()
+                                << " event " << bkg_library.get_event_number(bkg_event) << std::endl;
+                    }
                 
-                // Merge truth information from signal (kept for backward compatibility with write function)
-                if (signal_true_by_event.count(event_id) > 0) {
-                    merged_true = signal_true_by_event.at(event_id);
-                }
-                if (signal_nu_by_event.count(event_id) > 0) {
-                    merged_nu = signal_nu_by_event.at(event_id);
-                }
+                    // Signal and background events are both sorted by time: they are merged in time order
+                    // (for consistent clustering) through pointers, and written straight from their buffers.
+                    // The time_sorted flags of their files spare the sortedness checks (the kept rows keep their order)
+                    merge_inputs[0].tps = &signal_tps;
+                    merge_inputs[0].sorted = signal_reader.is_time_sorted();
+                    merge_inputs[1].tps = &bkg_tps;
+                    merge_inputs[1].sorted = bkg_library.is_event_time_sorted(bkg_event);
+                    merge_by_time_start(merge_inputs, merged_tps);
                 
-            } else {
-                // No background TPs available, just use signal truth
-                if (signal_true_by_event.count(event_id) > 0) {
-                    merged_true = signal_true_by_event.at(event_id);
-                }
-                if (signal_nu_by_event.count(event_id) > 0) {
-                    merged_nu = signal_nu_by_event.at(event_id);
+                    if (verboseMode && !bkg_scratch.empty()) {
+                        const size_t bkg_added = bkg_tps.size();
+                        LogInfo << "Signal event " << event_id << ": " << signal_tps.size() << " signal TPs + "
+                                << bkg_added << " background TPs (filtered: " << bkg_scratch.size() - bkg_added << ") = "
+                                << merged_tps.size() << " total TPs" << std::endl;
+                    }
+                
+                    // Background TPs take the event number of the signal event
+                    writer.write_event(merged_tps, event_id);
                 }
-            }
             
-            // CRITICAL FIX: Sort merged TPs by time to ensure consistent clustering
-            // Background TPs were appended after signal TPs, which can cause different
-            // clustering behavior compared to background-only files
-            std::sort(merged_tps.begin(), merged_tps.end(),
-                [](const TriggerPrimitive& a, const TriggerPrimitive& b) {
-                    return a.GetTimeStart() < b.GetTimeStart();
-                });
-            
-            merged_tps_vec.push_back(merged_tps);
-            merged_true_vec.push_back(merged_true);
-            merged_nu_vec.push_back(merged_nu);
-            signal_tp_counts.push_back(signal_tps.size());
-        }
-        
-        // Write output file with merged TPs
-        try {
-            write_tps(output_filename, merged_tps_vec, merged_true_vec, merged_nu_vec);
-            output_files.push_back(output_filename);
-            if (verboseMode) LogInfo << "Wrote: " << output_filename << std::endl;
-        } catch (const std::exception& e) {
-            LogError << "Error writing output file " << output_filename << ": " << e.what() << std::endl;
-            LogError << "Skipping this file and continuing..." << std::endl;
+                writer.close();
+                output_files_by_signal[iFile] = output_filename;
+                if (verboseMode) LogInfo << "Wrote: " << output_filename << std::endl;
+            } catch (const std::exception& e) {
+                LogError << "Error writing output file " << output_filename << ": " << e.what() << std::endl;
+                LogError << "Skipping this file and continuing..." << std::endl;
+            }
         }
+    };
+
+    if (n_threads == 1) {
+        process_files(rd());
+    } else {
+        std::vector<std::thread> workers;
+        for (int iThread = 0; iThread < n_threads; ++iThread) workers.emplace_back(process_files, rd());
+        for (auto& worker : workers) worker.join();
+    }
+
+    // Output files in the same order as the signal files, whatever the number of threads
+    std::vector<std::string> output_files;
+    for (const auto& out : output_files_by_signal) {
+        if (!out.empty()) output_files.push_back(out);
+    }
+    done_files -= n_skipped;
+    if (n_events_without_vertex > 0) {
+        LogWarning << n_events_without_vertex << " signal events have no MARLEY TP to locate the vertex: all their background TPs were added" << std::endl;
     }
     
     LogInfo << "\n\nProcessed " << done_files << " files successfully." << std::endl;
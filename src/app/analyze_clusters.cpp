@@ -541,6 +541,8 @@ int main(int argc, char* argv[]){
       if (pd.tree->GetBranch("tp_samples_over_threshold")) pd.tree->SetBranchAddress("tp_samples_over_threshold", &v_sot);
       if (pd.tree->GetBranch("tp_adc_integral")) pd.tree->SetBranchAddress("tp_adc_integral", &v_adcint);
       if (pd.tree->GetBranch("tp_simide_energy")) pd.tree->SetBranchAddress("tp_simide_energy", &v_simide_energy);
+      // The TP vectors not bound above (tp_detector, tp_adc_peak, ...) are not read
+      read_only_bound_branches(pd.tree);
 
       // Report if this is a matched_clusters file
       if (has_match_id && pd.name == planes[0].name) { // Only log once per file
@@ -200,6 +200,7 @@ int main(int argc, char* argv[]) {
     
     tree_multi->SetBranchAddress("marley_tp_fraction", &marley_tp_fraction);
     tree_multi->SetBranchAddress("cluster_id", &cluster_id);
+    read_only_bound_branches(tree_multi);
     
     LogInfo << "Processing " << metrics.n_multiplane_clusters << " matched clusters..." << std::endl;
     
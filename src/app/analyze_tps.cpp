@@ -1,3 +1,4 @@
+#include "Clustering.h"
 #include "Functions.h"
 #include "Global.h"
 
@@ -73,7 +74,7 @@ int main(int argc, char* argv[]) {
     if (clp.isOptionTriggered("inputFile")) {
         std::string input_file = clp.getOptionVal<std::string>("inputFile");
         inputs.clear();
-        if (input_file.find("_tps.root") != std::string::npos || input_file.find("_tps_") != std::string::npos) {
+        if (input_file.find("_tps.root") != std::string::npos || input_file.find("_tps.tpb") != std::string::npos || input_file.find("_tps_") != std::string::npos) {
             inputs.push_back(input_file);
         } else {
             std::ifstream lf(input_file);
@@ -233,6 +234,7 @@ int main(int argc, char* argv[]) {
     std::set<int> events_with_marley_truth;
     std::map<int, double> event_nu_energy;
     std::map<int, double> event_time_offsets;
+    std::map<int, double> event_marley_adc_integral;
     
     struct NeutrinoInfo {
         double en = 0.0;
@@ -263,178 +265,111 @@ int main(int argc, char* argv[]) {
 
         GenericToolbox::displayProgressBar(file_count, inputs.size(), "Analyzing files...");
         
-        TFile* file = TFile::Open(input_file.c_str());
-        if (!file || file->IsZombie()) {
-            LogWarning << "Cannot open file: " << input_file << std::endl;
-            if (file) { file->Close(); delete file; }
+        // Stream the TPs in chunks of rows read straight into compact columns (see TpsColumnReader). Everything
+        // below is keyed by the event of each TP, so a chunk does not need to hold whole events
+        TpsColumnReader reader(input_file);
+        if (!reader.is_open()) {
+            LogWarning << "Cannot read trigger primitives from file: " << input_file << std::endl;
             continue;
         }
-
-        // Find the trigger primitives tree at root level (no longer in "tps" directory)
-        TTree* tpTree = dynamic_cast<TTree*>(file->Get("tps"));
-        TTree* neutrinosTree = nullptr; // neutrinos tree is optional and may not exist
-        
-        if (!tpTree) {
-            LogWarning << "No trigger primitives tree found in file: " << input_file << std::endl;
-            file->Close();
-            delete file;
-            continue;
-        }
-
-        int nTPs = tpTree->GetEntries();
-        if (verboseMode) LogInfo << "Found TP tree with " << nTPs << " entries" << std::endl;
-
-        // Set up branches to read neutrino information (if available)
-        Int_t nu_event = 0;
-        Int_t nu_energy = 0.0;
-        Float_t nu_x = 0.0;
-        Float_t nu_y = 0.0;
-        Float_t nu_z = 0.0;
-        Float_t nu_Px = 0.0;
-        Float_t nu_Py = 0.0;
-        Float_t nu_Pz = 0.0;
-
-        if (neutrinosTree) {
-            int nNeutrinos = neutrinosTree->GetEntries();
-            if (verboseMode) LogInfo << "Found Neutrinos tree with " <<  nNeutrinos << " entries" << std::endl;
-            neutrinosTree->SetBranchAddress("event", &nu_event);
-            neutrinosTree->SetBranchAddress("en", &nu_energy);
-            neutrinosTree->SetBranchAddress("x", &nu_x);
-            neutrinosTree->SetBranchAddress("y", &nu_y);
-            neutrinosTree->SetBranchAddress("z", &nu_z);
-            neutrinosTree->SetBranchAddress("Px", &nu_Px);
-            neutrinosTree->SetBranchAddress("Py", &nu_Py);
-            neutrinosTree->SetBranchAddress("Pz", &nu_Pz);
-
-            // Fill up neutrino info map
-            for (Long64_t i = 0; i < nNeutrinos; ++i) {
-                neutrinosTree->GetEntry(i);
-                NeutrinoInfo& info = event_nu_info[nu_event];
-                info.en = nu_energy;
-                info.x = nu_x; info.y = nu_y; info.z = nu_z;
-                info.hasXYZ = true;
-                // Estimate time offset from z position and speed of light (in cm/ns)
-                info.t = nu_z / 29.9792458; // speed of light in cm/ns
-                info.hasT = true;
-                event_nu_energy[nu_event] = nu_energy;
-                // event_time_offsets[nu_event] = info.t;
-            }
-        }
-
-        // Set up branch addresses for reading TPs
-        Int_t tp_event = 0;
-        UInt_t ch_offline = 0;
-        UShort_t adc_peak = 0;
-        ULong64_t samples_over_threshold = 0;
-        UInt_t adc_integral = 0;
-        std::string* generator_name = new std::string();
-        Int_t tp_truth_id = 0;
-        UShort_t detector = 0;
-        std::string* view = new std::string();
-        
-        tpTree->SetBranchAddress("event", &tp_event);
-        tpTree->SetBranchAddress("channel", &ch_offline);
-        tpTree->SetBranchAddress("adc_peak", &adc_peak);
-        tpTree->SetBranchAddress("samples_over_threshold", &samples_over_threshold);
-        tpTree->SetBranchAddress("adc_integral", &adc_integral);
-        tpTree->SetBranchAddress("generator_name", &generator_name);
-        tpTree->SetBranchAddress("truth_id", &tp_truth_id);
-        if (tpTree->GetBranch("detector")) {
-            tpTree->SetBranchAddress("detector", &detector);
-        }
-        if (tpTree->GetBranch("view")) {
-            tpTree->SetBranchAddress("view", &view);
-        }
-
-        // First pass: read all entries and fill histograms
-        for (Long64_t i = 0; i < nTPs; ++i) {
-            tpTree->GetEntry(i);
+        TPStore store; // TPs of the current chunk, reused
+        size_t n_file_tps = 0;
+        while (true) {
+            store.clear();
+            if (!reader.read_chunk(store)) break;
+            n_file_tps += store.size();
+
+            // Fill histograms with every TP of the event
+            for (size_t i = 0; i < store.size(); ++i) {
+                const uint16_t samples_over_threshold = store.get_samples_over_threshold(i);
+                const uint16_t adc_peak = store.get_adc_peak(i);
+                const uint32_t adc_integral = store.get_adc_integral(i);
+                const int tp_event = store.get_event(i);
             
-            // Apply ToT cut
-            if (static_cast<int>(samples_over_threshold) <= tot_cut) continue;
+                // Apply ToT cut
+                if (static_cast<int>(samples_over_threshold) <= tot_cut) continue;
             
-            // Determine plane based on view field
-            std::string plane = *view; // Use view directly since it contains U, V
+                // Determine plane based on view field
+                std::string plane = tp_view_name(store.get_view(i));
             
-            // Count entries per plane
-            if (plane == "X") nentries_X++;
-            else if (plane == "U") nentries_U++;
-            else if (plane == "V") nentries_V++;
+                // Count entries per plane
+                if (plane == "X") nentries_X++;
+                else if (plane == "U") nentries_U++;
+                else if (plane == "V") nentries_V++;
             
-            // Fill ADC peak histograms
-            h_peak_all_fine->Fill(adc_peak);
-            if (plane == "X") h_peak_X_fine->Fill(adc_peak);
-            else if (plane == "U") h_peak_U_fine->Fill(adc_peak);
-            else if (plane == "V") h_peak_V_fine->Fill(adc_peak);
+                // Fill ADC peak histograms
+                h_peak_all_fine->Fill(adc_peak);
+                if (plane == "X") h_peak_X_fine->Fill(adc_peak);
+                else if (plane == "U") h_peak_U_fine->Fill(adc_peak);
+                else if (plane == "V") h_peak_V_fine->Fill(adc_peak);
             
-            // Check if this is MARLEY
-            std::string gen_lower = *generator_name;
-            std::transform(gen_lower.begin(), gen_lower.end(), gen_lower.begin(), 
-                          [](unsigned char c){ return std::tolower(c); });
-            bool is_marley = (gen_lower.find("marley") != std::string::npos);
+                // Check if this is MARLEY
+                const bool is_marley = store.is_marley(i);
             
-            if (is_marley) {
-                h_peak_all_marley_fine->Fill(adc_peak);
-                if (plane == "X") h_peak_X_marley_fine->Fill(adc_peak);
-                else if (plane == "U") h_peak_U_marley_fine->Fill(adc_peak);
-                else if (plane == "V") h_peak_V_marley_fine->Fill(adc_peak);
+                if (is_marley) {
+                    h_peak_all_marley_fine->Fill(adc_peak);
+                    if (plane == "X") h_peak_X_marley_fine->Fill(adc_peak);
+                    else if (plane == "U") h_peak_U_marley_fine->Fill(adc_peak);
+                    else if (plane == "V") h_peak_V_marley_fine->Fill(adc_peak);
                 
-                events_with_marley_truth.insert(tp_event);
-                if (plane == "X") event_has_marley_X.insert(tp_event);
-                else if (plane == "U") event_has_marley_U.insert(tp_event);
-                else if (plane == "V") event_has_marley_V.insert(tp_event);
-            }
+                    events_with_marley_truth.insert(tp_event);
+                    if (plane == "X") event_has_marley_X.insert(tp_event);
+                    else if (plane == "U") event_has_marley_U.insert(tp_event);
+                    else if (plane == "V") event_has_marley_V.insert(tp_event);
+                }
             
-            // Fill ToT histograms
-            h_tot_all->Fill(samples_over_threshold);
-            if (plane == "X") h_tot_X->Fill(samples_over_threshold);
-            else if (plane == "U") h_tot_U->Fill(samples_over_threshold);
-            else if (plane == "V") h_tot_V->Fill(samples_over_threshold);
+                // Fill ToT histograms
+                h_tot_all->Fill(samples_over_threshold);
+                if (plane == "X") h_tot_X->Fill(samples_over_threshold);
+                else if (plane == "U") h_tot_U->Fill(samples_over_threshold);
+                else if (plane == "V") h_tot_V->Fill(samples_over_threshold);
             
-            if (is_marley) {
-                h_tot_all_marley->Fill(samples_over_threshold);
-                if (plane == "X") h_tot_X_marley->Fill(samples_over_threshold);
-                else if (plane == "U") h_tot_U_marley->Fill(samples_over_threshold);
-                else if (plane == "V") h_tot_V_marley->Fill(samples_over_threshold);
-            }
+                if (is_marley) {
+                    h_tot_all_marley->Fill(samples_over_threshold);
+                    if (plane == "X") h_tot_X_marley->Fill(samples_over_threshold);
+                    else if (plane == "U") h_tot_U_marley->Fill(samples_over_threshold);
+                    else if (plane == "V") h_tot_V_marley->Fill(samples_over_threshold);
+                }
             
-            // Fill ADC vs ToT histograms
-            h_adc_vs_tot_all->Fill(samples_over_threshold, adc_peak);
-            if (plane == "X") h_adc_vs_tot_X->Fill(samples_over_threshold, adc_peak);
-            else if (plane == "U") h_adc_vs_tot_U->Fill(samples_over_threshold, adc_peak);
-            else if (plane == "V") h_adc_vs_tot_V->Fill(samples_over_threshold, adc_peak);
+                // Fill ADC vs ToT histograms
+                h_adc_vs_tot_all->Fill(samples_over_threshold, adc_peak);
+                if (plane == "X") h_adc_vs_tot_X->Fill(samples_over_threshold, adc_peak);
+                else if (plane == "U") h_adc_vs_tot_U->Fill(samples_over_threshold, adc_peak);
+                else if (plane == "V") h_adc_vs_tot_V->Fill(samples_over_threshold, adc_peak);
             
-            // Fill ADC integral histograms
-            h_int_all->Fill(adc_integral);
-            if (plane == "X") h_int_X->Fill(adc_integral);
-            else if (plane == "U") h_int_U->Fill(adc_integral);
-            else if (plane == "V") h_int_V->Fill(adc_integral);
+                // Fill ADC integral histograms
+                h_int_all->Fill(adc_integral);
+                if (plane == "X") h_int_X->Fill(adc_integral);
+                else if (plane == "U") h_int_U->Fill(adc_integral);
+                else if (plane == "V") h_int_V->Fill(adc_integral);
             
-            if (is_marley) {
-                h_int_all_marley->Fill(adc_integral);
-                if (plane == "X") h_int_X_marley->Fill(adc_integral);
-                else if (plane == "U") h_int_U_marley->Fill(adc_integral);
-                else if (plane == "V") h_int_V_marley->Fill(adc_integral);
-            }
+                if (is_marley) {
+                    h_int_all_marley->Fill(adc_integral);
+                    if (plane == "X") h_int_X_marley->Fill(adc_integral);
+                    else if (plane == "U") h_int_U_marley->Fill(adc_integral);
+                    else if (plane == "V") h_int_V_marley->Fill(adc_integral);
+                }
             
-            // Update label counts for analysis
-            label_tp_counts[*generator_name]++;
-            if (plane == "X") label_tp_counts_X_plane[*generator_name]++;
-            else if (plane == "U") label_tp_counts_U_plane[*generator_name]++;
-            else if (plane == "V") label_tp_counts_V_plane[*generator_name]++;
+                // Update label counts for analysis
+                const std::string& generator_name = store.get_generator_name(i);
+                label_tp_counts[generator_name]++;
+                if (plane == "X") label_tp_counts_X_plane[generator_name]++;
+                else if (plane == "U") label_tp_counts_U_plane[generator_name]++;
+                else if (plane == "V") label_tp_counts_V_plane[generator_name]++;
             
-            // Track events and channels for union computation
-            event_label_counts[tp_event][*generator_name]++;
-            if (is_marley) {
-                event_union_channels[tp_event].insert(ch_offline);
+                // Track events and channels for union computation
+                event_label_counts[tp_event][generator_name]++;
+                if (is_marley) {
+                    event_union_channels[tp_event].insert(store.get_channel(i));
+                    event_marley_adc_integral[tp_event] += adc_integral;
+                }
             }
         }
-        
-        // Clean up string pointers and file
-        delete generator_name;
-        delete view;
-        file->Close();
-        delete file;
+        if (n_file_tps == 0) {
+            LogWarning << "No trigger primitives found in file: " << input_file << std::endl;
+            continue;
+        }
+        if (verboseMode) LogInfo << "Found " << n_file_tps << " TPs" << std::endl;
     }
 
     LogInfo << "Finished processing all input files." << std::endl;
@@ -1120,28 +1055,9 @@ int main(int argc, char* argv[]) {
             int evt = kv.first;
             marley_adc_integral_sum[evt] = 0.0;
         }
-        // Loop over all TPs to accumulate MARLEY ADC integrals per event
-        for (const auto& input_file : inputs) {
-            TFile* file = TFile::Open(input_file.c_str(), "READ");
-            if (!file || file->IsZombie()) continue;
-            TTree* tpTree = (TTree*)file->Get("tps/tps");
-            if (!tpTree) { file->Close(); delete file; continue; }
-            Int_t tp_event = 0;
-            UInt_t adc_integral = 0;
-            std::string* generator_name = new std::string();
-            tpTree->SetBranchAddress("event", &tp_event);
-            tpTree->SetBranchAddress("adc_integral", &adc_integral);
-            tpTree->SetBranchAddress("generator_name", &generator_name);
-            for (Long64_t i = 0; i < tpTree->GetEntries(); ++i) {
-                tpTree->GetEntry(i);
-                std::string gen_lower = *generator_name;
-                std::transform(gen_lower.begin(), gen_lower.end(), gen_lower.begin(), [](unsigned char c){ return std::tolower(c); });
-                bool is_marley = (gen_lower.find("marley") != std::string::npos);
-                if (is_marley) {
-                    marley_adc_integral_sum[tp_event] += adc_integral;
-                }
-            }
-            file->Close(); delete file;
+        // MARLEY ADC integrals were accumulated per event while reading the TPs
+        for (const auto& kv : event_marley_adc_integral) {
+            marley_adc_integral_sum[kv.first] += kv.second;
         }
         // Now fill the graph
         for (const auto& kv : marley_adc_integral_sum) {
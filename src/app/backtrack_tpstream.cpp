@@ -15,6 +15,7 @@ int main(int argc, char* argv[]) {
     clp.addOption("bktrMargin", {"--bktr-margin"}, "Override backtracker_error_margin (int)");
     clp.addOption("maxFiles", {"--max-files"}, "Maximum number of files to process (overrides JSON max_files)");
     clp.addOption("skipFiles", {"--skip-files"}, "Number of files to skip at start (overrides JSON skip_files)");
+    clp.addOption("threads", {"-t", "--threads"}, "Number of threads backtracking files and events in parallel (default: 1)");
     clp.addDummyOption("Triggers");
     clp.addTriggerOption("verboseMode", {"-v", "--verbose"}, "Run in verbose mode");
     clp.addTriggerOption("debugMode", {"-d", "--debug"}, "Run in debug mode (more detailed than verbose)");
@@ -134,11 +135,24 @@ int main(int argc, char* argv[]) {
     
     LogInfo << "Output folder (pure signal TPs): " << outfolder << std::endl;
 
-    std::vector<std::string> output_files;
+    // ROOT tps tree or compact binary TP file (tps_format)
+    const std::string tps_extension = getTpsFileExtension(j);
+    LogInfo << "TP file format: " << (tps_extension == ".tpb" ? "binary" : "root") << std::endl;
+    const RootOutputSettings output_settings = getRootOutputSettings(j, "tps");
+    if (tps_extension == ".root") LogInfo << "ROOT output: " << output_settings.get_description() << std::endl;
 
-    std::vector<std::vector<TriggerPrimitive>> tps;
-    std::vector<std::vector<TrueParticle>> true_particles;
-    std::vector<std::vector<Neutrino>> neutrinos;
+    int n_threads = 1;
+    if (clp.isOptionTriggered("threads")) {
+        n_threads = std::max(1, clp.getOptionVal<int>("threads"));
+    }
+    // Files are spread over the threads first, the remaining threads split the events of each file
+    const int files_in_parallel = std::min<int>(n_threads, filenames.size());
+    const int threads_per_file = std::max(1, n_threads / files_in_parallel);
+    if (n_threads > 1) {
+        ROOT::EnableThreadSafety();
+        LogInfo << "Using " << n_threads << " threads: " << files_in_parallel << " file(s) in parallel, "
+                << threads_per_file << " thread(s) per file" << std::endl;
+    }
 
     // Effective time window for TP<->truth association in TDC ticks (base 1 TPC sample + margin in TPC samples)
     int effective_time_window = (1 + bktr_margin) * conversion_tdc_to_tpc;
@@ -151,106 +165,89 @@ int main(int argc, char* argv[]) {
     }
     LogInfo << "Channel tolerance (channels): " << channel_tolerance << std::endl;
 
+    std::vector<std::string> output_files_by_input(filenames.size());
+    std::vector<BacktrackingThreadStats> thread_stats(files_in_parallel * threads_per_file);
+    std::atomic<int> next_file(0);
     int done_files = 0;
+    std::mutex progress_mutex;
 
-    for (auto& filename : filenames) {
+    auto process_files = [&](int iWorker) {
+        std::vector<BacktrackingThreadStats> file_thread_stats;
+        for (int iFile = next_file++; iFile < (int)filenames.size(); iFile = next_file++) {
+            const std::string& filename = filenames[iFile];
 
-        done_files++;
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                done_files++;
+                GenericToolbox::displayProgressBar(done_files, filenames.size(), "Processing files...");
+            }
 
-        GenericToolbox::displayProgressBar(done_files, filenames.size(), "Processing files...");
+            // Compute expected output path early to allow skip-if-exists behavior
+            std::string input_basename = filename.substr(filename.find_last_of("/\\") + 1);
+            input_basename = input_basename.substr(0, input_basename.length() - 14); // remove _tpstream.root
+            std::ostringstream suffix;
+            if (bktr_margin != standard_backtracker_error_margin) {
+                suffix << "_tps_bktr" << bktr_margin << tps_extension;
+            } else {
+                suffix << "_tps" << tps_extension;
+            }
+            std::string out = outfolder + "/" + input_basename + suffix.str();
+            // Use absolute path for output
+            std::error_code _ec_abs;
+            std::filesystem::path out_abs_p = std::filesystem::absolute(std::filesystem::path(out), _ec_abs);
+            std::string out_abs = _ec_abs ? out : out_abs_p.string();
 
-        // Compute expected output path early to allow skip-if-exists behavior
-        std::string input_basename = filename.substr(filename.find_last_of("/\\") + 1);
-        input_basename = input_basename.substr(0, input_basename.length() - 14); // remove _tpstream.root
-        std::ostringstream suffix;
-        if (bktr_margin != standard_backtracker_error_margin) {
-            suffix << "_tps_bktr" << bktr_margin << ".root";
-        } else {
-            suffix << "_tps.root";
-        }
-        std::string out = outfolder + "/" + input_basename + suffix.str();
-        // Use absolute path for output
-        std::error_code _ec_abs;
-        std::filesystem::path out_abs_p = std::filesystem::absolute(std::filesystem::path(out), _ec_abs);
-        std::string out_abs = _ec_abs ? out : out_abs_p.string();
+            // Skip processing if output already exists and override is not set
+            if (!overrideMode && file_exists(out_abs)) {
+                LogInfo << "Output already exists, skipping: " << out_abs 
+                        << " (use --override to force reprocessing)" << std::endl;
+                output_files_by_input[iFile] = out_abs;
+                continue;
+            }
 
-        // Skip processing if output already exists and override is not set
-        if (!overrideMode && file_exists(out_abs)) {
-            LogInfo << "Output already exists, skipping: " << out_abs 
-                    << " (use --override to force reprocessing)" << std::endl;
-            done_files--;
-            output_files.push_back(out_abs);
-            continue;
-        }
+            if (verboseMode) LogInfo << "Reading file: " << filename << std::endl;
+            // Open, index and bind the file once per thread, then stream it event by event
+            if (!backtrack_tpstream_file(filename, out_abs, static_cast<double>(effective_time_window), channel_tolerance, threads_per_file, file_thread_stats, output_settings)) {
+                continue;
+            }
+            output_files_by_input[iFile] = out_abs;
 
-        if (verboseMode) LogInfo << "Reading file: " << filename << std::endl;
-        // count events
-        // using this tree just because it's the smallest
-        std::string MCtree_path = "triggerAnaDumpTPs/mctruths";
-        TFile *file = TFile::Open(filename.c_str());
-        if (!file || file->IsZombie()) { LogError << "Failed to open file: " << filename << std::endl; continue; }
-        // TTree *TPtree = dynamic_cast<TTree*>(file->Get(TPtree_path.c_str()));
-        // if (!TPtree) { LogError << "Tree not found: " << TPtree_path << std::endl; file->Close(); delete file; continue; }
-        TTree *MCtree = dynamic_cast<TTree*>(file->Get(MCtree_path.c_str()));
-        int n_events = 0;
-        UInt_t this_event_number = 0;
-        if (!MCtree) { LogError << "Tree not found: " << MCtree_path << std::endl; file->Close(); delete file; continue; }
-        if (MCtree) {
-            MCtree->SetBranchAddress("Event", &this_event_number);
-            std::set<UInt_t> unique_events;
-            for (Long64_t i = 0; i < MCtree->GetEntries(); ++i) {
-                MCtree->GetEntry(i);
-                unique_events.insert(this_event_number);
+            for (size_t iThread = 0; iThread < file_thread_stats.size(); ++iThread) {
+                BacktrackingThreadStats& stats = thread_stats.at(iWorker * threads_per_file + iThread);
+                stats.n_events += file_thread_stats[iThread].n_events;
+                stats.n_tps += file_thread_stats[iThread].n_tps;
+                stats.busy_seconds += file_thread_stats[iThread].busy_seconds;
             }
-            n_events = unique_events.size();
-            if (verboseMode) LogInfo << " Found " << n_events << " unique events in tree: " << MCtree_path << std::endl;
         }
-        
-        MCtree->GetEntry(0);
-        int first_event = this_event_number;
-
-        if (verboseMode) LogInfo << "Number of events in file: " << n_events << std::endl;
-        file->Close(); delete file; file = nullptr;
+    };
 
-        tps.clear(); true_particles.clear(); neutrinos.clear();
-        tps.resize(n_events); true_particles.resize(n_events); neutrinos.resize(n_events);
+    auto start_processing = std::chrono::steady_clock::now();
+    if (files_in_parallel == 1) {
+        process_files(0);
+    } else {
+        std::vector<std::thread> file_workers;
+        for (int iWorker = 0; iWorker < files_in_parallel; ++iWorker) {
+            file_workers.emplace_back(process_files, iWorker);
+        }
+        for (auto& worker : file_workers) worker.join();
+    }
+    std::chrono::duration<double> processing_time = std::chrono::steady_clock::now() - start_processing;
 
-        // loop over events
-        for (int iEvent = first_event; iEvent < first_event + n_events; ++iEvent) {
-            int event_index = iEvent - first_event;
-            if (verboseMode) LogInfo << "Reading event " << iEvent << std::endl;
-            if (debugMode) LogDebug << "Beginning read_tpstream for event " << iEvent << std::endl;
-            
-            read_tpstream(
-                filename,
-                tps.at(event_index),
-                true_particles.at(event_index),
-                neutrinos.at(iEvent - first_event),
-                /*supernova_option*/0,
-                iEvent,
-                static_cast<double>(effective_time_window),
-                channel_tolerance
-            );
+    // Output files in the same order as the inputs, whatever the number of threads
+    std::vector<std::string> output_files;
+    for (const auto& out : output_files_by_input) {
+        if (!out.empty()) output_files.push_back(out);
+    }
 
-            // Summarise direct TP-to-truth associations built inside read_tpstream
-            int matched_tps_counter = 0;
-            for (const auto& tp : tps.at(event_index)) {
-                if (tp.GetTrueParticle() != nullptr) { matched_tps_counter++; }
-            }
-            if (verboseMode) LogInfo << "Matched " << matched_tps_counter << "/" << tps.at(event_index).size() 
-                << " TPs to true particles via SimIDE association." << std::endl;
-                    
-            if (debugMode) {
-                LogDebug << "Event " << iEvent << " processing complete with " 
-                         << tps.at(event_index).size() << " TPs and " 
-                         << true_particles.at(event_index).size() << " true particles" << std::endl;
-            }
+    if (n_threads > 1 || verboseMode) {
+        LogInfo << "Backtracking throughput per thread (total wall time " << processing_time.count() << " s):" << std::endl;
+        for (size_t iThread = 0; iThread < thread_stats.size(); ++iThread) {
+            const auto& stats = thread_stats[iThread];
+            double events_per_second = stats.busy_seconds > 0 ? stats.n_events / stats.busy_seconds : 0.0;
+            double tps_per_second = stats.busy_seconds > 0 ? stats.n_tps / stats.busy_seconds : 0.0;
+            LogInfo << " - thread " << iThread << ": " << stats.n_events << " events, " << stats.n_tps << " TPs in "
+                    << stats.busy_seconds << " s (" << events_per_second << " events/s, " << tps_per_second << " TPs/s)" << std::endl;
         }
-
-        // write *_tps_bktr<N>.root where N is backtracker_error_margin
-        if (verboseMode) LogInfo << "Writing output to: " << out_abs << std::endl;
-        write_tps(out_abs, tps, true_particles, neutrinos);
-        output_files.push_back(out_abs);
     }
 
     LogInfo << "\nList of output files (" << output_files.size() << "):" << std::endl;
@@ -0,0 +1,225 @@
+#include "Backtracking.h"
+#include "Clustering.h"
+
+#include <iomanip>
+
+LoggerInit([]{
+  Logger::getUserHeader() << "[" << FILENAME << "]";
+});
+
+namespace {
+
+// One output policy to measure
+struct BenchmarkCase {
+    std::string name;
+    RootOutputSettings settings;
+    bool binary = false; // *.tpb instead of the tps tree (TPs only)
+};
+
+struct BenchmarkResult {
+    double write_seconds = 0.0;
+    double read_seconds = 0.0;
+    uintmax_t bytes = 0;
+};
+
+RootOutputSettings make_settings(const nlohmann::json& root_output) {
+    return getRootOutputSettings(nlohmann::json{{"root_output", root_output}});
+}
+
+std::vector<BenchmarkCase> get_default_cases() {
+    std::vector<BenchmarkCase> cases;
+    cases.push_back({"root default", RootOutputSettings()});
+    cases.push_back({"none", make_settings({{"compression", "none"}})});
+    cases.push_back({"zlib-1", make_settings({{"compression", "zlib"}, {"compression_level", 1}})});
+    cases.push_back({"lz4-4", make_settings({{"compression", "lz4"}, {"compression_level", 4}})});
+    cases.push_back({"lz4-4 32MB/256k", make_settings({{"compression", "lz4"}, {"compression_level", 4},
+                                                       {"auto_flush", -32000000}, {"basket_size", 256000}})});
+    cases.push_back({"zstd-5", make_settings({{"compression", "zstd"}, {"compression_level", 5}})});
+    cases.push_back({"lzma-8", make_settings({{"compression", "lzma"}, {"compression_level", 8}})});
+    BenchmarkCase binary;
+    binary.name = "binary tpb";
+    binary.binary = true;
+    cases.push_back(binary);
+    return cases;
+}
+
+double seconds_since(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Best of n_repeats for each of write and read
+BenchmarkResult benchmark_tps(const std::vector<std::vector<TriggerPrimitive>>& events, const std::string& out_filename,
+                              const RootOutputSettings& settings, int n_repeats) {
+    BenchmarkResult result;
+    result.write_seconds = result.read_seconds = std::numeric_limits<double>::max();
+    for (int iRepeat = 0; iRepeat < n_repeats; ++iRepeat) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            TpsWriter writer(out_filename, settings);
+            for (const auto& tps : events) writer.write_event(tps);
+            writer.close();
+        }
+        result.write_seconds = std::min(result.write_seconds, seconds_since(start));
+
+        start = std::chrono::steady_clock::now();
+        size_t n_tps = 0;
+        TpsReader reader(out_filename);
+        while (reader.next()) n_tps += reader.get_tps().size();
+        reader.close();
+        result.read_seconds = std::min(result.read_seconds, seconds_since(start));
+        if (n_tps == 0) LogWarning << "No TPs read back from " << out_filename << std::endl;
+    }
+    result.bytes = std::filesystem::file_size(out_filename);
+    return result;
+}
+
+BenchmarkResult benchmark_clusters(std::vector<ClusterSet>& clusters_per_view, const std::string& out_filename,
+                                   const RootOutputSettings& settings, int n_repeats) {
+    BenchmarkResult result;
+    result.write_seconds = result.read_seconds = std::numeric_limits<double>::max();
+    for (int iRepeat = 0; iRepeat < n_repeats; ++iRepeat) {
+        auto start = std::chrono::steady_clock::now();
+        TFile* file = new TFile(out_filename.c_str(), "RECREATE");
+        applyRootOutputSettings(file, settings);
+        TDirectory* dir = file->mkdir("clusters");
+        for (size_t iView = 0; iView < APA::views.size(); ++iView) {
+            ClusterTreeWriter writer(dir, APA::views.at(iView), settings);
+            writer.fill(clusters_per_view.at(iView).clusters());
+            writer.close();
+        }
+        file->Close();
+        delete file;
+        result.write_seconds = std::min(result.write_seconds, seconds_since(start));
+
+        start = std::chrono::steady_clock::now();
+        for (const auto& view : APA::views) {
+            ClusterSet clusters = read_clusters_from_tree(out_filename, view);
+        }
+        result.read_seconds = std::min(result.read_seconds, seconds_since(start));
+    }
+    result.bytes = std::filesystem::file_size(out_filename);
+    return result;
+}
+
+void print_results(const std::string& title, const std::vector<std::string>& names, const std::vector<BenchmarkResult>& results) {
+    LogInfo << title << std::endl;
+    std::ostringstream header;
+    header << std::left << std::setw(20) << "setting" << std::right << std::setw(12) << "size [kB]"
+           << std::setw(10) << "ratio" << std::setw(14) << "write [ms]" << std::setw(14) << "read [ms]";
+    LogInfo << header.str() << std::endl;
+    const double reference = results.empty() ? 1.0 : static_cast<double>(results.front().bytes);
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::ostringstream line;
+        line << std::left << std::setw(20) << names.at(i) << std::right << std::fixed
+             << std::setw(12) << results[i].bytes / 1024
+             << std::setw(10) << std::setprecision(2) << results[i].bytes / reference
+             << std::setw(14) << std::setprecision(1) << results[i].write_seconds * 1e3
+             << std::setw(14) << std::setprecision(1) << results[i].read_seconds * 1e3;
+        LogInfo << line.str() << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    CmdLineParser clp;
+    clp.getDescription() << "> benchmark_root_output app - Write and read back a TPs file (and a clusters file) with several compression and basket settings, reporting size and timings." << std::endl;
+    clp.addDummyOption("Main options");
+    clp.addOption("tpsFile", {"-i", "--input-file"}, "TPs file (*_tps.root or *_tps.tpb)");
+    clp.addOption("clustersFile", {"-c", "--clusters-file"}, "Clusters file (*_clusters.root), optional");
+    clp.addOption("json", {"-j", "--json"}, "JSON file: its root_output is benchmarked too, and a benchmark_root_output list of {name, root_output keys} replaces the default settings");
+    clp.addOption("outFolder", {"--output-folder"}, "Folder for the temporary files (default: next to the TPs file)");
+    clp.addOption("repeats", {"-n", "--repeats"}, "Number of write/read repetitions, the best time is kept (default: 3)", 3);
+    clp.addTriggerOption("verboseMode", {"-v", "--verbose"}, "Run in verbose mode");
+    clp.addDummyOption();
+
+    LogInfo << clp.getDescription().str() << std::endl;
+    LogInfo << "Usage: " << std::endl;
+    LogInfo << clp.getConfigSummary() << std::endl << std::endl;
+
+    clp.parseCmdLine(argc, argv);
+    LogThrowIf( clp.isNoOptionTriggered(), "No option was provided." );
+    LogThrowIf( !clp.isOptionTriggered("tpsFile"), "No TPs file was provided (-i)." );
+
+    verboseMode = clp.isOptionTriggered("verboseMode");
+    ParametersManager::getInstance().loadParameters();
+
+    const std::string tps_file = clp.getOptionVal<std::string>("tpsFile");
+    const int n_repeats = clp.isOptionTriggered("repeats") ? std::max(1, clp.getOptionVal<int>("repeats")) : 3;
+    std::string out_folder = std::filesystem::path(tps_file).parent_path().string();
+    if (clp.isOptionTriggered("outFolder")) out_folder = clp.getOptionVal<std::string>("outFolder");
+    if (out_folder.empty()) out_folder = ".";
+    LogThrowIf(!ensureDirectoryExists(out_folder), "Unable to create output folder '" << out_folder << "'.");
+
+    // Settings to compare
+    std::vector<BenchmarkCase> cases = get_default_cases();
+    if (clp.isOptionTriggered("json")) {
+        std::ifstream i(clp.getOptionVal<std::string>("json"));
+        LogThrowIf(!i.good(), "Failed to open JSON config: " << clp.getOptionVal<std::string>("json"));
+        nlohmann::json j;
+        i >> j;
+        if (j.contains("benchmark_root_output") && j["benchmark_root_output"].is_array()) {
+            cases.clear();
+            for (const auto& entry : j["benchmark_root_output"]) {
+                BenchmarkCase benchmark_case;
+                benchmark_case.name = entry.value("name", std::string("case ") + std::to_string(cases.size()));
+                benchmark_case.binary = entry.value("binary", false);
+                benchmark_case.settings = make_settings(entry);
+                cases.push_back(benchmark_case);
+            }
+        }
+        if (j.contains("root_output")) cases.push_back({"json", getRootOutputSettings(j)});
+    }
+
+    // Inputs are held in memory, so that only the output is measured
+    std::vector<std::vector<TriggerPrimitive>> events;
+    size_t n_tps = 0;
+    {
+        TpsReader reader(tps_file);
+        LogThrowIf(!reader.is_open(), "Cannot read TPs from: " << tps_file);
+        while (reader.next()) {
+            n_tps += reader.get_tps().size();
+            events.emplace_back(std::move(reader.get_tps()));
+        }
+    }
+    LogInfo << "TPs: " << events.size() << " events, " << n_tps << " TPs from " << tps_file << std::endl;
+
+    std::vector<ClusterSet> clusters_per_view;
+    if (clp.isOptionTriggered("clustersFile")) {
+        const std::string clusters_file = clp.getOptionVal<std::string>("clustersFile");
+        size_t n_clusters = 0;
+        for (const auto& view : APA::views) {
+            clusters_per_view.emplace_back(read_clusters_from_tree(clusters_file, view));
+            n_clusters += clusters_per_view.back().size();
+        }
+        LogInfo << "Clusters: " << n_clusters << " clusters from " << clusters_file << std::endl;
+    }
+
+    std::vector<std::string> tps_names, clusters_names;
+    std::vector<BenchmarkResult> tps_results, clusters_results;
+    for (size_t iCase = 0; iCase < cases.size(); ++iCase) {
+        const BenchmarkCase& benchmark_case = cases[iCase];
+        if (verboseMode) LogInfo << "Setting " << benchmark_case.name << ": "
+                                 << (benchmark_case.binary ? "binary" : benchmark_case.settings.get_description()) << std::endl;
+
+        const std::string tps_out = out_folder + "/benchmark_" + std::to_string(iCase) + "_tps"
+                                  + (benchmark_case.binary ? tp_binary::extension : ".root");
+        tps_names.push_back(benchmark_case.name);
+        tps_results.push_back(benchmark_tps(events, tps_out, benchmark_case.settings, n_repeats));
+        std::filesystem::remove(tps_out);
+
+        if (!clusters_per_view.empty() && !benchmark_case.binary) {
+            const std::string clusters_out = out_folder + "/benchmark_" + std::to_string(iCase) + "_clusters.root";
+            clusters_names.push_back(benchmark_case.name);
+            clusters_results.push_back(benchmark_clusters(clusters_per_view, clusters_out, benchmark_case.settings, n_repeats));
+            std::filesystem::remove(clusters_out);
+        }
+    }
+
+    print_results("TPs file (best of " + std::to_string(n_repeats) + ")", tps_names, tps_results);
+    if (!clusters_results.empty()) {
+        print_results("Clusters file (best of " + std::to_string(n_repeats) + ")", clusters_names, clusters_results);
+    }
+
+    return 0;
+}
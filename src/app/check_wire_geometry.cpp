@@ -0,0 +1,74 @@
+#include "Backtracking.h"
+#include "Geometry.h"
+
+#include <random>
+
+LoggerInit([]{
+  Logger::getUserHeader() << "[" << FILENAME << "]";
+});
+
+int main(int argc, char* argv[]) {
+    CmdLineParser clp;
+    clp.getDescription() << "> check_wire_geometry app - Compare the y of the induction wires in the wire geometry table (eval_y_knowing_z) with the per-TP formulas (eval_y_knowing_z_U_plane/_V_plane) on random channels, z and drift sides." << std::endl;
+    clp.addDummyOption("Main options");
+    clp.addOption("samples", {"-n", "--samples"}, "Number of random (channel, z, side) samples (default: 200000)", 200000);
+    clp.addOption("tolerance", {"--tolerance"}, "Largest accepted difference in cm (default: 1e-3)", 1e-3);
+    clp.addOption("seed", {"--seed"}, "Seed of the random samples (default: 1)", 1);
+    clp.addTriggerOption("verboseMode", {"-v", "--verbose"}, "Run in verbose mode");
+    clp.addDummyOption();
+
+    LogInfo << clp.getDescription().str() << std::endl;
+    LogInfo << "Usage: " << std::endl;
+    LogInfo << clp.getConfigSummary() << std::endl << std::endl;
+
+    clp.parseCmdLine(argc, argv);
+
+    verboseMode = clp.isOptionTriggered("verboseMode");
+    ParametersManager::getInstance().loadParameters();
+
+    const int n_samples = clp.isOptionTriggered("samples") ? clp.getOptionVal<int>("samples") : 200000;
+    const double tolerance = clp.isOptionTriggered("tolerance") ? clp.getOptionVal<double>("tolerance") : 1e-3;
+    const int seed = clp.isOptionTriggered("seed") ? clp.getOptionVal<int>("seed") : 1;
+
+    // Two APA pairs cover both parities and a non-zero z offset; z spans a little beyond each APA
+    const double apa_length = get_apa_length_cm();
+    const double pair_length = apa_length + get_offset_between_apa_cm();
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> random_apa(0, 3);
+    std::uniform_int_distribution<int> random_channel(0, APA::induction_channels * 2 - 1);
+    std::uniform_real_distribution<double> random_z(-5.0, apa_length + 5.0);
+
+    double max_difference = 0.0;
+    int n_failed = 0;
+    for (int i = 0; i < n_samples; ++i) {
+        const int apa = random_apa(rng);
+        const int local = random_channel(rng);
+        const int channel = apa * APA::total_channels + local;
+        const float z = static_cast<float>((apa / 2) * pair_length + random_z(rng));
+        const float x_sign = rng() % 2 ? 1.0f : -1.0f;
+
+        TriggerPrimitive tp(2, 0, 0, channel, 5, 100, 1, 10, 10);
+        std::vector<TriggerPrimitive*> tps{&tp};
+        const bool is_u = local < APA::induction_channels;
+        const float y_formula = is_u ? eval_y_knowing_z_U_plane(tps, z, x_sign) : eval_y_knowing_z_V_plane(tps, z, x_sign);
+        const float y_table = eval_y_knowing_z(tps, is_u ? TPView::U : TPView::V, z, x_sign);
+
+        const double difference = std::abs(static_cast<double>(y_formula) - y_table);
+        max_difference = std::max(max_difference, difference);
+        if (difference > tolerance) {
+            if (n_failed < 10) {
+                LogError << "Channel " << channel << ", z " << z << ", x sign " << x_sign << ": y " << y_table
+                         << " from the table, " << y_formula << " from the formulas" << std::endl;
+            }
+            n_failed++;
+        }
+    }
+
+    LogInfo << n_samples << " samples, largest difference " << max_difference << " cm (tolerance " << tolerance << " cm)" << std::endl;
+    if (n_failed > 0) {
+        LogError << n_failed << " samples beyond the tolerance" << std::endl;
+        return 1;
+    }
+    LogInfo << "Wire geometry table matches the formulas." << std::endl;
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "Backtracking.h"
+#include "Clustering.h"
+
+LoggerInit([]{
+  Logger::getUserHeader() << "[" << FILENAME << "]";
+});
+
+int main(int argc, char* argv[]) {
+    CmdLineParser clp;
+    clp.getDescription() << "> convert_tps app - Convert TP files between the ROOT tps tree (*_tps.root) and the compact binary format (*_tps.tpb)." << std::endl;
+    clp.addDummyOption("Main options");
+    clp.addOption("inputFile", {"-i", "--input-file"}, "TP file to convert (*.root or *.tpb)");
+    clp.addOption("outputFile", {"-o", "--output-file"}, "Output file, its extension selects the format (default: input with the other extension)");
+    clp.addTriggerOption("verboseMode", {"-v", "--verbose"}, "Run in verbose mode");
+    clp.addTriggerOption("override", {"-f", "--override"}, "Override existing output file");
+    clp.addDummyOption();
+
+    LogInfo << clp.getDescription().str() << std::endl;
+    LogInfo << "Usage: " << std::endl;
+    LogInfo << clp.getConfigSummary() << std::endl << std::endl;
+
+    clp.parseCmdLine(argc, argv);
+    LogThrowIf( clp.isNoOptionTriggered(), "No option was provided." );
+    LogThrowIf( !clp.isOptionTriggered("inputFile"), "No input file was provided (-i)." );
+
+    verboseMode = clp.isOptionTriggered("verboseMode");
+    bool overrideMode = clp.isOptionTriggered("override");
+
+    // Load parameters
+    ParametersManager::getInstance().loadParameters();
+
+    std::string input_file = clp.getOptionVal<std::string>("inputFile");
+    std::string output_file;
+    if (clp.isOptionTriggered("outputFile")) {
+        output_file = clp.getOptionVal<std::string>("outputFile");
+    } else {
+        std::filesystem::path output_path(input_file);
+        output_path.replace_extension(tp_binary::is_binary_filename(input_file) ? ".root" : tp_binary::extension);
+        output_file = output_path.string();
+    }
+    LogThrowIf(output_file == input_file, "Input and output files are the same: " << input_file);
+    LogThrowIf(std::filesystem::exists(output_file) && !overrideMode,
+               "Output file already exists (use --override to overwrite): " << output_file);
+
+    LogInfo << "Input: " << input_file << std::endl;
+    LogInfo << "Output: " << output_file << " (" << (tp_binary::is_binary_filename(output_file) ? "binary" : "root") << ")" << std::endl;
+
+    // Events are converted one at a time, in file order
+    TpsReader reader(input_file);
+    LogThrowIf(!reader.is_open(), "Cannot read TPs from: " << input_file);
+    TpsWriter writer(output_file);
+    LogThrowIf(!writer.is_open(), "Cannot write TPs to: " << output_file);
+
+    int n_events = 0;
+    size_t n_tps = 0;
+    while (reader.next()) {
+        writer.write_event(reader.get_tps());
+        n_events++;
+        n_tps += reader.get_tps().size();
+    }
+    writer.close();
+    reader.close();
+
+    std::error_code ec;
+    const auto input_size = std::filesystem::file_size(input_file, ec);
+    const auto output_size = ec ? 0 : std::filesystem::file_size(output_file, ec);
+    LogInfo << "Converted " << n_events << " events, " << n_tps << " TPs" << std::endl;
+    if (!ec) LogInfo << "File size: " << input_size / 1024 << " kB -> " << output_size / 1024 << " kB" << std::endl;
+
+    return 0;
+}
@@ -85,7 +85,8 @@ int main(int argc, char* argv[]) {
     std::vector<TriggerPrimitive*> tps;
     for (int i = 0; i < tps_object.size(); i++) tps.push_back(&tps_object[i]);
     
-    std::vector<Cluster> clusters           = read_clusters(cluster_filename);
+    ClusterSet cluster_set                  = read_clusters(cluster_filename);
+    std::vector<Cluster>& clusters          = cluster_set.clusters();
     std::vector<float> predictions_vector   = read_predictions(predictions);
 
     LogInfo << "Number of clusters: " << clusters.size() << std::endl;
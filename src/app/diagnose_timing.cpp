@@ -111,9 +111,14 @@ int main(int argc, char* argv[]) {
         std::cout << "\n=== File " << (file_idx+1) << ": " << input_file << " ===" << std::endl;
         
         // Load clusters
-        std::vector<Cluster> clusters_u = read_clusters_from_tree(input_file, "U");
-        std::vector<Cluster> clusters_v = read_clusters_from_tree(input_file, "V");
-        std::vector<Cluster> clusters_x = read_clusters_from_tree(input_file, "X");
+        // Only the branches used below are read
+        const uint32_t needed_columns = cluster_columns::id | cluster_columns::true_pos | cluster_columns::tp_time | cluster_columns::tp_channel;
+        ClusterSet cluster_set_u = read_clusters_from_tree(input_file, "U", "clusters", needed_columns);
+        std::vector<Cluster>& clusters_u = cluster_set_u.clusters();
+        ClusterSet cluster_set_v = read_clusters_from_tree(input_file, "V", "clusters", needed_columns);
+        std::vector<Cluster>& clusters_v = cluster_set_v.clusters();
+        ClusterSet cluster_set_x = read_clusters_from_tree(input_file, "X", "clusters", needed_columns);
+        std::vector<Cluster>& clusters_x = cluster_set_x.clusters();
         
         int n_main_x = 0;
         for (const auto& c : clusters_x) {
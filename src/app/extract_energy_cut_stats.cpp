@@ -41,6 +41,10 @@ ClusterStats analyze_cluster_file(const std::string& filepath) {
     Float_t marley_tp_fraction = 0;
     Bool_t is_main_cluster = false;
     
+    // Only these two branches are read, not the TP vectors
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("marley_tp_fraction", 1);
+    tree->SetBranchStatus("is_main_cluster", 1);
     tree->SetBranchAddress("marley_tp_fraction", &marley_tp_fraction);
     tree->SetBranchAddress("is_main_cluster", &is_main_cluster);
     
@@ -13,6 +13,7 @@ int main(int argc, char* argv[]) {
     clp.addOption("apa", {"-a", "--apa", "--apa-filter"}, "Filter TPs by APA index (e.g. 1 for APA1). Use -1 to disable.", -1);
     clp.addOption("override", {"-f", "--override"}, "Override existing output files (default: false)", false);
     clp.addOption("outFolder", {"--output-folder"}, "Output folder path (default: data)");
+    clp.addOption("threads", {"-t", "--threads"}, "Number of threads clustering (event, view, APA) groups in parallel (default: 1)", 1);
     clp.addTriggerOption("verboseMode", {"-v"}, "RunVerboseMode, bool");
     clp.addTriggerOption("debugMode", {"-d"}, "Run in debug mode (more detailed than verbose)");
     clp.addDummyOption();
@@ -49,6 +50,10 @@ int main(int argc, char* argv[]) {
     if (clp.isOptionTriggered("apa")) {
         apa_filter = clp.getOptionVal<int>("apa");
     }
+    int n_threads = 1;
+    if (clp.isOptionTriggered("threads")) {
+        n_threads = std::max(1, clp.getOptionVal<int>("threads"));
+    }
 
     // Use tpstream-based file tracking for consistent skip/max across pipeline
     // By default, load tps_bg files (TPs with backgrounds merged)
@@ -58,7 +63,7 @@ int main(int argc, char* argv[]) {
     if (clp.isOptionTriggered("inputFile")) {
         std::string input_file = clp.getOptionVal<std::string>("inputFile");
         inputs.clear();
-        if (input_file.find("_tps.root") != std::string::npos) {
+        if (input_file.find("_tps.root") != std::string::npos || input_file.find("_tps.tpb") != std::string::npos) {
             inputs.push_back(input_file);
         } else {
             std::ifstream lf(input_file);
@@ -108,6 +113,7 @@ int main(int argc, char* argv[]) {
     float adc_integral_cut_col = energy_cut * ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_collection");
     float adc_integral_cut_ind = energy_cut * ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_induction");
     int tot_cut = j.value("tot_cut", 0);
+    const RootOutputSettings output_settings = getRootOutputSettings(j, "clusters");
 
     // Get output folder: CLI > clusters_folder > outputFolder > default
     std::string clusters_folder_path;
@@ -129,13 +135,15 @@ int main(int argc, char* argv[]) {
     LogInfo << "    - ADC integral cut (collection): " << adc_integral_cut_col << std::endl;
     LogInfo << " - ToT cut: " << tot_cut << std::endl;
     LogInfo << " - APA filter: " << (apa_filter >= 0 ? std::to_string(apa_filter) : std::string("disabled")) << std::endl;
+    LogInfo << " - Threads: " << n_threads << std::endl;
+    LogInfo << " - Output: " << output_settings.get_description() << std::endl;
     LogInfo << " - Files to process (after skip/max): " << inputs.size() << std::endl;
 
     // Create clusters subfolder if it doesn't exist
     std::filesystem::create_directories(clusters_folder_path);    
 
     // Helper lambda to create metadata tree
-    auto create_metadata_tree = [&](TFile* file) {
+    auto create_metadata_tree = [&](TFile* file, bool time_sorted) {
         file->cd();
         TTree* metadata_tree = new TTree("clustering_metadata", "Clustering parameters used");
         
@@ -148,6 +156,7 @@ int main(int argc, char* argv[]) {
         float meta_energy_cut = energy_cut;
         float meta_adc_to_mev_collection = ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_collection");
         float meta_adc_to_mev_induction = ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_induction");
+        int meta_time_sorted = time_sorted ? 1 : 0;
         
         metadata_tree->Branch("tick_limit", &meta_tick_limit, "tick_limit/I");
         metadata_tree->Branch("channel_limit", &meta_channel_limit, "channel_limit/I");
@@ -158,6 +167,8 @@ int main(int argc, char* argv[]) {
         metadata_tree->Branch("energy_cut", &meta_energy_cut, "energy_cut/F");
         metadata_tree->Branch("adc_to_mev_collection", &meta_adc_to_mev_collection, "adc_to_mev_collection/F");
         metadata_tree->Branch("adc_to_mev_induction", &meta_adc_to_mev_induction, "adc_to_mev_induction/F");
+        // 1 if the clusters of every view are in (event, earliest TP time start) order, so match_clusters needs no sort
+        metadata_tree->Branch("time_sorted", &meta_time_sorted, "time_sorted/I");
         
         metadata_tree->Fill();
         metadata_tree->Write();
@@ -173,13 +184,14 @@ int main(int argc, char* argv[]) {
         std::filesystem::path tps_path(tps_file);
         std::string base_name = tps_path.filename().string();
         
-        // Replace _tps.root with _clusters.root
-        size_t tps_pos = base_name.find("_tps.root");
+        // Replace _tps.root (or _tps.tpb) with _clusters.root
+        const std::string tps_suffix = tp_binary::is_binary_filename(base_name) ? "_tps.tpb" : "_tps.root";
+        size_t tps_pos = base_name.find(tps_suffix);
         if (tps_pos == std::string::npos) {
             LogWarning << "File doesn't match expected *_tps.root pattern: " << tps_file << std::endl;
             continue;
         }
-        base_name.replace(tps_pos, 9, "_clusters.root");
+        base_name.replace(tps_pos, tps_suffix.size(), "_clusters.root");
         
         std::string current_clusters_filename = clusters_folder_path + "/" + base_name;
         
@@ -208,32 +220,11 @@ int main(int argc, char* argv[]) {
         
         GenericToolbox::displayProgressBar(done_files, (int)inputs.size(), "Making clusters...");
 
-        // Read TPs
-        std::map<int, std::vector<TriggerPrimitive>> tps_by_event;
-        std::map<int, std::vector<TrueParticle>> true_by_event;
-        std::map<int, std::vector<Neutrino>> nu_by_event;
-        
-        read_tps(tps_file, tps_by_event, true_by_event, nu_by_event);
-
-        if (apa_filter >= 0) {
-            for (auto& kv : tps_by_event) {
-                auto& vec = kv.second;
-                vec.erase(
-                    std::remove_if(vec.begin(), vec.end(), [&](const TriggerPrimitive &tp){ return tp.GetDetector() != apa_filter; }),
-                    vec.end()
-                );
-            }
-        }
-
-        // Apply ToT cut to TPs if requested
-        if (tot_cut > 0) {
-            for (auto &kv : tps_by_event) {
-                auto &vec = kv.second;
-                vec.erase(
-                    std::remove_if(vec.begin(), vec.end(), [&](const TriggerPrimitive &tp){ return (int)tp.GetSamplesOverThreshold() <= tot_cut; }),
-                    vec.end()
-                );
-            }
+        // TPs are streamed event by event (see TpsReader), the file is never held in memory
+        TpsReader reader(tps_file);
+        if (!reader.is_open()) {
+            LogError << "Failed to read TPs from: " << tps_file << std::endl;
+            continue;
         }
 
         // Create output file
@@ -243,124 +234,165 @@ int main(int argc, char* argv[]) {
             if (clusters_file) delete clusters_file;
             continue;
         }
+        applyRootOutputSettings(clusters_file, output_settings);
 
-        // Create directories for clusters and discarded clusters
-        clusters_file->mkdir("clusters");
-        clusters_file->mkdir("discarded");
+        // Create directories for clusters and discarded clusters, with one tree writer per view in each
+        TDirectory* accepted_dir = clusters_file->mkdir("clusters");
+        TDirectory* discarded_dir = clusters_file->mkdir("discarded");
+        std::vector<std::unique_ptr<ClusterTreeWriter>> accepted_writers;
+        std::vector<std::unique_ptr<ClusterTreeWriter>> discarded_writers;
+        for (size_t iView=0;iView<APA::views.size();++iView) {
+            accepted_writers.emplace_back(new ClusterTreeWriter(accepted_dir, APA::views.at(iView), output_settings));
+            discarded_writers.emplace_back(new ClusterTreeWriter(discarded_dir, APA::views.at(iView), output_settings));
+        }
 
         // Cluster ID counter (unique per file, shared across all views)
         int next_cluster_id = 0;
 
-        // Process events
-        for (auto& kv : tps_by_event) {
-            int event = kv.first;
-            auto& tps = kv.second;
-            
-            // split by view
-            std::vector<std::vector<TriggerPrimitive*>> tps_per_view;
-            tps_per_view.reserve(APA::views.size());
-            for (size_t iView=0;iView<APA::views.size();++iView){ 
-                std::vector<TriggerPrimitive*> v; 
-                getPrimitivesForView(APA::views.at(iView), tps, v); 
-                tps_per_view.emplace_back(std::move(v)); 
+        // ADC integral cut of each view
+        std::vector<int> adc_cut = {static_cast<int>(adc_integral_cut_ind), 
+                                    static_cast<int>(adc_integral_cut_ind), 
+                                    static_cast<int>(adc_integral_cut_col)};
+
+        // Events are clustered in batches, with one event per thread; the TP buffers are reused
+        const size_t batch_size = static_cast<size_t>(n_threads);
+        std::vector<std::vector<TriggerPrimitive>> batch_tps(batch_size);
+        std::vector<int> batch_events;
+        while (true) {
+            // Read a batch of events (one per thread), with the APA and ToT cuts applied
+            batch_events.clear();
+            while (batch_events.size() < batch_size && reader.next()) {
+                std::vector<TriggerPrimitive>& vec = batch_tps.at(batch_events.size());
+                std::swap(vec, reader.get_tps());
+                batch_events.push_back(reader.get_event());
+
+                if (apa_filter >= 0) {
+                    vec.erase(
+                        std::remove_if(vec.begin(), vec.end(), [&](const TriggerPrimitive &tp){ return tp.GetDetector() != apa_filter; }),
+                        vec.end()
+                    );
+                }
+                // Apply ToT cut to TPs if requested
+                if (tot_cut > 0) {
+                    vec.erase(
+                        std::remove_if(vec.begin(), vec.end(), [&](const TriggerPrimitive &tp){ return (int)tp.GetSamplesOverThreshold() <= tot_cut; }),
+                        vec.end()
+                    );
+                }
             }
+            if (batch_events.empty()) break;
 
-            std::vector<std::vector<Cluster>> clusters_per_view; 
-            clusters_per_view.reserve(APA::views.size());
-            std::vector<int> adc_cut = {static_cast<int>(adc_integral_cut_ind), 
-                                        static_cast<int>(adc_integral_cut_ind), 
-                                        static_cast<int>(adc_integral_cut_col)};
-            
-            for (size_t iView=0;iView<APA::views.size();++iView)
-                clusters_per_view.emplace_back(make_cluster(tps_per_view.at(iView), 
-                                                tick_limit, 
-                                                channel_limit, 
-                                                min_tps_to_cluster, 
-                                                adc_cut.at(iView)));
+            // split every event by view, each (event, view) group is clustered independently
+            std::vector<std::vector<TriggerPrimitive*>> tps_groups;
+            std::vector<int> adc_cut_per_group;
+            tps_groups.reserve(batch_events.size() * APA::views.size());
+            for (size_t iEvent=0;iEvent<batch_events.size();++iEvent) {
+                for (size_t iView=0;iView<APA::views.size();++iView){ 
+                    std::vector<TriggerPrimitive*> v; 
+                    getPrimitivesForView(APA::views.at(iView), batch_tps.at(iEvent), v); 
+                    tps_groups.emplace_back(std::move(v)); 
+                    adc_cut_per_group.push_back(adc_cut.at(iView));
+                }
+            }
+
+            std::vector<std::vector<Cluster>> clusters_per_group = make_clusters_parallel(tps_groups,
+                                                                                         tick_limit,
+                                                                                         channel_limit,
+                                                                                         min_tps_to_cluster,
+                                                                                         adc_cut_per_group,
+                                                                                         n_threads);
+
+            // Process events, in order, so that cluster IDs do not depend on the number of threads
+            size_t iGroup = 0;
+            for (size_t iEvent=0;iEvent<batch_events.size();++iEvent) {
+                int event = batch_events[iEvent];
+
+                std::vector<std::vector<Cluster>> clusters_per_view; 
+                clusters_per_view.reserve(APA::views.size());
+                for (size_t iView=0;iView<APA::views.size();++iView)
+                    clusters_per_view.emplace_back(std::move(clusters_per_group.at(iGroup++)));
             
-            // Identify the main marley cluster (most energetic) in each view for this event
-            for (size_t iView=0; iView<APA::views.size(); ++iView) {
-                auto& clusters = clusters_per_view.at(iView);
-                if (clusters.empty()) continue;
+                // Identify the main marley cluster (most energetic) in each view for this event
+                for (size_t iView=0; iView<APA::views.size(); ++iView) {
+                    auto& clusters = clusters_per_view.at(iView);
+                    if (clusters.empty()) continue;
                 
-                // Find cluster with highest reconstructed energy (not true particle energy)
-                Cluster* main_cluster = nullptr;
-                float max_energy = -1.0f;
-                
-                if (debugMode) {
-                    LogInfo << "Event " << event << " View " << APA::views.at(iView) 
-                            << " - Selecting main cluster from " << clusters.size() << " clusters" << std::endl;
-                }
+                    // Find cluster with highest reconstructed energy (not true particle energy)
+                    Cluster* main_cluster = nullptr;
+                    float max_energy = -1.0f;
                 
-                for (auto& cluster : clusters) {
-                    if (cluster.get_true_label() != "marley") continue; // only consider marley clusters
-                    float energy = cluster.get_total_energy();
-                    
                     if (debugMode) {
-                        LogInfo << "  Candidate cluster: reco_energy=" << energy << " MeV"
-                                << ", true_particle_energy=" << cluster.get_true_particle_energy() << " MeV"
-                                << ", true_pdg=" << cluster.get_true_pdg()
-                                << ", n_tps=" << cluster.get_size()
-                                << ", true_label=" << cluster.get_true_label() << std::endl;
+                        LogInfo << "Event " << event << " View " << APA::views.at(iView) 
+                                << " - Selecting main cluster from " << clusters.size() << " clusters" << std::endl;
                     }
+                
+                    for (auto& cluster : clusters) {
+                        if (cluster.get_true_label() != "marley") continue; // only consider marley clusters
+                        float energy = cluster.get_total_energy();
                     
-                    if (energy > max_energy) {
-                        max_energy = energy;
-                        main_cluster = &cluster;
+                        if (debugMode) {
+                            LogInfo << "  Candidate cluster: reco_energy=" << energy << " MeV"
+                                    << ", true_particle_energy=" << cluster.get_true_particle_energy() << " MeV"
+                                    << ", true_pdg=" << cluster.get_true_pdg()
+                                    << ", n_tps=" << cluster.get_size()
+                                    << ", true_label=" << cluster.get_true_label() << std::endl;
+                        }
+                    
+                        if (energy > max_energy) {
+                            max_energy = energy;
+                            main_cluster = &cluster;
+                        }
                     }
-                }
                 
-                // Mark the main cluster
-                if (main_cluster != nullptr) {
-                    main_cluster->set_is_main_cluster(true);
+                    // Mark the main cluster
+                    if (main_cluster != nullptr) {
+                        main_cluster->set_is_main_cluster(true);
                     
-                    if (debugMode) {
-                        LogInfo << "  SELECTED as main cluster: reco_energy=" << main_cluster->get_total_energy() << " MeV"
-                                << ", true_particle_energy=" << main_cluster->get_true_particle_energy() << " MeV"
-                                << ", true_pdg=" << main_cluster->get_true_pdg()
-                                << ", n_tps=" << main_cluster->get_size()
-                                << ", is_electron=" << (main_cluster->get_true_pdg() == 11 ? "YES" : "NO") << std::endl;
+                        if (debugMode) {
+                            LogInfo << "  SELECTED as main cluster: reco_energy=" << main_cluster->get_total_energy() << " MeV"
+                                    << ", true_particle_energy=" << main_cluster->get_true_particle_energy() << " MeV"
+                                    << ", true_pdg=" << main_cluster->get_true_pdg()
+                                    << ", n_tps=" << main_cluster->get_size()
+                                    << ", is_electron=" << (main_cluster->get_true_pdg() == 11 ? "YES" : "NO") << std::endl;
+                        }
                     }
                 }
-            }
 
-            // Separate clusters into accepted and discarded based on energy_cut
-            for (size_t iView=0;iView<APA::views.size();++iView) {
-                std::vector<Cluster> accepted_clusters;
-                std::vector<Cluster> discarded_clusters;
-                
-                for (auto& cluster : clusters_per_view.at(iView)) {
-                    // Assign unique cluster ID
-                    cluster.set_cluster_id(next_cluster_id++);
+                // Separate clusters into accepted (clusters/) and discarded (discarded/) based on energy_cut
+                for (size_t iView=0;iView<APA::views.size();++iView) {
+                    for (auto& cluster : clusters_per_view.at(iView)) {
+                        // Assign unique cluster ID
+                        cluster.set_cluster_id(next_cluster_id++);
                     
-                    // Get cluster energy in MeV
-                    float cluster_energy_mev = 0.0f;
-                    if (APA::views.at(iView) == "X") {
-                        cluster_energy_mev = cluster.get_total_charge() / ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_collection");
-                    } else {
-                        cluster_energy_mev = cluster.get_total_charge() / ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_induction");
-                    }
+                        // Get cluster energy in MeV
+                        float cluster_energy_mev = 0.0f;
+                        if (APA::views.at(iView) == "X") {
+                            cluster_energy_mev = cluster.get_total_charge() / get_adc_to_energy_factor_collection();
+                        } else {
+                            cluster_energy_mev = cluster.get_total_charge() / get_adc_to_energy_factor_induction();
+                        }
                     
-                    if (cluster_energy_mev >= energy_cut) {
-                        accepted_clusters.push_back(cluster);
-                    } else {
-                        discarded_clusters.push_back(cluster);
+                        if (cluster_energy_mev >= energy_cut) {
+                            accepted_writers.at(iView)->fill(cluster);
+                        } else {
+                            discarded_writers.at(iView)->fill(cluster);
+                        }
                     }
                 }
-                
-                // Write accepted clusters to clusters/ folder
-                clusters_file->cd("clusters");
-                write_clusters(accepted_clusters, clusters_file, APA::views.at(iView));
-                
-                // Write discarded clusters to discarded/ folder
-                clusters_file->cd("discarded");
-                write_clusters(discarded_clusters, clusters_file, APA::views.at(iView));
             }
         }
 
+        // Each clusters tree is written once, before the file is closed
+        bool time_sorted = true;
+        for (size_t iView=0;iView<APA::views.size();++iView) {
+            time_sorted = time_sorted && accepted_writers.at(iView)->is_time_sorted();
+            accepted_writers.at(iView)->close();
+            discarded_writers.at(iView)->close();
+        }
+
         // Write metadata and close
         LogInfo << "Writing clustering metadata..." << std::endl;
-        create_metadata_tree(clusters_file);
+        create_metadata_tree(clusters_file, time_sorted);
         clusters_file->Close();
         delete clusters_file;
         
@@ -9,10 +9,9 @@
 #include "verbosity.h"
 
 #include <algorithm>
-#include <climits>
-#include <limits>
-#include <tuple>
-#include <unordered_map>
+#include <chrono>
+#include <memory>
+#include <numeric>
 
 LoggerInit([]{Logger::getUserHeader() << "[" << FILENAME << "]";});
 
@@ -36,29 +35,25 @@ std::string joinPath(const std::string& dir, const std::string& file) {
     return clean_dir + "/" + clean_file;
 }
 
-// Helper function to get cluster time range in TDC ticks (original tick units)
-std::pair<int, int> getClusterTimeRange(const Cluster& cluster) {
-    if (cluster.get_tps().empty()) return {0, 0};
-    
-    int min_time_tdc = INT_MAX;
-    int max_time_tdc = INT_MIN;
-    
-    for (auto* tp : cluster.get_tps()) {
-        int start_tdc = tp->GetTimeStart();
-        int end_tdc = tp->GetTimeStart() + tp->GetSamplesOverThreshold();
-        min_time_tdc = std::min(min_time_tdc, start_tdc);
-        max_time_tdc = std::max(max_time_tdc, end_tdc);
-    }
-    
-    return {min_time_tdc, max_time_tdc};
-}
+// Orders clusters by (event, earliest time, id): the order make_clusters writes them in.
+// The keys are computed once per cluster, then the clusters are moved into place
+void sortClustersByEventAndTime(std::vector<Cluster>& clusters) {
+    std::vector<ClusterInterval> intervals;
+    intervals.reserve(clusters.size());
+    for (const auto& cluster : clusters) intervals.push_back(get_cluster_interval(cluster));
+
+    std::vector<size_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (intervals[a].event != intervals[b].event) return intervals[a].event < intervals[b].event;
+        if (intervals[a].t_min != intervals[b].t_min) return intervals[a].t_min < intervals[b].t_min;
+        return clusters[a].get_cluster_id() < clusters[b].get_cluster_id();
+    });
 
-// Check if two cluster time ranges overlap within tolerance (in TDC ticks)
-bool timesOverlap(const std::pair<int, int>& range1, const std::pair<int, int>& range2, int tolerance_tdc) {
-    // Check if ranges overlap considering tolerance
-    // range1: [min1, max1], range2: [min2, max2]
-    // They overlap if: max1 + tolerance >= min2 AND max2 + tolerance >= min1
-    return (range1.second + tolerance_tdc >= range2.first) && (range2.second + tolerance_tdc >= range1.first);
+    std::vector<Cluster> sorted;
+    sorted.reserve(clusters.size());
+    for (size_t index : order) sorted.push_back(std::move(clusters[index]));
+    clusters.swap(sorted);
 }
 
 int main(int argc, char* argv[]) {
@@ -74,6 +69,7 @@ int main(int argc, char* argv[]) {
 
     clp.addDummyOption("Triggers");
     clp.addTriggerOption("override", {"-f", "--override"}, "Override existing output files");
+    clp.addTriggerOption("match_all", {"--all-clusters"}, "Match every X cluster, not only the main ones (no truth needed, overrides JSON)");
     clp.addTriggerOption("verboseMode", {"-v"}, "RunVerboseMode, bool");
     clp.addTriggerOption("debugMode", {"-d"}, "RunDebugMode, bool");
 
@@ -117,11 +113,28 @@ int main(int argc, char* argv[]) {
     int time_tolerance_ticks_tpc = j.value("time_tolerance_ticks", 100);  // In TPC ticks (from JSON)
     int time_tolerance_ticks_tdc = toTDCticks(time_tolerance_ticks_tpc);  // Convert to TDC ticks for matching
     float spatial_tolerance_cm = j.value("spatial_tolerance_cm", 5.0);
+    bool geometric_matching = j.value("geometric_matching", true);  // wire crossing check of U+V+X matches
+    MatchSettings match_settings;
+    match_settings.time_tolerance = time_tolerance_ticks_tdc;
+    match_settings.spatial_tolerance = spatial_tolerance_cm;
+    match_settings.check_geometry = geometric_matching;
+    match_settings.time_weight = j.value("match_time_weight", 1.0);
+    match_settings.charge_weight = j.value("match_charge_weight", 1.0);
+    match_settings.geometry_weight = j.value("match_geometry_weight", 1.0);
+    match_settings.max_candidates = std::max(1, j.value("match_max_candidates", 8));
+    match_settings.max_component_size = std::max(2, j.value("match_max_component_size", 256));
+    // Truth-agnostic mode (online pointing): every X cluster is matched, main or not
+    bool match_all_clusters = j.value("match_all_clusters", false) || clp.isOptionTriggered("match_all");
+    const RootOutputSettings output_settings = getRootOutputSettings(j, "clusters");
     
     if (verboseMode) {
         LogInfo << "Matching parameters:" << std::endl;
         LogInfo << "  time_tolerance: " << time_tolerance_ticks_tpc << " TPC ticks = " << time_tolerance_ticks_tdc << " TDC ticks" << std::endl;
         LogInfo << "  spatial_tolerance: " << spatial_tolerance_cm << " cm" << std::endl;
+        LogInfo << "  geometric_matching: " << (geometric_matching ? "on" : "off") << std::endl;
+        LogInfo << "  score weights: time=" << match_settings.time_weight << " charge=" << match_settings.charge_weight
+                << " geometry=" << match_settings.geometry_weight << ", max candidates per view: " << match_settings.max_candidates << std::endl;
+        LogInfo << "  X clusters matched: " << (match_all_clusters ? "all" : "main only") << std::endl;
     }
     
     // Use tpstream-based file tracking
@@ -150,12 +163,17 @@ int main(int argc, char* argv[]) {
     int failed = 0;
     
     // Global matching statistics
-    int global_total_main_x = 0;
+    int global_total_main_x = 0; // X clusters to match: main ones, or all of them with match_all_clusters
     int global_complete_matches = 0;
     int global_partial_u_matches = 0;
     int global_partial_v_matches = 0;
-    std::unordered_map<int, int> global_event_delta_hist_u;
-    std::unordered_map<int, int> global_event_delta_hist_v;
+
+    // Throughput: clusters and events matched, time spent matching (indexing, scoring, assignment)
+    // and processing the files (with reading and writing)
+    long long global_clusters = 0;
+    long long global_events = 0;
+    double global_match_seconds = 0.0;
+    double global_file_seconds = 0.0;
 
     std::vector <std::string> output_files;
     
@@ -183,41 +201,39 @@ int main(int argc, char* argv[]) {
         }
         
         try {
-            std::clock_t start = std::clock();
+            const auto start_file = std::chrono::steady_clock::now();
             
             // Read clusters from clusters/ directory
             if (verboseMode) LogInfo << "  Reading clusters..." << std::endl;
-            std::vector<Cluster> clusters_u = read_clusters_from_tree(input_clusters_file, "U");
-            std::vector<Cluster> clusters_v = read_clusters_from_tree(input_clusters_file, "V");
-            std::vector<Cluster> clusters_x = read_clusters_from_tree(input_clusters_file, "X");
+            ClusterSet cluster_set_u = read_clusters_from_tree(input_clusters_file, "U");
+            std::vector<Cluster>& clusters_u = cluster_set_u.clusters();
+            ClusterSet cluster_set_v = read_clusters_from_tree(input_clusters_file, "V");
+            std::vector<Cluster>& clusters_v = cluster_set_v.clusters();
+            ClusterSet cluster_set_x = read_clusters_from_tree(input_clusters_file, "X");
+            std::vector<Cluster>& clusters_x = cluster_set_x.clusters();
 
-            // Ensure deterministic ordering by earliest time so the binary-search scan below is valid
-            auto sortClustersByStartTime = [](std::vector<Cluster>& clusters) {
-                std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
-                    auto range_a = getClusterTimeRange(a);
-                    auto range_b = getClusterTimeRange(b);
-                    if (range_a.first != range_b.first) {
-                        return range_a.first < range_b.first;
-                    }
-                    auto tps_a = a.get_tps();
-                    auto tps_b = b.get_tps();
-                    int event_a = tps_a.empty() ? std::numeric_limits<int>::min() : tps_a.front()->GetEvent();
-                    int event_b = tps_b.empty() ? std::numeric_limits<int>::min() : tps_b.front()->GetEvent();
-                    if (event_a != event_b) {
-                        return event_a < event_b;
-                    }
-                    return a.get_cluster_id() < b.get_cluster_id();
-                });
-            };
-            sortClustersByStartTime(clusters_u);
-            sortClustersByStartTime(clusters_v);
-            sortClustersByStartTime(clusters_x);
+            // Matches are searched, and written, in (event, earliest time) order: make_clusters writes the clusters
+            // so and records it in the time_sorted flag of clustering_metadata, other files are sorted
+            bool clusters_time_sorted = false;
+            {
+                std::unique_ptr<TFile> metadata_file(TFile::Open(input_clusters_file.c_str(), "READ"));
+                if (metadata_file && !metadata_file->IsZombie()) {
+                    clusters_time_sorted = read_time_sorted_flag(metadata_file.get(), "clustering_metadata");
+                }
+            }
+            if (!clusters_time_sorted) {
+                if (verboseMode) LogInfo << "  No time_sorted flag in clustering_metadata, sorting the clusters" << std::endl;
+                sortClustersByEventAndTime(clusters_u);
+                sortClustersByEventAndTime(clusters_v);
+                sortClustersByEventAndTime(clusters_x);
+            }
 
             // Count main clusters in X
             int n_main_x = 0;
             for (const auto& c : clusters_x) {
                 if (c.get_is_main_cluster()) n_main_x++;
             }
+            const int n_x_to_match = match_all_clusters ? static_cast<int>(clusters_x.size()) : n_main_x;
 
             if (verboseMode) {
                 LogInfo << "  Clusters: U=" << clusters_u.size() << " V=" << clusters_v.size() 
@@ -225,9 +241,12 @@ int main(int argc, char* argv[]) {
             }
             
             // Read discarded clusters from discarded/ directory
-            std::vector<Cluster> discarded_u = read_clusters_from_tree(input_clusters_file, "U", "discarded");
-            std::vector<Cluster> discarded_v = read_clusters_from_tree(input_clusters_file, "V", "discarded");
-            std::vector<Cluster> discarded_x = read_clusters_from_tree(input_clusters_file, "X", "discarded");
+            ClusterSet discarded_set_u = read_clusters_from_tree(input_clusters_file, "U", "discarded");
+            std::vector<Cluster>& discarded_u = discarded_set_u.clusters();
+            ClusterSet discarded_set_v = read_clusters_from_tree(input_clusters_file, "V", "discarded");
+            std::vector<Cluster>& discarded_v = discarded_set_v.clusters();
+            ClusterSet discarded_set_x = read_clusters_from_tree(input_clusters_file, "X", "discarded");
+            std::vector<Cluster>& discarded_x = discarded_set_x.clusters();
             
             if (verboseMode && (discarded_u.size() > 0 || discarded_v.size() > 0 || discarded_x.size() > 0)) {
                 LogInfo << "  Discarded: U=" << discarded_u.size() 
@@ -236,184 +255,72 @@ int main(int argc, char* argv[]) {
             }
             
             // Match clusters - now allowing partial matches (X+U or X+V)
-            std::vector<std::vector<Cluster>> matches;
-            std::vector<Cluster> multiplane_clusters;
-            
-            // Track partial matches
-            std::map<int, int> x_to_u_match;  // X cluster ID -> U cluster ID
-            std::map<int, int> x_to_v_match;  // X cluster ID -> V cluster ID
-
-            int start_j = 0;
-            int start_k = 0;
-            
-            int test_combinations = 0;
-            int failed_time_u = 0, failed_event_u = 0, failed_apa_u = 0;
-            int failed_time_v = 0, failed_event_v = 0, failed_apa_v = 0;
-            int failed_spatial = 0;
-
-            const size_t max_event_mismatch_samples = 20;
-            std::vector<std::tuple<int, int, int, int>> event_mismatch_samples_u; // X_id, X_event, U_id, U_event
-            std::vector<std::tuple<int, int, int, int>> event_mismatch_samples_v; // X_id, X_event, V_id, V_event
-            std::unordered_map<int, int> event_delta_hist_u;
-            std::unordered_map<int, int> event_delta_hist_v;
-
-            // First pass: match X with U
+            // Time range, APA and event of every cluster, computed once per view. The main X clusters (all
+            // of them with match_all_clusters) are matched together to the clusters of their event and APA
+            // overlapping them in time, found by the interval index of each view, by an optimal assignment
+            // on the scores of the candidates
+            const auto start_match = std::chrono::steady_clock::now();
+            const ClusterIntervalIndex index_u(clusters_u);
+            const ClusterIntervalIndex index_v(clusters_v);
+            const ClusterIntervalIndex index_x(clusters_x);
+            std::vector<uint32_t> x_selection;
+            x_selection.reserve(n_x_to_match);
             for (size_t i = 0; i < clusters_x.size(); i++) {
-                // Only match main clusters
-                if (!clusters_x[i].get_is_main_cluster()) continue;
-                
-                auto x_time_range = getClusterTimeRange(clusters_x[i]);
-                int x_id = clusters_x[i].get_cluster_id();
-                
-                // Binary search for starting point in U
-                int min_range_j = 0;
-                int max_range_j = clusters_u.size();
-                while (min_range_j < max_range_j) {
-                    start_j = (min_range_j + max_range_j) / 2;
-                    auto u_time = getClusterTimeRange(clusters_u[start_j]);
-                    if (u_time.first < x_time_range.first) {
-                        min_range_j = start_j + 1;
-                    } else {
-                        max_range_j = start_j;
-                    }
-                }
-                start_j = std::max(start_j-10, 0);
-                
-                for (size_t j = start_j; j < clusters_u.size(); j++) {
-                    auto u_time_range = getClusterTimeRange(clusters_u[j]);
-                    
-                    // Check if U cluster time range overlaps with X cluster time range
-                    if (u_time_range.first > x_time_range.second + time_tolerance_ticks_tdc) break;
-                    if (!timesOverlap(u_time_range, x_time_range, time_tolerance_ticks_tdc)) { failed_time_u++; continue; }
-                    int u_event = clusters_u[j].get_tps()[0]->GetEvent();
-                    int x_event = clusters_x[i].get_tps()[0]->GetEvent();
-                    if (u_event != x_event) {
-                        failed_event_u++;
-                        event_delta_hist_u[u_event - x_event]++;
-                        if (event_mismatch_samples_u.size() < max_event_mismatch_samples) {
-                            event_mismatch_samples_u.emplace_back(clusters_x[i].get_cluster_id(), x_event, clusters_u[j].get_cluster_id(), u_event);
-                        }
-                        continue;
-                    }
-                    if (int(clusters_u[j].get_tps()[0]->GetDetectorChannel()/APA::total_channels) != int(clusters_x[i].get_tps()[0]->GetDetectorChannel()/APA::total_channels)) { failed_apa_u++; continue; }
-                    
-                    // Found a matching U cluster - record it (take first match)
-                    if (x_to_u_match.find(x_id) == x_to_u_match.end()) {
-                        x_to_u_match[x_id] = j;
-                    }
-                }
+                // Only match main clusters, unless matching all of them
+                if (match_all_clusters || clusters_x[i].get_is_main_cluster()) x_selection.push_back(static_cast<uint32_t>(i));
             }
-            
-            // Second pass: match X with V
+            MatchStats match_stats;
+            // Matches refer to their clusters by index: the match_id of a cluster is the index of its match
+            const std::vector<MultiplaneMatch> matches =
+                match_multiplane(clusters_u, clusters_v, clusters_x, index_u, index_v, index_x, x_selection, match_settings, &match_stats);
+            const double match_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_match).count();
+
+            // Events of the file: the clusters are grouped by event
+            long long n_events = 0;
             for (size_t i = 0; i < clusters_x.size(); i++) {
-                // Only match main clusters
-                if (!clusters_x[i].get_is_main_cluster()) continue;
-                
-                auto x_time_range = getClusterTimeRange(clusters_x[i]);
-                int x_id = clusters_x[i].get_cluster_id();
-                
-                // Binary search for starting point in V
-                int min_range_k = 0;
-                int max_range_k = clusters_v.size();
-                while (min_range_k < max_range_k) {
-                    start_k = (min_range_k + max_range_k) / 2;
-                    auto v_time = getClusterTimeRange(clusters_v[start_k]);
-                    if (v_time.first < x_time_range.first) {
-                        min_range_k = start_k + 1;
-                    } else {
-                        max_range_k = start_k;
-                    }
-                }
-                start_k = std::max(start_k-10, 0);
-                
-                for (size_t k = start_k; k < clusters_v.size(); k++) {
-                    auto v_time_range = getClusterTimeRange(clusters_v[k]);
-                    
-                    // Check if V cluster time range overlaps with X cluster time range
-                    if (v_time_range.first > x_time_range.second + time_tolerance_ticks_tdc) break;
-                    if (!timesOverlap(v_time_range, x_time_range, time_tolerance_ticks_tdc)) { failed_time_v++; continue; }
-                    int v_event = clusters_v[k].get_tps()[0]->GetEvent();
-                    int x_event = clusters_x[i].get_tps()[0]->GetEvent();
-                    if (v_event != x_event) {
-                        failed_event_v++;
-                        event_delta_hist_v[v_event - x_event]++;
-                        if (event_mismatch_samples_v.size() < max_event_mismatch_samples) {
-                            event_mismatch_samples_v.emplace_back(clusters_x[i].get_cluster_id(), x_event, clusters_v[k].get_cluster_id(), v_event);
-                        }
-                        continue;
-                    }
-                    if (int(clusters_v[k].get_tps()[0]->GetDetectorChannel()/APA::total_channels) != int(clusters_x[i].get_tps()[0]->GetDetectorChannel()/APA::total_channels)) { failed_apa_v++; continue; }
-                    
-                    // Found a matching V cluster - record it (take first match)
-                    if (x_to_v_match.find(x_id) == x_to_v_match.end()) {
-                        x_to_v_match[x_id] = k;
-                    }
-                }
+                if (i == 0 || index_x.get_interval(i).event != index_x.get_interval(i - 1).event) n_events++;
             }
-            
-            // Third pass: create matches based on what we found
+            const long long n_clusters = static_cast<long long>(clusters_u.size() + clusters_v.size() + clusters_x.size());
+
             int complete_matches = 0;  // X+U+V
             int partial_u_matches = 0; // X+U only
             int partial_v_matches = 0; // X+V only
-            
-            for (size_t i = 0; i < clusters_x.size(); i++) {
-                if (!clusters_x[i].get_is_main_cluster()) continue;
-                
-                int x_id = clusters_x[i].get_cluster_id();
-                bool has_u = x_to_u_match.find(x_id) != x_to_u_match.end();
-                bool has_v = x_to_v_match.find(x_id) != x_to_v_match.end();
-                
-                if (has_u && has_v) {
+
+            std::vector<float> match_scores;
+            match_scores.reserve(matches.size());
+            for (const auto& m : matches) {
+                const size_t match_number = match_scores.size() + 1;
+                if (m.is_complete()) {
                     // Complete match: X+U+V
-                    test_combinations++;
-                    size_t j = x_to_u_match[x_id];
-                    size_t k = x_to_v_match[x_id];
-                    
-                    if (are_compatibles(clusters_u[j], clusters_v[k], clusters_x[i], spatial_tolerance_cm)) {
-                        matches.push_back({clusters_u[j], clusters_v[k], clusters_x[i]});
-                        Cluster c = join_clusters(clusters_u[j], clusters_v[k], clusters_x[i]);
-                        multiplane_clusters.push_back(c);
-                        complete_matches++;
-                        
-                        if (verboseMode && matches.size() <= 3) {
-                            LogInfo << "    Match #" << matches.size() << ": U_id=" << clusters_u[j].get_cluster_id() 
-                                    << " V_id=" << clusters_v[k].get_cluster_id()
-                                    << " X_id=" << clusters_x[i].get_cluster_id() << std::endl;
-                        }
-                    } else {
-                        failed_spatial++;
+                    complete_matches++;
+                    if (verboseMode && match_number <= 3) {
+                        LogInfo << "    Match #" << match_number << ": U_id=" << clusters_u[m.u].get_cluster_id()
+                                << " V_id=" << clusters_v[m.v].get_cluster_id()
+                                << " X_id=" << clusters_x[m.x].get_cluster_id() << " score=" << m.score << std::endl;
                     }
-                } else if (has_u) {
+                } else if (m.u >= 0) {
                     // Partial match: X+U only
-                    test_combinations++;
-                    size_t j = x_to_u_match[x_id];
-                    matches.push_back({clusters_u[j], clusters_x[i]});
-                    Cluster c = join_clusters(clusters_u[j], clusters_x[i]);
-                    multiplane_clusters.push_back(c);
                     partial_u_matches++;
-                    
-                    if (verboseMode && matches.size() <= 3) {
-                        LogInfo << "    Partial Match #" << matches.size() << ": U_id=" << clusters_u[j].get_cluster_id() 
-                                << " X_id=" << clusters_x[i].get_cluster_id() << " (no V)" << std::endl;
+                    if (verboseMode && match_number <= 3) {
+                        LogInfo << "    Partial Match #" << match_number << ": U_id=" << clusters_u[m.u].get_cluster_id()
+                                << " X_id=" << clusters_x[m.x].get_cluster_id() << " (no V) score=" << m.score << std::endl;
                     }
-                } else if (has_v) {
+                } else {
                     // Partial match: X+V only
-                    test_combinations++;
-                    size_t k = x_to_v_match[x_id];
-                    matches.push_back({clusters_v[k], clusters_x[i]});
-                    Cluster c = join_clusters(clusters_v[k], clusters_x[i]);
-                    multiplane_clusters.push_back(c);
                     partial_v_matches++;
-                    
-                    if (verboseMode && matches.size() <= 3) {
-                        LogInfo << "    Partial Match #" << matches.size() << ": V_id=" << clusters_v[k].get_cluster_id() 
-                                << " X_id=" << clusters_x[i].get_cluster_id() << " (no U)" << std::endl;
+                    if (verboseMode && match_number <= 3) {
+                        LogInfo << "    Partial Match #" << match_number << ": V_id=" << clusters_v[m.v].get_cluster_id()
+                                << " X_id=" << clusters_x[m.x].get_cluster_id() << " (no U) score=" << m.score << std::endl;
                     }
                 }
+                match_scores.push_back(m.score);
             }
             
             // Accumulate global statistics
-            global_total_main_x += n_main_x;
+            global_total_main_x += n_x_to_match;
+            global_clusters += n_clusters;
+            global_events += n_events;
+            global_match_seconds += match_seconds;
             global_complete_matches += complete_matches;
             global_partial_u_matches += partial_u_matches;
             global_partial_v_matches += partial_v_matches;
@@ -425,112 +332,40 @@ int main(int argc, char* argv[]) {
                 LogInfo << "    Partial (V only): " << partial_v_matches << std::endl;
                 LogInfo << "  Total clusters: U=" << clusters_u.size() << " V=" << clusters_v.size() << " X=" << clusters_x.size() << std::endl;
                 
-                // Count main clusters
-                int n_main_x_verbose = 0;
-                for (const auto& c : clusters_x) {
-                    if (c.get_is_main_cluster()) n_main_x_verbose++;
-                }
-                LogInfo << "  Main X clusters: " << n_main_x_verbose << std::endl;
+                LogInfo << "  Main X clusters: " << n_main_x << (match_all_clusters ? " (all X clusters matched)" : "") << std::endl;
                 
-                LogInfo << "  Combinations tested: " << test_combinations << std::endl;
-                LogInfo << "  Failed filters: time_u=" << failed_time_u << " event_u=" << failed_event_u << " apa_u=" << failed_apa_u;
-                LogInfo << " time_v=" << failed_time_v << " event_v=" << failed_event_v << " apa_v=" << failed_apa_v;
-                LogInfo << " spatial=" << failed_spatial << std::endl;
-
-                if (!event_mismatch_samples_u.empty()) {
-                    LogInfo << "  Event mismatch samples (X vs U):" << std::endl;
-                    for (size_t idx = 0; idx < event_mismatch_samples_u.size(); ++idx) {
-                        const auto& sample = event_mismatch_samples_u[idx];
-                        LogInfo << "    #" << (idx + 1) << ": X_id=" << std::get<0>(sample)
-                                << " (event=" << std::get<1>(sample) << ") vs U_id=" << std::get<2>(sample)
-                                << " (event=" << std::get<3>(sample) << ")" << std::endl;
-                    }
-                }
-                if (!event_mismatch_samples_v.empty()) {
-                    LogInfo << "  Event mismatch samples (X vs V):" << std::endl;
-                    for (size_t idx = 0; idx < event_mismatch_samples_v.size(); ++idx) {
-                        const auto& sample = event_mismatch_samples_v[idx];
-                        LogInfo << "    #" << (idx + 1) << ": X_id=" << std::get<0>(sample)
-                                << " (event=" << std::get<1>(sample) << ") vs V_id=" << std::get<2>(sample)
-                                << " (event=" << std::get<3>(sample) << ")" << std::endl;
-                    }
-                }
-                auto log_event_delta = [&](const char* label, const std::unordered_map<int, int>& hist) {
-                    if (hist.empty()) return;
-                    std::vector<std::pair<int, int>> entries(hist.begin(), hist.end());
-                    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
-                    size_t limit = std::min<size_t>(5, entries.size());
-                    LogInfo << "  Top event deltas " << label << " (candidate - X):" << std::endl;
-                    for (size_t i = 0; i < limit; ++i) {
-                        LogInfo << "    delta=" << entries[i].first << " count=" << entries[i].second << std::endl;
-                    }
-                };
-                log_event_delta("U", event_delta_hist_u);
-                log_event_delta("V", event_delta_hist_v);
-            }
-
-            for (const auto& entry : event_delta_hist_u) {
-                global_event_delta_hist_u[entry.first] += entry.second;
-            }
-            for (const auto& entry : event_delta_hist_v) {
-                global_event_delta_hist_v[entry.first] += entry.second;
+                LogInfo << "  Candidates: U=" << match_stats.candidates_u << " V=" << match_stats.candidates_v
+                        << " triplets=" << match_stats.triplets << std::endl;
+                LogInfo << "  Failed filters: time_u=" << match_stats.failed_time_u << " event_u=" << match_stats.failed_event_u << " apa_u=" << match_stats.failed_apa_u;
+                LogInfo << " time_v=" << match_stats.failed_time_v << " event_v=" << match_stats.failed_event_v << " apa_v=" << match_stats.failed_apa_v;
+                LogInfo << " spatial=" << match_stats.failed_spatial << std::endl;
+                LogInfo << "  Matching time: " << match_seconds * 1e3 << " ms for " << n_clusters << " clusters in " << n_events << " events ("
+                        << (match_seconds > 0 ? n_clusters / match_seconds : 0.0) << " clusters/s)" << std::endl;
             }
             
             // Assign match IDs and track X plane matching details
             std::map<int, int> u_cluster_to_match;
             std::map<int, int> v_cluster_to_match;
             std::map<int, int> x_cluster_to_match;
-            std::map<int, int> match_type_map;
             
             // Track which U and V clusters each X cluster matched to
             std::map<int, int> x_to_u_map;  // X cluster_id -> U cluster_id
             std::map<int, int> x_to_v_map;  // X cluster_id -> V cluster_id
             
+            // Each cluster is in at most one match
             for (size_t match_id = 0; match_id < matches.size(); match_id++) {
-                int match_size = matches[match_id].size();
-                
-                if (match_size == 3) {
-                    // Complete match: U, V, X
-                    int u_id = matches[match_id][0].get_cluster_id();
-                    int v_id = matches[match_id][1].get_cluster_id();
-                    int x_id = matches[match_id][2].get_cluster_id();
-                    
-                    if (u_cluster_to_match.find(u_id) == u_cluster_to_match.end()) u_cluster_to_match[u_id] = match_id;
-                    if (v_cluster_to_match.find(v_id) == v_cluster_to_match.end()) v_cluster_to_match[v_id] = match_id;
-                    if (x_cluster_to_match.find(x_id) == x_cluster_to_match.end()) {
-                        x_cluster_to_match[x_id] = match_id;
-                        // Track the first U and V matched to this X cluster
-                        if (x_to_u_map.find(x_id) == x_to_u_map.end()) x_to_u_map[x_id] = u_id;
-                        if (x_to_v_map.find(x_id) == x_to_v_map.end()) x_to_v_map[x_id] = v_id;
-                    }
-                    match_type_map[match_id] = 3;
-                } else if (match_size == 2) {
-                    // Partial match: determine if it's U+X or V+X based on plane
-                    auto& c1 = matches[match_id][0];
-                    auto& c2 = matches[match_id][1];
-                    
-                    bool c1_is_x = (c1.get_size() > 0 && c1.get_tps()[0]->GetView() == "X");
-                    bool c1_is_u = (c1.get_size() > 0 && c1.get_tps()[0]->GetView() == "U");
-                    
-                    int x_id = c1_is_x ? c1.get_cluster_id() : c2.get_cluster_id();
-                    
-                    if (x_cluster_to_match.find(x_id) == x_cluster_to_match.end()) {
-                        x_cluster_to_match[x_id] = match_id;
-                    }
-                    
-                    if (c1_is_u || (!c1_is_x && c2.get_tps()[0]->GetView() == "X")) {
-                        // This is U+X match
-                        int u_id = c1_is_u ? c1.get_cluster_id() : c2.get_cluster_id();
-                        if (u_cluster_to_match.find(u_id) == u_cluster_to_match.end()) u_cluster_to_match[u_id] = match_id;
-                        if (x_to_u_map.find(x_id) == x_to_u_map.end()) x_to_u_map[x_id] = u_id;
-                        match_type_map[match_id] = 2; // U+X
-                    } else {
-                        // This is V+X match
-                        int v_id = c1_is_x ? c2.get_cluster_id() : c1.get_cluster_id();
-                        if (v_cluster_to_match.find(v_id) == v_cluster_to_match.end()) v_cluster_to_match[v_id] = match_id;
-                        if (x_to_v_map.find(x_id) == x_to_v_map.end()) x_to_v_map[x_id] = v_id;
-                        match_type_map[match_id] = 1; // V+X
-                    }
+                const MultiplaneMatch& m = matches[match_id];
+                const int x_id = clusters_x[m.x].get_cluster_id();
+                x_cluster_to_match[x_id] = match_id;
+                if (m.u >= 0) {
+                    const int u_id = clusters_u[m.u].get_cluster_id();
+                    u_cluster_to_match[u_id] = match_id;
+                    x_to_u_map[x_id] = u_id;
+                }
+                if (m.v >= 0) {
+                    const int v_id = clusters_v[m.v].get_cluster_id();
+                    v_cluster_to_match[v_id] = match_id;
+                    x_to_v_map[x_id] = v_id;
                 }
             }
             
@@ -550,13 +385,15 @@ int main(int argc, char* argv[]) {
             // Write output
             TFile* output_root = new TFile(output_file.c_str(), "RECREATE");
             if (output_root && !output_root->IsZombie()) {
+                applyRootOutputSettings(output_root, output_settings);
+
                 // Create clusters directory and write matched clusters
                 output_root->mkdir("clusters");
                 output_root->cd("clusters");
                 
-                write_clusters_with_match_id(clusters_u, u_cluster_to_match, output_root, "U");
-                write_clusters_with_match_id(clusters_v, v_cluster_to_match, output_root, "V");
-                write_clusters_with_match_id(clusters_x, x_cluster_to_match, output_root, "X", &x_to_u_map, &x_to_v_map);
+                write_clusters_with_match_id(clusters_u, u_cluster_to_match, output_root, "U", nullptr, nullptr, output_settings, &match_scores);
+                write_clusters_with_match_id(clusters_v, v_cluster_to_match, output_root, "V", nullptr, nullptr, output_settings, &match_scores);
+                write_clusters_with_match_id(clusters_x, x_cluster_to_match, output_root, "X", &x_to_u_map, &x_to_v_map, output_settings, &match_scores);
                 
                 // Create discarded directory for consistency (will be empty in current production)
                 output_root->cd();
@@ -565,9 +402,9 @@ int main(int argc, char* argv[]) {
                 
                 // Write empty discarded clusters with match_id=-1 (currently none to write)
                 std::map<int, int> empty_match_map;  // Empty map means all get match_id=-1
-                write_clusters_with_match_id(discarded_u, empty_match_map, output_root, "U");
-                write_clusters_with_match_id(discarded_v, empty_match_map, output_root, "V");
-                write_clusters_with_match_id(discarded_x, empty_match_map, output_root, "X");
+                write_clusters_with_match_id(discarded_u, empty_match_map, output_root, "U", nullptr, nullptr, output_settings);
+                write_clusters_with_match_id(discarded_v, empty_match_map, output_root, "V", nullptr, nullptr, output_settings);
+                write_clusters_with_match_id(discarded_x, empty_match_map, output_root, "X", nullptr, nullptr, output_settings);
                 
                 output_root->Close();
                 
@@ -584,6 +421,7 @@ int main(int argc, char* argv[]) {
                             << ", V-only=" << x_matched_v_only 
                             << ", unmatched=" << (clusters_x.size() - matched_x) << std::endl;
                 }
+                global_file_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_file).count();
                 processed++;
             } else {
                 LogError << "  ✗ Failed to create output file" << std::endl;
@@ -611,7 +449,7 @@ int main(int argc, char* argv[]) {
         LogInfo << "=========================================" << std::endl;
         LogInfo << "GLOBAL MATCHING STATISTICS" << std::endl;
         LogInfo << "=========================================" << std::endl;
-        LogInfo << "Total main X clusters: " << global_total_main_x << std::endl;
+        LogInfo << (match_all_clusters ? "Total X clusters: " : "Total main X clusters: ") << global_total_main_x << std::endl;
         LogInfo << "Complete matches (X+U+V): " << global_complete_matches 
                 << " (" << (global_total_main_x > 0 ? (global_complete_matches*100.0/global_total_main_x) : 0.0) << "%)" << std::endl;
         LogInfo << "Partial matches (X+U only): " << global_partial_u_matches 
@@ -622,18 +460,13 @@ int main(int argc, char* argv[]) {
                 << " (" << (global_total_main_x > 0 ? (global_total_matched*100.0/global_total_main_x) : 0.0) << "%)" << std::endl;
         LogInfo << "Unmatched: " << (global_total_main_x - global_total_matched) 
                 << " (" << (global_total_main_x > 0 ? ((global_total_main_x-global_total_matched)*100.0/global_total_main_x) : 0.0) << "%)" << std::endl;
-        auto log_global_deltas = [&](const char* label, const std::unordered_map<int, int>& hist) {
-            if (hist.empty()) return;
-            std::vector<std::pair<int, int>> entries(hist.begin(), hist.end());
-            std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
-            size_t limit = std::min<size_t>(10, entries.size());
-            LogInfo << "Top global event deltas " << label << " (candidate - X):" << std::endl;
-            for (size_t i = 0; i < limit; ++i) {
-                LogInfo << "  delta=" << entries[i].first << " count=" << entries[i].second << std::endl;
-            }
-        };
-        log_global_deltas("U", global_event_delta_hist_u);
-        log_global_deltas("V", global_event_delta_hist_v);
+        LogInfo << "Throughput: " << global_clusters << " clusters, " << global_events << " events" << std::endl;
+        LogInfo << "  Matching: " << global_match_seconds << " s ("
+                << (global_match_seconds > 0 ? global_clusters / global_match_seconds : 0.0) << " clusters/s, "
+                << (global_match_seconds > 0 ? global_events / global_match_seconds : 0.0) << " events/s)" << std::endl;
+        LogInfo << "  With I/O: " << global_file_seconds << " s ("
+                << (global_file_seconds > 0 ? global_clusters / global_file_seconds : 0.0) << " clusters/s, "
+                << (global_file_seconds > 0 ? global_events / global_file_seconds : 0.0) << " events/s)" << std::endl;
         LogInfo << "=========================================" << std::endl;
     }
     
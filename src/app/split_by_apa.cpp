@@ -1,225 +1,293 @@
-#include <iostream>
-#include <string>
-#include <vector>
-#include <fstream>
-
-#include "TFile.h"
-#include "TTree.h"
-#include "TBranch.h"
-
-#include "ParametersManager.h"
-
-// APA configuration for 1x2x2 detector
-const int CHANNELS_PER_APA = 2560;
-
-// Structure matching the ROOT file format (same as in Clustering.cpp)
-struct TPBranches {
-    int event;
-    UShort_t version;
-    UInt_t detid;
-    UInt_t channel;
-    ULong64_t samples_over_threshold;
-    ULong64_t time_start;
-    ULong64_t samples_to_peak;
-    UInt_t adc_integral;
-    UShort_t adc_peak;
+#include "Backtracking.h"
+#include "Clustering.h"
+
+LoggerInit([]{
+  Logger::getUserHeader() << "[" << FILENAME << "]";
+});
+
+namespace {
+
+// TPs of one APA waiting to be written, with the writer of its output file
+struct ApaOutput {
+    std::string filename;
+    std::unique_ptr<TpsWriter> writer;
+    TPStore buffer;
+    std::vector<int32_t> truth_map; // truth index of the chunk being routed -> truth index in the buffer
+    size_t n_tps = 0;
 };
 
-void setupInputBranches(TTree* tree, TPBranches& tp) {
-    tree->SetBranchAddress("event", &tp.event);
-    tree->SetBranchAddress("version", &tp.version);
-    tree->SetBranchAddress("detid", &tp.detid);
-    tree->SetBranchAddress("channel", &tp.channel);
-    tree->SetBranchAddress("samples_over_threshold", &tp.samples_over_threshold);
-    tree->SetBranchAddress("time_start", &tp.time_start);
-    tree->SetBranchAddress("samples_to_peak", &tp.samples_to_peak);
-    tree->SetBranchAddress("adc_integral", &tp.adc_integral);
-    tree->SetBranchAddress("adc_peak", &tp.adc_peak);
-}
+struct SplitResult {
+    bool done = false;
+    bool skipped = false;
+    size_t n_tps = 0;
+    size_t n_invalid = 0; // TPs whose channel maps to no APA
+    std::vector<size_t> n_tps_per_apa;
+    std::vector<std::string> outputs;
+    double seconds = 0.0;
+};
 
-void setupOutputBranches(TTree* tree, TPBranches& tp) {
-    tree->Branch("event", &tp.event, "event/I");
-    tree->Branch("version", &tp.version, "version/s");
-    tree->Branch("detid", &tp.detid, "detid/i");
-    tree->Branch("channel", &tp.channel, "channel/i");
-    tree->Branch("samples_over_threshold", &tp.samples_over_threshold, "samples_over_threshold/l");
-    tree->Branch("time_start", &tp.time_start, "time_start/l");
-    tree->Branch("samples_to_peak", &tp.samples_to_peak, "samples_to_peak/l");
-    tree->Branch("adc_integral", &tp.adc_integral, "adc_integral/i");
-    tree->Branch("adc_peak", &tp.adc_peak, "adc_peak/s");
+// Copies a row and its truth from one store to another
+void copy_row(const TPStore& from, size_t i, TPStore& to, std::vector<int32_t>& truth_map) {
+    TPRow row = from.get_row(i);
+    if (row.truth >= 0) {
+        int32_t& mapped = truth_map[row.truth];
+        if (mapped < 0) mapped = to.add_truth(from.truths()[row.truth]);
+        row.truth = mapped;
+    }
+    to.push_back(row);
 }
 
-int getAPA(int channel) {
-    return channel / CHANNELS_PER_APA;
+// Writes the buffered events of an APA, one write_event per run of rows of the same event.
+// If keep_open_event, the trailing rows of open_event (the event still being read) stay in the buffer
+void flush(ApaOutput& out, bool keep_open_event, int open_event) {
+    const TPStore& buffer = out.buffer;
+    size_t end = buffer.size();
+    if (keep_open_event) {
+        while (end > 0 && buffer.get_event(end - 1) == open_event) --end;
+    }
+    if (end == 0) return;
+
+    for (size_t begin = 0; begin < end;) {
+        size_t stop = begin + 1;
+        while (stop < end && buffer.get_event(stop) == buffer.get_event(begin)) ++stop;
+        out.writer->write_event(buffer, begin, stop);
+        begin = stop;
+    }
+    out.n_tps += end;
+
+    // The rows of the open event start the next buffer, with a truth table of their own
+    TPStore rest;
+    std::vector<int32_t> rest_truth_map(buffer.truths().size(), -1);
+    for (size_t i = end; i < buffer.size(); ++i) copy_row(buffer, i, rest, rest_truth_map);
+    out.buffer = std::move(rest);
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <input_file.root> <output_directory>" << std::endl;
-        std::cerr << std::endl;
-        std::cerr << "Splits TriggerPrimitive data by APA (N APAs, 2560 channels each)" << std::endl;
-        std::cerr << "Creates N output files: <output_dir>/apa0_tps.root, apa1_tps.root, etc." << std::endl;
-        return 1;
+// Base of the output names of an input: its name without extension nor trailing "_tps"
+std::string get_output_base(const std::string& input, const std::string& output_folder) {
+    std::string stem = std::filesystem::path(input).stem().string();
+    const std::string tps_suffix = "_tps";
+    if (stem.size() > tps_suffix.size() && stem.compare(stem.size() - tps_suffix.size(), tps_suffix.size(), tps_suffix) == 0) {
+        stem.erase(stem.size() - tps_suffix.size());
     }
+    return output_folder + "/" + stem;
+}
 
-    std::string input_filename = argv[1];
-    std::string output_dir = argv[2];
+// Splits one file: chunks of TPs are read column by column, routed to the buffer of their APA
+// and written in batches of at least batch_size TPs per APA, whole events at a time
+SplitResult split_file(const std::string& input, const std::string& output_base, int n_apas,
+                       const std::string& extension, const RootOutputSettings& output_settings,
+                       size_t batch_size, bool override_mode) {
+    SplitResult result;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<ApaOutput> outputs(n_apas);
+    for (int apa = 0; apa < n_apas; ++apa) {
+        outputs[apa].filename = output_base + "_apa" + std::to_string(apa) + "_tps" + extension;
+        result.outputs.push_back(outputs[apa].filename);
+    }
+    if (!override_mode && std::all_of(outputs.begin(), outputs.end(), [](const ApaOutput& out){ return std::filesystem::exists(out.filename); })) {
+        result.skipped = true;
+        return result;
+    }
 
-    // Ensure output directory ends with /
-    if (output_dir.back() != '/') {
-        output_dir += "/";
+    TpsColumnReader reader(input);
+    if (!reader.is_open()) return result;
+    for (auto& out : outputs) {
+        out.writer.reset(new TpsWriter(out.filename, output_settings));
+        if (!out.writer->is_open()) return result;
     }
 
-    // Load detector configuration (optional; defaults preserve old behavior)
-    int n_apas = 4;
-    std::string detector_name;
-    try {
-        ParametersManager::getInstance().loadParameters();
-        if (ParametersManager::getInstance().hasParameter("detector.n_apas")) {
-            n_apas = ParametersManager::getInstance().getInt("detector.n_apas");
-        }
-        if (ParametersManager::getInstance().hasParameter("detector.name")) {
-            detector_name = ParametersManager::getInstance().getString("detector.name");
+    TPStore chunk;
+    while (true) {
+        chunk.clear();
+        if (!reader.read_chunk(chunk)) break;
+        if (chunk.empty()) continue;
+        result.n_tps += chunk.size();
+
+        for (auto& out : outputs) out.truth_map.assign(chunk.truths().size(), -1);
+        const std::vector<uint32_t>& channels = chunk.channel();
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            const uint32_t apa = channels[i] / APA::total_channels;
+            if (apa >= static_cast<uint32_t>(n_apas)) {
+                result.n_invalid++;
+                continue;
+            }
+            copy_row(chunk, i, outputs[apa].buffer, outputs[apa].truth_map);
         }
-    } catch (const std::exception&) {
-        // Keep defaults if parameter loading fails
-    }
-
-    std::cout << "======================================" << std::endl;
-    std::cout << "APA Splitter for TriggerPrimitive Data" << std::endl;
-    std::cout << "======================================" << std::endl;
-    std::cout << "Input file: " << input_filename << std::endl;
-    std::cout << "Output directory: " << output_dir << std::endl;
-    if (!detector_name.empty()) {
-        std::cout << "Detector: " << detector_name << std::endl;
-    }
-    std::cout << "Configuration:" << std::endl;
-    std::cout << "  - APAs: " << n_apas << std::endl;
-    std::cout << "  - Channels per APA: " << CHANNELS_PER_APA << std::endl;
-    std::cout << "======================================" << std::endl;
-
-    // Open input file
-    TFile* input_file = TFile::Open(input_filename.c_str(), "READ");
-    if (!input_file || input_file->IsZombie()) {
-        std::cerr << "ERROR: Cannot open input file: " << input_filename << std::endl;
-        return 1;
-    }
-
-    // Get TriggerPrimitive tree (try both naming conventions)
-    TTree* input_tree = (TTree*)input_file->Get("TriggerPrimitive");
-    if (!input_tree) {
-        input_tree = (TTree*)input_file->Get("tps/TriggerPrimitive");
-    }
-    if (!input_tree) {
-        input_tree = (TTree*)input_file->Get("tps");  // TPs at root level
-    }
-    if (!input_tree) {
-        input_tree = (TTree*)input_file->Get("tps/tps");  // Old format: TPs inside directory
-    }
-    if (!input_tree) {
-        std::cerr << "ERROR: Cannot find TriggerPrimitive tree in input file" << std::endl;
-        std::cerr << "Tried: 'TriggerPrimitive', 'tps/TriggerPrimitive', 'tps', and 'tps/tps'" << std::endl;
-        input_file->Close();
-        return 1;
-    }
-
-    Long64_t n_entries = input_tree->GetEntries();
-    std::cout << "Total TPs in input: " << n_entries << std::endl;
-
-    // Setup input branches
-    TPBranches tp_in;
-    setupInputBranches(input_tree, tp_in);
-
-    // Create output files and trees for each APA
-    std::vector<TFile*> output_files(n_apas);
-    std::vector<TTree*> output_trees(n_apas);
-    std::vector<TPBranches> tp_out(n_apas);
-    std::vector<Long64_t> apa_counters(n_apas, 0);
-
-    for (int apa = 0; apa < n_apas; apa++) {
-        std::string output_filename = output_dir + "apa" + std::to_string(apa) + "_tps.root";
-        output_files[apa] = new TFile(output_filename.c_str(), "RECREATE");
-        if (!output_files[apa] || output_files[apa]->IsZombie()) {
-            std::cerr << "ERROR: Cannot create output file: " << output_filename << std::endl;
-            return 1;
+
+        // Only the last event of the chunk may continue in the next one
+        const int open_event = chunk.get_event(chunk.size() - 1);
+        for (auto& out : outputs) {
+            if (out.buffer.size() >= batch_size) flush(out, true, open_event);
         }
+    }
 
-        // Create tps directory (to match input file structure)
-        TDirectory* tps_dir = output_files[apa]->mkdir("tps");
-        tps_dir->cd();
-        
-        // Create tree inside tps directory with name "tps"
-        output_trees[apa] = new TTree("tps", ("TriggerPrimitive data for APA " + std::to_string(apa)).c_str());
-        setupOutputBranches(output_trees[apa], tp_out[apa]);
+    for (auto& out : outputs) {
+        flush(out, false, 0);
+        out.writer->close();
+        result.n_tps_per_apa.push_back(out.n_tps);
     }
+    reader.close();
 
-    // Process all TPs
-    std::cout << "Processing TPs..." << std::endl;
-    Long64_t report_interval = n_entries / 10;
-    if (report_interval == 0) report_interval = 1;
+    result.done = true;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
 
-    for (Long64_t i = 0; i < n_entries; i++) {
-        input_tree->GetEntry(i);
+}
 
-        // Determine which APA this TP belongs to
-        int apa_id = getAPA(tp_in.channel);
+int main(int argc, char* argv[]) {
+    CmdLineParser clp;
+    clp.getDescription() << "> split_by_apa app - Split TP files by APA (channel / " << APA::total_channels << "), one output file per APA and input file." << std::endl;
+    clp.addDummyOption("Main options");
+    clp.addOption("inputFile", {"-i", "--input-file"}, "Input file with list OR single TP file path (*_tps.root or *_tps.tpb)");
+    clp.addOption("outFolder", {"-o", "--output-folder"}, "Output folder (default: next to each input file)");
+    clp.addOption("json", {"-j", "--json"}, "JSON file with the output format (tps_format) and ROOT output settings (root_output), optional");
+    clp.addOption("n_apas", {"-n", "--n-apas"}, "Number of APAs (default: detector.n_apas)");
+    clp.addOption("threads", {"-t", "--threads"}, "Number of input files split in parallel (default: 1)", 1);
+    clp.addOption("batch_size", {"--batch-size"}, "TPs buffered per APA before they are written (default: 100000)", 100000);
+    clp.addTriggerOption("binary", {"-b", "--binary"}, "Write the compact binary TP format (*_tps.tpb), overrides tps_format");
+    clp.addTriggerOption("override", {"-f", "--override"}, "Override existing output files");
+    clp.addTriggerOption("verboseMode", {"-v", "--verbose"}, "Run in verbose mode");
+    clp.addDummyOption();
+
+    LogInfo << clp.getDescription().str() << std::endl;
+    LogInfo << "Usage: " << std::endl;
+    LogInfo << clp.getConfigSummary() << std::endl << std::endl;
+
+    clp.parseCmdLine(argc, argv);
+    LogThrowIf( clp.isNoOptionTriggered(), "No option was provided." );
+    LogThrowIf( !clp.isOptionTriggered("inputFile"), "No input file was provided (-i)." );
+
+    verboseMode = clp.isOptionTriggered("verboseMode");
+    const bool overrideMode = clp.isOptionTriggered("override");
+
+    // Load parameters
+    ParametersManager::getInstance().loadParameters();
+
+    nlohmann::json j;
+    if (clp.isOptionTriggered("json")) {
+        std::ifstream i(clp.getOptionVal<std::string>("json"));
+        LogThrowIf(!i.good(), "Failed to open JSON config: " << clp.getOptionVal<std::string>("json"));
+        i >> j;
+    }
 
-        // Validate APA ID
-        if (apa_id < 0 || apa_id >= n_apas) {
-            std::cerr << "WARNING: Invalid channel " << tp_in.channel 
-                      << " maps to APA " << apa_id << " (entry " << i << ")" << std::endl;
-            continue;
+    int n_apas = 4;
+    if (ParametersManager::getInstance().hasParameter("detector.n_apas")) {
+        n_apas = ParametersManager::getInstance().getInt("detector.n_apas");
+    }
+    if (clp.isOptionTriggered("n_apas")) n_apas = clp.getOptionVal<int>("n_apas");
+    LogThrowIf(n_apas <= 0, "Invalid number of APAs: " << n_apas);
+
+    // Inputs: a single TP file, or a list of them
+    std::vector<std::string> inputs;
+    const std::string input_file = clp.getOptionVal<std::string>("inputFile");
+    const std::string input_extension = std::filesystem::path(input_file).extension().string();
+    if (input_extension == ".root" || input_extension == tp_binary::extension) {
+        inputs.push_back(input_file);
+    } else {
+        std::ifstream lf(input_file);
+        LogThrowIf(!lf.good(), "Cannot open input list: " << input_file);
+        std::string line;
+        while (std::getline(lf, line)) {
+            if (!line.empty() && line[0] != '#') inputs.push_back(line);
         }
+    }
+    LogThrowIf(inputs.empty(), "No input files found in: " << input_file);
 
-        // Copy to appropriate APA output
-        tp_out[apa_id].event = tp_in.event;
-        tp_out[apa_id].version = tp_in.version;
-        tp_out[apa_id].detid = tp_in.detid;
-        tp_out[apa_id].channel = tp_in.channel;
-        tp_out[apa_id].samples_over_threshold = tp_in.samples_over_threshold;
-        tp_out[apa_id].time_start = tp_in.time_start;
-        tp_out[apa_id].samples_to_peak = tp_in.samples_to_peak;
-        tp_out[apa_id].adc_integral = tp_in.adc_integral;
-        tp_out[apa_id].adc_peak = tp_in.adc_peak;
-
-        output_trees[apa_id]->Fill();
-        apa_counters[apa_id]++;
-
-        // Progress report
-        if (i % report_interval == 0) {
-            std::cout << "  Progress: " << (100 * i / n_entries) << "%" << std::endl;
-        }
+    std::string outfolder;
+    if (clp.isOptionTriggered("outFolder")) {
+        outfolder = clp.getOptionVal<std::string>("outFolder");
+        if (!outfolder.empty() && outfolder.back() == '/') outfolder.pop_back();
+        LogThrowIf(!ensureDirectoryExists(outfolder), "Unable to create output folder '" << outfolder << "'.");
     }
 
-    std::cout << "Processing complete!" << std::endl;
-    std::cout << "======================================" << std::endl;
-    std::cout << "TPs per APA:" << std::endl;
+    const std::string tps_extension = clp.isOptionTriggered("binary") ? std::string(tp_binary::extension) : getTpsFileExtension(j);
+    const RootOutputSettings output_settings = getRootOutputSettings(j, "tps");
+    const size_t batch_size = static_cast<size_t>(std::max(1, clp.getOptionVal<int>("batch_size")));
 
-    // Write and close output files
-    for (int apa = 0; apa < n_apas; apa++) {
-        // Navigate to tps directory and write tree there
-        TDirectory* tps_dir = (TDirectory*)output_files[apa]->Get("tps");
-        if (tps_dir) {
-            tps_dir->cd();
-            output_trees[apa]->Write();
+    int n_threads = 1;
+    if (clp.isOptionTriggered("threads")) {
+        n_threads = std::max(1, clp.getOptionVal<int>("threads"));
+    }
+    n_threads = std::min<int>(n_threads, inputs.size());
+    if (n_threads > 1) ROOT::EnableThreadSafety();
+
+    LogInfo << "Settings:" << std::endl;
+    LogInfo << " - Input files: " << inputs.size() << std::endl;
+    LogInfo << " - Output folder: " << (outfolder.empty() ? std::string("next to each input") : outfolder) << std::endl;
+    LogInfo << " - APAs: " << n_apas << " (" << APA::total_channels << " channels each)" << std::endl;
+    LogInfo << " - TP file format: " << (tps_extension == tp_binary::extension ? "binary" : "root") << std::endl;
+    if (tps_extension == ".root") LogInfo << " - ROOT output: " << output_settings.get_description() << std::endl;
+    LogInfo << " - Batch size: " << batch_size << " TPs per APA" << std::endl;
+    LogInfo << " - Threads: " << n_threads << std::endl;
+
+    // Every file is split by a single thread, into output files of its own
+    std::vector<SplitResult> results(inputs.size());
+    std::atomic<int> next_file(0);
+    int done_files = 0;
+    std::mutex progress_mutex;
+
+    auto process_files = [&]() {
+        for (int iFile = next_file++; iFile < (int)inputs.size(); iFile = next_file++) {
+            const std::string& input = inputs[iFile];
+            std::string folder = outfolder;
+            if (folder.empty()) {
+                folder = std::filesystem::path(input).parent_path().string();
+                if (folder.empty()) folder = ".";
+            }
+            results[iFile] = split_file(input, get_output_base(input, folder), n_apas, tps_extension,
+                                        output_settings, batch_size, overrideMode);
+
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            done_files++;
+            GenericToolbox::displayProgressBar(done_files, inputs.size(), "Splitting files...");
+        }
+    };
+
+    auto start_processing = std::chrono::steady_clock::now();
+    if (n_threads == 1) {
+        process_files();
+    } else {
+        std::vector<std::thread> workers;
+        for (int iThread = 0; iThread < n_threads; ++iThread) workers.emplace_back(process_files);
+        for (auto& worker : workers) worker.join();
+    }
+    std::chrono::duration<double> processing_time = std::chrono::steady_clock::now() - start_processing;
+
+    // Summary, in input order whatever the number of threads
+    size_t n_tps = 0, n_invalid = 0, n_done = 0, n_skipped = 0;
+    std::vector<size_t> n_tps_per_apa(n_apas, 0);
+    for (size_t iFile = 0; iFile < inputs.size(); ++iFile) {
+        const SplitResult& result = results[iFile];
+        if (result.skipped) {
+            n_skipped++;
+            if (verboseMode) LogInfo << "Outputs already exist, skipped: " << inputs[iFile] << " (use --override to force)" << std::endl;
+            continue;
+        }
+        if (!result.done) {
+            LogError << "Failed to split: " << inputs[iFile] << std::endl;
+            continue;
+        }
+        n_done++;
+        n_tps += result.n_tps;
+        n_invalid += result.n_invalid;
+        for (int apa = 0; apa < n_apas; ++apa) n_tps_per_apa[apa] += result.n_tps_per_apa[apa];
+        if (verboseMode) {
+            LogInfo << inputs[iFile] << ": " << result.n_tps << " TPs in " << result.seconds << " s" << std::endl;
+            for (const auto& out : result.outputs) LogInfo << " - " << out << std::endl;
+        }
+        if (result.n_invalid > 0) {
+            LogWarning << inputs[iFile] << ": " << result.n_invalid << " TPs with a channel beyond APA " << n_apas - 1 << " were dropped" << std::endl;
         }
-        output_files[apa]->Close();
-        delete output_files[apa];
-
-        std::cout << "  APA " << apa << ": " << apa_counters[apa] << " TPs" << std::endl;
     }
 
-    // Close input file
-    input_file->Close();
-    delete input_file;
-
-    std::cout << "======================================" << std::endl;
-    std::cout << "Split complete! Output files:" << std::endl;
-    for (int apa = 0; apa < n_apas; apa++) {
-        std::string output_filename = output_dir + "apa" + std::to_string(apa) + "_tps.root";
-        std::cout << "  " << output_filename << std::endl;
+    LogInfo << "Split " << n_done << " file(s), " << n_skipped << " skipped, " << n_tps << " TPs in "
+            << processing_time.count() << " s" << std::endl;
+    for (int apa = 0; apa < n_apas; ++apa) {
+        LogInfo << " - APA " << apa << ": " << n_tps_per_apa[apa] << " TPs" << std::endl;
     }
-    std::cout << "======================================" << std::endl;
+    if (n_invalid > 0) LogWarning << "Dropped " << n_invalid << " TPs with an invalid APA" << std::endl;
 
-    return 0;
+    return n_done + n_skipped == inputs.size() ? 0 : 1;
 }
@@ -58,7 +58,8 @@ int main(int argc, char* argv[]) {
     }
     LogInfo << "Number of files: " << filenames.size() << std::endl;
 
-    std::vector<Cluster> sig_clusters = read_clusters(signal_clusters);
+    ClusterSet sig_cluster_set = read_clusters(signal_clusters);
+    std::vector<Cluster>& sig_clusters = sig_cluster_set.clusters();
     std::map<int, std::vector<Cluster>> sig_event_mapping = create_event_mapping(sig_clusters);
     LogInfo << "Sig event mapping created" << std::endl;
     std::vector<int> sig_list_of_event_numbers;
@@ -3,6 +3,14 @@
 
 LoggerInit([]{Logger::getUserHeader() << "[" << FILENAME << "]";});
 
+namespace {
+    // Trees of the tpstream files produced by triggerAnaDumpTPs
+    const std::string tps_tree_path = "triggerAnaDumpTPs/TriggerPrimitives/tpmakerTPC__TriggerAnaTree1x2x2"; // TODO make flexible for 1x2x6 and maybe else
+    const std::string mcparticles_tree_path = "triggerAnaDumpTPs/mcparticles";
+    const std::string mctruths_tree_path = "triggerAnaDumpTPs/mctruths";
+    const std::string simides_tree_path = "triggerAnaDumpTPs/simides";
+}
+
 // read the tps from the files and save them in a vector
 void read_tpstream(std::string filename,
                  std::vector<TriggerPrimitive>& tps,
@@ -11,82 +19,156 @@ void read_tpstream(std::string filename,
                  int supernova_option,
                  int event_number,
                  double time_tolerance_ticks,
-                 int channel_tolerance) {
+                 int channel_tolerance,
+                 const TpstreamEventIndex* event_index) {
+
+    // Single-event convenience wrapper: whole files should be read with one TpstreamBacktracker
+    TpstreamBacktracker backtracker(filename, time_tolerance_ticks, channel_tolerance, event_index);
+    backtracker.read_event(event_number, tps, true_particles, neutrinos);
+}
 
-    if (debugMode) LogInfo << " Reading file: " << filename << std::endl;
+TpstreamBacktracker::TpstreamBacktracker(const std::string& filename,
+                                         double time_tolerance_ticks,
+                                         int channel_tolerance,
+                                         const TpstreamEventIndex* event_index)
+    : filename_(filename),
+      time_tolerance_ticks_(time_tolerance_ticks),
+      channel_tolerance_(channel_tolerance)
+{
+    if (debugMode) LogInfo << " Reading file: " << filename_ << std::endl;
 
-    TFile *file = TFile::Open(filename.c_str());
-    if (!file || file->IsZombie()) {
-        LogError << " Error opening file: " << filename << std::endl;
+    file_ = TFile::Open(filename_.c_str());
+    if (!file_ || file_->IsZombie()) {
+        LogError << " Error opening file: " << filename_ << std::endl;
+        close();
         return;
     }
-    
-    std::string this_interaction = "UNKNOWN";
+
     // Extract interaction type from filename by looking for exact _cc_ or _es_ patterns
     // Check _cc_ first to avoid false matches with substrings
-    if (filename.find("cc_") != std::string::npos) {
-        this_interaction = "CC";
-    } else if (filename.find("CC_") != std::string::npos) {
-        this_interaction = "CC";
-    } else if (filename.find("es_") != std::string::npos) {
-        this_interaction = "ES";
-    } else if (filename.find("ES_") != std::string::npos) {
-        this_interaction = "ES";
+    if (filename_.find("cc_") != std::string::npos) {
+        interaction_ = "CC";
+    } else if (filename_.find("CC_") != std::string::npos) {
+        interaction_ = "CC";
+    } else if (filename_.find("es_") != std::string::npos) {
+        interaction_ = "ES";
+    } else if (filename_.find("ES_") != std::string::npos) {
+        interaction_ = "ES";
     } else {
-        this_interaction = "UNKNOWN";
+        interaction_ = "UNKNOWN";
     }
 
-    if (verboseMode) LogInfo << " For this file, interaction type: " << this_interaction << std::endl;
+    if (verboseMode) LogInfo << " For this file, interaction type: " << interaction_ << std::endl;
+
+    tps_tree_ = dynamic_cast<TTree*>(file_->Get(tps_tree_path.c_str()));
+    mcparticles_tree_ = dynamic_cast<TTree*>(file_->Get(mcparticles_tree_path.c_str()));
+    mctruths_tree_ = dynamic_cast<TTree*>(file_->Get(mctruths_tree_path.c_str()));
+    simides_tree_ = dynamic_cast<TTree*>(file_->Get(simides_tree_path.c_str()));
+    if (!tps_tree_) LogError << " Tree not found: " << tps_tree_path << std::endl;
+    if (!mcparticles_tree_) LogError << " Tree not found: " << mcparticles_tree_path << std::endl;
+    if (!mctruths_tree_) LogError << " Tree not found: " << mctruths_tree_path << std::endl;
+    if (!tps_tree_ || !mcparticles_tree_ || !mctruths_tree_) {
+        close();
+        return;
+    }
+    if (!simides_tree_) LogError << "SimIDEs tree not found: " << simides_tree_path << ", TPs will not be backtracked" << std::endl;
+
+    // Entry ranges of every event, built once per file unless the caller already has them
+    if (event_index) event_index_ = *event_index;
+    else build_tpstream_event_index(file_, event_index_);
+
+    // Bind all the branches once, they are then read by entry range for every event
+    bindBranch(tps_tree_, "version", &tp_version_); // dropped v1, there are no samples with it
+    bindBranch(tps_tree_, "time_start", &tp_time_start_);
+    bindBranch(tps_tree_, "channel", &tp_channel_);
+    bindBranch(tps_tree_, "adc_integral", &tp_adc_integral_);
+    bindBranch(tps_tree_, "adc_peak", &tp_adc_peak_);
+    bindBranch(tps_tree_, "detid", &tp_detid_);
+    bindBranch(tps_tree_, "Event", &tp_event_);
+    bindBranch(tps_tree_, "samples_over_threshold", &tp_samples_over_threshold_);
+    bindBranch(tps_tree_, "samples_to_peak", &tp_samples_to_peak_);
+
+    // mcparticles and mctruths are never read at the same time, they share the buffers
+    mcparticles_tree_->SetBranchAddress("process", &process_);
+    mcparticles_tree_->SetBranchAddress("generator_name", &generator_name_);
+    mcparticles_tree_->SetBranchAddress("x", &x_);
+    mcparticles_tree_->SetBranchAddress("y", &y_);
+    mcparticles_tree_->SetBranchAddress("z", &z_);
+    if (!SetBranchWithFallback(mcparticles_tree_, {"Px", "px"}, &px_, "MC particles Px")
+        || !SetBranchWithFallback(mcparticles_tree_, {"Py", "py"}, &py_, "MC particles Py")
+        || !SetBranchWithFallback(mcparticles_tree_, {"Pz", "pz"}, &pz_, "MC particles Pz")
+        || !SetBranchWithFallback(mcparticles_tree_, {"en", "energy"}, &energy_, "MC particles energy")) {
+        close();
+        return;
+    }
+    mcparticles_tree_->SetBranchAddress("pdg", &pdg_);
+    mcparticles_tree_->SetBranchAddress("Event", &event_);
+    mcparticles_tree_->SetBranchAddress("g4_track_id", &track_id_);
+    mcparticles_tree_->SetBranchAddress("truth_block_id", &truth_id_);
+    mcparticles_tree_->SetBranchAddress("status_code", &status_code_);
+
+    mctruths_tree_->SetBranchAddress("generator_name", &generator_name_);
+    mctruths_tree_->SetBranchAddress("x", &x_);
+    mctruths_tree_->SetBranchAddress("y", &y_);
+    mctruths_tree_->SetBranchAddress("z", &z_);
+    if (!SetBranchWithFallback(mctruths_tree_, {"Px", "px"}, &px_, "MC truth Px")
+        || !SetBranchWithFallback(mctruths_tree_, {"Py", "py"}, &py_, "MC truth Py")
+        || !SetBranchWithFallback(mctruths_tree_, {"Pz", "pz"}, &pz_, "MC truth Pz")
+        || !SetBranchWithFallback(mctruths_tree_, {"en", "energy"}, &energy_, "MC truth energy")) {
+        close();
+        return;
+    }
+    mctruths_tree_->SetBranchAddress("pdg", &pdg_);
+    mctruths_tree_->SetBranchAddress("Event", &event_);
+    mctruths_tree_->SetBranchAddress("block_id", &block_id_);
+    mctruths_tree_->SetBranchAddress("status_code", &status_code_);
 
-    std::string TPtree_path = "triggerAnaDumpTPs/TriggerPrimitives/tpmakerTPC__TriggerAnaTree1x2x2"; // TODO make flexible for 1x2x6 and maybe else
-    TTree *TPtree = dynamic_cast<TTree*>(file->Get(TPtree_path.c_str()));
-    if (!TPtree) {
-        LogError << " Tree not found: " << TPtree_path << std::endl;
-        return; // can still go to next file
+    if (simides_tree_ && !simide_branches_.bind(simides_tree_)) {
+        simides_tree_ = nullptr;
     }
-    
-    int first_tp_entry_in_event = -1;
-    int last_tp_entry_in_event = -1;
+}
+
+TpstreamBacktracker::~TpstreamBacktracker() {
+    close();
+    delete process_;
+    delete generator_name_;
+}
 
-    UInt_t this_event_number = 0;
-    if (TPtree->SetBranchAddress("Event", &this_event_number) < 0) {
-        LogWarning << "Failed to bind branch 'Event'" << std::endl;
+void TpstreamBacktracker::close() {
+    if (file_) {
+        file_->Close();
+        delete file_;
+        file_ = nullptr;
     }
+    tps_tree_ = nullptr;
+    mcparticles_tree_ = nullptr;
+    mctruths_tree_ = nullptr;
+    simides_tree_ = nullptr;
+}
+
+bool TpstreamBacktracker::read_event(int event_number,
+                                     std::vector<TriggerPrimitive>& tps,
+                                     std::vector<TrueParticle>& true_particles,
+                                     std::vector<Neutrino>& neutrinos) {
+    if (!is_open()) return false;
+
+    Long64_t first_tp_entry_in_event = -1;
+    Long64_t last_tp_entry_in_event = -1;
 
-    get_first_and_last_event(TPtree, &this_event_number, event_number, first_tp_entry_in_event, last_tp_entry_in_event);
+    get_first_and_last_event(event_index_.tps, event_number, first_tp_entry_in_event, last_tp_entry_in_event);
 
     if (debugMode) LogInfo << "First entry having this event number: " << first_tp_entry_in_event << std::endl;
     if (debugMode) LogInfo << "Last entry having this event number: " << last_tp_entry_in_event << std::endl;
 
     // Check if we found the event in TPs tree - if not, skip this event (can happen with backgrounds)
     if (first_tp_entry_in_event == -1) {
-        if (verboseMode) LogInfo << "Event " << event_number << " has no TPs in file " << filename << " (skipping)" << std::endl;
-        return; // Return with empty vectors - this is normal for some background events
+        if (verboseMode) LogInfo << "Event " << event_number << " has no TPs in file " << filename_ << " (skipping)" << std::endl;
+        return false; // Return with empty vectors - this is normal for some background events
     }
 
     if (verboseMode) LogInfo << "Number of TPs in event " << event_number << ": " << last_tp_entry_in_event - first_tp_entry_in_event + 1 << std::endl;
 
-    tps.reserve(last_tp_entry_in_event - first_tp_entry_in_event + 1);
-
-    UShort_t this_version = 0;
-    uint64_t this_time_start = 0;
-    UInt_t this_channel = 0;          // Raw channel read from file, global
-    UInt_t this_adc_integral = 0;
-    UShort_t this_adc_peak = 0;
-    UShort_t this_detid = 0;          // Detector, it's just aleays 3 (TPC)
-    UShort_t this_samples_over_threshold = 0;
-    UShort_t this_samples_to_peak = 0;
-    // int this_event_number = 0;
-
-    bindBranch(TPtree,"version", &this_version); // dropped v1, there are no samples with it
-    bindBranch(TPtree,"time_start", &this_time_start);
-    bindBranch(TPtree,"channel", &this_channel);
-    bindBranch(TPtree,"adc_integral", &this_adc_integral);
-    bindBranch(TPtree,"adc_peak", &this_adc_peak);
-    bindBranch(TPtree,"detid", &this_detid);
-    bindBranch(TPtree,"Event", &this_event_number);
-    bindBranch(TPtree,"samples_over_threshold", &this_samples_over_threshold);
-    bindBranch(TPtree,"samples_to_peak", &this_samples_to_peak);
+    tps.reserve(tps.size() + last_tp_entry_in_event - first_tp_entry_in_event + 1);
 
     if (verboseMode) LogInfo << " Reading tree of TriggerPrimitives" << std::endl;
 
@@ -96,38 +178,30 @@ void read_tpstream(std::string filename,
 
     // Loop over the entries in the tree
     for (Long64_t iTP = first_tp_entry_in_event; iTP <= last_tp_entry_in_event; ++iTP) {
-        TPtree->GetEntry(iTP);
-    
-        // Determine if the channel appears detector-local; if so promote to global numbering
-        // Global scheme is: global = detid * APA::total_channels + local
-        // uint64_t effective_channel = this_channel;
-        // THIS IS WRONG
-        // if (this_detid > 0 && this_channel >= 0 && this_channel < APA::total_channels) {
-        //     effective_channel = (uint64_t)this_detid * APA::total_channels + (uint64_t)this_channel;
-        // }
-        // Heuristic safeguard: if channel already large (>= total_channels) but detid==0 we assume it's already global and leave unchanged
+        tps_tree_->GetEntry(iTP);
 
         // Track whether any non-zero ToT is observed; we'll apply the ToT<2 filter only if ToT info is present and non-trivial
-        if (this_samples_over_threshold > 0) {
+        if (tp_samples_over_threshold_ > 0) {
             ++tot_nonzero_seen;
         }
 
         TriggerPrimitive this_tp = TriggerPrimitive(
-            this_version,
+            tp_version_,
             0, // flag
-            this_detid, // this is just TPC, always 3
-            this_channel,
-            this_samples_over_threshold,
-            this_time_start,
-            this_samples_to_peak,
-            this_adc_integral,
-            this_adc_peak
+            tp_detid_, // this is just TPC, always 3
+            tp_channel_,
+            tp_samples_over_threshold_,
+            tp_time_start_,
+            tp_samples_to_peak_,
+            tp_adc_integral_,
+            tp_adc_peak_
         );
 
-        this_tp.SetEvent(this_event_number);
-        
+        this_tp.SetEvent(tp_event_);
+
         tps.emplace_back(this_tp); // add to collection of TPs
     }
+    UInt_t this_event_number = tp_event_;
 
     // Apply ToT<2 filter only if ToT info is actually populated (some non-zero values seen)
     if (!tps.empty()) {
@@ -139,135 +213,69 @@ void read_tpstream(std::string filename,
             }), tps.end());
             tot_filtered_count = before - tps.size();
 
-            if (verboseMode) LogInfo << " Found " << tps.size() << " TPs in file " << filename << " after ToT>=2 filter"
+            if (verboseMode) LogInfo << " Found " << tps.size() << " TPs in file " << filename_ << " after ToT>=2 filter"
                     << " (filtered " << tot_filtered_count << ")" << std::endl;
         } else {
             // No meaningful ToT data; skip the filter to avoid dropping everything
             // This is expected for older file formats or certain simulation types
             if (verboseMode) LogInfo << " Event " << this_event_number << ": ToT field absent or all zeros for " << tps.size() 
-                       << " TPs; skipping ToT<2 filter (keeping all TPs from file " << filename << ")" << std::endl;
+                       << " TPs; skipping ToT<2 filter (keeping all TPs from file " << filename_ << ")" << std::endl;
             // Only warn if we have very few TPs AND they all have ToT=0, which might indicate a problem
             if (tps.size() < 10 && tps.size() > 0) {
                 LogWarning << " Event " << this_event_number << ": Low TP count (" << tps.size() 
-                           << ") with all ToT=0 in file " << filename << " - this may be normal for background events" << std::endl;
+                           << ") with all ToT=0 in file " << filename_ << " - this may be normal for background events" << std::endl;
             }
         }
     } else {
-        LogWarning << " Found no TPs in file " << filename << " (nothing to filter)" << std::endl;
+        LogWarning << " Found no TPs in file " << filename_ << " (nothing to filter)" << std::endl;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Read mcparticles (geant)
 
-    std::string MCparticlestree_path = "triggerAnaDumpTPs/mcparticles";
-    TTree *MCparticlestree = dynamic_cast<TTree*>(file->Get(MCparticlestree_path.c_str()));
-    if (!MCparticlestree) {
-        LogError << "Tree not found: " << MCparticlestree_path << std::endl;
-        return;
-    }
-
     // find first and last entry of the event
-    int first_mcparticle_entry_in_event = -1;
-    int last_mcparticle_entry_in_event = -1;
-
-    UInt_t event = 0;
-    MCparticlestree->SetBranchAddress("Event", &event);
+    Long64_t first_mcparticle_entry_in_event = -1;
+    Long64_t last_mcparticle_entry_in_event = -1;
 
-    get_first_and_last_event(MCparticlestree, &event, this_event_number, first_mcparticle_entry_in_event, last_mcparticle_entry_in_event);
+    get_first_and_last_event(event_index_.mcparticles, this_event_number, first_mcparticle_entry_in_event, last_mcparticle_entry_in_event);
 
     if (verboseMode) LogInfo << "Number of MC particles in event " << event_number << ": " << last_mcparticle_entry_in_event - first_mcparticle_entry_in_event + 1 << std::endl;
 
     // we will have as many true particles as entries in this tree, 
     // including both geant and gen particles
-
-    std::map<int, std::vector<int>> truthId_to_mcparticleIdx;
-    std::string* generator_name = new std::string();
-    
-    // TODO tidy up this mess
-    Double_t x = 0.0, y = 0.0, z = 0.0;
-    Double_t px = 0.0, py = 0.0, pz = 0.0;
-    Double_t energy = 0.0;
-    int pdg = 0;
-    //UInt_t event = 0;
-    int block_id = 0, track_id = 0;
-    int truth_id = 0;
-    int status_code = -1;
-
-    std::string* process = new std::string();
-    MCparticlestree->SetBranchAddress("process", &process);
-    MCparticlestree->SetBranchAddress("generator_name", &generator_name);
-    MCparticlestree->SetBranchAddress("x", &x);
-    MCparticlestree->SetBranchAddress("y", &y);
-    MCparticlestree->SetBranchAddress("z", &z);
-
-    if (!SetBranchWithFallback(MCparticlestree, {"Px", "px"}, &px, "MC particles Px")) {
-        return;
-    }
-    if (!SetBranchWithFallback(MCparticlestree, {"Py", "py"}, &py, "MC particles Py")) {
-        return;
-    }
-    if (!SetBranchWithFallback(MCparticlestree, {"Pz", "pz"}, &pz, "MC particles Pz")) {
-        return;
-    }
-    if (!SetBranchWithFallback(MCparticlestree, {"en", "energy"}, &energy, "MC particles energy")) {
-        return;
-    }
-
-    MCparticlestree->SetBranchAddress("pdg", &pdg);
-    MCparticlestree->SetBranchAddress("Event", &event);
-    MCparticlestree->SetBranchAddress("g4_track_id", &track_id);
-    MCparticlestree->SetBranchAddress("truth_block_id", &truth_id);
-    MCparticlestree->SetBranchAddress("status_code", &status_code);
-
     for (Long64_t iMCpart = first_mcparticle_entry_in_event; iMCpart <= last_mcparticle_entry_in_event; ++iMCpart) {
-        MCparticlestree->GetEntry(iMCpart);
+        mcparticles_tree_->GetEntry(iMCpart);
 
-        if (status_code == 0) continue; // skip initial state particles, not tracked
-        if (pdg == PDG::nue) continue; // skip neutrinos, they are in the mctruth tree
+        if (status_code_ == 0) continue; // skip initial state particles, not tracked
+        if (pdg_ == PDG::nue) continue; // skip neutrinos, they are in the mctruth tree
         
         true_particles.emplace_back( TrueParticle(
-            event,
-            x,
-            y,
-            z,
-            px,
-            py,
-            pz,
-            energy*1e3, // converting to MeV
-            *generator_name,
-            pdg,
-            *process,
-            track_id,
-            truth_id
+            event_,
+            x_,
+            y_,
+            z_,
+            px_,
+            py_,
+            pz_,
+            energy_*1e3, // converting to MeV
+            *generator_name_,
+            pdg_,
+            *process_,
+            track_id_,
+            truth_id_
         ));
-
-        // truthId_to_mcparticleIdx[truth_id].push_back(i);
-
-        // LogInfo << "......" << std::endl;
-        // true_particles.back().Print();
-        // LogInfo << "......" << std::endl;
     }
 
-    if (verboseMode) LogInfo << " Found " << true_particles.size() << " geant particles in file " << filename << std::endl;
+    if (verboseMode) LogInfo << " Found " << true_particles.size() << " geant particles in file " << filename_ << std::endl;
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // Read MC truth
 
-    std::string MCtruthtree_path = "triggerAnaDumpTPs/mctruths"; 
-    TTree *MCtruthtree = dynamic_cast<TTree*>(file->Get(MCtruthtree_path.c_str()));
-    if (!MCtruthtree) {
-        LogError << " Tree not found: " << MCtruthtree_path << std::endl;
-        return;
-    }
-
     // find first and last entry of the event
-    int first_mctruth_entry_in_event = -1;
-    int last_mctruth_entry_in_event = -1;
-
-    UInt_t event_truth = 0;
-    MCtruthtree->SetBranchAddress("Event", &event_truth);
+    Long64_t first_mctruth_entry_in_event = -1;
+    Long64_t last_mctruth_entry_in_event = -1;
 
-    get_first_and_last_event(MCtruthtree, &event_truth, this_event_number, first_mctruth_entry_in_event, last_mctruth_entry_in_event);
+    get_first_and_last_event(event_index_.mctruths, this_event_number, first_mctruth_entry_in_event, last_mctruth_entry_in_event);
 
     if (verboseMode) LogInfo << "Number of MC truths in event " << event_number << ": " << last_mctruth_entry_in_event - first_mctruth_entry_in_event + 1 << std::endl;
 
@@ -275,79 +283,54 @@ void read_tpstream(std::string filename,
     // associating to the final true particles 
     std::vector <TrueParticle> mc_true_particles; 
     
-    if (verboseMode) LogInfo << " Reading tree of MCtruths, there are " << MCtruthtree->GetEntries() << " entries" << std::endl;
-    MCtruthtree->SetBranchAddress("generator_name", &generator_name);
-    MCtruthtree->SetBranchAddress("x", &x);
-    MCtruthtree->SetBranchAddress("y", &y);
-    MCtruthtree->SetBranchAddress("z", &z);
-    if (!SetBranchWithFallback(MCtruthtree, {"Px", "px"}, &px, "MC truth Px")) {
-        return;
-    }
-    if (!SetBranchWithFallback(MCtruthtree, {"Py", "py"}, &py, "MC truth Py")) {
-        return;
-    }
-    if (!SetBranchWithFallback(MCtruthtree, {"Pz", "pz"}, &pz, "MC truth Pz")) {
-        return;
-    }
-    if (!SetBranchWithFallback(MCtruthtree, {"en", "energy"}, &energy, "MC truth energy")) {
-        return;
-    }
-    MCtruthtree->SetBranchAddress("pdg", &pdg);
-    MCtruthtree->SetBranchAddress("Event", &event);
-    MCtruthtree->SetBranchAddress("block_id", &block_id);
-    MCtruthtree->SetBranchAddress("status_code", &status_code);
+    if (verboseMode) LogInfo << " Reading tree of MCtruths, there are " << mctruths_tree_->GetEntries() << " entries" << std::endl;
     
     for (Long64_t iMCtruth = first_mctruth_entry_in_event; iMCtruth <= last_mctruth_entry_in_event; ++iMCtruth) {
         
-        MCtruthtree->GetEntry(iMCtruth);
-        // neutrinos.reserve(MCtruthtree->GetEntries());
-        // LogInfo << "  Generator is " << *generator_name << std::endl;
+        mctruths_tree_->GetEntry(iMCtruth);
         
-        if ( pdg == PDG::nue) { 
+        if ( pdg_ == PDG::nue) { 
             // if status code is not 0, it's a final state neutrino
-            if (status_code != 0)  continue;
+            if (status_code_ != 0)  continue;
 
-            // LogInfo << "This is a nu_e" << std::endl;
             // Add to the vector of Neutrinos
             neutrinos.emplace_back(Neutrino(
-                event,
-                this_interaction,
-                x,
-                y,
-                z,
-                px,
-                py,
-                pz,
-                energy*1e3, // converting to MeV
-                block_id
+                event_,
+                interaction_,
+                x_,
+                y_,
+                z_,
+                px_,
+                py_,
+                pz_,
+                energy_*1e3, // converting to MeV
+                block_id_
             ));
 
-            if (verboseMode) LogInfo << " Neutrino energy is " << energy*1e3 << " MeV" << std::endl;
+            if (verboseMode) LogInfo << " Neutrino energy is " << energy_*1e3 << " MeV" << std::endl;
         }
         else { // particles from neutrino interaction or backgrounds
             
             // if status code is 0, particle is not tracked (initial state)
-            if (status_code == 0)  continue;
+            if (status_code_ == 0)  continue;
 
-            // LogInfo << " Found a true particle with generator " << *generator_name << std::endl;
             mc_true_particles.emplace_back(
                 TrueParticle(
-                    event,
-                    x,
-                    y,
-                    z,
-                    px,
-                    py,
-                    pz,
-                    energy*1e3, // converting to MeV
-                    *generator_name,
-                    pdg,
+                    event_,
+                    x_,
+                    y_,
+                    z_,
+                    px_,
+                    py_,
+                    pz_,
+                    energy_*1e3, // converting to MeV
+                    *generator_name_,
+                    pdg_,
                     "", // process not available from mctruth tree
                     -1, // track_id not available from mctruth, will be set later from mcparticles
-                    block_id
+                    block_id_
                 )
             );
-            // LogInfo << "  Status code: " << status_code << " and energy " << energy << std::endl;
         }
     }
 
@@ -356,14 +339,14 @@ void read_tpstream(std::string filename,
     
     ///////////////////////////////////////////////////////////////////////////////////////////////
     // Apply direct TP-SimIDE matching
-    // This function reads SimIDEs from the file and matches them directly to TPs
-    // based on time and channel proximity, then links to MCParticles via trackID
+    // SimIDEs are matched directly to TPs based on time and channel proximity,
+    // then linked to MCParticles via trackID
     
-    if (verboseMode) LogInfo << " Applying direct TP-SimIDE matching for event " << this_event_number << std::endl;
-    const double effective_time_tolerance = (time_tolerance_ticks >= 0.0) ? time_tolerance_ticks : 5000.0;
-    match_tps_to_simides_direct(tps, true_particles, file, this_event_number, effective_time_tolerance, channel_tolerance);
-
-    file->Close(); // don't need anymore
+    if (simides_tree_) {
+        if (verboseMode) LogInfo << " Applying direct TP-SimIDE matching for event " << this_event_number << std::endl;
+        const double effective_time_tolerance = (time_tolerance_ticks_ >= 0.0) ? time_tolerance_ticks_ : 5000.0;
+        match_event_simides(simides_tree_, simide_branches_, event_index_.simides, tps, true_particles, this_event_number, effective_time_tolerance, channel_tolerance_);
+    }
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     // Connect trueparticles to mctruths using the truth_id
@@ -379,9 +362,7 @@ void read_tpstream(std::string filename,
             if (neutrino.GetEvent() == particle.GetEvent() 
             && neutrino.GetTruthId() == particle.GetTruthId()) 
             {
-                // LogInfo << " This particle comes from a neutrino" << std::endl;
                 particle.SetNeutrino(&neutrino);
-                // particle.SetGeneratorName("marley");
                 found = true;
                 break;
             }
@@ -401,13 +382,14 @@ void read_tpstream(std::string filename,
                 particle.SetPz(mc_true_particle.GetPz());
                 found = true;
                 matched_MCparticles_counter++;
-                // LogInfo << "Found a match for truth ID " << particle.GetTruthId() << std::endl;
                 break;
             }
         }
 
         if (!found) {
             static std::set<int> warned_truth_ids;
+            static std::mutex warned_truth_ids_mutex; // events can be backtracked in parallel
+            std::lock_guard<std::mutex> lock(warned_truth_ids_mutex);
             if (warned_truth_ids.find(particle.GetTruthId()) == warned_truth_ids.end()) {
                 LogError << "TruthID " << particle.GetTruthId() << " not found in MC truths or neutrinos." << std::endl;
                 warned_truth_ids.insert(particle.GetTruthId());
@@ -427,122 +409,112 @@ void read_tpstream(std::string filename,
     }
     if (verboseMode) LogInfo << " Updated embedded generator names in TPs" << std::endl;
     
-    // sort the TPs by time
+    // sort the TPs by time, unless the tpstream already has them in order (a linear check)
     // C++ 17 has the parameter std::execution::par that handles parallelization, can try that out TODO
     std::clock_t start_sorting = std::clock();
-    std::sort(tps.begin(), tps.end(), [](const TriggerPrimitive& a, const TriggerPrimitive& b) {
+    auto earlier = [](const TriggerPrimitive& a, const TriggerPrimitive& b) {
         return a.GetTimeStart() < b.GetTimeStart();
-    });
+    };
+    if (!std::is_sorted(tps.begin(), tps.end(), earlier)) std::sort(tps.begin(), tps.end(), earlier);
     std::clock_t end_sorting = std::clock();
     double elapsed_time = double(end_sorting - start_sorting) / CLOCKS_PER_SEC;
     if (verboseMode) LogInfo << "Sorting TPs took " << elapsed_time << " seconds" << std::endl;
 
+    return true;
 }
 
-// TODO change this, one argument should be nentries_event
-void get_first_and_last_event(TTree* tree, UInt_t* branch_value, int which_event, int& first_entry, int& last_entry) {
-    first_entry = -1;
-    last_entry = -1;
+EventEntryIndex build_event_index(TTree* tree, const std::string& branch_name, std::vector<UInt_t>* events_in_order) {
+    EventEntryIndex index;
+    if (!tree) return index;
 
-    if (debugMode) LogInfo << " Looking for event number " << which_event << std::endl;
-    for (int iEntry = 0; iEntry < tree->GetEntries(); ++iEntry) {
-        tree->GetEntry(iEntry);
-        if (*branch_value == which_event) {
-            if (first_entry == -1) {
-                first_entry = iEntry;
-            }
-            last_entry = iEntry;
-        } else if (first_entry != -1) {
-            // Since entries are ordered, once we see a different event after finding the first, we stop
-            break;
+    TBranch* event_branch = tree->GetBranch(branch_name.c_str());
+    if (!event_branch) {
+        LogError << " Branch " << branch_name << " not found in tree " << tree->GetName() << ", cannot index events" << std::endl;
+        return index;
+    }
+
+    // Read only the event branch, the rest of the entry is not unpacked
+    UInt_t this_event = 0;
+    event_branch->SetAddress(&this_event);
+
+    const Long64_t n_entries = tree->GetEntries();
+    EventEntryIndex::iterator current_range = index.end();
+    for (Long64_t iEntry = 0; iEntry < n_entries; ++iEntry) {
+        event_branch->GetEntry(iEntry);
+        if (current_range != index.end() && current_range->first == this_event) {
+            current_range->second.second = iEntry;
+            continue;
         }
+        // Entries are ordered by event: only the first contiguous block of an event is kept
+        auto inserted = index.emplace(this_event, std::make_pair(iEntry, iEntry));
+        current_range = inserted.second ? inserted.first : index.end();
+        if (inserted.second && events_in_order) events_in_order->push_back(this_event);
     }
-}
 
-// Direct TP-SimIDE matching function based on time and channel proximity
-void match_tps_to_simides_direct(
-    std::vector<TriggerPrimitive>& tps,
-    std::vector<TrueParticle>& true_particles,
-    TFile* file,
-    int event_number,
-    double time_tolerance_ticks,
-    int channel_tolerance)
-{
-    if (verboseMode) LogInfo << "Starting direct TP-SimIDE matching for event " << event_number << std::endl;
-    
-    // Fetch any previously estimated time-offset correction for this event
-    // double event_time_offset = 0.0;
-    // {
-    //     auto it = g_event_time_offsets.find(event_number);
-    //     if (it != g_event_time_offsets.end()) event_time_offset = it->second;
-    // }
-    // if (event_time_offset != 0.0) {
-    //     LogInfo << "[DIRECT] Using event time-offset correction (ticks) = " << event_time_offset << std::endl;
-    // }
+    tree->ResetBranchAddress(event_branch);
+    return index;
+}
 
-    // Clear any existing truth links
-    for (auto& tp : tps) {
-        if (tp.GetEvent() == event_number) {
-            tp.SetTrueParticle(nullptr);
+bool build_tpstream_event_index(TFile* file, TpstreamEventIndex& index) {
+    index = TpstreamEventIndex();
+    if (!file || file->IsZombie()) return false;
+
+    bool all_trees_found = true;
+    auto index_tree = [&](const std::string& tree_path, EventEntryIndex& tree_index, std::vector<UInt_t>* events_in_order) {
+        TTree* tree = dynamic_cast<TTree*>(file->Get(tree_path.c_str()));
+        if (!tree) {
+            LogError << " Tree not found: " << tree_path << std::endl;
+            all_trees_found = false;
+            return;
         }
-    }
-    
-    // Read SimIDEs tree
-    std::string simidestree_path = "triggerAnaDumpTPs/simides";
-    TTree *simidestree = dynamic_cast<TTree*>(file->Get(simidestree_path.c_str()));
-    if (!simidestree) {
-        LogError << "SimIDEs tree not found: " << simidestree_path << std::endl;
-        return;
-    }
-    
-    // Get SimIDE entries for this event
-    int first_simide_entry = -1;
-    int last_simide_entry = -1;
-    UInt_t event_number_simides = 0;
-    simidestree->SetBranchAddress("Event", &event_number_simides);
-    get_first_and_last_event(simidestree, &event_number_simides, event_number, first_simide_entry, last_simide_entry);
-    
-    if (verboseMode)  LogInfo << "SimIDEs in event " << event_number << ": " 
-            << ((first_simide_entry != -1) ? std::to_string(last_simide_entry - first_simide_entry + 1) : "0") << std::endl;
+        tree_index = build_event_index(tree, "Event", events_in_order);
+        if (debugMode) LogInfo << " Indexed " << tree_index.size() << " events in tree " << tree_path << std::endl;
+    };
 
-    if (first_simide_entry == -1) {
-        LogWarning << "No SimIDEs found for event " << event_number << std::endl;
-        return;
-    }
-    
-    // Set up SimIDE branch addresses
-    UInt_t simide_channel;
-    UShort_t simide_timestamp;
-    Int_t simide_track_id;
-    Float_t simide_energy;  // Energy in MeV
+    index_tree(tps_tree_path, index.tps, nullptr);
+    index_tree(mcparticles_tree_path, index.mcparticles, nullptr);
+    index_tree(mctruths_tree_path, index.mctruths, &index.events);
+    index_tree(simides_tree_path, index.simides, nullptr);
 
-    if (!SetBranchWithFallback(simidestree, {"ChannelID", "channel"}, &simide_channel, "SimIDEs channel")) {
-        return;
+    return all_trees_found;
+}
+
+bool get_first_and_last_event(const EventEntryIndex& index, int which_event, Long64_t& first_entry, Long64_t& last_entry) {
+    first_entry = -1;
+    last_entry = -1;
+
+    if (debugMode) LogInfo << " Looking for event number " << which_event << std::endl;
+    auto range = index.find(static_cast<UInt_t>(which_event));
+    if (range == index.end()) return false;
+
+    first_entry = range->second.first;
+    last_entry = range->second.second;
+    return true;
+}
+
+bool SimideBranches::bind(TTree* simides_tree) {
+    if (!SetBranchWithFallback(simides_tree, {"ChannelID", "channel"}, &channel, "SimIDEs channel")) {
+        return false;
     }
-    if (!SetBranchWithFallback(simidestree, {"Timestamp", "timestamp"}, &simide_timestamp, "SimIDEs timestamp")) {
-        return;
+    if (!SetBranchWithFallback(simides_tree, {"Timestamp", "timestamp"}, &timestamp, "SimIDEs timestamp")) {
+        return false;
     }
-    if (!SetBranchWithFallback(simidestree, {"trackID", "origTrackID"}, &simide_track_id, "SimIDEs track ID")) {
-        return;
+    if (!SetBranchWithFallback(simides_tree, {"trackID", "origTrackID"}, &track_id, "SimIDEs track ID")) {
+        return false;
     }
-    
+
     // Try to read the energy branch (optional - may not be available in all files)
-    bool has_energy = (simidestree->GetBranch("energy") != nullptr);
+    has_energy = (simides_tree->GetBranch("energy") != nullptr);
     if (has_energy) {
-        simidestree->SetBranchAddress("energy", &simide_energy);
+        simides_tree->SetBranchAddress("energy", &energy);
         if (verboseMode) LogInfo << "SimIDE energy branch found - will accumulate energy to TPs" << std::endl;
     } else {
         LogWarning << "SimIDE energy branch not found - TP simide_energy will remain 0" << std::endl;
     }
-    
-    // Build lookup map for true particles by trackID
-    std::unordered_map<int, TrueParticle*> track_to_particle;
-    for (auto& particle : true_particles) {
-        if (particle.GetEvent() == event_number) {
-            track_to_particle[std::abs(particle.GetTrackId())] = &particle;
-        }
-    }
-    
+    return true;
+}
+
+namespace {
     // Structure to hold SimIDE information
     struct SimIDEInfo {
         int channel;
@@ -551,247 +523,405 @@ void match_tps_to_simides_direct(
         TrueParticle* particle;
         double energy;  // Energy in MeV
     };
-    std::vector<SimIDEInfo> simides_in_event;
-    
-    // Read all SimIDEs for this event
-    for (Long64_t iSimIde = first_simide_entry; iSimIde <= last_simide_entry; ++iSimIde) {
-        simidestree->GetEntry(iSimIde);
-        
-        // Convert SimIDE timestamp to TPC ticks (with overflow protection)
-        uint64_t timestampU64 = (uint64_t)simide_timestamp;
-        double time_tpc = (double)(timestampU64 * conversion_tdc_to_tpc);
-        // Apply event time-offset so SimIDE times are comparable to TP times
-        double time_tpc_aligned = time_tpc;// - event_time_offset;
-        
-        // Find associated particle
-        auto particle_it = track_to_particle.find(std::abs(simide_track_id));
-        if (particle_it != track_to_particle.end()) {
-            double energy_mev = has_energy ? simide_energy : 0.0;
-            simides_in_event.push_back({
-                (int)simide_channel,
-                time_tpc_aligned,
-                simide_track_id,
-                particle_it->second,
-                energy_mev
-            });
+
+    // Read the SimIDEs of one event that can be linked to a true particle through their track ID
+    void load_event_simides(
+        TTree* simidestree,
+        SimideBranches& branches,
+        Long64_t first_simide_entry,
+        Long64_t last_simide_entry,
+        std::vector<TrueParticle>& true_particles,
+        int event_number,
+        std::vector<SimIDEInfo>& simides_in_event)
+    {
+        // Build lookup map for true particles by trackID
+        std::unordered_map<int, TrueParticle*> track_to_particle;
+        for (auto& particle : true_particles) {
+            if (particle.GetEvent() == event_number) {
+                track_to_particle[std::abs(particle.GetTrackId())] = &particle;
+            }
+        }
+
+        for (Long64_t iSimIde = first_simide_entry; iSimIde <= last_simide_entry; ++iSimIde) {
+            simidestree->GetEntry(iSimIde);
+
+            // Convert SimIDE timestamp to TPC ticks (with overflow protection)
+            uint64_t timestampU64 = (uint64_t)branches.timestamp;
+            double time_tpc = (double)(timestampU64 * conversion_tdc_to_tpc);
+
+            // Find associated particle
+            auto particle_it = track_to_particle.find(std::abs(branches.track_id));
+            if (particle_it != track_to_particle.end()) {
+                double energy_mev = branches.has_energy ? branches.energy : 0.0;
+                simides_in_event.push_back({
+                    (int)branches.channel,
+                    time_tpc,
+                    branches.track_id,
+                    particle_it->second,
+                    energy_mev
+                });
+            }
         }
     }
+
+    // Match the TPs of one event to the SimIDEs of the same event, preferring plane-consistent matches
+    void match_tps_to_simide_infos(
+        std::vector<TriggerPrimitive>& tps,
+        const std::vector<SimIDEInfo>& simides_in_event,
+        int event_number,
+        double time_tolerance_ticks,
+        int channel_tolerance)
+    {
+        if (verboseMode) LogInfo << "Found " << simides_in_event.size() << " SimIDEs linked to particles in event " << event_number << std::endl;
     
-    if (verboseMode) LogInfo << "Found " << simides_in_event.size() << " SimIDEs linked to particles in event " << event_number << std::endl;
+        // SimIDE time and channel ranges (diagnostic output commented out for selected events)
+        double min_simide_time = std::numeric_limits<double>::max();
+        double max_simide_time = -std::numeric_limits<double>::max();
+        int min_simide_channel = INT_MAX;
+        int max_simide_channel = INT_MIN;
+        if (!simides_in_event.empty()) {
+            for (const auto& simide : simides_in_event) {
+                min_simide_time = std::min(min_simide_time, simide.time_tpc_ticks);
+                max_simide_time = std::max(max_simide_time, simide.time_tpc_ticks);
+                min_simide_channel = std::min(min_simide_channel, simide.channel);
+                max_simide_channel = std::max(max_simide_channel, simide.channel);
+            }
+            // Debug: diagnostic range output for specific events (commented out)
+            // if (event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) {
+            //     LogInfo << "[SIMIDE-RANGE] Event " << event_number << " time: [" << min_simide_time << "," << max_simide_time 
+            //             << "] channels: [" << min_simide_channel << "," << max_simide_channel << "]" << std::endl;
+            // }
+        }
     
-    // SimIDE time and channel ranges (diagnostic output commented out for selected events)
-    double min_simide_time = std::numeric_limits<double>::max();
-    double max_simide_time = -std::numeric_limits<double>::max();
-    int min_simide_channel = INT_MAX;
-    int max_simide_channel = INT_MIN;
-    if (!simides_in_event.empty()) {
-        for (const auto& simide : simides_in_event) {
-            min_simide_time = std::min(min_simide_time, simide.time_tpc_ticks);
-            max_simide_time = std::max(max_simide_time, simide.time_tpc_ticks);
-            min_simide_channel = std::min(min_simide_channel, simide.channel);
-            max_simide_channel = std::max(max_simide_channel, simide.channel);
+        // Determine APA coverage of SimIDEs to optionally filter TPs when SimIDEs use global channels
+        bool simides_use_global_channels = false;
+        std::unordered_set<int> simide_apa_set;
+        for (const auto& s : simides_in_event) {
+            if (s.channel >= APA::total_channels) simides_use_global_channels = true;
+            if (s.channel >= APA::total_channels) simide_apa_set.insert(s.channel / APA::total_channels);
         }
-        // Debug: diagnostic range output for specific events (commented out)
-        // if (event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) {
-        //     LogInfo << "[SIMIDE-RANGE] Event " << event_number << " time: [" << min_simide_time << "," << max_simide_time 
-        //             << "] channels: [" << min_simide_channel << "," << max_simide_channel << "]" << std::endl;
+        // Debug: show when SimIDEs use global channels (commented out)
+        // if (simides_use_global_channels && !simide_apa_set.empty()) {
+        //     std::ostringstream apas;
+        //     bool first = true; for (int a : simide_apa_set) { if (!first) apas << ","; apas << a; first = false; }
+        //     LogInfo << "[DIRECT] SimIDEs appear global; restricting TP candidates to APAs {" << apas.str() << "}" << std::endl;
         // }
-    }
-    
-    // Determine APA coverage of SimIDEs to optionally filter TPs when SimIDEs use global channels
-    bool simides_use_global_channels = false;
-    std::unordered_set<int> simide_apa_set;
-    for (const auto& s : simides_in_event) {
-        if (s.channel >= APA::total_channels) simides_use_global_channels = true;
-        if (s.channel >= APA::total_channels) simide_apa_set.insert(s.channel / APA::total_channels);
-    }
-    // Debug: show when SimIDEs use global channels (commented out)
-    // if (simides_use_global_channels && !simide_apa_set.empty()) {
-    //     std::ostringstream apas;
-    //     bool first = true; for (int a : simide_apa_set) { if (!first) apas << ","; apas << a; first = false; }
-    //     LogInfo << "[DIRECT] SimIDEs appear global; restricting TP candidates to APAs {" << apas.str() << "}" << std::endl;
-    // }
-
-    // Helper to infer plane from a channel index (local indexing rules: U:[0,800), V:[800,1600), X:[1600,2560))
-    auto infer_plane_from_channel = [](int channel) -> char {
-        int local = channel % APA::total_channels;
-        if (local < 800) return 'U';
-        if (local < 1600) return 'V';
-        return 'X';
-    };
 
-    // Match TPs to SimIDEs (prefer plane-consistent matches)
-    int matched_tp_count = 0;
-    int total_tp_count = 0; // number of TPs considered as candidates
-    int skipped_tp_outside_windows = 0; // skipped due to APA/time filters
-    int matched_same_plane = 0; // diagnostics: how many matches used plane-consistency
+        // Helper to infer plane from a channel index (local indexing rules: U:[0,800), V:[800,1600), X:[1600,2560))
+        auto infer_plane_from_channel = [](int channel) -> char {
+            int local = channel % APA::total_channels;
+            if (local < 800) return 'U';
+            if (local < 1600) return 'V';
+            return 'X';
+        };
+
+        // Spatial-temporal index of the SimIDEs: sorted by channel (which encodes APA and plane), then by time,
+        // so that every TP only visits the SimIDEs within its channel and time tolerance
+        struct SimideKey {
+            int channel;
+            double time_tpc_ticks;
+            int index; // position in simides_in_event
+        };
+        std::vector<SimideKey> simide_keys;
+        simide_keys.reserve(simides_in_event.size());
+        for (size_t i = 0; i < simides_in_event.size(); ++i) {
+            simide_keys.push_back({simides_in_event[i].channel, simides_in_event[i].time_tpc_ticks, (int)i});
+        }
+        std::sort(simide_keys.begin(), simide_keys.end(), [](const SimideKey& a, const SimideKey& b) {
+            if (a.channel != b.channel) return a.channel < b.channel;
+            return a.time_tpc_ticks < b.time_tpc_ticks;
+        });
+
+        // Collect the SimIDEs with channel in [channel_low, channel_high] and time in [time_low, time_high]
+        std::vector<int> candidate_simides;
+        auto collect_candidates = [&](long long channel_low, long long channel_high, double time_low, double time_high) {
+            if (channel_low > channel_high) return;
+            auto it = std::lower_bound(simide_keys.begin(), simide_keys.end(), channel_low,
+                [](const SimideKey& key, long long channel) { return key.channel < channel; });
+            while (it != simide_keys.end() && it->channel <= channel_high) {
+                const int channel = it->channel;
+                auto channel_end = std::find_if(it, simide_keys.end(), [channel](const SimideKey& key) { return key.channel != channel; });
+                auto in_window = std::lower_bound(it, channel_end, time_low,
+                    [](const SimideKey& key, double time) { return key.time_tpc_ticks < time; });
+                for (; in_window != channel_end && in_window->time_tpc_ticks <= time_high; ++in_window) {
+                    candidate_simides.push_back(in_window->index);
+                }
+                it = channel_end;
+            }
+        };
+
+        // Match TPs to SimIDEs (prefer plane-consistent matches)
+        int matched_tp_count = 0;
+        int total_tp_count = 0; // number of TPs considered as candidates
+        int skipped_tp_outside_windows = 0; // skipped due to APA/time filters
+        int matched_same_plane = 0; // diagnostics: how many matches used plane-consistency
     
-    for (auto& tp : tps) {
-        if (tp.GetEvent() != event_number) continue;
-        // If SimIDEs are global, ignore TPs that are outside SimIDE APA set to avoid spurious matches
-        if (simides_use_global_channels && !simide_apa_set.empty()) {
-            int tp_apa = tp.GetChannel() / APA::total_channels;
-            if (simide_apa_set.find(tp_apa) == simide_apa_set.end()) {
-                skipped_tp_outside_windows++;
-                continue; // skip this TP: different APA than SimIDEs
+        for (auto& tp : tps) {
+            if (tp.GetEvent() != event_number) continue;
+            // If SimIDEs are global, ignore TPs that are outside SimIDE APA set to avoid spurious matches
+            if (simides_use_global_channels && !simide_apa_set.empty()) {
+                int tp_apa = tp.GetChannel() / APA::total_channels;
+                if (simide_apa_set.find(tp_apa) == simide_apa_set.end()) {
+                    skipped_tp_outside_windows++;
+                    continue; // skip this TP: different APA than SimIDEs
+                }
             }
-        }
-        // Also restrict to TPs that lie near the SimIDE time span (within tolerance)
-        if (min_simide_time <= max_simide_time) {
-            double t = tp.GetTimeStart();
-            if (t < min_simide_time - time_tolerance_ticks || t > max_simide_time + time_tolerance_ticks) {
-                skipped_tp_outside_windows++;
-                continue;
+            // Also restrict to TPs that lie near the SimIDE time span (within tolerance)
+            if (min_simide_time <= max_simide_time) {
+                double t = tp.GetTimeStart();
+                if (t < min_simide_time - time_tolerance_ticks || t > max_simide_time + time_tolerance_ticks) {
+                    skipped_tp_outside_windows++;
+                    continue;
+                }
             }
-        }
-        total_tp_count++;
+            total_tp_count++;
         
-        // Find best matching SimIDE based on channel/time proximity with plane preference
-        TrueParticle* best_match_same_plane = nullptr;
-        double best_score_same_plane = std::numeric_limits<double>::max();
-        int best_channel_diff_same_plane = channel_tolerance + 1;
-        double best_time_diff_same_plane = time_tolerance_ticks + 1;
-
-        TrueParticle* best_match_any_plane = nullptr;
-        double best_score_any_plane = std::numeric_limits<double>::max();
-        int best_channel_diff_any_plane = channel_tolerance + 1;
-        double best_time_diff_any_plane = time_tolerance_ticks + 1;
-
-        // Determine TP plane (prefer explicit view if available, else infer from channel)
-        char tp_plane_char = 'U';
-        {
-            std::string tp_view = tp.GetView();
-            if (!tp_view.empty()) tp_plane_char = tp_view[0];
-            else tp_plane_char = infer_plane_from_channel(tp.GetChannel());
-        }
+            // Find best matching SimIDE based on channel/time proximity with plane preference
+            TrueParticle* best_match_same_plane = nullptr;
+            double best_score_same_plane = std::numeric_limits<double>::max();
+            int best_channel_diff_same_plane = channel_tolerance + 1;
+            double best_time_diff_same_plane = time_tolerance_ticks + 1;
+
+            TrueParticle* best_match_any_plane = nullptr;
+            double best_score_any_plane = std::numeric_limits<double>::max();
+            int best_channel_diff_any_plane = channel_tolerance + 1;
+            double best_time_diff_any_plane = time_tolerance_ticks + 1;
+
+            // Determine TP plane (prefer explicit view if available, else infer from channel)
+            char tp_plane_char = 'U';
+            {
+                const std::string& tp_view = tp.GetView();
+                if (!tp_view.empty()) tp_plane_char = tp_view[0];
+                else tp_plane_char = infer_plane_from_channel(tp.GetChannel());
+            }
         
-        for (const auto& simide : simides_in_event) {
             // Handle both local and global channel numbering for SimIDEs
             int tp_global_channel = tp.GetChannel();
             int tp_local_channel = tp_global_channel % 2560;
-            
-            int channel_diff;
-            if (simide.channel < 2560) {
-                // SimIDE uses local channel numbering - compare with TP local channel
-                channel_diff = std::abs(tp_local_channel - simide.channel);
-            } else {
-                // SimIDE uses global channel numbering - compare with TP global channel  
-                channel_diff = std::abs(tp_global_channel - simide.channel);
+
+            // Candidates from the index: local SimIDE channels (< 2560) are compared with the TP local channel,
+            // global ones with the TP global channel. The windows are slightly wider than the tolerances, the
+            // exact cuts are applied below. SimIDEs are visited in their original order, which keeps the
+            // energy accumulation and the tie-breaking between equal scores unchanged
+            candidate_simides.clear();
+            if (channel_tolerance >= 0) {
+                const double tp_time = tp.GetTimeStart();
+                const double time_low = tp_time - time_tolerance_ticks - 1;
+                const double time_high = tp_time + time_tolerance_ticks + 1;
+                collect_candidates((long long)tp_local_channel - channel_tolerance,
+                                   std::min<long long>((long long)tp_local_channel + channel_tolerance, 2559),
+                                   time_low, time_high);
+                collect_candidates(std::max<long long>((long long)tp_global_channel - channel_tolerance, 2560),
+                                   (long long)tp_global_channel + channel_tolerance,
+                                   time_low, time_high);
+                std::sort(candidate_simides.begin(), candidate_simides.end());
             }
+
+            for (int simide_index : candidate_simides) {
+                const auto& simide = simides_in_event[simide_index];
+
+                int channel_diff;
+                if (simide.channel < 2560) {
+                    // SimIDE uses local channel numbering - compare with TP local channel
+                    channel_diff = std::abs(tp_local_channel - simide.channel);
+                } else {
+                    // SimIDE uses global channel numbering - compare with TP global channel  
+                    channel_diff = std::abs(tp_global_channel - simide.channel);
+                }
             
-            // Calculate time difference
-            double time_diff = std::abs(tp.GetTimeStart() - simide.time_tpc_ticks);
+                // Calculate time difference
+                double time_diff = std::abs(tp.GetTimeStart() - simide.time_tpc_ticks);
             
-            // Check if within tolerance
-            if (channel_diff <= channel_tolerance && time_diff <= time_tolerance_ticks) {
-                // Accumulate SimIDE energy to this TP (sum all SimIDEs that overlap)
-                tp.AddSimideEnergy(simide.energy);
+                // Check if within tolerance
+                if (channel_diff <= channel_tolerance && time_diff <= time_tolerance_ticks) {
+                    // Accumulate SimIDE energy to this TP (sum all SimIDEs that overlap)
+                    tp.AddSimideEnergy(simide.energy);
                 
-                // Score based on combined time and channel proximity (favor tighter channel matches)
-                // Increased channel weight improves spatial consistency in presence of wide time windows
-                double score = time_diff + (channel_diff * 20.0);
-
-                // Determine SimIDE plane
-                char simide_plane_char = infer_plane_from_channel(simide.channel);
-                bool same_plane = (simide_plane_char == tp_plane_char);
-
-                if (same_plane) {
-                    if (score < best_score_same_plane) {
-                        best_score_same_plane = score;
-                        best_match_same_plane = simide.particle;
-                        best_channel_diff_same_plane = channel_diff;
-                        best_time_diff_same_plane = time_diff;
-                    }
-                } else {
-                    if (score < best_score_any_plane) {
-                        best_score_any_plane = score;
-                        best_match_any_plane = simide.particle;
-                        best_channel_diff_any_plane = channel_diff;
-                        best_time_diff_any_plane = time_diff;
+                    // Score based on combined time and channel proximity (favor tighter channel matches)
+                    // Increased channel weight improves spatial consistency in presence of wide time windows
+                    double score = time_diff + (channel_diff * 20.0);
+
+                    // Determine SimIDE plane
+                    char simide_plane_char = infer_plane_from_channel(simide.channel);
+                    bool same_plane = (simide_plane_char == tp_plane_char);
+
+                    if (same_plane) {
+                        if (score < best_score_same_plane) {
+                            best_score_same_plane = score;
+                            best_match_same_plane = simide.particle;
+                            best_channel_diff_same_plane = channel_diff;
+                            best_time_diff_same_plane = time_diff;
+                        }
+                    } else {
+                        if (score < best_score_any_plane) {
+                            best_score_any_plane = score;
+                            best_match_any_plane = simide.particle;
+                            best_channel_diff_any_plane = channel_diff;
+                            best_time_diff_any_plane = time_diff;
+                        }
                     }
                 }
             }
+            // Prefer a same-plane match if available; otherwise, fall back to best any-plane match
+            bool used_same_plane = false;
+            if (best_match_same_plane) {
+                tp.SetTrueParticle(best_match_same_plane);
+                matched_tp_count++;
+                matched_same_plane++;
+                used_same_plane = true;
+
+                // Debug: per-match details for specific events (commented out)
+                // if (event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) {
+                //     int tp_local_ch = tp.GetChannel() % 2560;
+                //     LogInfo << "[DIRECT-MATCH] TP ch=" << tp.GetChannel() << " (local=" << tp_local_ch << ") time=" << tp.GetTimeStart()
+                //             << " -> particle_id=" << best_match_same_plane->GetTrackId()
+                //             << " (ch_diff=" << best_channel_diff_same_plane << " time_diff=" << best_time_diff_same_plane << ")" << std::endl;
+                // }
+            }
+            else if (best_match_any_plane) {
+                tp.SetTrueParticle(best_match_any_plane);
+                matched_tp_count++;
+
+                // Debug: fallback any-plane match details (commented out)
+                // if (event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) {
+                //     int tp_local_ch = tp.GetChannel() % 2560;
+                //     LogInfo << "[DIRECT-MATCH] (fallback-any-plane) TP ch=" << tp.GetChannel() << " (local=" << tp_local_ch << ") time=" << tp.GetTimeStart()
+                //             << " -> particle_id=" << best_match_any_plane->GetTrackId()
+                //             << " (ch_diff=" << best_channel_diff_any_plane << " time_diff=" << best_time_diff_any_plane << ")" << std::endl;
+                // }
+            }
+            else {
+                // Debug: diagnostic for failed matches (commented out)
+                // if ((event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) && total_tp_count <= 10) {
+                //     int tp_local_ch = tp.GetChannel() % 2560;
+                //     LogInfo << "[NO-MATCH] TP ch=" << tp.GetChannel() << " (local=" << tp_local_ch << ") time=" << tp.GetTimeStart()
+                //             << " -> no SimIDE match found within tolerances" << std::endl;
+                // }
+            }
         }
-        // Prefer a same-plane match if available; otherwise, fall back to best any-plane match
-        bool used_same_plane = false;
-        if (best_match_same_plane) {
-            tp.SetTrueParticle(best_match_same_plane);
-            matched_tp_count++;
-            matched_same_plane++;
-            used_same_plane = true;
-
-            // Debug: per-match details for specific events (commented out)
-            // if (event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) {
-            //     int tp_local_ch = tp.GetChannel() % 2560;
-            //     LogInfo << "[DIRECT-MATCH] TP ch=" << tp.GetChannel() << " (local=" << tp_local_ch << ") time=" << tp.GetTimeStart()
-            //             << " -> particle_id=" << best_match_same_plane->GetTrackId()
-            //             << " (ch_diff=" << best_channel_diff_same_plane << " time_diff=" << best_time_diff_same_plane << ")" << std::endl;
-            // }
+    
+        double match_efficiency = total_tp_count > 0 ? (double)matched_tp_count / total_tp_count * 100.0 : 0.0;
+        if (verboseMode) LogInfo << "Direct TP-SimIDE matching results for event " << event_number << ": "
+                << matched_tp_count << "/" << total_tp_count << " TPs matched ("
+                << std::fixed << std::setprecision(1) << match_efficiency << "%)" << std::endl;
+        if (skipped_tp_outside_windows > 0) {
+            if (verboseMode) LogInfo << "[DIRECT] Skipped " << skipped_tp_outside_windows << " TPs outside APA/time windows." << std::endl;
         }
-        else if (best_match_any_plane) {
-            tp.SetTrueParticle(best_match_any_plane);
-            matched_tp_count++;
-
-            // Debug: fallback any-plane match details (commented out)
-            // if (event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) {
-            //     int tp_local_ch = tp.GetChannel() % 2560;
-            //     LogInfo << "[DIRECT-MATCH] (fallback-any-plane) TP ch=" << tp.GetChannel() << " (local=" << tp_local_ch << ") time=" << tp.GetTimeStart()
-            //             << " -> particle_id=" << best_match_any_plane->GetTrackId()
-            //             << " (ch_diff=" << best_channel_diff_any_plane << " time_diff=" << best_time_diff_any_plane << ")" << std::endl;
-            // }
+        if (matched_tp_count > 0) {
+            if (verboseMode) LogInfo << "[DIRECT] Plane-consistent matches: " << matched_same_plane << "/" << matched_tp_count << std::endl;
         }
-        else {
-            // Debug: diagnostic for failed matches (commented out)
-            // if ((event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) && total_tp_count <= 10) {
-            //     int tp_local_ch = tp.GetChannel() % 2560;
-            //     LogInfo << "[NO-MATCH] TP ch=" << tp.GetChannel() << " (local=" << tp_local_ch << ") time=" << tp.GetTimeStart()
-            //             << " -> no SimIDE match found within tolerances" << std::endl;
-            // }
+    
+        // Debug: TP channel ranges for comparison (commented out)
+        // if ((event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) && total_tp_count > 0) {
+        //     int min_tp_channel = std::numeric_limits<int>::max();
+        //     int max_tp_channel = 0;
+        //     int min_tp_local = std::numeric_limits<int>::max();
+        //     int max_tp_local = 0;
+        //     for (const auto& tp : tps) {
+        //         if (tp.GetEvent() == event_number) {
+        //             int global_ch = tp.GetChannel();
+        //             int local_ch = global_ch % 2560;
+        //             min_tp_channel = std::min(min_tp_channel, global_ch);
+        //             max_tp_channel = std::max(max_tp_channel, global_ch);
+        //             min_tp_local = std::min(min_tp_local, local_ch);
+        //             max_tp_local = std::max(max_tp_local, local_ch);
+        //         }
+        //     }
+        //     LogInfo << "[TP-RANGE] Event " << event_number << " global: [" << min_tp_channel << "," << max_tp_channel 
+        //             << "] local: [" << min_tp_local << "," << max_tp_local << "]" << std::endl;
+        // }
+    }
+}
+
+void match_event_simides(
+    TTree* simidestree,
+    SimideBranches& branches,
+    const EventEntryIndex& simides_index,
+    std::vector<TriggerPrimitive>& tps,
+    std::vector<TrueParticle>& true_particles,
+    int event_number,
+    double time_tolerance_ticks,
+    int channel_tolerance)
+{
+    if (verboseMode) LogInfo << "Starting direct TP-SimIDE matching for event " << event_number << std::endl;
+
+    // Clear any existing truth links
+    for (auto& tp : tps) {
+        if (tp.GetEvent() == event_number) {
+            tp.SetTrueParticle(nullptr);
         }
     }
-    
-    double match_efficiency = total_tp_count > 0 ? (double)matched_tp_count / total_tp_count * 100.0 : 0.0;
-    if (verboseMode) LogInfo << "Direct TP-SimIDE matching results for event " << event_number << ": "
-            << matched_tp_count << "/" << total_tp_count << " TPs matched ("
-            << std::fixed << std::setprecision(1) << match_efficiency << "%)" << std::endl;
-    if (skipped_tp_outside_windows > 0) {
-        if (verboseMode) LogInfo << "[DIRECT] Skipped " << skipped_tp_outside_windows << " TPs outside APA/time windows." << std::endl;
+
+    // Get SimIDE entries for this event
+    Long64_t first_simide_entry = -1;
+    Long64_t last_simide_entry = -1;
+    get_first_and_last_event(simides_index, event_number, first_simide_entry, last_simide_entry);
+
+    if (verboseMode)  LogInfo << "SimIDEs in event " << event_number << ": " 
+            << ((first_simide_entry != -1) ? std::to_string(last_simide_entry - first_simide_entry + 1) : "0") << std::endl;
+
+    if (first_simide_entry == -1) {
+        LogWarning << "No SimIDEs found for event " << event_number << std::endl;
+        return;
+    }
+
+    std::vector<SimIDEInfo> simides_in_event;
+    simides_in_event.reserve(last_simide_entry - first_simide_entry + 1);
+    load_event_simides(simidestree, branches, first_simide_entry, last_simide_entry, true_particles, event_number, simides_in_event);
+
+    match_tps_to_simide_infos(tps, simides_in_event, event_number, time_tolerance_ticks, channel_tolerance);
+}
+
+// Direct TP-SimIDE matching function based on time and channel proximity
+void match_tps_to_simides_direct(
+    std::vector<TriggerPrimitive>& tps,
+    std::vector<TrueParticle>& true_particles,
+    TFile* file,
+    int event_number,
+    double time_tolerance_ticks,
+    int channel_tolerance,
+    const EventEntryIndex* simides_index)
+{
+    // Read SimIDEs tree
+    const std::string& simidestree_path = simides_tree_path;
+    TTree *simidestree = dynamic_cast<TTree*>(file->Get(simidestree_path.c_str()));
+    if (!simidestree) {
+        LogError << "SimIDEs tree not found: " << simidestree_path << std::endl;
+        return;
     }
-    if (matched_tp_count > 0) {
-        if (verboseMode) LogInfo << "[DIRECT] Plane-consistent matches: " << matched_same_plane << "/" << matched_tp_count << std::endl;
+
+    EventEntryIndex local_simides_index;
+    if (!simides_index) {
+        local_simides_index = build_event_index(simidestree);
+        simides_index = &local_simides_index;
     }
-    
-    // Debug: TP channel ranges for comparison (commented out)
-    // if ((event_number == 4 || event_number == 6 || event_number == 8 || event_number == 10) && total_tp_count > 0) {
-    //     int min_tp_channel = std::numeric_limits<int>::max();
-    //     int max_tp_channel = 0;
-    //     int min_tp_local = std::numeric_limits<int>::max();
-    //     int max_tp_local = 0;
-    //     for (const auto& tp : tps) {
-    //         if (tp.GetEvent() == event_number) {
-    //             int global_ch = tp.GetChannel();
-    //             int local_ch = global_ch % 2560;
-    //             min_tp_channel = std::min(min_tp_channel, global_ch);
-    //             max_tp_channel = std::max(max_tp_channel, global_ch);
-    //             min_tp_local = std::min(min_tp_local, local_ch);
-    //             max_tp_local = std::max(max_tp_local, local_ch);
-    //         }
-    //     }
-    //     LogInfo << "[TP-RANGE] Event " << event_number << " global: [" << min_tp_channel << "," << max_tp_channel 
-    //             << "] local: [" << min_tp_local << "," << max_tp_local << "]" << std::endl;
-    // }
+
+    // Set up SimIDE branch addresses, only valid within this call
+    SimideBranches branches;
+    if (!branches.bind(simidestree)) {
+        return;
+    }
+
+    match_event_simides(simidestree, branches, *simides_index, tps, true_particles, event_number, time_tolerance_ticks, channel_tolerance);
+    simidestree->ResetBranchAddresses();
 }
 
 std::vector<float> calculate_position(TriggerPrimitive* tp) {
+    // Detector constants are read once, not per expression
+    const double apa_length = get_apa_length_cm();
+    const double wire_pitch_collection = get_wire_pitch_collection_cm();
+    const double offset_between_apa = get_offset_between_apa_cm();
+    const double time_tick = get_time_tick_cm();
+    const double apa_width = get_apa_width_cm();
     // ...existing code from cluster.cpp...
     float x_signs = (int(tp->GetDetectorChannel()) % APA::total_channels < (APA::induction_channels * 2 + APA::collection_channels)) ? -1.0f : 1.0f;
-    float x = ((int(tp->GetTimeStart()) ) * time_tick_in_cm + apa_width_in_cm/2) * x_signs; 
+    float x = ((int(tp->GetTimeStart()) ) * time_tick + apa_width/2) * x_signs; 
     float y = 0;
     float z = 0;
-    if (tp->GetView() == "X") {
-        float z_apa_offset = int( tp->GetDetector() / 2 ) * (apa_lenght_in_cm + offset_between_apa_in_cm);
-        float z_channel_offset = ((int(tp->GetDetectorChannel()) - APA::induction_channels*2) % APA::collection_channels/2) * wire_pitch_in_cm_collection;
-        z = wire_pitch_in_cm_collection + z_apa_offset + z_channel_offset;
+    if (tp->GetViewId() == interned::view_x_id) {
+        float z_apa_offset = int( tp->GetDetector() / 2 ) * (apa_length + offset_between_apa);
+        float z_channel_offset = ((int(tp->GetDetectorChannel()) - APA::induction_channels*2) % APA::collection_channels/2) * wire_pitch_collection;
+        z = wire_pitch_collection + z_apa_offset + z_channel_offset;
     }
     return {x, y, z};
 }
@@ -802,64 +932,69 @@ std::vector<std::vector<float>> validate_position_calculation(std::vector<Trigge
 }
 
 float eval_y_knowing_z_U_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign) {
-    z = z - int(tps.at(0)->GetDetectorChannel()) / (APA::total_channels*2) * (apa_lenght_in_cm + offset_between_apa_in_cm); // not sure about the 0 TODO
+    const double apa_length = get_apa_length_cm();
+    const double wire_pitch_induction = get_wire_pitch_induction_cm();
+    const int error_margin = get_backtracker_error_margin();
+    const double angular_coeff = get_apa_angular_coeff();
+    const double offset_between_apa = get_offset_between_apa_cm();
+    z = z - int(tps.at(0)->GetDetectorChannel()) / (APA::total_channels*2) * (apa_length + offset_between_apa); // not sure about the 0 TODO
     float ordinate;
     std::vector<float> Y_pred;
     for (auto& tp : tps) {
         if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 0) {
             if (x_sign < 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction + error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
+                        float the_last_piece = apa_length - z;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
+                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction - z) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (apa_length - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_induction) * angular_coeff;
                 }
             } else if (x_sign > 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    if (z < (799 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
+                    if (z < (799 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction - error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
                         float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = (z - (799 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                        ordinate = (z - (799 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction) * angular_coeff;
                 }
             }
         } else if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 1) {
             if (x_sign < 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    if (z < (399 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
+                    if (z < (399 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction - error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
                         float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = (z - (399 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                        ordinate = (z - (399 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_induction) * angular_coeff;
                 }
             } else if (x_sign > 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_induction + error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
+                        float the_last_piece = apa_length - z;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
+                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_induction - z) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (apa_length - z + (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction) * angular_coeff;
                 }
             }
         }
@@ -882,65 +1017,70 @@ float eval_y_knowing_z_U_plane(std::vector<TriggerPrimitive*> tps, float z, floa
 }
 
 float eval_y_knowing_z_V_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign) {
+    const double apa_length = get_apa_length_cm();
+    const double wire_pitch_induction = get_wire_pitch_induction_cm();
+    const int error_margin = get_backtracker_error_margin();
+    const double angular_coeff = get_apa_angular_coeff();
+    const double offset_between_apa = get_offset_between_apa_cm();
     
-    z = z - int(tps.at(0)->GetDetectorChannel()) / (APA::total_channels*2) * (apa_lenght_in_cm + offset_between_apa_in_cm);
+    z = z - int(tps.at(0)->GetDetectorChannel()) / (APA::total_channels*2) * (apa_length + offset_between_apa);
     float ordinate;
     std::vector<float> Y_pred;
     for (auto& tp : tps) {
         if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 0) {
             if (x_sign < 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    if (z < (1199 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
+                    if (z < (1199 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction - error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
                         float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = (z - (1199 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                        ordinate = (z - (1199 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_induction) * angular_coeff;
                 }
             } else if (x_sign > 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_induction + error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
+                        float the_last_piece = apa_length - z;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
+                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_induction - z) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (apa_length - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_induction) * angular_coeff;
                 }
             } 
         } else if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 1) {
             if (x_sign < 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_induction + error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
+                        float the_last_piece = apa_length - z;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
+                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_induction - z) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (apa_length - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_induction) * angular_coeff;
                 }
             } else if (x_sign > 0) {
                 if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    if (z < (1599 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
+                    if (z < (1599 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction - error_margin) {
+                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_induction;
+                        float all_the_way_behind = apa_length;
                         float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * angular_coeff;
                     } else {
-                        ordinate = (z - (1599 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                        ordinate = (z - (1599 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_induction) * angular_coeff;
                     }
                 } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_induction) * angular_coeff;
                 }
             }
         }
@@ -962,161 +1102,474 @@ float eval_y_knowing_z_V_plane(std::vector<TriggerPrimitive*> tps, float z, floa
     return Y_pred_mean;
 }
 
-void write_tps(
+bool backtrack_tpstream_file(
+    const std::string& filename,
     const std::string& out_filename,
-    const std::vector<std::vector<TriggerPrimitive>>& tps_by_event,
-    const std::vector<std::vector<TrueParticle>>& true_particles_by_event,
-    const std::vector<std::vector<Neutrino>>& neutrinos_by_event)
+    double time_tolerance_ticks,
+    int channel_tolerance,
+    int n_threads,
+    std::vector<BacktrackingThreadStats>& thread_stats,
+    const RootOutputSettings& output_settings)
+{
+    n_threads = std::max(1, n_threads);
+    thread_stats.assign(n_threads, BacktrackingThreadStats());
+
+    // Every thread has its own backtracker (file handle and branch buffers), the first one also indexes the file
+    std::vector<std::unique_ptr<TpstreamBacktracker>> backtrackers;
+    backtrackers.emplace_back(new TpstreamBacktracker(filename, time_tolerance_ticks, channel_tolerance));
+    if (!backtrackers.front()->is_open() || backtrackers.front()->get_events().empty()) {
+        LogError << "Failed to read events of file: " << filename << std::endl;
+        return false;
+    }
+
+    // count events, using the mctruths tree because it's the smallest
+    const int n_events = backtrackers.front()->get_events().size();
+    const int first_event = backtrackers.front()->get_events().front();
+    if (verboseMode) LogInfo << "Number of events in file: " << n_events << std::endl;
+
+    n_threads = std::min(n_threads, n_events);
+    for (int iThread = 1; iThread < n_threads; ++iThread) {
+        backtrackers.emplace_back(new TpstreamBacktracker(filename, time_tolerance_ticks, channel_tolerance, &backtrackers.front()->get_event_index()));
+        if (!backtrackers.back()->is_open()) {
+            LogError << "Failed to open file for thread " << iThread << ": " << filename << std::endl;
+            return false;
+        }
+    }
+
+    // write *_tps_bktr<N>.root where N is backtracker_error_margin, one event at a time
+    if (verboseMode) LogInfo << "Writing output to: " << out_filename << std::endl;
+    TpsWriter writer(out_filename, output_settings);
+    if (!writer.is_open()) return false;
+
+    struct EventResult {
+        std::vector<TriggerPrimitive> tps;
+        std::vector<TrueParticle> true_particles;
+        std::vector<Neutrino> neutrinos;
+        bool ready = false;
+    };
+
+    auto backtrack_event = [&](int iThread, int event_index, EventResult& result) {
+        const int iEvent = first_event + event_index;
+        if (verboseMode) LogInfo << "Reading event " << iEvent << std::endl;
+
+        auto start = std::chrono::steady_clock::now();
+        backtrackers[iThread]->read_event(iEvent, result.tps, result.true_particles, result.neutrinos);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        thread_stats[iThread].n_events++;
+        thread_stats[iThread].n_tps += result.tps.size();
+        thread_stats[iThread].busy_seconds += elapsed.count();
+
+        // Summarise direct TP-to-truth associations built while reading the event
+        if (verboseMode) {
+            int matched_tps_counter = 0;
+            for (const auto& tp : result.tps) {
+                if (tp.GetTrueParticle() != nullptr) { matched_tps_counter++; }
+            }
+            LogInfo << "Matched " << matched_tps_counter << "/" << result.tps.size() 
+                << " TPs to true particles via SimIDE association." << std::endl;
+        }
+        if (debugMode) {
+            LogDebug << "Event " << iEvent << " processing complete with " 
+                     << result.tps.size() << " TPs and " 
+                     << result.true_particles.size() << " true particles" << std::endl;
+        }
+    };
+
+    if (n_threads == 1) {
+        // Serial run: only one event is held in memory, buffers are reused across events
+        EventResult result;
+        for (int event_index = 0; event_index < n_events; ++event_index) {
+            result.tps.clear(); result.true_particles.clear(); result.neutrinos.clear();
+            backtrack_event(0, event_index, result);
+            writer.write_event(result.tps);
+        }
+        writer.close();
+        return true;
+    }
+
+    // Parallel run: threads take the next event to backtrack, while this thread writes them in order.
+    // Events are stored in a ring of slots, a thread cannot run more than max_in_flight events ahead of the writer
+    const int max_in_flight = 4 * n_threads;
+    std::vector<EventResult> slots(max_in_flight);
+    std::mutex slots_mutex;
+    std::condition_variable slots_cv;
+    int next_to_read = 0;
+    int next_to_write = 0;
+
+    auto worker = [&](int iThread) {
+        while (true) {
+            int event_index = 0;
+            {
+                std::unique_lock<std::mutex> lock(slots_mutex);
+                slots_cv.wait(lock, [&]{ return next_to_read >= n_events || next_to_read < next_to_write + max_in_flight; });
+                if (next_to_read >= n_events) return;
+                event_index = next_to_read++;
+            }
+
+            EventResult result;
+            backtrack_event(iThread, event_index, result);
+
+            {
+                std::lock_guard<std::mutex> lock(slots_mutex);
+                EventResult& slot = slots[event_index % max_in_flight];
+                slot = std::move(result); // moving keeps the TP -> true particle -> neutrino pointers valid
+                slot.ready = true;
+            }
+            slots_cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int iThread = 0; iThread < n_threads; ++iThread) {
+        threads.emplace_back(worker, iThread);
+    }
+
+    for (int event_index = 0; event_index < n_events; ++event_index) {
+        EventResult result;
+        {
+            std::unique_lock<std::mutex> lock(slots_mutex);
+            EventResult& slot = slots[event_index % max_in_flight];
+            slots_cv.wait(lock, [&]{ return slot.ready; });
+            result = std::move(slot);
+            slot = EventResult();
+            next_to_write++;
+        }
+        slots_cv.notify_all();
+        writer.write_event(result.tps);
+    }
+
+    for (auto& thread : threads) thread.join();
+    writer.close();
+    return true;
+}
+
+void merge_by_time_start(const std::vector<TPMergeInput>& inputs, std::vector<const TriggerPrimitive*>& merged) {
+    merged.clear();
+    auto earlier = [](const TriggerPrimitive& a, const TriggerPrimitive& b) { return a.GetTimeStart() < b.GetTimeStart(); };
+
+    // One cursor per input over the TPs it keeps, in time order: the TPs themselves when they are
+    // sorted (the normal case), pointers to them sorted once otherwise
+    struct Cursor {
+        const TPMergeInput* input = nullptr;
+        bool sorted = true;
+        std::vector<const TriggerPrimitive*> order;
+        size_t pos = 0;
+
+        bool done() const { return pos >= (sorted ? input->tps->size() : order.size()); }
+        const TriggerPrimitive* current() const { return sorted ? &(*input->tps)[pos] : order[pos]; }
+        void skip_dropped() {
+            if (!sorted || !input->keep) return;
+            while (!done() && !input->keep((*input->tps)[pos])) ++pos;
+        }
+        void advance() { ++pos; skip_dropped(); }
+    };
+
+    std::vector<Cursor> cursors;
+    cursors.reserve(inputs.size());
+    size_t n_total = 0;
+    for (const auto& input : inputs) {
+        if (!input.tps || input.tps->empty()) continue;
+        Cursor cursor;
+        cursor.input = &input;
+        cursor.sorted = input.sorted || std::is_sorted(input.tps->begin(), input.tps->end(), earlier);
+        if (!cursor.sorted) {
+            for (const auto& tp : *input.tps) {
+                if (!input.keep || input.keep(tp)) cursor.order.push_back(&tp);
+            }
+            std::stable_sort(cursor.order.begin(), cursor.order.end(),
+                             [&](const TriggerPrimitive* a, const TriggerPrimitive* b) { return earlier(*a, *b); });
+        }
+        cursor.skip_dropped();
+        n_total += input.tps->size();
+        cursors.push_back(std::move(cursor));
+    }
+    merged.reserve(n_total);
+
+    // Few inputs (the signal event and one background event): a linear scan for the earliest head
+    while (true) {
+        Cursor* first = nullptr;
+        for (auto& cursor : cursors) {
+            if (cursor.done()) continue;
+            if (!first || earlier(*cursor.current(), *first->current())) first = &cursor;
+        }
+        if (!first) break;
+        merged.push_back(first->current());
+        first->advance();
+    }
+}
+
+TpsWriter::TpsWriter(const std::string& out_filename, const RootOutputSettings& output_settings)
+    : out_filename_(out_filename)
 {
     // Ensure output directory exists
-    std::string folder = out_filename.substr(0, out_filename.find_last_of("/"));
+    std::string folder = out_filename_.substr(0, out_filename_.find_last_of("/"));
     if (!ensureDirectoryExists(folder)) {
         LogError << "Cannot create or access directory for output file: " << folder << std::endl;
         return;
     }
 
-    TFile outFile(out_filename.c_str(), "RECREATE");
-    if (outFile.IsZombie()) {
-        LogError << "Cannot create output file: " << out_filename << std::endl;
+    // Binary TP format, chosen by the extension of the file
+    if (tp_binary::is_binary_filename(out_filename_)) {
+        binary_.reset(new TPBinaryWriter(out_filename_));
+        if (!binary_->is_open()) binary_.reset();
         return;
     }
 
-    // TPs tree at root level (not inside a folder)
-    TTree tpsTree("tps", "Trigger Primitives with embedded truth");
-    
-    // TP basic variables
-    int evt = 0; 
-    UShort_t version=0; 
-    UInt_t detid=0; 
-    UInt_t channel=0; 
-    UInt_t adc_integral=0; 
-    UShort_t adc_peak=0; 
-    UShort_t det=0; 
-    Int_t det_channel=0; 
-    ULong64_t tstart=0; 
-    ULong64_t s_over=0; 
-    ULong64_t s_to_peak=0;
-    std::string view;
-    Double_t simide_energy = 0.0;
-    
-    // Truth variables (always stored: generator_name from MC truth)
-    std::string gen_name;
-    
-    // MARLEY-specific particle truth (only meaningful when gen_name contains "marley")
-    Int_t particle_pdg = 0;
-    std::string particle_process;
-    Float_t particle_energy = 0.0f;
-    Float_t particle_x = 0.0f, particle_y = 0.0f, particle_z = 0.0f;
-    Float_t particle_px = 0.0f, particle_py = 0.0f, particle_pz = 0.0f;
-    
-    // Neutrino info (only for MARLEY with neutrino association)
-    std::string neutrino_interaction;
-    Float_t neutrino_x = 0.0f, neutrino_y = 0.0f, neutrino_z = 0.0f;
-    Float_t neutrino_px = 0.0f, neutrino_py = 0.0f, neutrino_pz = 0.0f;
-    Float_t neutrino_energy = 0.0f;
-    
+    file_ = new TFile(out_filename_.c_str(), "RECREATE");
+    if (file_->IsZombie()) {
+        LogError << "Cannot create output file: " << out_filename_ << std::endl;
+        delete file_;
+        file_ = nullptr;
+        return;
+    }
+
+    // The tree takes the compression of the file
+    applyRootOutputSettings(file_, output_settings);
+
+    // TPs tree at root level (not inside a folder), owned by the file
+    file_->cd();
+    tps_tree_ = new TTree("tps", "Trigger Primitives with embedded truth");
+
     // TP basic branches
-    tpsTree.Branch("event", &evt, "event/I");
-    tpsTree.Branch("version", &version, "version/s");
-    tpsTree.Branch("detid", &detid, "detid/i");
-    tpsTree.Branch("channel", &channel, "channel/i");
-    tpsTree.Branch("samples_over_threshold", &s_over, "samples_over_threshold/l");
-    tpsTree.Branch("time_start", &tstart, "time_start/l");
-    tpsTree.Branch("samples_to_peak", &s_to_peak, "samples_to_peak/l");
-    tpsTree.Branch("adc_integral", &adc_integral, "adc_integral/i");
-    tpsTree.Branch("adc_peak", &adc_peak, "adc_peak/s");
-    tpsTree.Branch("detector", &det, "detector/s");
-    tpsTree.Branch("detector_channel", &det_channel, "detector_channel/I");
-    tpsTree.Branch("view", &view);
-    tpsTree.Branch("simide_energy", &simide_energy, "simide_energy/D");
-    
+    tps_tree_->Branch("event", &evt_, "event/I");
+    tps_tree_->Branch("version", &version_, "version/s");
+    tps_tree_->Branch("detid", &detid_, "detid/i");
+    tps_tree_->Branch("channel", &channel_, "channel/i");
+    tps_tree_->Branch("samples_over_threshold", &s_over_, "samples_over_threshold/l");
+    tps_tree_->Branch("time_start", &tstart_, "time_start/l");
+    tps_tree_->Branch("samples_to_peak", &s_to_peak_, "samples_to_peak/l");
+    tps_tree_->Branch("adc_integral", &adc_integral_, "adc_integral/i");
+    tps_tree_->Branch("adc_peak", &adc_peak_, "adc_peak/s");
+    tps_tree_->Branch("detector", &det_, "detector/s");
+    tps_tree_->Branch("detector_channel", &det_channel_, "detector_channel/I");
+    tps_tree_->Branch("view", &view_);
+    tps_tree_->Branch("simide_energy", &simide_energy_, "simide_energy/D");
+
     // Truth branches (always: generator_name from MC truth)
-    tpsTree.Branch("generator_name", &gen_name);
-    
+    tps_tree_->Branch("generator_name", &gen_name_);
+
     // MARLEY-specific particle truth branches
-    tpsTree.Branch("particle_pdg", &particle_pdg, "particle_pdg/I");
-    tpsTree.Branch("particle_process", &particle_process);
-    tpsTree.Branch("particle_energy", &particle_energy, "particle_energy/F");
-    tpsTree.Branch("particle_x", &particle_x, "particle_x/F");
-    tpsTree.Branch("particle_y", &particle_y, "particle_y/F");
-    tpsTree.Branch("particle_z", &particle_z, "particle_z/F");
-    tpsTree.Branch("particle_px", &particle_px, "particle_px/F");
-    tpsTree.Branch("particle_py", &particle_py, "particle_py/F");
-    tpsTree.Branch("particle_pz", &particle_pz, "particle_pz/F");
-    
+    tps_tree_->Branch("particle_pdg", &particle_pdg_, "particle_pdg/I");
+    tps_tree_->Branch("particle_process", &particle_process_);
+    tps_tree_->Branch("particle_energy", &particle_energy_, "particle_energy/F");
+    tps_tree_->Branch("particle_x", &particle_x_, "particle_x/F");
+    tps_tree_->Branch("particle_y", &particle_y_, "particle_y/F");
+    tps_tree_->Branch("particle_z", &particle_z_, "particle_z/F");
+    tps_tree_->Branch("particle_px", &particle_px_, "particle_px/F");
+    tps_tree_->Branch("particle_py", &particle_py_, "particle_py/F");
+    tps_tree_->Branch("particle_pz", &particle_pz_, "particle_pz/F");
+
     // Neutrino branches
-    tpsTree.Branch("neutrino_interaction", &neutrino_interaction);
-    tpsTree.Branch("neutrino_x", &neutrino_x, "neutrino_x/F");
-    tpsTree.Branch("neutrino_y", &neutrino_y, "neutrino_y/F");
-    tpsTree.Branch("neutrino_z", &neutrino_z, "neutrino_z/F");
-    tpsTree.Branch("neutrino_px", &neutrino_px, "neutrino_px/F");
-    tpsTree.Branch("neutrino_py", &neutrino_py, "neutrino_py/F");
-    tpsTree.Branch("neutrino_pz", &neutrino_pz, "neutrino_pz/F");
-    tpsTree.Branch("neutrino_energy", &neutrino_energy, "neutrino_energy/F");
+    tps_tree_->Branch("neutrino_interaction", &neutrino_interaction_);
+    tps_tree_->Branch("neutrino_x", &neutrino_x_, "neutrino_x/F");
+    tps_tree_->Branch("neutrino_y", &neutrino_y_, "neutrino_y/F");
+    tps_tree_->Branch("neutrino_z", &neutrino_z_, "neutrino_z/F");
+    tps_tree_->Branch("neutrino_px", &neutrino_px_, "neutrino_px/F");
+    tps_tree_->Branch("neutrino_py", &neutrino_py_, "neutrino_py/F");
+    tps_tree_->Branch("neutrino_pz", &neutrino_pz_, "neutrino_pz/F");
+    tps_tree_->Branch("neutrino_energy", &neutrino_energy_, "neutrino_energy/F");
+
+    applyRootOutputSettings(tps_tree_, output_settings);
+}
 
-    // Backtracking metadata tree
-    TTree metaTree("backtracking_metadata", "Backtracking metadata");
-    int n_events = tps_by_event.size();
-    int n_tps_total = 0;
-    for (const auto& v : tps_by_event) n_tps_total += v.size();
-    float bt_error_margin = static_cast<float>(ParametersManager::getInstance().getDouble("timing.backtracker_error_margin"));
-    metaTree.Branch("n_events", &n_events, "n_events/I");
-    metaTree.Branch("n_tps_total", &n_tps_total, "n_tps_total/I");
-    metaTree.Branch("backtracker_error_margin", &bt_error_margin, "backtracker_error_margin/F");
-    metaTree.Fill();
+TpsWriter::~TpsWriter() {
+    close();
+}
+
+void TpsWriter::fill(const TriggerPrimitive& tp, int event) {
+    // Basic TP info
+    evt_ = event;
+    version_ = TriggerPrimitive::s_trigger_primitive_version;
+    detid_ = 0;
+    channel_ = tp.GetChannel();
+    s_over_ = tp.GetSamplesOverThreshold();
+    tstart_ = tp.GetTimeStart();
+    s_to_peak_ = tp.GetSamplesToPeak();
+    adc_integral_ = tp.GetAdcIntegral();
+    adc_peak_ = tp.GetAdcPeak();
+    det_ = tp.GetDetector();
+    det_channel_ = tp.GetDetectorChannel();
+    view_ = tp.GetView();
+    simide_energy_ = tp.GetSimideEnergy();
+
+    // Truth info (embedded in TP)
+    gen_name_ = tp.GetGeneratorName();
+    particle_pdg_ = tp.GetParticlePDG();
+    particle_process_ = tp.GetParticleProcess();
+    particle_energy_ = tp.GetParticleEnergy();
+    particle_x_ = tp.GetParticleX();
+    particle_y_ = tp.GetParticleY();
+    particle_z_ = tp.GetParticleZ();
+    particle_px_ = tp.GetParticlePx();
+    particle_py_ = tp.GetParticlePy();
+    particle_pz_ = tp.GetParticlePz();
+    neutrino_interaction_ = tp.GetNeutrinoInteraction();
+    neutrino_x_ = tp.GetNeutrinoX();
+    neutrino_y_ = tp.GetNeutrinoY();
+    neutrino_z_ = tp.GetNeutrinoZ();
+    neutrino_px_ = tp.GetNeutrinoPx();
+    neutrino_py_ = tp.GetNeutrinoPy();
+    neutrino_pz_ = tp.GetNeutrinoPz();
+    neutrino_energy_ = tp.GetNeutrinoEnergy();
+
+    tps_tree_->Fill();
+}
+
+void TpsWriter::write_event(const std::vector<TriggerPrimitive>& tps) {
+    if (binary_) {
+        binary_->write_event(tps);
+        return;
+    }
+    if (!is_open()) return;
+
+    n_events_++;
+    n_tps_total_ += tps.size();
+    if (time_sorted_ && !std::is_sorted(tps.begin(), tps.end(),
+            [](const TriggerPrimitive& a, const TriggerPrimitive& b) { return a.GetTimeStart() < b.GetTimeStart(); })) {
+        time_sorted_ = 0;
+    }
 
     // Fill TPs with embedded truth
-    for (size_t ev = 0; ev < tps_by_event.size(); ++ev) {
-        const auto& v = tps_by_event[ev];
-        for (const auto& tp : v) {
-            // Basic TP info
-            evt = tp.GetEvent(); 
-            version = TriggerPrimitive::s_trigger_primitive_version; 
-            detid = 0; 
-            channel = tp.GetChannel(); 
-            s_over = tp.GetSamplesOverThreshold(); 
-            tstart = tp.GetTimeStart(); 
-            s_to_peak = tp.GetSamplesToPeak(); 
-            adc_integral = tp.GetAdcIntegral(); 
-            adc_peak = tp.GetAdcPeak(); 
-            det = tp.GetDetector(); 
-            det_channel = tp.GetDetectorChannel(); 
-            view = tp.GetView();
-            simide_energy = tp.GetSimideEnergy();
-            
-            // Truth info (embedded in TP)
-            gen_name = tp.GetGeneratorName();
-            particle_pdg = tp.GetParticlePDG();
-            particle_process = tp.GetParticleProcess();
-            particle_energy = tp.GetParticleEnergy();
-            particle_x = tp.GetParticleX();
-            particle_y = tp.GetParticleY();
-            particle_z = tp.GetParticleZ();
-            particle_px = tp.GetParticlePx();
-            particle_py = tp.GetParticlePy();
-            particle_pz = tp.GetParticlePz();
-            neutrino_interaction = tp.GetNeutrinoInteraction();
-            neutrino_x = tp.GetNeutrinoX();
-            neutrino_y = tp.GetNeutrinoY();
-            neutrino_z = tp.GetNeutrinoZ();
-            neutrino_px = tp.GetNeutrinoPx();
-            neutrino_py = tp.GetNeutrinoPy();
-            neutrino_pz = tp.GetNeutrinoPz();
-            neutrino_energy = tp.GetNeutrinoEnergy();
-            
-            tpsTree.Fill();
+    for (const auto& tp : tps) fill(tp, tp.GetEvent());
+}
+
+void TpsWriter::write_event(const std::vector<const TriggerPrimitive*>& tps, int event) {
+    if (binary_) {
+        binary_->write_event(tps, event);
+        return;
+    }
+    if (!is_open()) return;
+
+    n_events_++;
+    n_tps_total_ += tps.size();
+    if (time_sorted_ && !std::is_sorted(tps.begin(), tps.end(),
+            [](const TriggerPrimitive* a, const TriggerPrimitive* b) { return a->GetTimeStart() < b->GetTimeStart(); })) {
+        time_sorted_ = 0;
+    }
+
+    for (const TriggerPrimitive* tp : tps) fill(*tp, event);
+}
+
+void TpsWriter::write_event(const TPStore& store, size_t begin, size_t end) {
+    if (binary_) {
+        binary_->write_event(store, begin, end);
+        return;
+    }
+    if (!is_open()) return;
+
+    end = std::min(end, store.size());
+    if (begin >= end) return;
+
+    n_events_++;
+    n_tps_total_ += end - begin;
+    if (time_sorted_ && !store.is_time_sorted(begin, end)) time_sorted_ = 0;
+
+    for (size_t i = begin; i < end; ++i) {
+        evt_ = store.get_event(i);
+        version_ = TriggerPrimitive::s_trigger_primitive_version;
+        detid_ = 0;
+        channel_ = store.get_channel(i);
+        s_over_ = store.get_samples_over_threshold(i);
+        tstart_ = store.get_time_start(i);
+        s_to_peak_ = store.get_samples_to_peak(i);
+        adc_integral_ = store.get_adc_integral(i);
+        adc_peak_ = store.get_adc_peak(i);
+        det_ = store.get_detector(i);
+        det_channel_ = store.get_detector_channel(i);
+        view_ = tp_view_name(store.get_view(i));
+        simide_energy_ = store.get_simide_energy(i);
+
+        // Truth strings are only copied when the particle changes
+        const int32_t truth_index = store.get_truth_index(i);
+        if (i == begin || truth_index != store.get_truth_index(i - 1)) {
+            const TPTruth& truth = store.get_truth(i);
+            gen_name_ = interned::generators().get(truth.generator_id);
+            particle_pdg_ = truth.particle_pdg;
+            particle_process_ = interned::processes().get(truth.particle_process_id);
+            particle_energy_ = truth.particle_energy;
+            particle_x_ = truth.particle_x;
+            particle_y_ = truth.particle_y;
+            particle_z_ = truth.particle_z;
+            particle_px_ = truth.particle_px;
+            particle_py_ = truth.particle_py;
+            particle_pz_ = truth.particle_pz;
+            neutrino_interaction_ = interned::interactions().get(truth.neutrino_interaction_id);
+            neutrino_x_ = truth.neutrino_x;
+            neutrino_y_ = truth.neutrino_y;
+            neutrino_z_ = truth.neutrino_z;
+            neutrino_px_ = truth.neutrino_px;
+            neutrino_py_ = truth.neutrino_py;
+            neutrino_pz_ = truth.neutrino_pz;
+            neutrino_energy_ = truth.neutrino_energy;
         }
+
+        tps_tree_->Fill();
+    }
+}
+
+void TpsWriter::close() {
+    if (!is_open()) return;
+
+    if (binary_) {
+        binary_->close();
+        binary_.reset();
+        if (verboseMode) LogInfo << "Wrote binary TPs file: " << out_filename_ << std::endl;
+        return;
     }
 
+    file_->cd();
+
+    // Backtracking metadata tree
+    TTree* meta_tree = new TTree("backtracking_metadata", "Backtracking metadata");
+    float bt_error_margin = static_cast<float>(ParametersManager::getInstance().getDouble("timing.backtracker_error_margin"));
+    meta_tree->Branch("n_events", &n_events_, "n_events/I");
+    meta_tree->Branch("n_tps_total", &n_tps_total_, "n_tps_total/I");
+    meta_tree->Branch("backtracker_error_margin", &bt_error_margin, "backtracker_error_margin/F");
+    // Sortedness contract: 1 if the TPs of every event are in time start order, so readers may skip sorting them
+    meta_tree->Branch("time_sorted", &time_sorted_, "time_sorted/I");
+    meta_tree->Fill();
+
     // Write both trees at root level
-    outFile.cd();
-    tpsTree.Write();
-    metaTree.Write();
-    
-    outFile.Close();
-    
+    tps_tree_->Write();
+    meta_tree->Write();
+
+    file_->Close(); // also deletes the trees
+    delete file_;
+    file_ = nullptr;
+    tps_tree_ = nullptr;
+
     // Report absolute output path for consistency
     std::error_code _ec_abs;
-    auto abs_p = std::filesystem::absolute(std::filesystem::path(out_filename), _ec_abs);
-    if (verboseMode) LogInfo << "Wrote TPs file: " << (_ec_abs ? out_filename : abs_p.string()) << std::endl;
+    auto abs_p = std::filesystem::absolute(std::filesystem::path(out_filename_), _ec_abs);
+    if (verboseMode) LogInfo << "Wrote TPs file: " << (_ec_abs ? out_filename_ : abs_p.string()) << std::endl;
+}
+
+void write_tps(
+    const std::string& out_filename,
+    const std::vector<std::vector<TriggerPrimitive>>& tps_by_event,
+    const std::vector<std::vector<TrueParticle>>& true_particles_by_event,
+    const std::vector<std::vector<Neutrino>>& neutrinos_by_event,
+    const RootOutputSettings& output_settings)
+{
+    TpsWriter writer(out_filename, output_settings);
+    if (!writer.is_open()) return;
+    for (const auto& tps : tps_by_event) {
+        writer.write_event(tps);
+    }
+    writer.close();
+}
+
+void write_tps(const std::string& out_filename, const TPStore& store, const RootOutputSettings& output_settings) {
+    TpsWriter writer(out_filename, output_settings);
+    if (!writer.is_open()) return;
+    // Events are written in order of appearance, each as one contiguous block of rows
+    size_t begin = 0;
+    while (begin < store.size()) {
+        size_t end = begin + 1;
+        while (end < store.size() && store.get_event(end) == store.get_event(begin)) ++end;
+        writer.write_event(store, begin, end);
+        begin = end;
+    }
+    writer.close();
 }
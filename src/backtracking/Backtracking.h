@@ -2,13 +2,104 @@
 #define BACKTRACKING_H
 
 #include "TriggerPrimitive.hpp"
+#include "TPStore.h"
+#include "TPBinary.h"
 
 std::vector<float> calculate_position(TriggerPrimitive* tp);
 std::vector<std::vector<float>> validate_position_calculation(std::vector<TriggerPrimitive*> tps);
 float eval_y_knowing_z_U_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign);
 float eval_y_knowing_z_V_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign);
 
-void get_first_and_last_event(TTree* tree, UInt_t* branch_value, int which_event, int& first_entry, int& last_entry);
+// Entry range [first, last] of each event in a tree, keyed by the value of its "Event" branch.
+// Built once per tree reading only the Event branch, then queried for every event.
+typedef std::map<UInt_t, std::pair<Long64_t, Long64_t>> EventEntryIndex;
+
+// Event indices of all the trees of a tpstream file, shared by the whole event loop
+struct TpstreamEventIndex {
+	EventEntryIndex tps;
+	EventEntryIndex mcparticles;
+	EventEntryIndex mctruths;
+	EventEntryIndex simides;
+	std::vector<UInt_t> events; // events of the mctruths tree, in order of appearance
+};
+
+EventEntryIndex build_event_index(TTree* tree, const std::string& branch_name = "Event", std::vector<UInt_t>* events_in_order = nullptr);
+bool build_tpstream_event_index(TFile* file, TpstreamEventIndex& index);
+bool get_first_and_last_event(const EventEntryIndex& index, int which_event, Long64_t& first_entry, Long64_t& last_entry);
+
+// Branch buffers of the simides tree
+struct SimideBranches {
+	UInt_t channel = 0;
+	UShort_t timestamp = 0;
+	Int_t track_id = 0;
+	Float_t energy = 0.0f; // MeV, only if has_energy
+	bool has_energy = false;
+
+	bool bind(TTree* simides_tree);
+};
+
+// Backtracks a whole tpstream file: the file is opened, indexed and its branches are bound once,
+// then the TP, mcparticles, mctruths and simides trees are read in lockstep, one event at a time
+class TpstreamBacktracker {
+	public:
+		TpstreamBacktracker(const std::string& filename,
+						   double time_tolerance_ticks = -1.0,
+						   int channel_tolerance = -1,
+						   const TpstreamEventIndex* event_index = nullptr);
+		~TpstreamBacktracker();
+		TpstreamBacktracker(const TpstreamBacktracker&) = delete;
+		TpstreamBacktracker& operator=(const TpstreamBacktracker&) = delete;
+
+		bool is_open() const { return file_ != nullptr; }
+		const std::vector<UInt_t>& get_events() const { return event_index_.events; }
+		const TpstreamEventIndex& get_event_index() const { return event_index_; }
+
+		// Appends the TPs (sorted by time start, with truth attached), true particles and neutrinos of one event.
+		// Returns false if the event has no TPs in this file
+		bool read_event(int event_number,
+						std::vector<TriggerPrimitive>& tps,
+						std::vector<TrueParticle>& true_particles,
+						std::vector<Neutrino>& neutrinos);
+
+	private:
+		void close();
+
+		std::string filename_;
+		std::string interaction_ = "UNKNOWN";
+		double time_tolerance_ticks_;
+		int channel_tolerance_;
+
+		TFile* file_ = nullptr;
+		TTree* tps_tree_ = nullptr;
+		TTree* mcparticles_tree_ = nullptr;
+		TTree* mctruths_tree_ = nullptr;
+		TTree* simides_tree_ = nullptr;
+		TpstreamEventIndex event_index_;
+
+		// TP branches
+		UShort_t tp_version_ = 0;
+		uint64_t tp_time_start_ = 0;
+		UInt_t tp_channel_ = 0; // global channel
+		UInt_t tp_adc_integral_ = 0;
+		UShort_t tp_adc_peak_ = 0;
+		UShort_t tp_detid_ = 0;
+		UInt_t tp_event_ = 0;
+		UShort_t tp_samples_over_threshold_ = 0;
+		UShort_t tp_samples_to_peak_ = 0;
+
+		// mcparticles and mctruths branches
+		std::string* process_ = new std::string();
+		std::string* generator_name_ = new std::string();
+		Double_t x_ = 0.0, y_ = 0.0, z_ = 0.0;
+		Double_t px_ = 0.0, py_ = 0.0, pz_ = 0.0;
+		Double_t energy_ = 0.0;
+		int pdg_ = 0;
+		UInt_t event_ = 0;
+		int block_id_ = 0, track_id_ = 0, truth_id_ = 0;
+		int status_code_ = -1;
+
+		SimideBranches simide_branches_;
+};
 
 // read the tps from the files and save them in a vector
 // std::vector<TriggerPrimitive> read_tpstream(std::vector<std::string> filenames, int plane=2, int supernova_option=0, int max_events_per_filename = INT_MAX);
@@ -19,23 +110,130 @@ void read_tpstream(std::string filename,
 				 int supernova_option = 0,
 				 int event_number = 0,
 				 double time_tolerance_ticks = -1.0,
-				 int channel_tolerance = -1);
+				 int channel_tolerance = -1,
+				 const TpstreamEventIndex* event_index = nullptr);
                  
 // Direct TP-SimIDE matching based on time and channel proximity
+void match_event_simides(
+	TTree* simides_tree,
+	SimideBranches& branches,
+	const EventEntryIndex& simides_index,
+	std::vector<TriggerPrimitive>& tps,
+	std::vector<TrueParticle>& true_particles,
+	int event_number,
+	double time_tolerance_ticks,
+	int channel_tolerance);
+
 void match_tps_to_simides_direct(
 	std::vector<TriggerPrimitive>& tps,
 	std::vector<TrueParticle>& true_particles,
 	TFile* file,
 	int event_number,
 	double time_tolerance_ticks = 50.0,
-	int channel_tolerance = 5);
+	int channel_tolerance = 5,
+	const EventEntryIndex* simides_index = nullptr);
+
+// One event to merge: its TPs, sorted by time start, and which of them to take (all if keep is not set).
+// sorted tells that the TPs are known to be in order (time_sorted flag of their file), which spares the check
+struct TPMergeInput {
+	const std::vector<TriggerPrimitive>* tps = nullptr;
+	std::function<bool(const TriggerPrimitive&)> keep;
+	bool sorted = false;
+};
+
+// k-way merge of events by time start into pointers to their TPs, none of which is copied.
+// Ties keep the order of the inputs; an input not known to be sorted is checked, and if it is not
+// ordered through pointers first
+void merge_by_time_start(const std::vector<TPMergeInput>& inputs, std::vector<const TriggerPrimitive*>& merged);
+
+// Writes condensed TPs and truth to a ROOT file for later clustering, one event at a time,
+// so that a file never has to be held in memory as a whole
+class TpsWriter {
+	public:
+		// output_settings only apply to the ROOT format
+		explicit TpsWriter(const std::string& out_filename, const RootOutputSettings& output_settings = RootOutputSettings());
+		~TpsWriter();
+		TpsWriter(const TpsWriter&) = delete;
+		TpsWriter& operator=(const TpsWriter&) = delete;
+
+		bool is_open() const { return file_ != nullptr || binary_ != nullptr; }
+		void write_event(const std::vector<TriggerPrimitive>& tps);
+		// Writes TPs owned elsewhere (e.g. merge_by_time_start()) as one event, numbered event whatever their own number
+		void write_event(const std::vector<const TriggerPrimitive*>& tps, int event);
+		// Writes the rows [begin, end) of a store as one event
+		void write_event(const TPStore& store, size_t begin, size_t end);
+		// Writes the metadata and closes the file, called by the destructor if needed
+		void close();
+
+	private:
+		void fill(const TriggerPrimitive& tp, int event);
 
-// Write condensed TPs and truth to a ROOT file for later clustering
+		std::string out_filename_;
+		TFile* file_ = nullptr;
+		TTree* tps_tree_ = nullptr;
+		std::unique_ptr<TPBinaryWriter> binary_; // set instead of the tree for a *.tpb file
+		int n_events_ = 0;
+		int n_tps_total_ = 0;
+		int time_sorted_ = 1; // every event written so far in time start order, recorded in the metadata
+
+		// TP basic variables
+		int evt_ = 0;
+		UShort_t version_ = 0;
+		UInt_t detid_ = 0;
+		UInt_t channel_ = 0;
+		UInt_t adc_integral_ = 0;
+		UShort_t adc_peak_ = 0;
+		UShort_t det_ = 0;
+		Int_t det_channel_ = 0;
+		ULong64_t tstart_ = 0;
+		ULong64_t s_over_ = 0;
+		ULong64_t s_to_peak_ = 0;
+		std::string view_;
+		Double_t simide_energy_ = 0.0;
+
+		// Truth variables (always stored: generator_name from MC truth)
+		std::string gen_name_;
+		Int_t particle_pdg_ = 0;
+		std::string particle_process_;
+		Float_t particle_energy_ = 0.0f;
+		Float_t particle_x_ = 0.0f, particle_y_ = 0.0f, particle_z_ = 0.0f;
+		Float_t particle_px_ = 0.0f, particle_py_ = 0.0f, particle_pz_ = 0.0f;
+		std::string neutrino_interaction_;
+		Float_t neutrino_x_ = 0.0f, neutrino_y_ = 0.0f, neutrino_z_ = 0.0f;
+		Float_t neutrino_px_ = 0.0f, neutrino_py_ = 0.0f, neutrino_pz_ = 0.0f;
+		Float_t neutrino_energy_ = 0.0f;
+};
+
+// Counters of one backtracking thread
+struct BacktrackingThreadStats {
+	int n_events = 0;
+	long n_tps = 0;
+	double busy_seconds = 0.0; // time spent reading and backtracking events
+};
+
+// Backtracks all the events of a tpstream file and writes them to out_filename.
+// With n_threads > 1 the events are read by n_threads backtrackers, each on its own file handle,
+// and written in the same order as the serial run; at most a few events per thread are held in memory.
+// ROOT::EnableThreadSafety() must have been called before using more than one thread
+bool backtrack_tpstream_file(
+	const std::string& filename,
+	const std::string& out_filename,
+	double time_tolerance_ticks,
+	int channel_tolerance,
+	int n_threads,
+	std::vector<BacktrackingThreadStats>& thread_stats,
+	const RootOutputSettings& output_settings = RootOutputSettings());
+
+// Write condensed TPs and truth of all the events at once
 void write_tps(
 	const std::string& out_filename,
 	const std::vector<std::vector<TriggerPrimitive>>& tps_by_event,
 	const std::vector<std::vector<TrueParticle>>& true_particles_by_event,
-	const std::vector<std::vector<Neutrino>>& neutrinos_by_event);
+	const std::vector<std::vector<Neutrino>>& neutrinos_by_event,
+	const RootOutputSettings& output_settings = RootOutputSettings());
+
+// Write the TPs of a store, one event per contiguous block of rows with the same event number
+void write_tps(const std::string& out_filename, const TPStore& store, const RootOutputSettings& output_settings = RootOutputSettings());
 
 
 #endif // BACKTRACKING_H
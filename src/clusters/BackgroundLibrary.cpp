@@ -0,0 +1,160 @@
+#include "BackgroundLibrary.h"
+
+#include <unistd.h>
+
+LoggerInit([]{Logger::getUserHeader() << "[" << FILENAME << "]";});
+
+std::string get_cached_binary_tps(const std::string& filename, const std::string& cache_folder) {
+    if (tp_binary::is_binary_filename(filename)) return filename;
+
+    // The hash of the full path keeps apart files of the same name in different folders, and the format
+    // version the copies written by an older layout, which the reader would reject
+    std::error_code ec;
+    const std::filesystem::path source = std::filesystem::absolute(filename, ec);
+    std::ostringstream cached_name;
+    cached_name << source.stem().string() << "_" << std::hex << std::hash<std::string>()(source.string())
+                << "_v" << std::dec << tp_binary::format_version << tp_binary::extension;
+    const std::filesystem::path cached = std::filesystem::path(cache_folder) / cached_name.str();
+
+    if (std::filesystem::exists(cached, ec)) {
+        const auto cached_time = std::filesystem::last_write_time(cached, ec);
+        const auto source_time = std::filesystem::last_write_time(source, ec);
+        if (!ec && cached_time >= source_time) return cached.string();
+    }
+
+    if (!ensureDirectoryExists(cache_folder)) {
+        LogError << "Unable to create background cache folder: " << cache_folder << std::endl;
+        return "";
+    }
+
+    // Written under a name of this process, then renamed: a concurrent job maps either no file or a complete one
+    const std::string tmp = cached.string() + "." + std::to_string(getpid()) + ".tmp" + tp_binary::extension;
+    size_t n_events = 0;
+    {
+        TpsReader reader(filename);
+        if (!reader.is_open()) {
+            LogError << "Cannot read background file: " << filename << std::endl;
+            return "";
+        }
+        TPBinaryWriter writer(tmp);
+        if (!writer.is_open()) {
+            LogError << "Cannot write background cache file: " << tmp << std::endl;
+            return "";
+        }
+        while (reader.next()) {
+            writer.write_event(reader.get_tps());
+            n_events++;
+        }
+        writer.close();
+    }
+    std::filesystem::rename(tmp, cached, ec);
+    if (ec) {
+        LogError << "Cannot rename " << tmp << " to " << cached.string() << ": " << ec.message() << std::endl;
+        std::filesystem::remove(tmp, ec);
+        return "";
+    }
+    if (verboseMode) LogInfo << "Cached " << n_events << " background events of " << filename << " in " << cached.string() << std::endl;
+    return cached.string();
+}
+
+BackgroundLibrary::BackgroundLibrary(const std::vector<std::string>& filenames, const std::string& cache_folder) {
+    for (const auto& filename : filenames) {
+        const std::string binary = get_cached_binary_tps(filename, cache_folder);
+        if (binary.empty()) continue;
+
+        std::unique_ptr<TPBinaryReader> reader(new TPBinaryReader(binary));
+        if (!reader->is_open()) {
+            LogWarning << "Cannot map background file " << binary << ", skipping it" << std::endl;
+            continue;
+        }
+        if (reader->get_n_events() == 0) {
+            LogWarning << "Background file " << filename << " has no events!" << std::endl;
+            continue;
+        }
+        reader->advise_random_access();
+
+        const uint32_t file_index = static_cast<uint32_t>(files_.size());
+        for (size_t entry = 0; entry < reader->get_n_events(); ++entry) {
+            events_.push_back({file_index, static_cast<uint32_t>(entry)});
+        }
+        files_.push_back(filename);
+        readers_.push_back(std::move(reader));
+    }
+}
+
+int BackgroundLibrary::get_event_number(size_t i) const {
+    const EventRef& ref = events_[i];
+    return readers_[ref.file]->get_event(ref.entry);
+}
+
+bool BackgroundLibrary::is_event_time_sorted(size_t i) const {
+    const EventRef& ref = events_[i];
+    return readers_[ref.file]->is_event_time_sorted(ref.entry);
+}
+
+void BackgroundLibrary::read_event(size_t i, TPStore& store) const {
+    const EventRef& ref = events_[i];
+    readers_[ref.file]->read_event(ref.entry, store);
+}
+
+void BackgroundLibrary::get_event_tps(size_t i, TPStore& scratch, std::vector<uint32_t>& rows, std::vector<TriggerPrimitive>& tps,
+                                      const std::function<bool(const TPStore&, size_t)>& keep_row) const {
+    scratch.clear();
+    read_event(i, scratch);
+    rows.clear();
+    for (size_t row = 0; row < scratch.size(); ++row) {
+        if (!keep_row || keep_row(scratch, row)) rows.push_back(static_cast<uint32_t>(row));
+    }
+    scratch.get_tps(rows, tps);
+}
+
+VertexWindow::VertexWindow(const std::vector<TriggerPrimitive>& signal_tps, double radius_cm) {
+    const int n_views = static_cast<int>(APA::views.size());
+    // Neighbouring induction wires are one perpendicular pitch apart, not the pitch along z
+    const int margin_induction = static_cast<int>(std::ceil(radius_cm / get_wire_pitch_induction_diagonal_cm()));
+    const int margin_collection = static_cast<int>(std::ceil(radius_cm / get_wire_pitch_collection_cm()));
+    const double margin_time = toTDCticks(static_cast<int>(std::ceil(radius_cm / get_time_tick_cm())));
+
+    for (const auto& tp : signal_tps) {
+        if (!tp.IsMarley()) continue;
+        const int view = tp.GetViewId();
+        if (tp.GetDetector() < 0 || view < 0 || view >= n_views) continue;
+        const size_t index = static_cast<size_t>(tp.GetDetector() * n_views + view);
+        if (index >= channels_.size()) channels_.resize(index + 1);
+        channels_[index].min = std::min(channels_[index].min, tp.GetChannel());
+        channels_[index].max = std::max(channels_[index].max, tp.GetChannel());
+        time_min_ = std::min(time_min_, tp.GetTimeStart());
+        time_max_ = std::max(time_max_, tp.GetTimeStart() + toTDCticks(static_cast<int>(tp.GetSamplesOverThreshold())));
+    }
+    if (!is_valid()) return;
+
+    for (size_t index = 0; index < channels_.size(); ++index) {
+        ChannelRange& range = channels_[index];
+        if (range.min > range.max) continue;
+        const int margin = APA::views.at(index % n_views) == "X" ? margin_collection : margin_induction;
+        range.min -= margin;
+        range.max += margin;
+    }
+    time_min_ -= margin_time;
+    time_max_ += margin_time;
+}
+
+bool VertexWindow::contains(const TriggerPrimitive& tp) const {
+    return contains(tp.GetDetector(), tp.GetViewId(), tp.GetChannel(), tp.GetTimeStart());
+}
+
+bool VertexWindow::contains(const TPStore& store, size_t row) const {
+    // TPView follows the view ids (U, V, X), Unknown being out of range
+    return contains(store.get_detector(row), static_cast<int>(store.get_view(row)), static_cast<int>(store.get_channel(row)),
+                    static_cast<double>(store.get_time_start(row)));
+}
+
+bool VertexWindow::contains(int detector, int view, int channel, double time_start) const {
+    if (time_start < time_min_ || time_start > time_max_) return false;
+    const int n_views = static_cast<int>(APA::views.size());
+    if (detector < 0 || view < 0 || view >= n_views) return false;
+    const size_t index = static_cast<size_t>(detector * n_views + view);
+    if (index >= channels_.size()) return false;
+    const ChannelRange& range = channels_[index];
+    return channel >= range.min && channel <= range.max;
+}
@@ -0,0 +1,81 @@
+#ifndef BACKGROUNDLIBRARY_H
+#define BACKGROUNDLIBRARY_H
+
+#include "Clustering.h"
+
+#include <functional>
+
+// Read-only library of background events, indexed over all the events of a set of background files,
+// so that any event is reached in O(1) (random or sequential selection alike).
+// The events stay in memory-mapped binary TP files (*.tpb, see TPBinary.h): ROOT background files are
+// converted once into a cache folder, which the next runs and the concurrent jobs of a node map again
+// instead of reloading them (the pages are shared through the page cache).
+// Once built the library is never modified: one instance is shared by all the threads of a job
+class BackgroundLibrary {
+    public:
+        // cache_folder receives the binary copies of the ROOT files (*.tpb files are mapped directly)
+        BackgroundLibrary(const std::vector<std::string>& filenames, const std::string& cache_folder);
+        BackgroundLibrary(const BackgroundLibrary&) = delete;
+        BackgroundLibrary& operator=(const BackgroundLibrary&) = delete;
+
+        size_t get_n_events() const { return events_.size(); }
+        size_t get_n_files() const { return files_.size(); }
+        bool empty() const { return events_.empty(); }
+        // Event number of the i-th event of the library, in its file
+        int get_event_number(size_t i) const;
+        const std::string& get_filename(size_t i) const { return files_[events_[i].file]; }
+        // Whether the TPs of the i-th event are in time start order, from the flags of the binary file
+        bool is_event_time_sorted(size_t i) const;
+
+        // Appends the TPs of the i-th event to the store
+        void read_event(size_t i, TPStore& store) const;
+        // TPs of the i-th event passing keep_row (all if empty), tested on the columns: the event is copied column
+        // by column from the mapped file into scratch, and only the kept rows (listed in rows) are built into tps.
+        // scratch, rows and tps are buffers of the caller, cleared and reused from call to call
+        void get_event_tps(size_t i, TPStore& scratch, std::vector<uint32_t>& rows, std::vector<TriggerPrimitive>& tps,
+                           const std::function<bool(const TPStore&, size_t)>& keep_row = nullptr) const;
+
+    private:
+        struct EventRef {
+            uint32_t file;
+            uint32_t entry; // in the binary file
+        };
+
+        std::vector<std::string> files_; // original file names
+        std::vector<std::unique_ptr<TPBinaryReader>> readers_;
+        std::vector<EventRef> events_;
+};
+
+// Readout region around the neutrino vertex of a signal event, to overlay only the background TPs near it.
+// The vertex is located in readout coordinates by the MARLEY TPs of the event: per (APA, view) their channel
+// range, and their time range, each widened by the vertex radius converted to channels (perpendicular wire
+// pitch of the view) and to TDC ticks (drift per tick). A TP is then tested with a few comparisons, without
+// computing any position
+class VertexWindow {
+    public:
+        VertexWindow(const std::vector<TriggerPrimitive>& signal_tps, double radius_cm);
+
+        // false if the event has no MARLEY TP to locate the vertex
+        bool is_valid() const { return time_min_ <= time_max_; }
+        bool contains(const TriggerPrimitive& tp) const;
+        // Same test on the columns of a row, without building its TriggerPrimitive
+        bool contains(const TPStore& store, size_t row) const;
+
+    private:
+        bool contains(int detector, int view, int channel, double time_start) const;
+
+        struct ChannelRange {
+            int min = std::numeric_limits<int>::max();
+            int max = std::numeric_limits<int>::min();
+        };
+
+        std::vector<ChannelRange> channels_; // indexed by APA * n views + view id
+        double time_min_ = std::numeric_limits<double>::max();
+        double time_max_ = std::numeric_limits<double>::lowest();
+};
+
+// Binary TP file holding the TPs of filename: the file itself if it already is one, otherwise its copy
+// in cache_folder, written first if missing or older than the file. Empty if the file cannot be read
+std::string get_cached_binary_tps(const std::string& filename, const std::string& cache_folder);
+
+#endif // BACKGROUNDLIBRARY_H
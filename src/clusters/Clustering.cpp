@@ -7,34 +7,20 @@ LoggerInit([]{Logger::getUserHeader() << "[" << FILENAME << "]";});
 
 namespace {
 
-enum class ViewId : uint8_t {
-    U,
-    V,
-    X,
-    Unknown
-};
-
 struct TpCached {
     int time_start = 0;
     int time_end = 0;
     int detector_channel = 0;
     int detector = -1;
-    ViewId view = ViewId::Unknown;
+    TPView view = TPView::Unknown;
 };
 
-inline ViewId view_from_string(const std::string& view) {
-    if (view == "U") return ViewId::U;
-    if (view == "V") return ViewId::V;
-    if (view == "X") return ViewId::X;
-    return ViewId::Unknown;
-}
-
-inline int channels_in_view(ViewId view) {
+inline int channels_in_view(TPView view) {
     switch (view) {
-        case ViewId::U:
-        case ViewId::V:
+        case TPView::U:
+        case TPView::V:
             return APA::induction_channels;
-        case ViewId::X:
+        case TPView::X:
             return APA::collection_channels;
         default:
             return 0;
@@ -48,14 +34,14 @@ inline int interval_gap_ticks(const TpCached& a, const TpCached& b) {
 }
 
 inline bool channel_condition_with_pbc_cached(const TpCached& tp1, const TpCached& tp2, int channel_limit) {
-    if (tp1.detector != tp2.detector || tp1.view != tp2.view || tp1.view == ViewId::Unknown) {
+    if (tp1.detector != tp2.detector || tp1.view != tp2.view || tp1.view == TPView::Unknown) {
         return false;
     }
 
     const double diff = std::abs(tp1.detector_channel - tp2.detector_channel);
     const int channels_in_this_view = channels_in_view(tp1.view);
 
-    if (tp1.view == ViewId::X) {
+    if (tp1.view == TPView::X) {
         const int ch1 = tp1.detector_channel % 2560;
         const int ch2 = tp2.detector_channel % 2560;
 
@@ -73,7 +59,7 @@ inline bool channel_condition_with_pbc_cached(const TpCached& tp1, const TpCache
         return true;
     }
 
-    if ((tp1.view == ViewId::U || tp1.view == ViewId::V) && diff >= channels_in_this_view - channel_limit) {
+    if ((tp1.view == TPView::U || tp1.view == TPView::V) && diff >= channels_in_this_view - channel_limit) {
         return true;
     }
 
@@ -86,136 +72,14 @@ TpCached build_tp_cache(const TriggerPrimitive* tp) {
     out.time_end = out.time_start + toTDCticks(static_cast<int>(tp->GetSamplesOverThreshold()));
     out.detector_channel = tp->GetDetectorChannel();
     out.detector = tp->GetDetector();
-    out.view = view_from_string(tp->GetView());
+    out.view = static_cast<TPView>(tp->GetViewId()); // view ids follow TPView
     return out;
 }
 
-}
-
-void read_tps(const std::string& in_filename, 
-        std::map<int, std::vector<TriggerPrimitive>>& tps_by_event, 
-        std::map<int, std::vector<TrueParticle>>& true_particles_by_event, 
-        std::map<int, std::vector<Neutrino>>& neutrinos_by_event){
-    
-    if (verboseMode) LogInfo << "Reading TPs from: " << in_filename << std::endl;
-    
-    TFile inFile(in_filename.c_str(), "READ"); 
-    if (inFile.IsZombie()) { LogError << "Cannot open: " << in_filename << std::endl; return; }
-
-    // Read TPs tree from root level (no longer in "tps" directory)
-    if (auto* tpTree = dynamic_cast<TTree*>(inFile.Get("tps"))) {
-        
-        // TP basic variables
-        int event=0; 
-        UShort_t version=0; 
-        UInt_t detid=0, channel=0; 
-        ULong64_t s_over=0, tstart=0, s_to_peak=0; 
-        UInt_t adc_integral=0; 
-        UShort_t adc_peak=0, det=0; 
-        Int_t det_channel=0; 
-        std::string* view=nullptr;
-        Double_t simide_energy=0.0;
-        
-        // Truth variables
-        std::string* gen_name=nullptr;
-        Int_t particle_pdg=0;
-        std::string* particle_process=nullptr;
-        Float_t particle_energy=0.0f;
-        Float_t particle_x=0.0f, particle_y=0.0f, particle_z=0.0f;
-        Float_t particle_px=0.0f, particle_py=0.0f, particle_pz=0.0f;
-        std::string* neutrino_interaction=nullptr;
-        Float_t neutrino_x=0.0f, neutrino_y=0.0f, neutrino_z=0.0f;
-        Float_t neutrino_px=0.0f, neutrino_py=0.0f, neutrino_pz=0.0f;
-        Float_t neutrino_energy=0.0f;
-        
-        // Set branch addresses for TP basics
-        tpTree->SetBranchAddress("event", &event); 
-        tpTree->SetBranchAddress("version", &version); 
-        tpTree->SetBranchAddress("detid", &detid); 
-        tpTree->SetBranchAddress("channel", &channel);
-        tpTree->SetBranchAddress("samples_over_threshold", &s_over);
-        tpTree->SetBranchAddress("time_start", &tstart);
-        tpTree->SetBranchAddress("samples_to_peak", &s_to_peak);
-        tpTree->SetBranchAddress("adc_integral", &adc_integral);
-        tpTree->SetBranchAddress("adc_peak", &adc_peak);
-        tpTree->SetBranchAddress("detector", &det);
-        tpTree->SetBranchAddress("detector_channel", &det_channel);
-        tpTree->SetBranchAddress("view", &view);
-        if (tpTree->GetBranch("simide_energy")) {
-            tpTree->SetBranchAddress("simide_energy", &simide_energy);
-        }
-        
-        // Set branch addresses for truth
-        tpTree->SetBranchAddress("generator_name", &gen_name);
-        if (tpTree->GetBranch("particle_pdg")) tpTree->SetBranchAddress("particle_pdg", &particle_pdg);
-        if (tpTree->GetBranch("particle_process")) tpTree->SetBranchAddress("particle_process", &particle_process);
-        if (tpTree->GetBranch("particle_energy")) tpTree->SetBranchAddress("particle_energy", &particle_energy);
-        if (tpTree->GetBranch("particle_x")) tpTree->SetBranchAddress("particle_x", &particle_x);
-        if (tpTree->GetBranch("particle_y")) tpTree->SetBranchAddress("particle_y", &particle_y);
-        if (tpTree->GetBranch("particle_z")) tpTree->SetBranchAddress("particle_z", &particle_z);
-        if (tpTree->GetBranch("particle_px")) tpTree->SetBranchAddress("particle_px", &particle_px);
-        if (tpTree->GetBranch("particle_py")) tpTree->SetBranchAddress("particle_py", &particle_py);
-        if (tpTree->GetBranch("particle_pz")) tpTree->SetBranchAddress("particle_pz", &particle_pz);
-        if (tpTree->GetBranch("neutrino_interaction")) tpTree->SetBranchAddress("neutrino_interaction", &neutrino_interaction);
-        if (tpTree->GetBranch("neutrino_x")) tpTree->SetBranchAddress("neutrino_x", &neutrino_x);
-        if (tpTree->GetBranch("neutrino_y")) tpTree->SetBranchAddress("neutrino_y", &neutrino_y);
-        if (tpTree->GetBranch("neutrino_z")) tpTree->SetBranchAddress("neutrino_z", &neutrino_z);
-        if (tpTree->GetBranch("neutrino_px")) tpTree->SetBranchAddress("neutrino_px", &neutrino_px);
-        if (tpTree->GetBranch("neutrino_py")) tpTree->SetBranchAddress("neutrino_py", &neutrino_py);
-        if (tpTree->GetBranch("neutrino_pz")) tpTree->SetBranchAddress("neutrino_pz", &neutrino_pz);
-        if (tpTree->GetBranch("neutrino_energy")) tpTree->SetBranchAddress("neutrino_energy", &neutrino_energy);
-
-        for (Long64_t i=0;i<tpTree->GetEntries();++i){ 
-
-            tpTree->GetEntry(i); 
-
-            TriggerPrimitive tp(version, 0, detid, channel, s_over, tstart, s_to_peak, adc_integral, adc_peak); 
-            tp.SetEvent(event); 
-            tp.SetDetector(det);
-            tp.SetDetectorChannel(det_channel);
-            tp.SetSimideEnergy(simide_energy);
-            
-            // Set embedded truth
-            if (gen_name) tp.SetGeneratorName(*gen_name);
-            tp.SetParticlePDG(particle_pdg);
-            if (particle_process) tp.SetParticleProcess(*particle_process);
-            tp.SetParticleEnergy(particle_energy);
-            tp.SetParticlePosition(particle_x, particle_y, particle_z);
-            tp.SetParticleMomentum(particle_px, particle_py, particle_pz);
-            if (neutrino_interaction) {
-                tp.SetNeutrinoInfo(*neutrino_interaction, neutrino_x, neutrino_y, neutrino_z,
-                                  neutrino_px, neutrino_py, neutrino_pz, neutrino_energy);
-            }
-            
-            tps_by_event[event].push_back(tp);
-        }
-    }
-
-    // Note: true_particles_by_event and neutrinos_by_event are no longer populated
-    // Truth information is now embedded directly in TPs
-    // These maps are kept as function parameters for backward compatibility but will be empty
-
-    inFile.Close();
-}
-
-// PBC is periodic boundary condition
-bool channel_condition_with_pbc(TriggerPrimitive *tp1, TriggerPrimitive* tp2, int channel_limit) {
-    return channel_condition_with_pbc_cached(build_tp_cache(tp1), build_tp_cache(tp2), channel_limit);
-}
-
-// this is supposed to do one event at the time
-// TODO add number to save fraction of TPs removed with the cut
-std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps, int ticks_limit, int channel_limit, int min_tps_to_cluster, int adc_integral_cut) {
-    
-    if (verboseMode) LogInfo << "Creating clusters from TPs" << std::endl;
-    
-    if (verboseMode) LogInfo << "Ticks limit: " << ticks_limit << " TPC ticks" << std::endl;
-
-    int ticks_limit_tdc = toTDCticks(ticks_limit);
-    if (verboseMode) LogInfo << "Ticks limit: " << ticks_limit_tdc << " TDC ticks" << std::endl;
+// Groups the TPs into candidate clusters, in creation order. Each group holds indices into tp_cache
+std::vector<std::vector<size_t>> group_tps(const std::vector<TpCached>& tp_cache, int ticks_limit_tdc, int channel_limit) {
 
     struct CandidateCluster {
-        std::vector<TriggerPrimitive*> tps;
         std::vector<size_t> tp_indices;
         std::unordered_set<int> channels;
         int min_time_start = INT_MAX;
@@ -223,34 +87,46 @@ std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps,
         int min_channel = INT_MAX;
         int max_channel = INT_MIN;
         int detector = -1;
-        ViewId view = ViewId::Unknown;
+        TPView view = TPView::Unknown;
     };
 
+    // All the candidates, in creation order (which is also the output order)
     std::vector<CandidateCluster> buffer;
-    std::vector<Cluster> clusters;
-    std::vector<TpCached> tp_cache;
-    tp_cache.reserve(all_tps.size());
-    for (const auto* tp : all_tps) {
-        tp_cache.push_back(build_tp_cache(tp));
-    }
-
-    // Reset the buffer for each event
-    buffer.clear();
 
-    // ...existing code...
+    // Sliding time window: with TPs sorted by time start, a candidate that ended more than ticks_limit_tdc
+    // before the current TP can never be appended to again, so it is retired from the live candidates.
+    // Unsorted input keeps every candidate live, as the window would not be exact
+    const bool time_sorted = std::is_sorted(tp_cache.begin(), tp_cache.end(), [](const TpCached& a, const TpCached& b) {
+        return a.time_start < b.time_start;
+    });
+    if (!time_sorted && verboseMode) LogInfo << "TPs are not sorted by time start, candidates are never retired" << std::endl;
 
+    // Live candidates indexed by (detector, view), as indices into buffer in creation order,
+    // so that the first appendable candidate is the same as in a scan of the whole buffer
+    std::unordered_map<int, std::vector<size_t>> live_candidates;
+    auto live_key = [](const TpCached& tpc) { return tpc.detector * 4 + static_cast<int>(tpc.view); };
 
-    for (size_t iTP = 0; iTP < all_tps.size(); iTP++) {
+    for (size_t iTP = 0; iTP < tp_cache.size(); iTP++) {
         
         
-        TriggerPrimitive* tp1 = all_tps[iTP];
         const TpCached& tp1c = tp_cache[iTP];
 
-        if (debugMode) LogInfo << "Processing TP: " << tp1->GetTimeStart() << " " << tp1->GetDetectorChannel() << std::endl;
+        if (debugMode) LogInfo << "Processing TP: " << tp1c.time_start << " " << tp1c.detector_channel << std::endl;
 
         bool appended = false;
 
-        for (auto& candidate : buffer) {
+        std::vector<size_t>& live = live_candidates[live_key(tp1c)];
+        size_t n_kept = 0; // live candidates are compacted in place while scanning
+
+        for (size_t iLive = 0; iLive < live.size(); ++iLive) {
+            const size_t candidate_index = live[iLive];
+            auto& candidate = buffer[candidate_index];
+
+            if (time_sorted && tp1c.time_start - candidate.max_time_end > ticks_limit_tdc) {
+                continue; // retired
+            }
+            live[n_kept++] = candidate_index;
+
             if (candidate.detector != tp1c.detector || candidate.view != tp1c.view) {
                 continue;
             }
@@ -261,7 +137,7 @@ std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps,
                 continue;
             }
 
-            if (tp1c.view == ViewId::X) {
+            if (tp1c.view == TPView::X) {
                 if (tp1c.detector_channel < candidate.min_channel - channel_limit
                     || tp1c.detector_channel > candidate.max_channel + channel_limit) {
                     continue;
@@ -279,8 +155,7 @@ std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps,
 
             const bool has_same_channel_in_candidate = (candidate.channels.find(tp1c.detector_channel) != candidate.channels.end());
 
-            for (size_t j = 0; j < candidate.tps.size(); ++j) {
-                TriggerPrimitive* tp2 = candidate.tps[j];
+            for (size_t j = 0; j < candidate.tp_indices.size(); ++j) {
                 const TpCached& tp2c = tp_cache[candidate.tp_indices[j]];
 
                 const bool same_channel = has_same_channel_in_candidate && (tp1c.detector_channel == tp2c.detector_channel);
@@ -312,7 +187,6 @@ std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps,
             }
 
             if (can_append) {
-                candidate.tps.push_back(tp1);
                 candidate.tp_indices.push_back(iTP);
                 candidate.channels.insert(tp1c.detector_channel);
                 candidate.min_time_start = std::min(candidate.min_time_start, tp1c.time_start);
@@ -321,15 +195,17 @@ std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps,
                 candidate.max_channel = std::max(candidate.max_channel, tp1c.detector_channel);
                 appended = true;
                 if (debugMode) LogInfo << "Appended TP to candidate Cluster" << std::endl;
+                // keep the candidates not scanned yet
+                n_kept = std::copy(live.begin() + iLive + 1, live.end(), live.begin() + n_kept) - live.begin();
                 break;
             }
         }
+        live.resize(n_kept);
 
         // If not appended to any candidate, create a new Cluster in the buffer
         if (!appended) {
             if (debugMode) LogInfo << "Creating new candidate Cluster" << std::endl;
             CandidateCluster candidate;
-            candidate.tps.push_back(tp1);
             candidate.tp_indices.push_back(iTP);
             candidate.channels.insert(tp1c.detector_channel);
             candidate.min_time_start = tp1c.time_start;
@@ -339,37 +215,507 @@ std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps,
             candidate.detector = tp1c.detector;
             candidate.view = tp1c.view;
             buffer.emplace_back(std::move(candidate));
+            live.push_back(buffer.size() - 1);
         }
     }
 
-    // Process remaining candidates in the buffer
+    std::vector<std::vector<size_t>> groups;
+    groups.reserve(buffer.size());
     for (auto& candidate : buffer) {
-        if (candidate.tps.size() >= static_cast<size_t>(min_tps_to_cluster)) {
-            int adc_integral = 0;
-            for (auto& tp1 : candidate.tps) {
-                adc_integral += tp1->GetAdcIntegral();
+        groups.emplace_back(std::move(candidate.tp_indices));
+    }
+    return groups;
+}
+
+}
+
+TpsReader::TpsReader(const std::string& in_filename) {
+    if (verboseMode) LogInfo << "Reading TPs from: " << in_filename << std::endl;
+
+    if (tp_binary::is_binary_filename(in_filename)) {
+        binary_.reset(new TPBinaryReader(in_filename));
+        if (!binary_->is_open()) {
+            binary_.reset();
+            return;
+        }
+        n_entries_ = binary_->get_n_events();
+        return;
+    }
+
+    file_ = TFile::Open(in_filename.c_str(), "READ");
+    if (!file_ || file_->IsZombie()) {
+        LogError << "Cannot open: " << in_filename << std::endl;
+        delete file_;
+        file_ = nullptr;
+        return;
+    }
+
+    // TPs tree at root level (no longer in "tps" directory)
+    tree_ = dynamic_cast<TTree*>(file_->Get("tps"));
+    if (!tree_) {
+        close();
+        return;
+    }
+    n_entries_ = tree_->GetEntries();
+    time_sorted_ = read_time_sorted_flag(file_, "backtracking_metadata");
+
+    // Set branch addresses for TP basics
+    tree_->SetBranchAddress("event", &event_);
+    tree_->SetBranchAddress("version", &version_);
+    tree_->SetBranchAddress("detid", &detid_);
+    tree_->SetBranchAddress("channel", &channel_);
+    tree_->SetBranchAddress("samples_over_threshold", &s_over_);
+    tree_->SetBranchAddress("time_start", &tstart_);
+    tree_->SetBranchAddress("samples_to_peak", &s_to_peak_);
+    tree_->SetBranchAddress("adc_integral", &adc_integral_);
+    tree_->SetBranchAddress("adc_peak", &adc_peak_);
+    tree_->SetBranchAddress("detector", &det_);
+    tree_->SetBranchAddress("detector_channel", &det_channel_);
+    tree_->SetBranchAddress("view", &view_);
+    if (tree_->GetBranch("simide_energy")) tree_->SetBranchAddress("simide_energy", &simide_energy_);
+
+    // Set branch addresses for truth
+    tree_->SetBranchAddress("generator_name", &gen_name_);
+    if (tree_->GetBranch("particle_pdg")) tree_->SetBranchAddress("particle_pdg", &particle_pdg_);
+    if (tree_->GetBranch("particle_process")) tree_->SetBranchAddress("particle_process", &particle_process_);
+    if (tree_->GetBranch("particle_energy")) tree_->SetBranchAddress("particle_energy", &particle_energy_);
+    if (tree_->GetBranch("particle_x")) tree_->SetBranchAddress("particle_x", &particle_x_);
+    if (tree_->GetBranch("particle_y")) tree_->SetBranchAddress("particle_y", &particle_y_);
+    if (tree_->GetBranch("particle_z")) tree_->SetBranchAddress("particle_z", &particle_z_);
+    if (tree_->GetBranch("particle_px")) tree_->SetBranchAddress("particle_px", &particle_px_);
+    if (tree_->GetBranch("particle_py")) tree_->SetBranchAddress("particle_py", &particle_py_);
+    if (tree_->GetBranch("particle_pz")) tree_->SetBranchAddress("particle_pz", &particle_pz_);
+    if (tree_->GetBranch("neutrino_interaction")) tree_->SetBranchAddress("neutrino_interaction", &neutrino_interaction_);
+    if (tree_->GetBranch("neutrino_x")) tree_->SetBranchAddress("neutrino_x", &neutrino_x_);
+    if (tree_->GetBranch("neutrino_y")) tree_->SetBranchAddress("neutrino_y", &neutrino_y_);
+    if (tree_->GetBranch("neutrino_z")) tree_->SetBranchAddress("neutrino_z", &neutrino_z_);
+    if (tree_->GetBranch("neutrino_px")) tree_->SetBranchAddress("neutrino_px", &neutrino_px_);
+    if (tree_->GetBranch("neutrino_py")) tree_->SetBranchAddress("neutrino_py", &neutrino_py_);
+    if (tree_->GetBranch("neutrino_pz")) tree_->SetBranchAddress("neutrino_pz", &neutrino_pz_);
+    if (tree_->GetBranch("neutrino_energy")) tree_->SetBranchAddress("neutrino_energy", &neutrino_energy_);
+}
+
+TpsReader::~TpsReader() {
+    close();
+}
+
+TriggerPrimitive TpsReader::make_tp() const {
+    TriggerPrimitive tp(version_, 0, detid_, channel_, s_over_, tstart_, s_to_peak_, adc_integral_, adc_peak_);
+    tp.SetEvent(event_);
+    tp.SetDetector(det_);
+    tp.SetDetectorChannel(det_channel_);
+    tp.SetSimideEnergy(simide_energy_);
+
+    // Set embedded truth
+    if (gen_name_) tp.SetGeneratorName(*gen_name_);
+    tp.SetParticlePDG(particle_pdg_);
+    if (particle_process_) tp.SetParticleProcess(*particle_process_);
+    tp.SetParticleEnergy(particle_energy_);
+    tp.SetParticlePosition(particle_x_, particle_y_, particle_z_);
+    tp.SetParticleMomentum(particle_px_, particle_py_, particle_pz_);
+    if (neutrino_interaction_) {
+        tp.SetNeutrinoInfo(*neutrino_interaction_, neutrino_x_, neutrino_y_, neutrino_z_,
+                           neutrino_px_, neutrino_py_, neutrino_pz_, neutrino_energy_);
+    }
+    return tp;
+}
+
+bool TpsReader::next() {
+    tps_.clear();
+    if (!is_open() || next_entry_ >= n_entries_) return false;
+
+    if (binary_) {
+        binary_event_.clear();
+        binary_->read_event(next_entry_, binary_event_);
+        time_sorted_ = binary_->is_event_time_sorted(next_entry_);
+        current_event_ = binary_->get_event(next_entry_++);
+        tps_.reserve(binary_event_.size());
+        for (size_t i = 0; i < binary_event_.size(); ++i) tps_.push_back(binary_event_.get_tp(i));
+        return true;
+    }
+
+    // The first entry of this event may already be loaded, from the end of the previous call
+    if (loaded_entry_ != next_entry_) {
+        tree_->GetEntry(next_entry_);
+        loaded_entry_ = next_entry_;
+    }
+    current_event_ = event_;
+
+    while (true) {
+        tps_.push_back(make_tp());
+        if (++next_entry_ >= n_entries_) break;
+        tree_->GetEntry(next_entry_);
+        loaded_entry_ = next_entry_;
+        if (event_ != current_event_) break;
+    }
+    return true;
+}
+
+void TpsReader::close() {
+    binary_.reset();
+    if (!file_) return;
+    if (tree_) tree_->ResetBranchAddresses();
+    tree_ = nullptr;
+    file_->Close(); // also deletes the tree
+    delete file_;
+    file_ = nullptr;
+    // Objects allocated by ROOT for the string branches
+    delete view_;
+    delete gen_name_;
+    delete particle_process_;
+    delete neutrino_interaction_;
+    view_ = gen_name_ = particle_process_ = neutrino_interaction_ = nullptr;
+}
+
+void read_tps(const std::string& in_filename, 
+        std::map<int, std::vector<TriggerPrimitive>>& tps_by_event, 
+        std::map<int, std::vector<TrueParticle>>& true_particles_by_event, 
+        std::map<int, std::vector<Neutrino>>& neutrinos_by_event){
+
+    TpsReader reader(in_filename);
+    while (reader.next()) {
+        std::vector<TriggerPrimitive>& event_tps = tps_by_event[reader.get_event()];
+        if (event_tps.empty()) std::swap(event_tps, reader.get_tps());
+        else event_tps.insert(event_tps.end(), reader.get_tps().begin(), reader.get_tps().end());
+    }
+
+    // Note: true_particles_by_event and neutrinos_by_event are no longer populated
+    // Truth information is now embedded directly in TPs
+    // These maps are kept as function parameters for backward compatibility but will be empty
+}
+
+namespace {
+
+// Reads n entries of one branch, from first, handing each value to set(i, value)
+template <typename T, typename F>
+void read_branch_column(TTree* tree, const char* name, const T& value, Long64_t first, size_t n, F&& set) {
+    TBranch* branch = tree->GetBranch(name);
+    if (!branch) return;
+    for (size_t i = 0; i < n; ++i) {
+        branch->GetEntry(first + i);
+        set(i, value);
+    }
+}
+
+// Interned id of a string branch, with the previous string of the column remembered
+// (the TPs of one particle are consecutive, so most lookups are skipped)
+class ColumnInterner {
+    public:
+        ColumnInterner(StringInterner& interner, int missing_id) : interner_(interner), missing_id_(missing_id) {}
+        int get(const std::string* s) {
+            if (!s) return missing_id_;
+            if (id_ < 0 || *s != last_) {
+                last_ = *s;
+                id_ = interner_.intern(last_);
             }
-            // ENERGY CUT LOGIC IN THE APP, NOT HERE
-            // if (adc_integral > adc_integral_cut) {
-                // check validity of tps in candidate
-                if (debugMode) LogInfo << "Candidate Cluster has " << candidate.tps.size() << " TPs" << std::endl;
-                clusters.emplace_back(Cluster(std::move(candidate.tps)));
-                if (debugMode) LogInfo << "Cluster created with " << clusters.back().get_tps().size() << " TPs" << std::endl;
-            // }
-            // else {
-            //     if (verboseMode) LogInfo << "Candidate Cluster rejected due to adc_integral cut: " << adc_integral << " <= " << adc_integral_cut << std::endl;
-            // }
+            return id_;
         }
+    private:
+        StringInterner& interner_;
+        int missing_id_;
+        std::string last_;
+        int id_ = -1;
+};
+
+}
+
+TpsColumnReader::TpsColumnReader(const std::string& in_filename, size_t chunk_size) : chunk_size_(std::max<size_t>(1, chunk_size)) {
+    if (verboseMode) LogInfo << "Reading TPs from: " << in_filename << std::endl;
+
+    if (tp_binary::is_binary_filename(in_filename)) {
+        binary_.reset(new TPBinaryReader(in_filename));
+        if (!binary_->is_open()) {
+            binary_.reset();
+            return;
+        }
+        n_entries_ = binary_->get_n_events();
+        return;
     }
 
-    // ...existing code...
+    file_ = TFile::Open(in_filename.c_str(), "READ");
+    if (!file_ || file_->IsZombie()) {
+        LogError << "Cannot open: " << in_filename << std::endl;
+        delete file_;
+        file_ = nullptr;
+        return;
+    }
 
+    // Backtracked tps trees, or raw TriggerPrimitive trees of the tpstream files
+    for (const char* name : {"TriggerPrimitive", "tps/TriggerPrimitive", "tps", "tps/tps"}) {
+        tree_ = dynamic_cast<TTree*>(file_->Get(name));
+        if (tree_) break;
+    }
+    if (!tree_) {
+        LogError << "Cannot find a TP tree in " << in_filename << " (tried TriggerPrimitive, tps/TriggerPrimitive, tps, tps/tps)" << std::endl;
+        close();
+        return;
+    }
+    n_entries_ = tree_->GetEntries();
+
+    // TP basic variables (the view is recomputed from the channel, as in the TriggerPrimitive constructor)
+    tree_->SetBranchAddress("event", &event_);
+    tree_->SetBranchAddress("channel", &channel_);
+    tree_->SetBranchAddress("samples_over_threshold", &s_over_);
+    tree_->SetBranchAddress("time_start", &tstart_);
+    tree_->SetBranchAddress("samples_to_peak", &s_to_peak_);
+    tree_->SetBranchAddress("adc_integral", &adc_integral_);
+    tree_->SetBranchAddress("adc_peak", &adc_peak_);
+    // Raw trees have neither: detector and detector_channel are then computed from the channel
+    has_detector_ = tree_->GetBranch("detector") != nullptr;
+    has_detector_channel_ = tree_->GetBranch("detector_channel") != nullptr;
+    if (has_detector_) tree_->SetBranchAddress("detector", &det_);
+    if (has_detector_channel_) tree_->SetBranchAddress("detector_channel", &det_channel_);
+    if (tree_->GetBranch("simide_energy")) tree_->SetBranchAddress("simide_energy", &simide_energy_);
+
+    // Truth variables
+    if (tree_->GetBranch("generator_name")) tree_->SetBranchAddress("generator_name", &gen_name_);
+    if (tree_->GetBranch("particle_pdg")) tree_->SetBranchAddress("particle_pdg", &truth_.particle_pdg);
+    if (tree_->GetBranch("particle_process")) tree_->SetBranchAddress("particle_process", &particle_process_);
+    if (tree_->GetBranch("particle_energy")) tree_->SetBranchAddress("particle_energy", &truth_.particle_energy);
+    if (tree_->GetBranch("particle_x")) tree_->SetBranchAddress("particle_x", &truth_.particle_x);
+    if (tree_->GetBranch("particle_y")) tree_->SetBranchAddress("particle_y", &truth_.particle_y);
+    if (tree_->GetBranch("particle_z")) tree_->SetBranchAddress("particle_z", &truth_.particle_z);
+    if (tree_->GetBranch("particle_px")) tree_->SetBranchAddress("particle_px", &truth_.particle_px);
+    if (tree_->GetBranch("particle_py")) tree_->SetBranchAddress("particle_py", &truth_.particle_py);
+    if (tree_->GetBranch("particle_pz")) tree_->SetBranchAddress("particle_pz", &truth_.particle_pz);
+    if (tree_->GetBranch("neutrino_interaction")) tree_->SetBranchAddress("neutrino_interaction", &neutrino_interaction_);
+    if (tree_->GetBranch("neutrino_x")) tree_->SetBranchAddress("neutrino_x", &truth_.neutrino_x);
+    if (tree_->GetBranch("neutrino_y")) tree_->SetBranchAddress("neutrino_y", &truth_.neutrino_y);
+    if (tree_->GetBranch("neutrino_z")) tree_->SetBranchAddress("neutrino_z", &truth_.neutrino_z);
+    if (tree_->GetBranch("neutrino_px")) tree_->SetBranchAddress("neutrino_px", &truth_.neutrino_px);
+    if (tree_->GetBranch("neutrino_py")) tree_->SetBranchAddress("neutrino_py", &truth_.neutrino_py);
+    if (tree_->GetBranch("neutrino_pz")) tree_->SetBranchAddress("neutrino_pz", &truth_.neutrino_pz);
+    if (tree_->GetBranch("neutrino_energy")) tree_->SetBranchAddress("neutrino_energy", &truth_.neutrino_energy);
+
+    // Only the bound branches are read, and they are prefetched together by the cache
+    read_only_bound_branches(tree_);
+    tree_->SetCacheSize(32 * 1024 * 1024);
+    tree_->AddBranchToCache("*", true);
+    tree_->StopCacheLearningPhase();
+}
+
+TpsColumnReader::~TpsColumnReader() {
+    close();
+}
+
+Long64_t TpsColumnReader::get_n_tps() const {
+    if (binary_) return static_cast<Long64_t>(binary_->get_n_tps());
+    return n_entries_;
+}
+
+bool TpsColumnReader::read_chunk(TPStore& store) {
+    if (!is_open() || next_entry_ >= n_entries_) return false;
+
+    if (binary_) {
+        const size_t start_size = store.size();
+        while (next_entry_ < n_entries_ && store.size() - start_size < chunk_size_) {
+            binary_->read_event(next_entry_++, store);
+        }
+        return true;
+    }
+
+    read_tree_chunk(store);
+    return true;
+}
+
+void TpsColumnReader::read_tree_chunk(TPStore& store) {
+    const Long64_t first = next_entry_;
+    const size_t n = static_cast<size_t>(std::min<Long64_t>(chunk_size_, n_entries_ - first));
+    next_entry_ += n;
+
+    rows_.assign(n, TPRow());
+    truths_.assign(n, TPTruth());
+
+    // One column at a time over the whole chunk
+    read_branch_column(tree_, "event", event_, first, n, [&](size_t i, int v){ rows_[i].event = v; });
+    read_branch_column(tree_, "channel", channel_, first, n, [&](size_t i, UInt_t v){ rows_[i].channel = v; });
+    read_branch_column(tree_, "samples_over_threshold", s_over_, first, n, [&](size_t i, ULong64_t v){ rows_[i].samples_over_threshold = static_cast<uint16_t>(v); });
+    read_branch_column(tree_, "time_start", tstart_, first, n, [&](size_t i, ULong64_t v){ rows_[i].time_start = v; });
+    read_branch_column(tree_, "samples_to_peak", s_to_peak_, first, n, [&](size_t i, ULong64_t v){ rows_[i].samples_to_peak = static_cast<uint16_t>(v); });
+    read_branch_column(tree_, "adc_integral", adc_integral_, first, n, [&](size_t i, UInt_t v){ rows_[i].adc_integral = v; });
+    read_branch_column(tree_, "adc_peak", adc_peak_, first, n, [&](size_t i, UShort_t v){ rows_[i].adc_peak = v; });
+    read_branch_column(tree_, "detector", det_, first, n, [&](size_t i, UShort_t v){ rows_[i].detector = v; });
+    read_branch_column(tree_, "detector_channel", det_channel_, first, n, [&](size_t i, Int_t v){ rows_[i].detector_channel = v; });
+    read_branch_column(tree_, "simide_energy", simide_energy_, first, n, [&](size_t i, Double_t v){ rows_[i].simide_energy = v; });
+
+    ColumnInterner generators(interned::generators(), interned::unknown_generator_id);
+    ColumnInterner processes(interned::processes(), interned::empty_string_id);
+    ColumnInterner interactions(interned::interactions(), interned::empty_string_id);
+    read_branch_column(tree_, "generator_name", gen_name_, first, n, [&](size_t i, const std::string* v){ truths_[i].generator_id = generators.get(v); });
+    read_branch_column(tree_, "particle_process", particle_process_, first, n, [&](size_t i, const std::string* v){ truths_[i].particle_process_id = processes.get(v); });
+    read_branch_column(tree_, "neutrino_interaction", neutrino_interaction_, first, n, [&](size_t i, const std::string* v){ truths_[i].neutrino_interaction_id = interactions.get(v); });
+    read_branch_column(tree_, "particle_pdg", truth_.particle_pdg, first, n, [&](size_t i, int v){ truths_[i].particle_pdg = v; });
+    read_branch_column(tree_, "particle_energy", truth_.particle_energy, first, n, [&](size_t i, float v){ truths_[i].particle_energy = v; });
+    read_branch_column(tree_, "particle_x", truth_.particle_x, first, n, [&](size_t i, float v){ truths_[i].particle_x = v; });
+    read_branch_column(tree_, "particle_y", truth_.particle_y, first, n, [&](size_t i, float v){ truths_[i].particle_y = v; });
+    read_branch_column(tree_, "particle_z", truth_.particle_z, first, n, [&](size_t i, float v){ truths_[i].particle_z = v; });
+    read_branch_column(tree_, "particle_px", truth_.particle_px, first, n, [&](size_t i, float v){ truths_[i].particle_px = v; });
+    read_branch_column(tree_, "particle_py", truth_.particle_py, first, n, [&](size_t i, float v){ truths_[i].particle_py = v; });
+    read_branch_column(tree_, "particle_pz", truth_.particle_pz, first, n, [&](size_t i, float v){ truths_[i].particle_pz = v; });
+    read_branch_column(tree_, "neutrino_x", truth_.neutrino_x, first, n, [&](size_t i, float v){ truths_[i].neutrino_x = v; });
+    read_branch_column(tree_, "neutrino_y", truth_.neutrino_y, first, n, [&](size_t i, float v){ truths_[i].neutrino_y = v; });
+    read_branch_column(tree_, "neutrino_z", truth_.neutrino_z, first, n, [&](size_t i, float v){ truths_[i].neutrino_z = v; });
+    read_branch_column(tree_, "neutrino_px", truth_.neutrino_px, first, n, [&](size_t i, float v){ truths_[i].neutrino_px = v; });
+    read_branch_column(tree_, "neutrino_py", truth_.neutrino_py, first, n, [&](size_t i, float v){ truths_[i].neutrino_py = v; });
+    read_branch_column(tree_, "neutrino_pz", truth_.neutrino_pz, first, n, [&](size_t i, float v){ truths_[i].neutrino_pz = v; });
+    read_branch_column(tree_, "neutrino_energy", truth_.neutrino_energy, first, n, [&](size_t i, float v){ truths_[i].neutrino_energy = v; });
+
+    store.reserve(store.size() + n);
+    int32_t truth_index = -1;
+    for (size_t i = 0; i < n; ++i) {
+        TPRow& row = rows_[i];
+        if (!has_detector_) row.detector = static_cast<int32_t>(row.channel / APA::total_channels);
+        if (!has_detector_channel_) row.detector_channel = static_cast<int32_t>(row.channel % APA::total_channels);
+        row.view = tp_view_from_detector_channel(row.channel % APA::total_channels);
+        // Consecutive TPs of the same particle share their truth entry
+        if (i == 0 || !(truths_[i] == truths_[i - 1])) truth_index = store.add_truth(truths_[i]);
+        row.truth = truth_index;
+        store.push_back(row);
+    }
+}
+
+void TpsColumnReader::close() {
+    binary_.reset();
+    if (!file_) return;
+    if (tree_) tree_->ResetBranchAddresses();
+    tree_ = nullptr;
+    file_->Close(); // also deletes the tree
+    delete file_;
+    file_ = nullptr;
+    // Objects allocated by ROOT for the string branches
+    delete gen_name_;
+    delete particle_process_;
+    delete neutrino_interaction_;
+    gen_name_ = particle_process_ = neutrino_interaction_ = nullptr;
+}
+
+void read_tps(const std::string& in_filename, TPStore& store) {
+    TpsColumnReader reader(in_filename);
+    store.reserve(store.size() + reader.get_n_tps());
+    while (reader.read_chunk(store)) {}
+}
+
+// PBC is periodic boundary condition
+bool channel_condition_with_pbc(TriggerPrimitive *tp1, TriggerPrimitive* tp2, int channel_limit) {
+    return channel_condition_with_pbc_cached(build_tp_cache(tp1), build_tp_cache(tp2), channel_limit);
+}
+
+// this is supposed to do one event at the time
+// TODO add number to save fraction of TPs removed with the cut
+std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps, int ticks_limit, int channel_limit, int min_tps_to_cluster, int adc_integral_cut) {
+    
+    if (verboseMode) LogInfo << "Creating clusters from TPs" << std::endl;
+    
+    if (verboseMode) LogInfo << "Ticks limit: " << ticks_limit << " TPC ticks" << std::endl;
+
+    int ticks_limit_tdc = toTDCticks(ticks_limit);
+    if (verboseMode) LogInfo << "Ticks limit: " << ticks_limit_tdc << " TDC ticks" << std::endl;
+
+    std::vector<TpCached> tp_cache;
+    tp_cache.reserve(all_tps.size());
+    for (const auto* tp : all_tps) {
+        tp_cache.push_back(build_tp_cache(tp));
+    }
+
+    std::vector<Cluster> clusters;
+    for (const auto& group : group_tps(tp_cache, ticks_limit_tdc, channel_limit)) {
+        if (group.size() >= static_cast<size_t>(min_tps_to_cluster)) {
+            // ENERGY CUT LOGIC IN THE APP, NOT HERE
+            std::vector<TriggerPrimitive*> tps;
+            tps.reserve(group.size());
+            for (size_t index : group) {
+                tps.push_back(all_tps[index]);
+            }
+            if (debugMode) LogInfo << "Candidate Cluster has " << tps.size() << " TPs" << std::endl;
+            clusters.emplace_back(Cluster(std::move(tps)));
+            if (debugMode) LogInfo << "Cluster created with " << clusters.back().get_tps().size() << " TPs" << std::endl;
+        }
+    }
 
     if (verboseMode) LogInfo << "Finished clustering. Number of clusters: " << clusters.size() << std::endl;
 
     return clusters;
 }
 
+std::vector<std::vector<Cluster>> make_clusters_parallel(const std::vector<std::vector<TriggerPrimitive*>>& tps_groups, int ticks_limit, int channel_limit, int min_tps_to_cluster, const std::vector<int>& adc_integral_cuts, int n_threads) {
+
+    // One task per (group, APA): clusters never span two detectors, so the APAs can be clustered independently
+    struct ClusteringTask {
+        size_t group = 0;
+        std::vector<TriggerPrimitive*> tps;
+        std::vector<Cluster> clusters;
+    };
+    std::vector<ClusteringTask> tasks;
+    for (size_t iGroup = 0; iGroup < tps_groups.size(); ++iGroup) {
+        std::map<int, size_t> task_of_detector;
+        for (auto* tp : tps_groups[iGroup]) {
+            auto it = task_of_detector.find(tp->GetDetector());
+            if (it == task_of_detector.end()) {
+                it = task_of_detector.emplace(tp->GetDetector(), tasks.size()).first;
+                tasks.emplace_back();
+                tasks.back().group = iGroup;
+            }
+            tasks[it->second].tps.push_back(tp); // keeps the order of the group
+        }
+    }
+
+    if (verboseMode) LogInfo << "Clustering " << tps_groups.size() << " groups of TPs in " << tasks.size() << " tasks on " << n_threads << " thread(s)" << std::endl;
+
+    std::atomic<size_t> next_task(0);
+    auto run_tasks = [&]() {
+        for (size_t iTask = next_task++; iTask < tasks.size(); iTask = next_task++) {
+            auto& task = tasks[iTask];
+            task.clusters = make_cluster(task.tps, ticks_limit, channel_limit, min_tps_to_cluster, adc_integral_cuts.at(task.group));
+        }
+    };
+
+    n_threads = std::max(1, std::min<int>(n_threads, tasks.size()));
+    if (n_threads == 1) {
+        run_tasks();
+    } else {
+        std::vector<std::thread> threads;
+        for (int iThread = 0; iThread < n_threads; ++iThread) threads.emplace_back(run_tasks);
+        for (auto& thread : threads) thread.join();
+    }
+
+    // Merge the APAs of each group. make_cluster outputs clusters in the order of their first TP,
+    // so sorting by the position of the first TP in the group gives back the order of a single run
+    std::vector<std::vector<Cluster>> clusters_by_group(tps_groups.size());
+    std::vector<std::vector<size_t>> tasks_of_group(tps_groups.size());
+    for (size_t iTask = 0; iTask < tasks.size(); ++iTask) {
+        tasks_of_group[tasks[iTask].group].push_back(iTask);
+    }
+    for (size_t iGroup = 0; iGroup < tps_groups.size(); ++iGroup) {
+        auto& clusters = clusters_by_group[iGroup];
+        if (tasks_of_group[iGroup].size() == 1) {
+            clusters = std::move(tasks[tasks_of_group[iGroup].front()].clusters);
+            continue;
+        }
+
+        std::unordered_map<const TriggerPrimitive*, size_t> position_in_group;
+        position_in_group.reserve(tps_groups[iGroup].size());
+        for (size_t iTP = 0; iTP < tps_groups[iGroup].size(); ++iTP) {
+            position_in_group[tps_groups[iGroup][iTP]] = iTP;
+        }
+
+        std::vector<std::pair<size_t, Cluster*>> ordered_clusters;
+        for (size_t iTask : tasks_of_group[iGroup]) {
+            for (auto& cluster : tasks[iTask].clusters) {
+                ordered_clusters.emplace_back(position_in_group.at(cluster.get_tp(0)), &cluster);
+            }
+        }
+        std::sort(ordered_clusters.begin(), ordered_clusters.end(),
+            [](const std::pair<size_t, Cluster*>& a, const std::pair<size_t, Cluster*>& b) { return a.first < b.first; });
+
+        clusters.reserve(ordered_clusters.size());
+        for (auto& position_and_cluster : ordered_clusters) {
+            clusters.emplace_back(std::move(*position_and_cluster.second));
+        }
+    }
+
+    return clusters_by_group;
+}
+
 
 std::vector<Cluster> filter_main_tracks(std::vector<Cluster>& clusters) { // valid only if the clusters are ordered by event and for clean sn data
     int best_idx = INT_MAX;
@@ -470,238 +816,212 @@ std::vector<Cluster> filter_out_main_track(std::vector<Cluster>& clusters) { //
 }
 
 
-void write_clusters(std::vector<Cluster>& clusters, TFile* clusters_file, std::string view) {
-    // File is already open and managed by caller
-    if (!clusters_file || clusters_file->IsZombie()) {
-        LogError << "Invalid TFile pointer provided to write_clusters" << std::endl;
+ClusterTreeWriter::ClusterTreeWriter(TDirectory* dir, const std::string& view, const RootOutputSettings& output_settings)
+    : dir_(dir)
+{
+    if (!dir_) {
+        LogError << "Invalid TDirectory pointer provided to ClusterTreeWriter" << std::endl;
         return;
     }
-    // Use the current directory (set by caller with cd())
-    TDirectory* clusters_dir = gDirectory;
-    
-    // Check if tree exists and if it has the new momentum branches
-    TTree *old_tree = (TTree*)clusters_dir->Get(Form("clusters_tree_%s", view.c_str()));
-    TTree *clusters_tree = nullptr;
-    
+    const std::string tree_name = "clusters_tree_" + view;
+
+    // Extend a tree left by a previous writer, unless it predates the momentum branches
+    TTree* old_tree = (TTree*)dir_->Get(tree_name.c_str());
+    if (old_tree && old_tree->GetBranch("true_mom_x") == nullptr) {
+        LogWarning << "Existing tree lacks momentum branches - creating new tree with updated structure" << std::endl;
+        old_tree = nullptr;
+    }
+
     if (old_tree) {
-        bool has_momentum = (old_tree->GetBranch("true_mom_x") != nullptr);
-        if (!has_momentum) {
-            // Old tree doesn't have momentum - create a new tree which will overwrite on Write()
-            LogWarning << "Existing tree lacks momentum branches - creating new tree with updated structure" << std::endl;
-            clusters_tree = nullptr; // Force creation of new tree below
-        } else {
-            clusters_tree = old_tree; // Use existing tree
-        }
+        tree_ = old_tree;
+        bind_existing_tree();
+        return;
     }
 
-    int event;
-    int n_tps;
-    float true_pos_x;
-    float true_pos_y;
-    float true_pos_z;
-    float true_neutrino_mom_x;
-    float true_neutrino_mom_y;
-    float true_neutrino_mom_z;
-    float true_neutrino_energy;
-    float true_particle_energy;
-    std::string true_label;
-    std::string *true_label_point = nullptr;
-    bool is_es_interaction;
-    float true_mom_x;
-    float true_mom_y;
-    float true_mom_z;
-    float supernova_tp_fraction;
-    float generator_tp_fraction;
-    float marley_tp_fraction;
-    double total_charge;
-    double total_energy;    
-    int true_pdg;
-    bool is_main_cluster;
-    int cluster_id;
-    
-    // TP information (allocate vectors once and reuse/clear per entry)
-    std::vector<int>* tp_detector_channel = new std::vector<int>();
-    std::vector<int>* tp_detector = new std::vector<int>();
-    std::vector<int>* tp_samples_over_threshold = new std::vector<int>();
-    std::vector<int>* tp_time_start = new std::vector<int>();
-    std::vector<int>* tp_samples_to_peak = new std::vector<int>();
-    std::vector<int>* tp_adc_peak = new std::vector<int>();
-    std::vector<int>* tp_adc_integral = new std::vector<int>();
-    std::vector<double>* tp_simide_energy = new std::vector<double>();
+    dir_->cd();
+    tree_ = new TTree(tree_name.c_str(), "Tree of clusters");
+    if (verboseMode) LogInfo << "Tree not found, creating it" << std::endl;
+    tree_->Branch("event", &event_, "event/I");
+    tree_->Branch("n_tps", &n_tps_, "n_tps/I");
+    tree_->Branch("true_pos_x", &true_pos_x_, "true_pos_x/F");
+    tree_->Branch("true_pos_y", &true_pos_y_, "true_pos_y/F");
+    tree_->Branch("true_pos_z", &true_pos_z_, "true_pos_z/F");
+    tree_->Branch("true_neutrino_mom_x", &true_neutrino_mom_x_, "true_neutrino_mom_x/F");
+    tree_->Branch("true_neutrino_mom_y", &true_neutrino_mom_y_, "true_neutrino_mom_y/F");
+    tree_->Branch("true_neutrino_mom_z", &true_neutrino_mom_z_, "true_neutrino_mom_z/F");
+    tree_->Branch("true_mom_x", &true_mom_x_, "true_mom_x/F");
+    tree_->Branch("true_mom_y", &true_mom_y_, "true_mom_y/F");
+    tree_->Branch("true_mom_z", &true_mom_z_, "true_mom_z/F");
+    tree_->Branch("true_neutrino_energy", &true_neutrino_energy_, "true_neutrino_energy/F");
+    tree_->Branch("true_particle_energy", &true_particle_energy_, "true_particle_energy/F");
+    tree_->Branch("true_label", &true_label_);
+    tree_->Branch("supernova_tp_fraction", &supernova_tp_fraction_, "supernova_tp_fraction/F");
+    tree_->Branch("generator_tp_fraction", &generator_tp_fraction_, "generator_tp_fraction/F");
+    tree_->Branch("marley_tp_fraction", &marley_tp_fraction_, "marley_tp_fraction/F");
+    tree_->Branch("is_es_interaction", &is_es_interaction_, "is_es_interaction/O");
+    tree_->Branch("total_charge", &total_charge_, "total_charge/D");
+    tree_->Branch("total_energy", &total_energy_, "total_energy/D");
+    tree_->Branch("true_pdg", &true_pdg_, "true_pdg/I");
+    tree_->Branch("is_main_cluster", &is_main_cluster_, "is_main_cluster/O");
+    tree_->Branch("cluster_id", &cluster_id_, "cluster_id/I");
+
+    tree_->Branch("tp_detector_channel", &tp_detector_channel_);
+    tree_->Branch("tp_detector", &tp_detector_);
+    tree_->Branch("tp_samples_over_threshold", &tp_samples_over_threshold_);
+    tree_->Branch("tp_samples_to_peak", &tp_samples_to_peak_);
+    tree_->Branch("tp_time_start", &tp_time_start_);
+    tree_->Branch("tp_adc_peak", &tp_adc_peak_);
+    tree_->Branch("tp_adc_integral", &tp_adc_integral_);
+    tree_->Branch("tp_simide_energy", &tp_simide_energy_);
+
+    applyRootOutputSettings(tree_, output_settings);
+}
 
-    if (!clusters_tree) {
-        clusters_tree = new TTree(Form("clusters_tree_%s", view.c_str()), "Tree of clusters");
-        if (verboseMode) LogInfo << "Tree not found, creating it" << std::endl;
-        // create the branches
-        clusters_tree->Branch("event", &event, "event/I");
-        clusters_tree->Branch("n_tps", &n_tps, "n_tps/I");
-        clusters_tree->Branch("true_pos_x", &true_pos_x, "true_pos_x/F");
-        clusters_tree->Branch("true_pos_y", &true_pos_y, "true_pos_y/F");
-        clusters_tree->Branch("true_pos_z", &true_pos_z, "true_pos_z/F");
-        clusters_tree->Branch("true_neutrino_mom_x", &true_neutrino_mom_x, "true_neutrino_mom_x/F");
-        clusters_tree->Branch("true_neutrino_mom_y", &true_neutrino_mom_y, "true_neutrino_mom_y/F");
-        clusters_tree->Branch("true_neutrino_mom_z", &true_neutrino_mom_z, "true_neutrino_mom_z/F");
-        clusters_tree->Branch("true_mom_x", &true_mom_x, "true_mom_x/F");
-        clusters_tree->Branch("true_mom_y", &true_mom_y, "true_mom_y/F");
-        clusters_tree->Branch("true_mom_z", &true_mom_z, "true_mom_z/F");
-        clusters_tree->Branch("true_neutrino_energy", &true_neutrino_energy, "true_neutrino_energy/F");
-        clusters_tree->Branch("true_particle_energy", &true_particle_energy, "true_particle_energy/F");
-        clusters_tree->Branch("true_label", &true_label);
-        clusters_tree->Branch("supernova_tp_fraction", &supernova_tp_fraction, "supernova_tp_fraction/F");
-        clusters_tree->Branch("generator_tp_fraction", &generator_tp_fraction, "generator_tp_fraction/F");
-        clusters_tree->Branch("marley_tp_fraction", &marley_tp_fraction, "marley_tp_fraction/F");
-        clusters_tree->Branch("is_es_interaction", &is_es_interaction, "is_es_interaction/O");
-        clusters_tree->Branch("total_charge", &total_charge, "total_charge/D");
-        clusters_tree->Branch("total_energy", &total_energy, "total_energy/D");
-        clusters_tree->Branch("true_pdg", &true_pdg, "true_pdg/I");
-        clusters_tree->Branch("is_main_cluster", &is_main_cluster, "is_main_cluster/O");
-        clusters_tree->Branch("cluster_id", &cluster_id, "cluster_id/I");
-
-        clusters_tree->Branch("tp_detector_channel", &tp_detector_channel);
-        clusters_tree->Branch("tp_detector", &tp_detector);
-        clusters_tree->Branch("tp_samples_over_threshold", &tp_samples_over_threshold);
-        clusters_tree->Branch("tp_samples_to_peak", &tp_samples_to_peak);
-        clusters_tree->Branch("tp_time_start", &tp_time_start);
-        clusters_tree->Branch("tp_adc_peak", &tp_adc_peak);
-        clusters_tree->Branch("tp_adc_integral", &tp_adc_integral);
-        clusters_tree->Branch("tp_simide_energy", &tp_simide_energy);
-
-        // LogInfo << "Tree created" << std::endl;
-    }
-    else {
-        // Existing tree: bind branch addresses to current output variables so Fill() works
-        true_label_point = &true_label; // point to stack string for fill
-        clusters_tree->SetBranchAddress("event", &event);
-        clusters_tree->SetBranchAddress("n_tps", &n_tps);
-        clusters_tree->SetBranchAddress("true_pos_x", &true_pos_x);
-        clusters_tree->SetBranchAddress("true_pos_y", &true_pos_y);
-        clusters_tree->SetBranchAddress("true_pos_z", &true_pos_z);
-        clusters_tree->SetBranchAddress("true_neutrino_mom_x", &true_neutrino_mom_x);
-        clusters_tree->SetBranchAddress("true_neutrino_mom_y", &true_neutrino_mom_y);
-        clusters_tree->SetBranchAddress("true_neutrino_mom_z", &true_neutrino_mom_z);
-        clusters_tree->SetBranchAddress("true_mom_x", &true_mom_x);
-        clusters_tree->SetBranchAddress("true_mom_y", &true_mom_y);
-        clusters_tree->SetBranchAddress("true_mom_z", &true_mom_z);
-        clusters_tree->SetBranchAddress("true_neutrino_energy", &true_neutrino_energy);
-        clusters_tree->SetBranchAddress("true_particle_energy", &true_particle_energy);
-        clusters_tree->SetBranchAddress("true_label", &true_label_point);
-        clusters_tree->SetBranchAddress("supernova_tp_fraction", &supernova_tp_fraction);
-        clusters_tree->SetBranchAddress("generator_tp_fraction", &generator_tp_fraction);
-        clusters_tree->SetBranchAddress("is_es_interaction", &is_es_interaction);
-        clusters_tree->SetBranchAddress("total_charge", &total_charge);
-        clusters_tree->SetBranchAddress("total_energy", &total_energy);
-        clusters_tree->SetBranchAddress("true_pdg", &true_pdg);
-        clusters_tree->SetBranchAddress("is_main_cluster", &is_main_cluster);
-        if (clusters_tree->GetBranch("cluster_id")) {
-            clusters_tree->SetBranchAddress("cluster_id", &cluster_id);
-        }
-        clusters_tree->SetBranchAddress("tp_detector_channel", &tp_detector_channel);
-        clusters_tree->SetBranchAddress("tp_detector", &tp_detector);
-        clusters_tree->SetBranchAddress("tp_samples_over_threshold", &tp_samples_over_threshold);
-        clusters_tree->SetBranchAddress("tp_samples_to_peak", &tp_samples_to_peak);
-        clusters_tree->SetBranchAddress("tp_time_start", &tp_time_start);
-        clusters_tree->SetBranchAddress("tp_adc_peak", &tp_adc_peak);
-        clusters_tree->SetBranchAddress("tp_adc_integral", &tp_adc_integral);
-        // Optional: only set if branch exists (for backward compatibility)
-        if (clusters_tree->GetBranch("tp_simide_energy")) {
-            clusters_tree->SetBranchAddress("tp_simide_energy", &tp_simide_energy);
-        }
-    }
-    
+void ClusterTreeWriter::bind_existing_tree() {
+    time_sorted_ = false;
+    tree_->SetBranchAddress("event", &event_);
+    tree_->SetBranchAddress("n_tps", &n_tps_);
+    tree_->SetBranchAddress("true_pos_x", &true_pos_x_);
+    tree_->SetBranchAddress("true_pos_y", &true_pos_y_);
+    tree_->SetBranchAddress("true_pos_z", &true_pos_z_);
+    tree_->SetBranchAddress("true_neutrino_mom_x", &true_neutrino_mom_x_);
+    tree_->SetBranchAddress("true_neutrino_mom_y", &true_neutrino_mom_y_);
+    tree_->SetBranchAddress("true_neutrino_mom_z", &true_neutrino_mom_z_);
+    tree_->SetBranchAddress("true_mom_x", &true_mom_x_);
+    tree_->SetBranchAddress("true_mom_y", &true_mom_y_);
+    tree_->SetBranchAddress("true_mom_z", &true_mom_z_);
+    tree_->SetBranchAddress("true_neutrino_energy", &true_neutrino_energy_);
+    tree_->SetBranchAddress("true_particle_energy", &true_particle_energy_);
+    tree_->SetBranchAddress("true_label", &true_label_);
+    tree_->SetBranchAddress("supernova_tp_fraction", &supernova_tp_fraction_);
+    tree_->SetBranchAddress("generator_tp_fraction", &generator_tp_fraction_);
+    tree_->SetBranchAddress("is_es_interaction", &is_es_interaction_);
+    tree_->SetBranchAddress("total_charge", &total_charge_);
+    tree_->SetBranchAddress("total_energy", &total_energy_);
+    tree_->SetBranchAddress("true_pdg", &true_pdg_);
+    tree_->SetBranchAddress("is_main_cluster", &is_main_cluster_);
+    tree_->SetBranchAddress("tp_detector_channel", &tp_detector_channel_);
+    tree_->SetBranchAddress("tp_detector", &tp_detector_);
+    tree_->SetBranchAddress("tp_samples_over_threshold", &tp_samples_over_threshold_);
+    tree_->SetBranchAddress("tp_samples_to_peak", &tp_samples_to_peak_);
+    tree_->SetBranchAddress("tp_time_start", &tp_time_start_);
+    tree_->SetBranchAddress("tp_adc_peak", &tp_adc_peak_);
+    tree_->SetBranchAddress("tp_adc_integral", &tp_adc_integral_);
+    // Optional: only set if branch exists (for backward compatibility)
+    if (tree_->GetBranch("marley_tp_fraction")) tree_->SetBranchAddress("marley_tp_fraction", &marley_tp_fraction_);
+    if (tree_->GetBranch("cluster_id")) tree_->SetBranchAddress("cluster_id", &cluster_id_);
+    if (tree_->GetBranch("tp_simide_energy")) tree_->SetBranchAddress("tp_simide_energy", &tp_simide_energy_);
+}
 
-    // fill the tree
-    for (auto& Cluster : clusters) {
-        event = Cluster.get_event();
-        n_tps = Cluster.get_size();
-        true_pos_x = Cluster.get_true_pos()[0];
-        true_pos_y = Cluster.get_true_pos()[1];
-        true_pos_z = Cluster.get_true_pos()[2];
-        true_neutrino_mom_x = Cluster.get_true_neutrino_momentum()[0];
-        true_neutrino_mom_y = Cluster.get_true_neutrino_momentum()[1];
-        true_neutrino_mom_z = Cluster.get_true_neutrino_momentum()[2];
-        true_mom_x = Cluster.get_true_momentum()[0];
-        true_mom_y = Cluster.get_true_momentum()[1];
-        true_mom_z = Cluster.get_true_momentum()[2];
-        true_neutrino_energy = Cluster.get_true_neutrino_energy();
-        true_particle_energy = Cluster.get_true_particle_energy();
-        true_label = Cluster.get_true_label();
-        true_label_point = &true_label;
-        supernova_tp_fraction = Cluster.get_supernova_tp_fraction();
-        // Compute fraction of TPs in this Cluster with a non-UNKNOWN generator
-        // Also compute marley-specific fraction
-        int cluster_truth_count = 0;
-        int marley_count = 0;
-        {
-            const auto& cl_tps = Cluster.get_tps();
-            for (auto* tp : cl_tps) {
-                std::string gen_name = tp->GetGeneratorName();
-                if (gen_name != "UNKNOWN") {
-                    cluster_truth_count++;
-                }
-                // Case-insensitive check for MARLEY
-                std::string gen_lower = gen_name;
-                std::transform(gen_lower.begin(), gen_lower.end(), gen_lower.begin(), ::tolower);
-                if (gen_lower.find("marley") != std::string::npos) {
-                    marley_count++;
-                }
-            }
-            generator_tp_fraction = cl_tps.empty() ? 0.f : static_cast<float>(cluster_truth_count) / static_cast<float>(cl_tps.size());
-            marley_tp_fraction = cl_tps.empty() ? 0.f : static_cast<float>(marley_count) / static_cast<float>(cl_tps.size());
-            // std::cout << "Fraction of TPs with non-null generator: " << generator_tp_fraction << std::endl;
-        }
-        
-        // If TPs don't have truth info (cluster_truth_count==0), use the cluster's stored value instead
-        if (cluster_truth_count == 0) {
-            marley_tp_fraction = Cluster.get_supernova_tp_fraction();
-            generator_tp_fraction = Cluster.get_generator_tp_fraction();
-        }
-        
-        is_es_interaction = Cluster.get_is_es_interaction();
-        total_charge = Cluster.get_total_charge();
-        total_energy = Cluster.get_total_energy();
-        true_pdg = Cluster.get_true_pdg();
-        is_main_cluster = Cluster.get_is_main_cluster();
-        cluster_id = Cluster.get_cluster_id();
-        // TODO create different tree for metadata? Currently in filename
+ClusterTreeWriter::~ClusterTreeWriter() {
+    close();
+}
 
-        if (tp_detector_channel) tp_detector_channel->clear();
-        if (tp_detector) tp_detector->clear();
-    if (tp_samples_over_threshold) tp_samples_over_threshold->clear();
-    if (tp_samples_to_peak) tp_samples_to_peak->clear();
-        if (tp_time_start) tp_time_start->clear();
-        if (tp_samples_to_peak) tp_samples_to_peak->clear();
-        if (tp_adc_peak) tp_adc_peak->clear();
-        if (tp_adc_integral) tp_adc_integral->clear();
-        if (tp_simide_energy) tp_simide_energy->clear();
-        for (auto& tp : Cluster.get_tps()) {
-            tp_detector_channel->push_back(tp->GetDetectorChannel());
-            tp_detector->push_back(tp->GetDetector());
-            tp_samples_over_threshold->push_back(tp->GetSamplesOverThreshold());
-            tp_time_start->push_back(tp->GetTimeStart());
-            tp_samples_to_peak->push_back(tp->GetSamplesToPeak());
-            tp_adc_peak->push_back(tp->GetAdcPeak());
-            tp_adc_integral->push_back(tp->GetAdcIntegral());
-            tp_simide_energy->push_back(tp->GetSimideEnergy());
-            if (debugMode && tp_samples_to_peak->size() <= 5) {
-                LogDebug << "[write_clusters_with_match_id] cluster_id=" << cluster_id
-                         << " tp_index=" << (tp_samples_to_peak->size() - 1)
-                         << " samples_to_peak=" << tp->GetSamplesToPeak()
-                         << " adc_peak=" << tp->GetAdcPeak() << std::endl;
-            }
-        }
-        clusters_tree->Fill();
+void ClusterTreeWriter::fill(Cluster& cluster) {
+    if (!is_open()) return;
+
+    event_ = cluster.get_event();
+    n_tps_ = cluster.get_size();
+    const auto& true_pos = cluster.get_true_pos();
+    true_pos_x_ = true_pos[0];
+    true_pos_y_ = true_pos[1];
+    true_pos_z_ = true_pos[2];
+    const auto& true_neutrino_mom = cluster.get_true_neutrino_momentum();
+    true_neutrino_mom_x_ = true_neutrino_mom[0];
+    true_neutrino_mom_y_ = true_neutrino_mom[1];
+    true_neutrino_mom_z_ = true_neutrino_mom[2];
+    const auto& true_mom = cluster.get_true_momentum();
+    true_mom_x_ = true_mom[0];
+    true_mom_y_ = true_mom[1];
+    true_mom_z_ = true_mom[2];
+    true_neutrino_energy_ = cluster.get_true_neutrino_energy();
+    true_particle_energy_ = cluster.get_true_particle_energy();
+    true_label_ = cluster.get_true_label();
+    supernova_tp_fraction_ = cluster.get_supernova_tp_fraction();
+
+    // Fraction of TPs with a non-UNKNOWN generator, and of MARLEY TPs
+    const auto& cl_tps = cluster.get_tps();
+    int cluster_truth_count = 0;
+    int marley_count = 0;
+    double time_start = std::numeric_limits<double>::max();
+    for (auto* tp : cl_tps) {
+        if (tp->GetGeneratorId() != interned::unknown_generator_id) cluster_truth_count++;
+        if (tp->IsMarley()) marley_count++;
+        time_start = std::min(time_start, tp->GetTimeStart());
+    }
+    if (has_last_ && (event_ < last_event_ || (event_ == last_event_ && time_start < last_time_start_))) time_sorted_ = false;
+    has_last_ = true;
+    last_event_ = event_;
+    last_time_start_ = time_start;
+    generator_tp_fraction_ = cl_tps.empty() ? 0.f : static_cast<float>(cluster_truth_count) / static_cast<float>(cl_tps.size());
+    marley_tp_fraction_ = cl_tps.empty() ? 0.f : static_cast<float>(marley_count) / static_cast<float>(cl_tps.size());
+    // If TPs don't have truth info (cluster_truth_count==0), use the cluster's stored value instead
+    if (cluster_truth_count == 0) {
+        marley_tp_fraction_ = cluster.get_supernova_tp_fraction();
+        generator_tp_fraction_ = cluster.get_generator_tp_fraction();
     }
-    // write the tree
-    // Write inside 'clusters' directory
-    clusters_dir->cd();
-    clusters_tree->Write("", TObject::kOverwrite);
-    // File close is managed by caller
 
-    return;   
+    is_es_interaction_ = cluster.get_is_es_interaction();
+    total_charge_ = cluster.get_total_charge();
+    total_energy_ = cluster.get_total_energy();
+    true_pdg_ = cluster.get_true_pdg();
+    is_main_cluster_ = cluster.get_is_main_cluster();
+    cluster_id_ = cluster.get_cluster_id();
+
+    tp_detector_channel_.clear();
+    tp_detector_.clear();
+    tp_samples_over_threshold_.clear();
+    tp_time_start_.clear();
+    tp_samples_to_peak_.clear();
+    tp_adc_peak_.clear();
+    tp_adc_integral_.clear();
+    tp_simide_energy_.clear();
+    for (auto* tp : cl_tps) {
+        tp_detector_channel_.push_back(tp->GetDetectorChannel());
+        tp_detector_.push_back(tp->GetDetector());
+        tp_samples_over_threshold_.push_back(tp->GetSamplesOverThreshold());
+        tp_time_start_.push_back(tp->GetTimeStart());
+        tp_samples_to_peak_.push_back(tp->GetSamplesToPeak());
+        tp_adc_peak_.push_back(tp->GetAdcPeak());
+        tp_adc_integral_.push_back(tp->GetAdcIntegral());
+        tp_simide_energy_.push_back(tp->GetSimideEnergy());
+    }
+    tree_->Fill();
+}
+
+void ClusterTreeWriter::fill(std::vector<Cluster>& clusters) {
+    for (auto& cluster : clusters) fill(cluster);
+}
+
+Long64_t ClusterTreeWriter::get_entries() const {
+    return is_open() ? tree_->GetEntries() : 0;
+}
+
+void ClusterTreeWriter::close() {
+    if (!is_open()) return;
+    // One cycle per tree, written in its own directory; the tree stays owned by the directory
+    TDirectory* previous_dir = gDirectory;
+    dir_->cd();
+    tree_->Write("", TObject::kOverwrite);
+    if (previous_dir) previous_dir->cd();
+    tree_ = nullptr;
+}
+
+void write_clusters(std::vector<Cluster>& clusters, TFile* clusters_file, std::string view, const RootOutputSettings& output_settings) {
+    // File is already open and managed by caller
+    if (!clusters_file || clusters_file->IsZombie()) {
+        LogError << "Invalid TFile pointer provided to write_clusters" << std::endl;
+        return;
+    }
+    // Use the current directory (set by caller with cd())
+    ClusterTreeWriter writer(gDirectory, view, output_settings);
+    writer.fill(clusters);
+    writer.close();
 }
 
 void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int, int>& cluster_to_match, TFile* clusters_file, std::string view,
-                                   std::map<int, int>* x_to_u_map, std::map<int, int>* x_to_v_map) {
+                                   std::map<int, int>* x_to_u_map, std::map<int, int>* x_to_v_map,
+                                   const RootOutputSettings& output_settings, const std::vector<float>* match_scores) {
     // Similar to write_clusters but adds match_id and match_type branches
     // For X plane, also adds matching_clusterId_U and matching_clusterId_V
     if (!clusters_file || clusters_file->IsZombie()) {
@@ -729,6 +1049,7 @@ void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int,
     int cluster_id;
     int match_id;
     int match_type;
+    float match_score;
     int matching_clusterId_U;  // Only for X plane
     int matching_clusterId_V;  // Only for X plane
     
@@ -767,6 +1088,7 @@ void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int,
     clusters_tree->Branch("cluster_id", &cluster_id, "cluster_id/I");
     clusters_tree->Branch("match_id", &match_id, "match_id/I");
     clusters_tree->Branch("match_type", &match_type, "match_type/I");
+    clusters_tree->Branch("match_score", &match_score, "match_score/F");
     
     // Add matching cluster ID branches only for X plane
     if (view == "X" && x_to_u_map && x_to_v_map) {
@@ -782,6 +1104,7 @@ void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int,
     clusters_tree->Branch("tp_adc_peak", &tp_adc_peak);
     clusters_tree->Branch("tp_adc_integral", &tp_adc_integral);
     clusters_tree->Branch("tp_simide_energy", &tp_simide_energy);
+    applyRootOutputSettings(clusters_tree, output_settings);
 
     // Fill the tree
     for (auto& Cluster : clusters) {
@@ -806,13 +1129,10 @@ void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int,
         {
             const auto& cl_tps = Cluster.get_tps();
             for (auto* tp : cl_tps) {
-                std::string gen_name = tp->GetGeneratorName();
-                if (gen_name != "UNKNOWN") {
+                if (tp->GetGeneratorId() != interned::unknown_generator_id) {
                     cluster_truth_count++;
                 }
-                std::string gen_lower = gen_name;
-                std::transform(gen_lower.begin(), gen_lower.end(), gen_lower.begin(), ::tolower);
-                if (gen_lower.find("marley") != std::string::npos) {
+                if (tp->IsMarley()) {
                     marley_count++;
                 }
             }
@@ -839,9 +1159,11 @@ void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int,
         if (it != cluster_to_match.end()) {
             match_id = it->second;
             match_type = 3;  // Currently only 3-plane matches
+            match_score = (match_scores && match_id >= 0 && match_id < int(match_scores->size())) ? (*match_scores)[match_id] : -1.0f;
         } else {
             match_id = -1;
             match_type = -1;  // No match
+            match_score = -1.0f;
         }
         
         // Set matching cluster IDs for X plane
@@ -893,10 +1215,28 @@ void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int,
     return;
 }
 
-std::vector<Cluster> read_clusters(std::string root_filename){
+namespace {
+
+// Sizes the arena of a cluster set for all the TPs of a clusters tree, from its n_tps branch
+// (already bound to n_tps), so that the file is read with a single TP allocation
+void reserve_cluster_set(ClusterSet& clusters, TTree* tree, Int_t* n_tps) {
+    clusters.reserve(clusters.size() + tree->GetEntries());
+    TBranch* n_tps_branch = tree->GetBranch("n_tps");
+    if (!n_tps_branch) return;
+    size_t total_tps = 0;
+    for (Long64_t i = 0; i < tree->GetEntries(); i++) {
+        n_tps_branch->GetEntry(i);
+        if (*n_tps > 0) total_tps += *n_tps;
+    }
+    clusters.reserve_tps(total_tps);
+}
+
+}
+
+ClusterSet read_clusters(std::string root_filename){
     if (verboseMode) LogInfo << "Reading clusters from: " << root_filename << std::endl;
-    std::vector<Cluster> clusters;
-    TFile *f = TFile::Open(root_filename.c_str());
+    ClusterSet clusters;
+    std::unique_ptr<TFile> f(TFile::Open(root_filename.c_str()));
     if (!f || f->IsZombie()) {
         LogError << "Cannot open file: " << root_filename << std::endl;
         return clusters;
@@ -906,7 +1246,7 @@ std::vector<Cluster> read_clusters(std::string root_filename){
     TDirectory* clusters_dir = dynamic_cast<TDirectory*>(f->Get("clusters"));
     if (!clusters_dir) {
         LogWarning << "No 'clusters' directory found, trying file root" << std::endl;
-        clusters_dir = f;
+        clusters_dir = f.get();
     }
     
     // Iterate through all trees in the directory
@@ -961,7 +1301,21 @@ std::vector<Cluster> read_clusters(std::string root_filename){
     if (tree->GetBranch("tp_detector_channel")) tree->SetBranchAddress("tp_detector_channel", &tp_channel);
     if (tree->GetBranch("tp_time_start")) tree->SetBranchAddress("tp_time_start", &tp_time_start);
     if (tree->GetBranch("tp_samples_over_threshold")) tree->SetBranchAddress("tp_samples_over_threshold", &tp_s_over);
-    if (tree->GetBranch("tp_adc_integral")) tree->SetBranchAddress("tp_adc_integral", &tp_adc_integral);        // Read all entries
+    if (tree->GetBranch("tp_adc_integral")) tree->SetBranchAddress("tp_adc_integral", &tp_adc_integral);
+        reserve_cluster_set(clusters, tree, &n_tps);
+
+        // Determine view from tree name
+        const std::string tree_name = tree->GetName();
+        int view_channel = -1;
+        if (tree_name.find("_X") != std::string::npos) {
+            view_channel = 0; // Collection
+        } else if (tree_name.find("_U") != std::string::npos) {
+            view_channel = 1; // Induction U
+        } else if (tree_name.find("_V") != std::string::npos) {
+            view_channel = 2; // Induction V
+        }
+
+        // Read all entries
         for (Long64_t i = 0; i < tree->GetEntries(); i++) {
             tree->GetEntry(i);
             
@@ -981,20 +1335,11 @@ std::vector<Cluster> read_clusters(std::string root_filename){
                 int adc_integral = (*tp_adc_integral)[j];
                 
                 // Create TP (version=0, flag=0, detid=0 are defaults, adc_peak=0, samples_to_peak=0)
-                TriggerPrimitive* tp = new TriggerPrimitive(0, 0, 0, channel, s_over_threshold, time_start, 0, adc_integral, 0);
-                tp->SetEvent(event);
-                
-                // Determine view from tree name
-                std::string tree_name = tree->GetName();
-                if (tree_name.find("_X") != std::string::npos) {
-                    tp->SetView(0); // Collection
-                } else if (tree_name.find("_U") != std::string::npos) {
-                    tp->SetView(1); // Induction U
-                } else if (tree_name.find("_V") != std::string::npos) {
-                    tp->SetView(2); // Induction V
-                }
+                TriggerPrimitive tp(0, 0, 0, channel, s_over_threshold, time_start, 0, adc_integral, 0);
+                tp.SetEvent(event);
+                if (view_channel >= 0) tp.SetView(view_channel);
                 
-                tps.push_back(tp);
+                tps.push_back(clusters.add_tp(tp));
             }
             
             if (verboseMode) LogInfo << "    Creating cluster from " << tps.size() << " TPs..." << std::endl;
@@ -1012,8 +1357,18 @@ std::vector<Cluster> read_clusters(std::string root_filename){
             cluster.set_is_es_interaction(is_es_interaction);
             cluster.set_true_pdg(true_pdg);
             
-            clusters.push_back(cluster);
+            clusters.add_cluster(std::move(cluster));
         }
+
+        // Objects allocated by ROOT for the pointer branches, and the tree read from its key, are ours to delete
+        tree->ResetBranchAddresses();
+        delete true_label;
+        delete tp_channel;
+        delete tp_detector;
+        delete tp_time_start;
+        delete tp_s_over;
+        delete tp_adc_integral;
+        delete tree;
     }
     
     f->Close();
@@ -1021,173 +1376,287 @@ std::vector<Cluster> read_clusters(std::string root_filename){
     return clusters;
 }
 
-std::vector<Cluster> read_clusters_from_tree(std::string root_filename, std::string view, std::string directory){
-    LogInfo << "Reading " << view << " clusters from: " << root_filename << " (directory: " << directory << ")" << std::endl;
-    std::vector<Cluster> clusters;
-    TFile *f = TFile::Open(root_filename.c_str());
+namespace {
+
+// Enables a branch of a tree whose other branches are disabled, binds it and adds it to the cache
+template <typename T>
+bool bind_column(TTree* tree, const char* name, T* address) {
+    if (!tree->GetBranch(name)) return false;
+    tree->SetBranchStatus(name, 1);
+    tree->SetBranchAddress(name, address);
+    tree->AddBranchToCache(name);
+    return true;
+}
+
+// Appends n values of a TP branch, padding with zeros when it is missing or shorter
+template <typename T>
+void append_tp_column(std::vector<T>& column, const std::vector<T>* values, size_t n) {
+    const size_t n_values = values ? std::min(n, values->size()) : 0;
+    if (n_values > 0) column.insert(column.end(), values->begin(), values->begin() + n_values);
+    column.resize(column.size() + (n - n_values), T(0));
+}
+
+}
+
+bool read_cluster_columns(const std::string& root_filename, const std::string& view, uint32_t columns,
+                          ClusterColumns& out, const std::string& directory) {
+    out.clear();
+    out.columns = columns | cluster_columns::event;
+
+    std::unique_ptr<TFile> f(TFile::Open(root_filename.c_str()));
     if (!f || f->IsZombie()) {
         LogError << "Cannot open file: " << root_filename << std::endl;
-        return clusters;
+        return false;
     }
-    
-    // Find specified directory
     TDirectory* clusters_dir = dynamic_cast<TDirectory*>(f->Get(directory.c_str()));
     if (!clusters_dir) {
         LogWarning << "No '" << directory << "' directory found, trying file root" << std::endl;
-        clusters_dir = f;
+        clusters_dir = f.get();
     }
-    
-    // Look for specific tree by view name
     std::string tree_name = "clusters_tree_" + view;
     TTree* tree = dynamic_cast<TTree*>(clusters_dir->Get(tree_name.c_str()));
     if (!tree) {
         LogError << "  Tree " << tree_name << " not found in file" << std::endl;
-        f->Close();
-        delete f;
-        return clusters;
+        return false;
     }
-    
     if (verboseMode) LogInfo << "  Found tree: " << tree->GetName() << " with " << tree->GetEntries() << " entries" << std::endl;
-    
-    // Set up branch addresses for CURRENT schema (as written by write_clusters)
+
     Int_t event = 0;
     Int_t n_tps = 0;
+    Int_t cluster_id = -1;
+    Bool_t is_main_cluster = false;
     Float_t true_pos_x = 0, true_pos_y = 0, true_pos_z = 0;
-    Float_t true_neutrino_mom_x = 0, true_neutrino_mom_y = 0, true_neutrino_mom_z = 0;
     Float_t true_mom_x = 0, true_mom_y = 0, true_mom_z = 0;
-    Float_t true_neutrino_energy = 0;
-    Float_t true_particle_energy = 0;
-    Float_t marley_tp_fraction = 0;
+    Float_t true_neutrino_mom_x = 0, true_neutrino_mom_y = 0, true_neutrino_mom_z = 0;
+    Float_t true_neutrino_energy = 0, true_particle_energy = 0;
     std::string* true_label = nullptr;
-    Bool_t is_main_cluster = false;
-    Bool_t is_es_interaction = false;
     Int_t true_pdg = 0;
-    Int_t cluster_id = -1;
-    std::vector<int>* tp_channel = nullptr;
-    std::vector<int>* tp_detector = nullptr;
+    Bool_t is_es_interaction = false;
+    Float_t marley_tp_fraction = 0, generator_tp_fraction = 0;
+    Double_t total_charge = 0, total_energy = 0;
     std::vector<int>* tp_time_start = nullptr;
     std::vector<int>* tp_s_over = nullptr;
-    std::vector<int>* tp_samples_to_peak = nullptr;
-    std::vector<int>* tp_adc_peak = nullptr;
+    std::vector<int>* tp_detector = nullptr;
+    std::vector<int>* tp_channel = nullptr;
     std::vector<int>* tp_adc_integral = nullptr;
+    std::vector<int>* tp_adc_peak = nullptr;
+    std::vector<int>* tp_samples_to_peak = nullptr;
     std::vector<double>* tp_simide_energy = nullptr;
-    
-    if (tree->GetBranch("event")) tree->SetBranchAddress("event", &event);
-    if (tree->GetBranch("n_tps")) tree->SetBranchAddress("n_tps", &n_tps);
-    if (tree->GetBranch("true_pos_x")) tree->SetBranchAddress("true_pos_x", &true_pos_x);
-    if (tree->GetBranch("true_pos_y")) tree->SetBranchAddress("true_pos_y", &true_pos_y);
-    if (tree->GetBranch("true_pos_z")) tree->SetBranchAddress("true_pos_z", &true_pos_z);
-    if (tree->GetBranch("true_neutrino_mom_x")) tree->SetBranchAddress("true_neutrino_mom_x", &true_neutrino_mom_x);
-    if (tree->GetBranch("true_neutrino_mom_y")) tree->SetBranchAddress("true_neutrino_mom_y", &true_neutrino_mom_y);
-    if (tree->GetBranch("true_neutrino_mom_z")) tree->SetBranchAddress("true_neutrino_mom_z", &true_neutrino_mom_z);
-    if (tree->GetBranch("true_mom_x")) tree->SetBranchAddress("true_mom_x", &true_mom_x);
-    if (tree->GetBranch("true_mom_y")) tree->SetBranchAddress("true_mom_y", &true_mom_y);
-    if (tree->GetBranch("true_mom_z")) tree->SetBranchAddress("true_mom_z", &true_mom_z);
-    if (tree->GetBranch("true_neutrino_energy")) tree->SetBranchAddress("true_neutrino_energy", &true_neutrino_energy);
-    if (tree->GetBranch("true_particle_energy")) tree->SetBranchAddress("true_particle_energy", &true_particle_energy);
-    if (tree->GetBranch("marley_tp_fraction")) tree->SetBranchAddress("marley_tp_fraction", &marley_tp_fraction);
-    if (tree->GetBranch("true_label")) tree->SetBranchAddress("true_label", &true_label);
-    if (tree->GetBranch("is_main_cluster")) tree->SetBranchAddress("is_main_cluster", &is_main_cluster);
-    if (tree->GetBranch("is_es_interaction")) tree->SetBranchAddress("is_es_interaction", &is_es_interaction);
-    if (tree->GetBranch("true_pdg")) tree->SetBranchAddress("true_pdg", &true_pdg);
-    if (tree->GetBranch("cluster_id")) tree->SetBranchAddress("cluster_id", &cluster_id);
-    if (tree->GetBranch("tp_detector")) tree->SetBranchAddress("tp_detector", &tp_detector);
-    if (tree->GetBranch("tp_detector_channel")) tree->SetBranchAddress("tp_detector_channel", &tp_channel);
-    if (tree->GetBranch("tp_time_start")) tree->SetBranchAddress("tp_time_start", &tp_time_start);
-    if (tree->GetBranch("tp_samples_over_threshold")) tree->SetBranchAddress("tp_samples_over_threshold", &tp_s_over);
-    if (tree->GetBranch("tp_samples_to_peak")) tree->SetBranchAddress("tp_samples_to_peak", &tp_samples_to_peak);
-    if (tree->GetBranch("tp_adc_peak")) tree->SetBranchAddress("tp_adc_peak", &tp_adc_peak);
-    if (tree->GetBranch("tp_adc_integral")) tree->SetBranchAddress("tp_adc_integral", &tp_adc_integral);
-    if (tree->GetBranch("tp_simide_energy")) tree->SetBranchAddress("tp_simide_energy", &tp_simide_energy);
-    
-    // Read all entries
-    for (Long64_t i = 0; i < tree->GetEntries(); i++) {
+
+    bool has_true_label = false;
+
+    // Only the branches of the requested groups are read from disk, and only those fill the cache
+    tree->SetBranchStatus("*", 0);
+    tree->SetCacheSize(32 * 1024 * 1024);
+    bind_column(tree, "event", &event);
+    bind_column(tree, "n_tps", &n_tps);
+    if (out.has(cluster_columns::id)) {
+        bind_column(tree, "cluster_id", &cluster_id);
+        bind_column(tree, "is_main_cluster", &is_main_cluster);
+    }
+    if (out.has(cluster_columns::true_pos)) {
+        bind_column(tree, "true_pos_x", &true_pos_x);
+        bind_column(tree, "true_pos_y", &true_pos_y);
+        bind_column(tree, "true_pos_z", &true_pos_z);
+    }
+    if (out.has(cluster_columns::truth)) {
+        bind_column(tree, "true_mom_x", &true_mom_x);
+        bind_column(tree, "true_mom_y", &true_mom_y);
+        bind_column(tree, "true_mom_z", &true_mom_z);
+        bind_column(tree, "true_neutrino_mom_x", &true_neutrino_mom_x);
+        bind_column(tree, "true_neutrino_mom_y", &true_neutrino_mom_y);
+        bind_column(tree, "true_neutrino_mom_z", &true_neutrino_mom_z);
+        bind_column(tree, "true_neutrino_energy", &true_neutrino_energy);
+        bind_column(tree, "true_particle_energy", &true_particle_energy);
+        has_true_label = bind_column(tree, "true_label", &true_label);
+        bind_column(tree, "true_pdg", &true_pdg);
+        bind_column(tree, "is_es_interaction", &is_es_interaction);
+        bind_column(tree, "marley_tp_fraction", &marley_tp_fraction);
+        bind_column(tree, "generator_tp_fraction", &generator_tp_fraction);
+    }
+    if (out.has(cluster_columns::charge)) {
+        bind_column(tree, "total_charge", &total_charge);
+        bind_column(tree, "total_energy", &total_energy);
+    }
+    if (out.has(cluster_columns::tp_time)) {
+        bind_column(tree, "tp_time_start", &tp_time_start);
+        bind_column(tree, "tp_samples_over_threshold", &tp_s_over);
+    }
+    if (out.has(cluster_columns::tp_channel)) {
+        bind_column(tree, "tp_detector", &tp_detector);
+        bind_column(tree, "tp_detector_channel", &tp_channel);
+    }
+    if (out.has(cluster_columns::tp_adc)) {
+        bind_column(tree, "tp_adc_integral", &tp_adc_integral);
+        bind_column(tree, "tp_adc_peak", &tp_adc_peak);
+        bind_column(tree, "tp_samples_to_peak", &tp_samples_to_peak);
+    }
+    if (out.has(cluster_columns::tp_simide)) {
+        bind_column(tree, "tp_simide_energy", &tp_simide_energy);
+    }
+    tree->StopCacheLearningPhase();
+
+    // The number of TPs of an entry comes from the first TP branch read, or from n_tps
+    const std::vector<int>* tp_counter = tp_channel ? tp_channel : tp_time_start ? tp_time_start : tp_adc_integral;
+
+    const Long64_t n_entries = tree->GetEntries();
+    out.event.reserve(n_entries);
+    out.n_tps.reserve(n_entries);
+    for (Long64_t i = 0; i < n_entries; i++) {
         tree->GetEntry(i);
-        
-        if (!tp_channel || tp_channel->empty()) {
+
+        size_t n = 0;
+        if (tp_counter) n = tp_counter->size();
+        else if (tp_simide_energy) n = tp_simide_energy->size();
+        else n = n_tps > 0 ? n_tps : 0;
+        if (n == 0) {
             if (debugMode) LogDebug << "    Skipping entry " << i << " (no TPs)" << std::endl;
             continue;
         }
-        
-        if (verboseMode) LogInfo << "    Entry " << i << ": " << tp_channel->size() << " TPs, event " << event << ", cluster_id " << cluster_id << std::endl;
-        
-        // Create TriggerPrimitives from the vectors
-        std::vector<TriggerPrimitive*> tps;
-        for (size_t j = 0; j < tp_channel->size(); j++) {
-            int channel = (*tp_channel)[j];
-            int detector = (*tp_detector)[j];
-            int time_start = (*tp_time_start)[j];
-            int s_over_threshold = (*tp_s_over)[j];
-            int samples_to_peak = 0;
-            if (tp_samples_to_peak && j < tp_samples_to_peak->size()) {
-                samples_to_peak = (*tp_samples_to_peak)[j];
-            }
-            int adc_peak = (tp_adc_peak && j < tp_adc_peak->size()) ? (*tp_adc_peak)[j] : 0;
-            int adc_integral = (*tp_adc_integral)[j];
-            double simide_energy = 0.0;
-            if (tp_simide_energy && j < tp_simide_energy->size()) {
-                simide_energy = (*tp_simide_energy)[j];
-            }
 
-            if (debugMode) {
-                LogDebug << "      TP " << j
-                         << " channel=" << channel
-                         << " detector=" << detector
-                         << " time_start=" << time_start
-                         << " sot=" << s_over_threshold
-                         << " samples_to_peak=" << samples_to_peak
-                         << " adc_peak=" << adc_peak
-                         << " adc_integral=" << adc_integral
-                         << " simide_energy=" << simide_energy
-                         << std::endl;
-            }
-            
+        out.event.push_back(event);
+        out.n_tps.push_back(static_cast<int>(n));
+        if (out.has(cluster_columns::id)) {
+            out.cluster_id.push_back(cluster_id);
+            out.is_main_cluster.push_back(is_main_cluster);
+        }
+        if (out.has(cluster_columns::true_pos)) {
+            out.true_pos_x.push_back(true_pos_x);
+            out.true_pos_y.push_back(true_pos_y);
+            out.true_pos_z.push_back(true_pos_z);
+        }
+        if (out.has(cluster_columns::truth)) {
+            out.true_mom_x.push_back(true_mom_x);
+            out.true_mom_y.push_back(true_mom_y);
+            out.true_mom_z.push_back(true_mom_z);
+            out.true_neutrino_mom_x.push_back(true_neutrino_mom_x);
+            out.true_neutrino_mom_y.push_back(true_neutrino_mom_y);
+            out.true_neutrino_mom_z.push_back(true_neutrino_mom_z);
+            out.true_neutrino_energy.push_back(true_neutrino_energy);
+            out.true_particle_energy.push_back(true_particle_energy);
+            if (has_true_label) out.true_label.push_back(true_label ? *true_label : std::string());
+            out.true_pdg.push_back(true_pdg);
+            out.is_es_interaction.push_back(is_es_interaction);
+            out.marley_tp_fraction.push_back(marley_tp_fraction);
+            out.generator_tp_fraction.push_back(generator_tp_fraction);
+        }
+        if (out.has(cluster_columns::charge)) {
+            out.total_charge.push_back(total_charge);
+            out.total_energy.push_back(total_energy);
+        }
+        if (out.has(cluster_columns::tp_time)) {
+            append_tp_column(out.tp_time_start, tp_time_start, n);
+            append_tp_column(out.tp_samples_over_threshold, tp_s_over, n);
+        }
+        if (out.has(cluster_columns::tp_channel)) {
+            append_tp_column(out.tp_detector, tp_detector, n);
+            append_tp_column(out.tp_detector_channel, tp_channel, n);
+        }
+        if (out.has(cluster_columns::tp_adc)) {
+            append_tp_column(out.tp_adc_integral, tp_adc_integral, n);
+            append_tp_column(out.tp_adc_peak, tp_adc_peak, n);
+            append_tp_column(out.tp_samples_to_peak, tp_samples_to_peak, n);
+        }
+        if (out.has(cluster_columns::tp_simide)) {
+            append_tp_column(out.tp_simide_energy, tp_simide_energy, n);
+        }
+        out.tp_begin.push_back(out.tp_begin.back() + static_cast<uint32_t>(n));
+    }
+
+    // Objects allocated by ROOT for the pointer branches are ours to delete
+    tree->ResetBranchAddresses();
+    delete true_label;
+    delete tp_time_start;
+    delete tp_s_over;
+    delete tp_detector;
+    delete tp_channel;
+    delete tp_adc_integral;
+    delete tp_adc_peak;
+    delete tp_samples_to_peak;
+    delete tp_simide_energy;
+    f->Close();
+    return true;
+}
+
+void read_only_bound_branches(TTree* tree) {
+    if (!tree) return;
+    TIter next_branch(tree->GetListOfBranches());
+    while (TBranch* branch = (TBranch*)next_branch()) {
+        if (branch->GetAddress() == nullptr) tree->SetBranchStatus(branch->GetName(), 0);
+    }
+}
+
+bool read_time_sorted_flag(TFile* file, const std::string& metadata_tree) {
+    if (!file) return false;
+    TTree* tree = dynamic_cast<TTree*>(file->Get(metadata_tree.c_str()));
+    if (!tree || !tree->GetBranch("time_sorted") || tree->GetEntries() == 0) return false;
+    int time_sorted = 0;
+    tree->SetBranchAddress("time_sorted", &time_sorted);
+    read_only_bound_branches(tree);
+    tree->GetEntry(0);
+    tree->ResetBranchAddresses();
+    return time_sorted != 0;
+}
+
+ClusterSet read_clusters_from_tree(std::string root_filename, std::string view, std::string directory, uint32_t columns){
+    LogInfo << "Reading " << view << " clusters from: " << root_filename << " (directory: " << directory << ")" << std::endl;
+    ClusterSet clusters;
+    ClusterColumns cols;
+    if (!read_cluster_columns(root_filename, view, columns, cols, directory)) return clusters;
+
+    // Set view from parameter
+    int view_channel = -1;
+    if (view == "X") {
+        view_channel = 0; // Collection
+    } else if (view == "U") {
+        view_channel = 1; // Induction U
+    } else if (view == "V") {
+        view_channel = 2; // Induction V
+    }
+
+    // Columns that were not read give the value of a missing branch
+    auto value = [](const auto& column, size_t i, auto fallback) {
+        return column.empty() ? fallback : column[i];
+    };
+
+    clusters.reserve(cols.size());
+    clusters.reserve_tps(cols.get_n_tps());
+    for (size_t i = 0; i < cols.size(); i++) {
+        const int event = cols.event[i];
+        std::vector<TriggerPrimitive*> tps;
+        tps.reserve(cols.n_tps[i]);
+        for (size_t j = cols.tp_begin[i]; j < cols.tp_begin[i + 1]; j++) {
             // Create TP - Note: event number set via SetEvent() after construction
             // because TriggerPrimitive constructor doesn't take event as parameter
-            TriggerPrimitive* tp = new TriggerPrimitive(0, 0, 0, channel, s_over_threshold, time_start, samples_to_peak, adc_integral, adc_peak);
-            
-            // Set simide energy
-            tp->SetSimideEnergy(simide_energy);
-            
+            TriggerPrimitive tp(0, 0, 0, value(cols.tp_detector_channel, j, 0), value(cols.tp_samples_over_threshold, j, 0),
+                                value(cols.tp_time_start, j, 0), value(cols.tp_samples_to_peak, j, 0),
+                                value(cols.tp_adc_integral, j, 0), value(cols.tp_adc_peak, j, 0));
+            tp.SetSimideEnergy(value(cols.tp_simide_energy, j, 0.0));
             // IMPORTANT: Set event BEFORE adding to vector to avoid Cluster constructor check failures
-            tp->SetEvent(event);
+            tp.SetEvent(event);
+            tp.SetDetector(value(cols.tp_detector, j, 0));
+            if (view_channel >= 0) tp.SetView(view_channel);
 
-            tp->SetDetector(detector);
-            
-            // Set view from parameter
-            if (view == "X") {
-                tp->SetView(0); // Collection
-            } else if (view == "U") {
-                tp->SetView(1); // Induction U
-            } else if (view == "V") {
-                tp->SetView(2); // Induction V
-            }
-            
-            tps.push_back(tp);
+            tps.push_back(clusters.add_tp(tp));
         }
-        
-        if (verboseMode) LogInfo << "    Creating cluster from " << tps.size() << " TPs..." << std::endl;
-        
+
         // Create cluster
         Cluster cluster(tps);
-        cluster.set_is_main_cluster(is_main_cluster);
-        cluster.set_cluster_id(cluster_id);
-        cluster.set_supernova_tp_fraction(marley_tp_fraction);
-        cluster.set_is_es_interaction(is_es_interaction);
-        cluster.set_true_neutrino_energy(true_neutrino_energy);
-        cluster.set_true_particle_energy(true_particle_energy);
-        cluster.set_true_pos({true_pos_x, true_pos_y, true_pos_z});
-        cluster.set_true_neutrino_momentum({true_neutrino_mom_x, true_neutrino_mom_y, true_neutrino_mom_z});
-        cluster.set_true_momentum({true_mom_x, true_mom_y, true_mom_z});
-        if (true_label) cluster.set_true_label(*true_label);
-        cluster.set_true_pdg(true_pdg);
-        
-        clusters.push_back(cluster);
+        cluster.set_is_main_cluster(value(cols.is_main_cluster, i, char(0)));
+        cluster.set_cluster_id(value(cols.cluster_id, i, -1));
+        cluster.set_supernova_tp_fraction(value(cols.marley_tp_fraction, i, 0.0f));
+        cluster.set_is_es_interaction(value(cols.is_es_interaction, i, char(0)));
+        cluster.set_true_neutrino_energy(value(cols.true_neutrino_energy, i, 0.0f));
+        cluster.set_true_particle_energy(value(cols.true_particle_energy, i, 0.0f));
+        cluster.set_true_pos({value(cols.true_pos_x, i, 0.0f), value(cols.true_pos_y, i, 0.0f), value(cols.true_pos_z, i, 0.0f)});
+        cluster.set_true_neutrino_momentum({value(cols.true_neutrino_mom_x, i, 0.0f), value(cols.true_neutrino_mom_y, i, 0.0f), value(cols.true_neutrino_mom_z, i, 0.0f)});
+        cluster.set_true_momentum({value(cols.true_mom_x, i, 0.0f), value(cols.true_mom_y, i, 0.0f), value(cols.true_mom_z, i, 0.0f)});
+        if (!cols.true_label.empty()) cluster.set_true_label(cols.true_label[i]);
+        cluster.set_true_pdg(value(cols.true_pdg, i, 0));
+
+        clusters.add_cluster(std::move(cluster));
     }
-    
-    f->Close();
-    delete f;
-    
+
     LogInfo << "  Loaded " << clusters.size() << " " << view << " clusters" << std::endl;
     return clusters;
 }
@@ -2,13 +2,19 @@
 #ifndef cluster_TO_ROOT_LIBS_H
 #define cluster_TO_ROOT_LIBS_H
 
-#include "Cluster.h"
+#include "ClusterSet.h"
+#include "TPStore.h"
+#include "TPBinary.h"
 #include "Functions.h"
 
 // create the clusters from the tps
 bool channel_condition_with_pbc(TriggerPrimitive* tp1, TriggerPrimitive* tp2, int channel_limit);
 std::vector<Cluster> make_cluster(const std::vector<TriggerPrimitive*>& all_tps, int ticks_limit=3, int channel_limit=1, int min_tps_to_cluster=1, int adc_integral_cut=0);
 
+// cluster several independent groups of tps (e.g. one per event and view) on n_threads threads.
+// Each group is split per APA, and the clusters of a group come out in the same order as make_cluster on the whole group
+std::vector<std::vector<Cluster>> make_clusters_parallel(const std::vector<std::vector<TriggerPrimitive*>>& tps_groups, int ticks_limit, int channel_limit, int min_tps_to_cluster, const std::vector<int>& adc_integral_cuts, int n_threads=1);
+
 // create a map connectig the file index to the true x y z
 // std::map<int, std::vector<float>> file_idx_to_true_xyz(std::vector<std::string> filenames);
 
@@ -23,28 +29,276 @@ std::vector<Cluster> filter_out_main_track(std::vector<Cluster>& clusters);
 // assing a different label to the main tracks
 // void assing_different_label_to_main_tracks(std::vector<Cluster>& clusters, int new_label=77);
 
-// write the clusters to a root file
-void write_clusters(std::vector<Cluster>& clusters, TFile* clusters_file, std::string view);
+// Clusters tree of one view in one directory (clusters_tree_<view>), with its branches bound once.
+// Fill it with the clusters of every event and close it once: the tree is written as a single cycle.
+// An existing tree of the current schema in the directory is extended (and keeps its basket layout).
+// The directory must stay open until close(), which the destructor calls if needed
+class ClusterTreeWriter {
+    public:
+        ClusterTreeWriter(TDirectory* dir, const std::string& view, const RootOutputSettings& output_settings = RootOutputSettings());
+        ~ClusterTreeWriter();
+        ClusterTreeWriter(const ClusterTreeWriter&) = delete;
+        ClusterTreeWriter& operator=(const ClusterTreeWriter&) = delete;
+
+        bool is_open() const { return tree_ != nullptr; }
+        void fill(Cluster& cluster);
+        void fill(std::vector<Cluster>& clusters);
+        Long64_t get_entries() const;
+        // Whether the clusters were filled in (event, earliest TP time start) order, the order make_clusters
+        // produces; always false when an existing tree was extended, whose order is not known
+        bool is_time_sorted() const { return time_sorted_; }
+        // Writes the tree in its directory, which keeps owning it
+        void close();
+
+    private:
+        void bind_existing_tree();
+
+        TDirectory* dir_ = nullptr;
+        TTree* tree_ = nullptr;
+        bool time_sorted_ = true;
+        bool has_last_ = false;
+        int last_event_ = 0;
+        double last_time_start_ = 0.0;
+
+        int event_ = 0;
+        int n_tps_ = 0;
+        float true_pos_x_ = 0.0f, true_pos_y_ = 0.0f, true_pos_z_ = 0.0f;
+        float true_neutrino_mom_x_ = 0.0f, true_neutrino_mom_y_ = 0.0f, true_neutrino_mom_z_ = 0.0f;
+        float true_mom_x_ = 0.0f, true_mom_y_ = 0.0f, true_mom_z_ = 0.0f;
+        float true_neutrino_energy_ = 0.0f;
+        float true_particle_energy_ = 0.0f;
+        std::string true_label_;
+        float supernova_tp_fraction_ = 0.0f;
+        float generator_tp_fraction_ = 0.0f;
+        float marley_tp_fraction_ = 0.0f;
+        bool is_es_interaction_ = false;
+        double total_charge_ = 0.0;
+        double total_energy_ = 0.0;
+        int true_pdg_ = 0;
+        bool is_main_cluster_ = false;
+        int cluster_id_ = -1;
+
+        // TP information, cleared and refilled for every cluster
+        std::vector<int> tp_detector_channel_;
+        std::vector<int> tp_detector_;
+        std::vector<int> tp_samples_over_threshold_;
+        std::vector<int> tp_time_start_;
+        std::vector<int> tp_samples_to_peak_;
+        std::vector<int> tp_adc_peak_;
+        std::vector<int> tp_adc_integral_;
+        std::vector<double> tp_simide_energy_;
+};
+
+// write the clusters to a root file, in the current directory (one ClusterTreeWriter per call)
+void write_clusters(std::vector<Cluster>& clusters, TFile* clusters_file, std::string view,
+                    const RootOutputSettings& output_settings = RootOutputSettings());
 
 // write the clusters to a root file with match_id information
-// For X plane, also provide maps to store matching U and V cluster IDs
+// For X plane, also provide maps to store matching U and V cluster IDs.
+// match_scores, indexed by match_id, fills the match_score branch (-1 for unmatched clusters or without scores)
 void write_clusters_with_match_id(std::vector<Cluster>& clusters, std::map<int, int>& cluster_to_match, TFile* clusters_file, std::string view,
-                                   std::map<int, int>* x_to_u_map = nullptr, std::map<int, int>* x_to_v_map = nullptr);
+                                   std::map<int, int>* x_to_u_map = nullptr, std::map<int, int>* x_to_v_map = nullptr,
+                                   const RootOutputSettings& output_settings = RootOutputSettings(),
+                                   const std::vector<float>* match_scores = nullptr);
 
-std::vector<Cluster> read_clusters(std::string root_filename);
-std::vector<Cluster> read_clusters_from_tree(std::string root_filename, std::string view, std::string directory = "clusters");
+// Groups of branches of a clusters tree. The readers below only enable (and read from disk)
+// the groups they are given; event and n_tps are always read
+namespace cluster_columns {
+    constexpr uint32_t event      = 1u << 0; // event, n_tps
+    constexpr uint32_t id         = 1u << 1; // cluster_id, is_main_cluster
+    constexpr uint32_t true_pos   = 1u << 2; // true_pos_x/y/z
+    constexpr uint32_t truth      = 1u << 3; // true momenta and energies, true_label, true_pdg, is_es_interaction, tp fractions
+    constexpr uint32_t charge     = 1u << 4; // total_charge, total_energy
+    constexpr uint32_t tp_time    = 1u << 5; // tp_time_start, tp_samples_over_threshold
+    constexpr uint32_t tp_channel = 1u << 6; // tp_detector, tp_detector_channel
+    constexpr uint32_t tp_adc     = 1u << 7; // tp_adc_integral, tp_adc_peak, tp_samples_to_peak
+    constexpr uint32_t tp_simide  = 1u << 8; // tp_simide_energy
+    constexpr uint32_t all        = (1u << 9) - 1;
+}
+
+// Flat columns of a clusters tree: one value per cluster, and the TPs of all the clusters back to back,
+// the TPs of cluster i being [tp_begin[i], tp_begin[i+1]). Entries without TPs are skipped.
+// The columns of the groups that were not read are empty; a missing branch reads as 0,
+// except true_label which stays empty
+struct ClusterColumns {
+    uint32_t columns = 0;
+    std::vector<int> event;
+    std::vector<int> n_tps;
+    // id
+    std::vector<int> cluster_id;
+    std::vector<char> is_main_cluster;
+    // true_pos
+    std::vector<float> true_pos_x, true_pos_y, true_pos_z;
+    // truth
+    std::vector<float> true_mom_x, true_mom_y, true_mom_z;
+    std::vector<float> true_neutrino_mom_x, true_neutrino_mom_y, true_neutrino_mom_z;
+    std::vector<float> true_neutrino_energy, true_particle_energy;
+    std::vector<std::string> true_label;
+    std::vector<int> true_pdg;
+    std::vector<char> is_es_interaction;
+    std::vector<float> marley_tp_fraction, generator_tp_fraction;
+    // charge
+    std::vector<double> total_charge, total_energy;
+    // TPs
+    std::vector<uint32_t> tp_begin {0};
+    std::vector<int> tp_time_start, tp_samples_over_threshold;
+    std::vector<int> tp_detector, tp_detector_channel;
+    std::vector<int> tp_adc_integral, tp_adc_peak, tp_samples_to_peak;
+    std::vector<double> tp_simide_energy;
+
+    size_t size() const { return event.size(); }
+    size_t get_n_tps() const { return tp_begin.back(); }
+    bool has(uint32_t group) const { return (columns & group) == group; }
+    void clear() { *this = ClusterColumns(); }
+};
+
+// read the given column groups of clusters_tree_<view>; returns false if the file or tree cannot be opened
+bool read_cluster_columns(const std::string& root_filename, const std::string& view, uint32_t columns,
+                          ClusterColumns& out, const std::string& directory = "clusters");
+
+// Disables the branches of a tree that have no address set, so GetEntry only reads the bound ones
+void read_only_bound_branches(TTree* tree);
+
+// time_sorted flag of a metadata tree (backtracking_metadata, clustering_metadata) of an open file.
+// false if the tree or the flag is missing (files written before it): the reader must then sort
+bool read_time_sorted_flag(TFile* file, const std::string& metadata_tree);
+
+// read the clusters of a file; their TPs are owned by the returned set and freed with it
+ClusterSet read_clusters(std::string root_filename);
+// the fields of the groups not in columns keep the defaults of a missing branch
+ClusterSet read_clusters_from_tree(std::string root_filename, std::string view, std::string directory = "clusters",
+                                   uint32_t columns = cluster_columns::all);
 
 std::map<int, std::vector<Cluster>> create_event_mapping(std::vector<Cluster>& clusters);
 
 std::map<int, std::vector<TriggerPrimitive>> create_background_event_mapping(std::vector<TriggerPrimitive>& bkg_tps);
 
-// Read condensed TPs and truth back from a ROOT file
+// Reads the tps tree of a file one event at a time, into a buffer reused from event to event,
+// so that memory is bounded by the largest event instead of the file.
+// The TPs of an event are contiguous in the tree (as written by TpsWriter): events come out in file
+// order, and an event number that shows up again further down is returned again as a separate block.
+// A binary TP file (*.tpb, see TPBinary.h) is read through its event table instead of a tree
+class TpsReader {
+    public:
+        explicit TpsReader(const std::string& in_filename);
+        ~TpsReader();
+        TpsReader(const TpsReader&) = delete;
+        TpsReader& operator=(const TpsReader&) = delete;
+
+        bool is_open() const { return tree_ != nullptr || binary_ != nullptr; }
+        // Loads the TPs of the next event, false once the tree is exhausted
+        bool next();
+        int get_event() const { return current_event_; }
+        // TPs of the current event; the caller may modify or swap the buffer, it is cleared by next()
+        std::vector<TriggerPrimitive>& get_tps() { return tps_; }
+        Long64_t get_n_entries() const { return n_entries_; }
+        // Whether the TPs of the current event are known to be in time start order, from the time_sorted
+        // flag of the file (per event for a *.tpb file): if so, they need no sorting nor checking
+        bool is_time_sorted() const { return time_sorted_; }
+        void close();
+
+    private:
+        TriggerPrimitive make_tp() const;
+
+        TFile* file_ = nullptr;
+        TTree* tree_ = nullptr;
+        Long64_t n_entries_ = 0;
+        Long64_t next_entry_ = 0;
+        Long64_t loaded_entry_ = -1; // entry currently in the branch buffers
+        int current_event_ = -1;
+        bool time_sorted_ = false;
+        std::vector<TriggerPrimitive> tps_;
+
+        // Binary TP file: the entries are its events
+        std::unique_ptr<TPBinaryReader> binary_;
+        TPStore binary_event_;
+
+        // TP basic variables
+        int event_ = 0;
+        UShort_t version_ = 0;
+        UInt_t detid_ = 0, channel_ = 0;
+        ULong64_t s_over_ = 0, tstart_ = 0, s_to_peak_ = 0;
+        UInt_t adc_integral_ = 0;
+        UShort_t adc_peak_ = 0, det_ = 0;
+        Int_t det_channel_ = 0;
+        std::string* view_ = nullptr;
+        Double_t simide_energy_ = 0.0;
+
+        // Truth variables
+        std::string* gen_name_ = nullptr;
+        Int_t particle_pdg_ = 0;
+        std::string* particle_process_ = nullptr;
+        Float_t particle_energy_ = 0.0f;
+        Float_t particle_x_ = 0.0f, particle_y_ = 0.0f, particle_z_ = 0.0f;
+        Float_t particle_px_ = 0.0f, particle_py_ = 0.0f, particle_pz_ = 0.0f;
+        std::string* neutrino_interaction_ = nullptr;
+        Float_t neutrino_x_ = 0.0f, neutrino_y_ = 0.0f, neutrino_z_ = 0.0f;
+        Float_t neutrino_px_ = 0.0f, neutrino_py_ = 0.0f, neutrino_pz_ = 0.0f;
+        Float_t neutrino_energy_ = 0.0f;
+};
+
+// Reads the TPs of a file in chunks of rows straight into the columns of a TPStore, for the apps that
+// route or count TPs without building TriggerPrimitives. A chunk of the tps tree is read one branch at a
+// time (each basket is decompressed once for the whole chunk, through a TTreeCache); a *.tpb chunk is
+// made of whole events, copied column by column. Chunks follow the file order, events may span two chunks.
+// Raw TriggerPrimitive trees (tpstream files) are read as well, their detector and detector_channel
+// computed from the channel as in the TriggerPrimitive constructor
+class TpsColumnReader {
+    public:
+        static constexpr size_t default_chunk_size = 65536;
+
+        explicit TpsColumnReader(const std::string& in_filename, size_t chunk_size = default_chunk_size);
+        ~TpsColumnReader();
+        TpsColumnReader(const TpsColumnReader&) = delete;
+        TpsColumnReader& operator=(const TpsColumnReader&) = delete;
+
+        bool is_open() const { return tree_ != nullptr || binary_ != nullptr; }
+        // Appends the next chunk to the store, false once the file is exhausted
+        bool read_chunk(TPStore& store);
+        // TPs in the file
+        Long64_t get_n_tps() const;
+        void close();
+
+    private:
+        void read_tree_chunk(TPStore& store);
+
+        size_t chunk_size_;
+        TFile* file_ = nullptr;
+        TTree* tree_ = nullptr;
+        Long64_t n_entries_ = 0;
+        Long64_t next_entry_ = 0;
+        bool has_detector_ = true;         // false for raw TriggerPrimitive trees, see read_tree_chunk
+        bool has_detector_channel_ = true;
+        std::unique_ptr<TPBinaryReader> binary_; // the entries are its events
+
+        // Rows and truths of the chunk being read, filled branch by branch
+        std::vector<TPRow> rows_;
+        std::vector<TPTruth> truths_;
+
+        // Branch buffers
+        int event_ = 0;
+        UInt_t channel_ = 0;
+        ULong64_t s_over_ = 0, tstart_ = 0, s_to_peak_ = 0;
+        UInt_t adc_integral_ = 0;
+        UShort_t adc_peak_ = 0, det_ = 0;
+        Int_t det_channel_ = 0;
+        Double_t simide_energy_ = 0.0;
+        std::string* gen_name_ = nullptr;
+        std::string* particle_process_ = nullptr;
+        std::string* neutrino_interaction_ = nullptr;
+        TPTruth truth_;
+};
+
+// Read condensed TPs and truth back from a ROOT file (the whole file at once, see TpsReader)
 void read_tps(
 	const std::string& in_filename,
 	std::map<int, std::vector<TriggerPrimitive>>& tps_by_event,
 	std::map<int, std::vector<TrueParticle>>& true_particles_by_event,
 	std::map<int, std::vector<Neutrino>>& neutrinos_by_event);
 
+// Read condensed TPs into the columns of a TPStore, appending to it (a *.tpb file is copied column by column)
+void read_tps(const std::string& in_filename, TPStore& store);
+
 
 #endif
 
@@ -1,72 +1,77 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <climits>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
 #include "MatchClusters.h"
 #include "Cluster.h"
 #include "Geometry.h"
 #include "Utils.h"
 // #include "PositionCalculator.h"
 
-// Helper function to calculate average Z position from X plane TPs
-// Based on calculate_position() logic from Backtracking.cpp
-float calculate_z_from_x_plane(std::vector<TriggerPrimitive*> tps) {
-    if (tps.empty()) return 0.0;
-    
-    float z_sum = 0.0;
-    int count = 0;
-    
+// Range of y covered by the wires of an induction cluster for z in [z_min, z_max], seen from the side of x_sign
+static std::pair<float, float> induction_y_range(const std::vector<TriggerPrimitive*>& tps, const WireGeometry& geometry,
+                                                 float z_min, float z_max, float x_sign) {
+    std::pair<float, float> range(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
     for (auto* tp : tps) {
-        int channel = tp->GetDetectorChannel();
-        int local_channel = channel % APA::total_channels;
-        
-        // X plane channels are at 1600+ in local coordinates
-        if (local_channel >= APA::induction_channels * 2) {
-            // Z calculation from calculate_position():
-            // z_apa_offset: which APA pair (detector/2) * (APA length + gap)
-            float z_apa_offset = int(tp->GetDetector() / 2) * (apa_lenght_in_cm + offset_between_apa_in_cm);
-            
-            // z_channel_offset: position within half of collection plane
-            // ((channel - 1600) % (collection_channels/2)) * wire_pitch
-            int channel_offset_in_collection = (local_channel - APA::induction_channels * 2) % (APA::collection_channels / 2);
-            float z_channel_offset = channel_offset_in_collection * wire_pitch_in_cm_collection;
-            
-            float z = wire_pitch_in_cm_collection + z_apa_offset + z_channel_offset;
-            z_sum += z;
-            count++;
-        }
+        const InductionWire* wire = geometry.get_wire(tp->GetDetectorChannel(), x_sign);
+        if (!wire) continue;
+        const std::pair<float, float> wire_range = wire->y_range(z_min, z_max);
+        range.first = std::min(range.first, wire_range.first);
+        range.second = std::max(range.second, wire_range.second);
     }
-    
-    return (count > 0) ? z_sum / count : 0.0;
+    return range;
 }
 
-// Helper function to determine X sign from X plane TPs
-// Based on calculate_position() logic: 
-// x_signs = (channel % total_channels < (induction*2 + collection)) ? -1 : +1
-float calculate_x_sign_from_x_plane(std::vector<TriggerPrimitive*> tps) {
-    if (tps.empty()) return 1.0;
-    
-    int channel = tps[0]->GetDetectorChannel();
-    int local_channel = channel % APA::total_channels;
-    
-    // From calculate_position():
-    // x_signs = (channel % APA::total_channels < (induction*2 + collection)) ? -1 : +1
-    int full_range = APA::induction_channels * 2 + APA::collection_channels;
-    float x_sign = (local_channel < full_range) ? -1.0f : 1.0f;
-    
-    return x_sign;
+// z range of the collection wires of the TPs of an X cluster, false if none of them is in the geometry table
+static bool collection_z_range(const std::vector<TriggerPrimitive*>& tps, const WireGeometry& geometry, float& z_min, float& z_max) {
+    z_min = std::numeric_limits<float>::max();
+    z_max = std::numeric_limits<float>::lowest();
+    for (auto* tp : tps) {
+        const float z = geometry.get_collection_z(tp->GetDetectorChannel());
+        if (z < 0) continue;
+        z_min = std::min(z_min, z);
+        z_max = std::max(z_max, z);
+    }
+    return z_min <= z_max;
+}
+
+// Distance in y between the ranges of the U and V wires (from induction_y_range, for x_sign -1 then 1) on the
+// more consistent drift side; 0 if a range is empty, as nothing then rules the crossing out
+static float wire_crossing_gap(const std::pair<float, float> y_u[2], const std::pair<float, float> y_v[2]) {
+    float gap = std::numeric_limits<float>::max();
+    for (int side = 0; side < 2; ++side) {
+        if (y_u[side].first > y_u[side].second || y_v[side].first > y_v[side].second) return 0.0f;
+        gap = std::min(gap, std::max(0.0f, std::max(y_u[side].first - y_v[side].second, y_v[side].first - y_u[side].second)));
+    }
+    return gap;
 }
 
-bool are_compatibles(Cluster& c_u, Cluster& c_v, Cluster& c_x, float radius) {
+bool are_compatibles(const Cluster& c_u, const Cluster& c_v, const Cluster& c_x, float radius, bool check_geometry) {
     // Check if they come from the same detector
     if (!(int(c_u.get_tp(0)->GetDetector()) == int(c_v.get_tp(0)->GetDetector()) && 
             int(c_u.get_tp(0)->GetDetector()) == int(c_x.get_tp(0)->GetDetector())))
         return false;
-
-    // Simplified matching: just check time+event+APA compatibility
-    // Wire crossing geometry check disabled for now to see if it's the bottleneck
     // Time overlap is already checked in the outer loop (match_clusters.cpp)
-    
-    return true;
+    if (!check_geometry) return true;
+
+    // Wire crossing: the z range of the X wires, widened by radius, must cross U and V wires at the
+    // same height within radius. The drift side of a collection face is not fixed by the channel map,
+    // so the triplet is accepted if it is consistent on either side
+    const WireGeometry& geometry = get_wire_geometry();
+    float z_min = 0, z_max = 0;
+    if (!collection_z_range(c_x.get_tps(), geometry, z_min, z_max)) return true;
+
+    std::pair<float, float> y_u[2], y_v[2];
+    for (int side = 0; side < 2; ++side) {
+        const float x_sign = side == 0 ? -1.0f : 1.0f;
+        y_u[side] = induction_y_range(c_u.get_tps(), geometry, z_min - radius, z_max + radius, x_sign);
+        y_v[side] = induction_y_range(c_v.get_tps(), geometry, z_min - radius, z_max + radius, x_sign);
+    }
+    return wire_crossing_gap(y_u, y_v) <= radius;
 }
 
 bool match_with_true_pos(Cluster& c_u, Cluster& c_v, Cluster& c_x, float radius){
@@ -78,14 +83,14 @@ bool match_with_true_pos(Cluster& c_u, Cluster& c_v, Cluster& c_x, float radius)
         return false;
     }
     
-    if (std::abs(std::abs(std::abs(eval_y_knowing_z_U_plane(c_u.get_tps(), true_z, true_x > 0 ? 1 : -1))- std::abs(true_y))) > radius) {
+    if (std::abs(std::abs(std::abs(eval_y_knowing_z(c_u.get_tps(), TPView::U, true_z, true_x > 0 ? 1 : -1))- std::abs(true_y))) > radius) {
         return false;
     }
     // Check V Cluster
     if (std::abs(std::abs(c_v.get_true_pos()[0]) - std::abs(true_x)) > radius) {
         return false;
     }
-    if (std::abs(std::abs(eval_y_knowing_z_V_plane(c_v.get_tps(), true_z, true_x > 0 ? 1 : -1)) - std::abs(true_y)) > radius) {
+    if (std::abs(std::abs(eval_y_knowing_z(c_v.get_tps(), TPView::V, true_z, true_x > 0 ? 1 : -1)) - std::abs(true_y)) > radius) {
         return false;
     }
     // Check X Cluster
@@ -98,63 +103,23 @@ bool match_with_true_pos(Cluster& c_u, Cluster& c_v, Cluster& c_x, float radius)
     return true;
 }
 
-Cluster join_clusters(Cluster c_u, Cluster c_v, Cluster c_x){
+// Cluster of the TPs of the given clusters, all set to the event of the X cluster, with its truth
+static Cluster join_clusters(std::initializer_list<const Cluster*> clusters, const Cluster& x_cluster) {
+    size_t n_tps = 0;
+    for (const Cluster* cluster : clusters) n_tps += cluster->get_tps().size();
     std::vector<TriggerPrimitive*> tps;
-    
-    // Set all TPs to same event (use X cluster's first TP event)
-    int common_event = (c_x.get_size() > 0) ? c_x.get_tps()[0]->GetEvent() : 0;
-    
-    for (int i = 0; i < c_u.get_size(); i++) {
-        TriggerPrimitive* tp = c_u.get_tps()[i];
-        tp->SetEvent(common_event);  // Ensure consistent event
-        tps.push_back(tp);
-    }
-    for (int i = 0; i < c_v.get_size(); i++) {
-        TriggerPrimitive* tp = c_v.get_tps()[i];
-        tp->SetEvent(common_event);  // Ensure consistent event
-        tps.push_back(tp);
-    }
-    for (int i = 0; i < c_x.get_size(); i++) {
-        tps.push_back(c_x.get_tps()[i]);
-    }
-
-    Cluster c(tps);
-    c.set_true_pos(c_x.get_true_pos());
-    c.set_true_dir(c_x.get_true_dir());
-    c.set_true_momentum(c_x.get_true_momentum());
-    c.set_true_energy(c_x.get_true_neutrino_energy());
-    c.set_true_label(c_x.get_true_label());
-    c.set_is_es_interaction(c_x.get_is_es_interaction());
-    c.set_min_distance_from_true_pos(c_x.get_min_distance_from_true_pos());
-    c.set_supernova_tp_fraction(c_x.get_supernova_tp_fraction());
+    tps.reserve(n_tps);
 
-    return c;
-}
-
-// Overload for joining 2 clusters (partial matches)
-Cluster join_clusters(Cluster c1, Cluster c2){
-    std::vector<TriggerPrimitive*> tps;
-    
-    // Determine which is X plane (collection) for truth info
-    bool c1_is_x = (c1.get_size() > 0 && c1.get_tps()[0]->GetView() == "X");
-    bool c2_is_x = (c2.get_size() > 0 && c2.get_tps()[0]->GetView() == "X");
-    
-    Cluster& x_cluster = c1_is_x ? c1 : c2;
-    int common_event = (x_cluster.get_size() > 0) ? x_cluster.get_tps()[0]->GetEvent() : 0;
-    
-    // Add all TPs from both clusters
-    for (int i = 0; i < c1.get_size(); i++) {
-        TriggerPrimitive* tp = c1.get_tps()[i];
-        tp->SetEvent(common_event);
-        tps.push_back(tp);
-    }
-    for (int i = 0; i < c2.get_size(); i++) {
-        TriggerPrimitive* tp = c2.get_tps()[i];
-        tp->SetEvent(common_event);
-        tps.push_back(tp);
+    // Set all TPs to same event (use X cluster's first TP event)
+    const int common_event = (x_cluster.get_size() > 0) ? x_cluster.get_tp(0)->GetEvent() : 0;
+    for (const Cluster* cluster : clusters) {
+        for (TriggerPrimitive* tp : cluster->get_tps()) {
+            if (cluster != &x_cluster) tp->SetEvent(common_event);  // Ensure consistent event
+            tps.push_back(tp);
+        }
     }
 
-    Cluster c(tps);
+    Cluster c(std::move(tps));
     // Copy truth info from X cluster
     c.set_true_pos(x_cluster.get_true_pos());
     c.set_true_dir(x_cluster.get_true_dir());
@@ -164,7 +129,453 @@ Cluster join_clusters(Cluster c1, Cluster c2){
     c.set_is_es_interaction(x_cluster.get_is_es_interaction());
     c.set_min_distance_from_true_pos(x_cluster.get_min_distance_from_true_pos());
     c.set_supernova_tp_fraction(x_cluster.get_supernova_tp_fraction());
-    
     return c;
 }
 
+Cluster join_clusters(const Cluster& c_u, const Cluster& c_v, const Cluster& c_x) {
+    return join_clusters({&c_u, &c_v, &c_x}, c_x);
+}
+
+// Overload for joining 2 clusters (partial matches)
+Cluster join_clusters(const Cluster& c1, const Cluster& c2) {
+    // Determine which is X plane (collection) for truth info
+    const bool c1_is_x = (c1.get_size() > 0 && c1.get_tp(0)->GetViewId() == interned::view_x_id);
+    return join_clusters({&c1, &c2}, c1_is_x ? c1 : c2);
+}
+
+ClusterInterval get_cluster_interval(const Cluster& cluster) {
+    ClusterInterval interval;
+    const std::vector<TriggerPrimitive*>& tps = cluster.get_tps();
+    if (tps.empty()) return interval;
+
+    interval.t_min = INT_MAX;
+    interval.t_max = INT_MIN;
+    for (auto* tp : tps) {
+        int start_tdc = tp->GetTimeStart();
+        int end_tdc = tp->GetTimeStart() + tp->GetSamplesOverThreshold();
+        interval.t_min = std::min(interval.t_min, start_tdc);
+        interval.t_max = std::max(interval.t_max, end_tdc);
+    }
+    interval.apa = tps[0]->GetDetectorChannel() / APA::total_channels;
+    interval.event = tps[0]->GetEvent();
+    return interval;
+}
+
+ClusterIntervalIndex::ClusterIntervalIndex(const std::vector<Cluster>& clusters) {
+    intervals_.reserve(clusters.size());
+    for (const auto& cluster : clusters) intervals_.push_back(get_cluster_interval(cluster));
+
+    order_.resize(intervals_.size());
+    std::iota(order_.begin(), order_.end(), 0);
+    std::sort(order_.begin(), order_.end(), [&](uint32_t a, uint32_t b) {
+        const ClusterInterval& ia = intervals_[a];
+        const ClusterInterval& ib = intervals_[b];
+        return std::tie(ia.event, ia.apa, ia.t_min, a) < std::tie(ib.event, ib.apa, ib.t_min, b);
+    });
+
+    t_min_.resize(order_.size());
+    running_t_max_.resize(order_.size());
+    for (uint32_t pos = 0; pos < order_.size(); ++pos) {
+        const ClusterInterval& interval = intervals_[order_[pos]];
+        const bool new_group = groups_.empty() || groups_.back().event != interval.event || groups_.back().apa != interval.apa;
+        if (new_group) groups_.push_back({interval.event, interval.apa, pos, pos});
+        groups_.back().end = pos + 1;
+        t_min_[pos] = interval.t_min;
+        running_t_max_[pos] = new_group ? interval.t_max : std::max(running_t_max_[pos - 1], interval.t_max);
+    }
+
+    while (n_leaves_ < order_.size()) n_leaves_ *= 2;
+    t_max_tree_.assign(2 * n_leaves_, INT_MIN);
+    for (size_t pos = 0; pos < order_.size(); ++pos) t_max_tree_[n_leaves_ + pos] = intervals_[order_[pos]].t_max;
+    for (size_t node = n_leaves_ - 1; node > 0; --node) {
+        t_max_tree_[node] = std::max(t_max_tree_[2 * node], t_max_tree_[2 * node + 1]);
+    }
+}
+
+bool ClusterIntervalIndex::has_event(int event) const {
+    auto it = std::lower_bound(groups_.begin(), groups_.end(), event,
+                               [](const Group& group, int value) { return group.event < value; });
+    return it != groups_.end() && it->event == event;
+}
+
+bool ClusterIntervalIndex::has_group(int event, int apa) const {
+    auto it = std::lower_bound(groups_.begin(), groups_.end(), std::make_pair(event, apa),
+                               [](const Group& group, const std::pair<int, int>& key) { return std::make_pair(group.event, group.apa) < key; });
+    return it != groups_.end() && it->event == event && it->apa == apa;
+}
+
+bool ClusterIntervalIndex::locate(int event, int apa, int t_min, int t_max, int tolerance, size_t& first, size_t& end) const {
+    auto group = std::lower_bound(groups_.begin(), groups_.end(), std::make_pair(event, apa),
+                                  [](const Group& g, const std::pair<int, int>& key) { return std::make_pair(g.event, g.apa) < key; });
+    if (group == groups_.end() || group->event != event || group->apa != apa) return false;
+
+    // Clusters starting no later than the end of the range (plus tolerance)
+    auto prefix_end = std::upper_bound(t_min_.begin() + group->begin, t_min_.begin() + group->end, t_max + tolerance);
+    end = prefix_end - t_min_.begin();
+    if (end == group->begin) return false;
+
+    // First of them ending no earlier than the start of the range (minus tolerance)
+    auto hit = std::lower_bound(running_t_max_.begin() + group->begin, running_t_max_.begin() + end, t_min - tolerance);
+    if (hit == running_t_max_.begin() + end) return false;
+    first = hit - running_t_max_.begin();
+    return true;
+}
+
+void ClusterIntervalIndex::find_overlaps(int event, int apa, int t_min, int t_max, int tolerance, std::vector<uint32_t>& out) const {
+    size_t first = 0, end = 0;
+    if (!locate(event, apa, t_min, t_max, tolerance, first, end)) return;
+    collect_overlaps(1, 0, n_leaves_, first, end, t_min - tolerance, out);
+}
+
+void ClusterIntervalIndex::collect_overlaps(size_t node, size_t node_first, size_t node_end, size_t first, size_t end,
+                                            int min_t_max, std::vector<uint32_t>& out) const {
+    if (node_end <= first || end <= node_first || t_max_tree_[node] < min_t_max) return;
+    if (node_end - node_first == 1) {
+        out.push_back(order_[node_first]);
+        return;
+    }
+    const size_t node_mid = (node_first + node_end) / 2;
+    collect_overlaps(2 * node, node_first, node_mid, first, end, min_t_max, out);
+    collect_overlaps(2 * node + 1, node_mid, node_end, first, end, min_t_max, out);
+}
+
+std::vector<int> solve_assignment(const std::vector<float>& weights, int n_rows, int n_cols) {
+    std::vector<int> assignment(n_rows, -1);
+    if (n_rows == 0 || n_cols == 0) return assignment;
+
+    // The algorithm needs no more rows than columns: the transposed problem is solved otherwise
+    if (n_rows > n_cols) {
+        std::vector<float> transposed(weights.size());
+        for (int i = 0; i < n_rows; ++i) {
+            for (int j = 0; j < n_cols; ++j) transposed[j * n_rows + i] = weights[i * n_cols + j];
+        }
+        const std::vector<int> col_to_row = solve_assignment(transposed, n_cols, n_rows);
+        for (int j = 0; j < n_cols; ++j) {
+            if (col_to_row[j] >= 0) assignment[col_to_row[j]] = j;
+        }
+        return assignment;
+    }
+
+    // Minimum cost assignment of every row, the cost of a pair being minus its weight (0 without an edge:
+    // a row left on such a column is unassigned). Rows and columns are 1-based below, 0 being a sentinel
+    auto cost = [&](int i, int j) {
+        const float w = weights[(i - 1) * n_cols + (j - 1)];
+        return w > 0 ? -static_cast<double>(w) : 0.0;
+    };
+    const double inf = std::numeric_limits<double>::max();
+    std::vector<double> u(n_rows + 1, 0.0), v(n_cols + 1, 0.0), min_v(n_cols + 1);
+    std::vector<int> p(n_cols + 1, 0), way(n_cols + 1, 0);
+    std::vector<char> used(n_cols + 1);
+    for (int i = 1; i <= n_rows; ++i) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(min_v.begin(), min_v.end(), inf);
+        std::fill(used.begin(), used.end(), 0);
+        do {
+            used[j0] = 1;
+            const int i0 = p[j0];
+            int j1 = 0;
+            double delta = inf;
+            for (int j = 1; j <= n_cols; ++j) {
+                if (used[j]) continue;
+                const double reduced = cost(i0, j) - u[i0] - v[j];
+                if (reduced < min_v[j]) {
+                    min_v[j] = reduced;
+                    way[j] = j0;
+                }
+                if (min_v[j] < delta) {
+                    delta = min_v[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= n_cols; ++j) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    min_v[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            const int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    for (int j = 1; j <= n_cols; ++j) {
+        if (p[j] > 0 && weights[(p[j] - 1) * n_cols + (j - 1)] > 0) assignment[p[j] - 1] = j - 1;
+    }
+    return assignment;
+}
+
+namespace {
+
+// Edge of a bipartite candidate graph: row (position in the selection of X clusters), column (index of a
+// cluster of another view) and weight > 0
+struct AssignmentEdge {
+    uint32_t row;
+    uint32_t col;
+    float weight;
+};
+
+// Maximum weight matching of a sparse bipartite graph: the column of every row, -1 if none.
+// The graph is split in connected parts (union-find), each solved by solve_assignment() on its own
+// dense matrix; the parts of more than max_component_size nodes are assigned greedily by weight instead
+std::vector<int> assign_sparse(const std::vector<AssignmentEdge>& edges, size_t n_rows, size_t max_component_size) {
+    std::vector<int> assignment(n_rows, -1);
+    if (edges.empty()) return assignment;
+
+    // Nodes: the rows, then the columns met in the edges
+    std::unordered_map<uint32_t, uint32_t> col_node;
+    std::vector<uint32_t> node_col;
+    std::vector<uint32_t> edge_col_node(edges.size());
+    for (size_t e = 0; e < edges.size(); ++e) {
+        auto it = col_node.emplace(edges[e].col, static_cast<uint32_t>(n_rows + node_col.size())).first;
+        if (it->second == n_rows + node_col.size()) node_col.push_back(edges[e].col);
+        edge_col_node[e] = it->second;
+    }
+
+    std::vector<uint32_t> parent(n_rows + node_col.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find_root = [&](uint32_t node) {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    };
+    for (size_t e = 0; e < edges.size(); ++e) {
+        const uint32_t a = find_root(edges[e].row);
+        const uint32_t b = find_root(edge_col_node[e]);
+        if (a != b) parent[a] = b;
+    }
+
+    // Edges grouped by connected part
+    std::vector<uint32_t> edge_order(edges.size());
+    std::iota(edge_order.begin(), edge_order.end(), 0);
+    std::vector<uint32_t> edge_root(edges.size());
+    for (size_t e = 0; e < edges.size(); ++e) edge_root[e] = find_root(edges[e].row);
+    std::stable_sort(edge_order.begin(), edge_order.end(), [&](uint32_t a, uint32_t b) { return edge_root[a] < edge_root[b]; });
+
+    std::vector<int> local(parent.size(), -1);
+    std::vector<uint32_t> rows, cols;
+    std::vector<float> weights;
+    for (size_t begin = 0; begin < edge_order.size();) {
+        size_t end = begin;
+        while (end < edge_order.size() && edge_root[edge_order[end]] == edge_root[edge_order[begin]]) ++end;
+
+        rows.clear();
+        cols.clear();
+        for (size_t k = begin; k < end; ++k) {
+            const uint32_t e = edge_order[k];
+            if (local[edges[e].row] < 0) {
+                local[edges[e].row] = static_cast<int>(rows.size());
+                rows.push_back(edges[e].row);
+            }
+            if (local[edge_col_node[e]] < 0) {
+                local[edge_col_node[e]] = static_cast<int>(cols.size());
+                cols.push_back(edge_col_node[e]);
+            }
+        }
+
+        if (rows.size() + cols.size() <= max_component_size) {
+            weights.assign(rows.size() * cols.size(), 0.0f);
+            for (size_t k = begin; k < end; ++k) {
+                const uint32_t e = edge_order[k];
+                float& w = weights[local[edges[e].row] * cols.size() + local[edge_col_node[e]]];
+                w = std::max(w, edges[e].weight);
+            }
+            const std::vector<int> solution = solve_assignment(weights, static_cast<int>(rows.size()), static_cast<int>(cols.size()));
+            for (size_t r = 0; r < rows.size(); ++r) {
+                if (solution[r] >= 0) assignment[rows[r]] = static_cast<int>(node_col[cols[solution[r]] - n_rows]);
+            }
+        } else {
+            std::vector<uint32_t> by_weight(edge_order.begin() + begin, edge_order.begin() + end);
+            std::stable_sort(by_weight.begin(), by_weight.end(), [&](uint32_t a, uint32_t b) { return edges[a].weight > edges[b].weight; });
+            std::vector<char> col_used(cols.size(), 0);
+            for (uint32_t e : by_weight) {
+                char& used = col_used[local[edge_col_node[e]]];
+                if (assignment[edges[e].row] >= 0 || used) continue;
+                assignment[edges[e].row] = static_cast<int>(edges[e].col);
+                used = 1;
+            }
+        }
+
+        for (uint32_t row : rows) local[row] = -1;
+        for (uint32_t col : cols) local[col] = -1;
+        begin = end;
+    }
+    return assignment;
+}
+
+// Fraction of the shorter of two time intervals covered by their overlap, the tolerance counting as overlap
+float time_overlap_score(const ClusterInterval& a, const ClusterInterval& b, int tolerance) {
+    const double overlap = std::min(a.t_max, b.t_max) - std::max(a.t_min, b.t_min) + tolerance;
+    const double length = std::min(a.t_max - a.t_min, b.t_max - b.t_min) + tolerance;
+    if (length <= 0) return overlap >= 0 ? 1.0f : 0.0f;
+    return static_cast<float>(std::min(1.0, std::max(0.0, overlap / length)));
+}
+
+// Ratio of the smaller to the larger of two energies, 0 if either is not positive
+float energy_ratio_score(double energy_a, double energy_b) {
+    if (energy_a <= 0 || energy_b <= 0) return 0.0f;
+    return static_cast<float>(std::min(energy_a, energy_b) / std::max(energy_a, energy_b));
+}
+
+// Candidate of an X cluster in another view, with the y ranges its wires cover over the z range of the
+// X cluster, on either drift side (empty if the X cluster has no z range)
+struct ViewCandidate {
+    uint32_t cluster;
+    float score; // time and energy terms only
+    std::pair<float, float> y_range[2];
+};
+
+} // namespace
+
+std::vector<MultiplaneMatch> match_multiplane(const std::vector<Cluster>& clusters_u, const std::vector<Cluster>& clusters_v,
+                                              const std::vector<Cluster>& clusters_x, const ClusterIntervalIndex& index_u,
+                                              const ClusterIntervalIndex& index_v, const ClusterIntervalIndex& index_x,
+                                              const std::vector<uint32_t>& x_selection, const MatchSettings& settings,
+                                              MatchStats* stats) {
+    MatchStats local_stats;
+    MatchStats& st = stats ? *stats : local_stats;
+    const WireGeometry& geometry = get_wire_geometry();
+    const float radius = settings.spatial_tolerance;
+    const double factor_collection = get_adc_to_energy_factor_collection();
+    const double factor_induction = get_adc_to_energy_factor_induction();
+    const float pair_weight = settings.time_weight + settings.charge_weight;
+    const float triplet_weight = pair_weight + settings.geometry_weight;
+    auto pair_score = [&](float time, float charge) {
+        return pair_weight > 0 ? (settings.time_weight * time + settings.charge_weight * charge) / pair_weight : 0.0f;
+    };
+
+    // Candidates of every selected X cluster in U and V, the best max_candidates of each view by score
+    const size_t n_sel = x_selection.size();
+    std::vector<std::vector<ViewCandidate>> candidates_u(n_sel), candidates_v(n_sel);
+    std::vector<uint32_t> overlaps;
+    for (size_t s = 0; s < n_sel; ++s) {
+        const Cluster& c_x = clusters_x[x_selection[s]];
+        const ClusterInterval& x = index_x.get_interval(x_selection[s]);
+        const double energy_x = c_x.get_total_charge() / factor_collection;
+
+        float z_min = 0, z_max = 0;
+        const bool has_z = settings.check_geometry && collection_z_range(c_x.get_tps(), geometry, z_min, z_max);
+
+        auto collect = [&](const std::vector<Cluster>& clusters, const ClusterIntervalIndex& index, std::vector<ViewCandidate>& out,
+                           long long& failed_event, long long& failed_apa, long long& failed_time, long long& n_candidates) {
+            overlaps.clear();
+            index.find_overlaps(x.event, x.apa, x.t_min, x.t_max, settings.time_tolerance, overlaps);
+            if (overlaps.empty()) {
+                if (!index.has_event(x.event)) failed_event++;
+                else if (!index.has_group(x.event, x.apa)) failed_apa++;
+                else failed_time++;
+                return;
+            }
+            out.reserve(overlaps.size());
+            for (uint32_t j : overlaps) {
+                const float time = time_overlap_score(x, index.get_interval(j), settings.time_tolerance);
+                const float charge = energy_ratio_score(energy_x, clusters[j].get_total_charge() / factor_induction);
+                out.push_back({j, pair_score(time, charge), {}});
+            }
+            auto better = [](const ViewCandidate& a, const ViewCandidate& b) {
+                return a.score != b.score ? a.score > b.score : a.cluster < b.cluster;
+            };
+            if (out.size() > settings.max_candidates) {
+                std::partial_sort(out.begin(), out.begin() + settings.max_candidates, out.end(), better);
+                out.resize(settings.max_candidates);
+            } else {
+                std::sort(out.begin(), out.end(), better);
+            }
+            n_candidates += out.size();
+
+            const float empty = std::numeric_limits<float>::max();
+            for (auto& candidate : out) {
+                for (int side = 0; side < 2; ++side) {
+                    candidate.y_range[side] = has_z ? induction_y_range(clusters[candidate.cluster].get_tps(), geometry, z_min - radius,
+                                                                        z_max + radius, side == 0 ? -1.0f : 1.0f)
+                                                    : std::make_pair(empty, -empty);
+                }
+            }
+        };
+        collect(clusters_u, index_u, candidates_u[s], st.failed_event_u, st.failed_apa_u, st.failed_time_u, st.candidates_u);
+        collect(clusters_v, index_v, candidates_v[s], st.failed_event_v, st.failed_apa_v, st.failed_time_v, st.candidates_v);
+    }
+
+    // Score of the triplet of the a-th U and b-th V candidates of an X cluster, -1 if their wires do not cross
+    // within radius. The geometry term is 1 - (distance between the U and V y ranges) / radius on the more
+    // consistent side (wire_crossing_gap, as in are_compatibles), 1 without geometry check
+    auto triplet_score = [&](const ViewCandidate& cu, const ViewCandidate& cv) {
+        float geometry_score = 1.0f;
+        if (settings.check_geometry) {
+            const float gap = wire_crossing_gap(cu.y_range, cv.y_range);
+            if (gap > radius) return -1.0f;
+            geometry_score = radius > 0 ? 1.0f - gap / radius : 1.0f;
+        }
+        if (triplet_weight <= 0) return 0.0f;
+        return (pair_weight * 0.5f * (cu.score + cv.score) + settings.geometry_weight * geometry_score) / triplet_weight;
+    };
+
+    // Triplet scores of every X cluster, U candidate major
+    std::vector<std::vector<float>> triplets(n_sel);
+    for (size_t s = 0; s < n_sel; ++s) {
+        triplets[s].reserve(candidates_u[s].size() * candidates_v[s].size());
+        for (const auto& cu : candidates_u[s]) {
+            for (const auto& cv : candidates_v[s]) {
+                const float score = triplet_score(cu, cv);
+                st.triplets++;
+                if (score < 0) st.failed_spatial++;
+                triplets[s].push_back(score);
+            }
+        }
+    }
+
+    // Every candidate weighs 1 plus its score: the assignment favours matching more X clusters, then better ones.
+    // Stage 1, X to U: each pair weighted by the best match it leads to, on its own or in a triplet
+    std::vector<AssignmentEdge> edges;
+    for (size_t s = 0; s < n_sel; ++s) {
+        const size_t n_v = candidates_v[s].size();
+        for (size_t a = 0; a < candidates_u[s].size(); ++a) {
+            float best = candidates_u[s][a].score;
+            for (size_t b = 0; b < n_v; ++b) best = std::max(best, triplets[s][a * n_v + b]);
+            edges.push_back({static_cast<uint32_t>(s), candidates_u[s][a].cluster, 1.0f + best});
+        }
+    }
+    const std::vector<int> assigned_u = assign_sparse(edges, n_sel, settings.max_component_size);
+
+    // Stage 2, X to V: the triplets of the U of each X cluster, or the pairs when it has none
+    std::vector<int> assigned_u_candidate(n_sel, -1);
+    edges.clear();
+    for (size_t s = 0; s < n_sel; ++s) {
+        const size_t n_v = candidates_v[s].size();
+        for (size_t a = 0; a < candidates_u[s].size(); ++a) {
+            if (static_cast<int>(candidates_u[s][a].cluster) == assigned_u[s]) assigned_u_candidate[s] = static_cast<int>(a);
+        }
+        for (size_t b = 0; b < n_v; ++b) {
+            const float score = assigned_u_candidate[s] >= 0 ? triplets[s][assigned_u_candidate[s] * n_v + b] : candidates_v[s][b].score;
+            if (score >= 0) edges.push_back({static_cast<uint32_t>(s), candidates_v[s][b].cluster, 1.0f + score});
+        }
+    }
+    const std::vector<int> assigned_v = assign_sparse(edges, n_sel, settings.max_component_size);
+
+    std::vector<MultiplaneMatch> matches;
+    for (size_t s = 0; s < n_sel; ++s) {
+        if (assigned_u[s] < 0 && assigned_v[s] < 0) continue;
+        MultiplaneMatch match;
+        match.x = static_cast<int>(x_selection[s]);
+        match.u = assigned_u[s];
+        match.v = assigned_v[s];
+        const int a = assigned_u_candidate[s];
+        int b = -1;
+        for (size_t k = 0; k < candidates_v[s].size(); ++k) {
+            if (static_cast<int>(candidates_v[s][k].cluster) == assigned_v[s]) b = static_cast<int>(k);
+        }
+        if (a >= 0 && b >= 0) match.score = triplets[s][a * candidates_v[s].size() + b];
+        else if (a >= 0) match.score = candidates_u[s][a].score;
+        else match.score = candidates_v[s][b].score;
+        matches.push_back(match);
+    }
+    return matches;
+}
@@ -4,11 +4,119 @@
 #include "Cluster.h"
 // #include "PositionCalculator.h"
 
-bool are_compatibles(Cluster& c_u, Cluster& c_v, Cluster& c_x, float radius);
+// Same APA, and unless check_geometry is false, U and V wires crossing the X wires at a common point
+// within radius (cm), looked up in the wire geometry table (Geometry.h)
+bool are_compatibles(const Cluster& c_u, const Cluster& c_v, const Cluster& c_x, float radius, bool check_geometry = true);
 bool match_with_true_pos(Cluster& c_u, Cluster& c_v, Cluster& c_x, float radius);
 
-Cluster join_clusters(Cluster c_u, Cluster c_v, Cluster c_x);
-Cluster join_clusters(Cluster c1, Cluster c2);  // For partial matches (2 planes)    
+// Multi-plane cluster of the TPs of the given clusters (moved to the event of the X cluster), with the truth of the
+// X cluster. The TP pointers are shared with the given clusters, which must outlive it
+Cluster join_clusters(const Cluster& c_u, const Cluster& c_v, const Cluster& c_x);
+Cluster join_clusters(const Cluster& c1, const Cluster& c2);  // For partial matches (2 planes)
+
+// Time range of a cluster in TDC ticks (from the earliest time start to the latest time start + ToT
+// of its TPs), with its APA and event: what the time matching needs, computed once per cluster
+struct ClusterInterval {
+    int t_min = 0;
+    int t_max = 0;
+    int apa = -1;
+    int event = 0;
+};
+ClusterInterval get_cluster_interval(const Cluster& cluster);
+
+// Time index of the clusters of one view: their intervals, grouped by (event, APA) and sorted by t_min
+// within a group, with the running maximum of t_max. The clusters of a group starting before the end of
+// a time range are a prefix of it, in which the running maximum is monotonic: the first of them ending
+// after the start of the range is found by binary search as well, in O(log N). All the overlaps of that
+// prefix are collected from a max-tree of t_max over the same order, skipping the subtrees that end too
+// early: O((k + 1) log N) for k overlaps, however long the clusters before them
+class ClusterIntervalIndex {
+    public:
+        explicit ClusterIntervalIndex(const std::vector<Cluster>& clusters);
+
+        size_t size() const { return intervals_.size(); }
+        // Interval of the i-th cluster of the view
+        const ClusterInterval& get_interval(size_t i) const { return intervals_[i]; }
+        bool has_event(int event) const;
+        bool has_group(int event, int apa) const;
+        // Indices in the view of the clusters of the event and APA whose interval overlaps [t_min, t_max]
+        // within tolerance (in TDC ticks), by (t_min, index), appended to out
+        void find_overlaps(int event, int apa, int t_min, int t_max, int tolerance, std::vector<uint32_t>& out) const;
+
+    private:
+        // Positions [first, end) of order_ from the first overlapping cluster to the last one starting in time
+        bool locate(int event, int apa, int t_min, int t_max, int tolerance, size_t& first, size_t& end) const;
+        // Clusters at positions [first, end) of order_ ending no earlier than min_t_max, below a node of the max-tree
+        // covering positions [node_first, node_end)
+        void collect_overlaps(size_t node, size_t node_first, size_t node_end, size_t first, size_t end, int min_t_max,
+                              std::vector<uint32_t>& out) const;
+
+        struct Group {
+            int event;
+            int apa;
+            uint32_t begin; // range in order_
+            uint32_t end;
+        };
+
+        std::vector<ClusterInterval> intervals_; // in view order
+        std::vector<uint32_t> order_;            // cluster indices, by group then t_min
+        std::vector<int> t_min_;                 // t_min of order_
+        std::vector<int> running_t_max_;         // maximum t_max over the group up to each position of order_
+        std::vector<int> t_max_tree_;            // max-tree of t_max over order_: node 1 is the root, leaves from n_leaves_
+        size_t n_leaves_ = 1;
+        std::vector<Group> groups_;              // by (event, APA)
+};
+
+// Maximum weight matching of a bipartite graph, given as a dense n_rows x n_cols matrix of weights
+// (row-major, <= 0 meaning no edge): the column of every row, -1 if none. Hungarian algorithm, O(n^2 m)
+std::vector<int> solve_assignment(const std::vector<float>& weights, int n_rows, int n_cols);
+
+// Settings of match_multiplane()
+struct MatchSettings {
+    int time_tolerance = 0;          // TDC ticks
+    float spatial_tolerance = 5.0f;  // cm
+    bool check_geometry = true;      // wire crossing of the U+V+X matches (are_compatibles)
+    // Weights of the terms of the score: time overlap, ratio of the energies, wire crossing
+    float time_weight = 1.0f;
+    float charge_weight = 1.0f;
+    float geometry_weight = 1.0f;
+    size_t max_candidates = 8;       // best U and V candidates kept per X cluster
+    size_t max_component_size = 256; // larger connected parts of the candidate graph are assigned greedily
+};
+
+// One multi-plane match: indices in their views of its clusters (-1 for a missing plane) and its score in [0, 1].
+// It refers to the clusters without copying them
+struct MultiplaneMatch {
+    int x = -1;
+    int u = -1;
+    int v = -1;
+    float score = 0.0f;
+
+    bool is_complete() const { return u >= 0 && v >= 0; }
+};
+
+// Counters of match_multiplane(). failed_*: X clusters left without a candidate of the view because
+// the view has no cluster in their event, none in their APA, or none overlapping them in time
+struct MatchStats {
+    long long failed_event_u = 0, failed_apa_u = 0, failed_time_u = 0;
+    long long failed_event_v = 0, failed_apa_v = 0, failed_time_v = 0;
+    long long candidates_u = 0, candidates_v = 0; // (X, U) and (X, V) pairs kept
+    long long triplets = 0;                       // (X, U, V) triplets scored
+    long long failed_spatial = 0;                 // triplets rejected by the wire crossing
+};
+
+// Global matching of the X clusters of x_selection (indices in clusters_x) to U and V clusters.
+// Every (X, U) and (X, V) pair of the same event and APA overlapping in time is a candidate, scored
+// on time overlap and energy ratio; an (X, U, V) triplet adds the consistency of its wire crossing.
+// The clusters are then assigned in two optimal bipartite stages, X to U (each pair weighted by the
+// best triplet it can make) and X to V (given the U of each X), each cluster in at most one match.
+// The candidate graph is sparse: each stage is solved per connected part with solve_assignment().
+// Matches come out in the order of x_selection
+std::vector<MultiplaneMatch> match_multiplane(const std::vector<Cluster>& clusters_u, const std::vector<Cluster>& clusters_v,
+                                              const std::vector<Cluster>& clusters_x, const ClusterIntervalIndex& index_u,
+                                              const ClusterIntervalIndex& index_v, const ClusterIntervalIndex& index_x,
+                                              const std::vector<uint32_t>& x_selection, const MatchSettings& settings,
+                                              MatchStats* stats = nullptr);
 
 
 #endif
\ No newline at end of file
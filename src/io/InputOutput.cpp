@@ -1,5 +1,7 @@
 #include "Global.h"
 
+#include <Compression.h>
+
 LoggerInit([]{Logger::getUserHeader() << "[" << FILENAME << "]";});
 
 bool ensureDirectoryExists(const std::string& folder) {
@@ -64,6 +66,95 @@ void bindBranch(TTree *tree, const char* name, void* address) {
     }
 }
 
+namespace {
+
+const std::vector<std::pair<std::string, ROOT::RCompressionSetting::EAlgorithm::EValues>> compression_algorithms = {
+    {"zlib", ROOT::RCompressionSetting::EAlgorithm::kZLIB},
+    {"lzma", ROOT::RCompressionSetting::EAlgorithm::kLZMA},
+    {"lz4", ROOT::RCompressionSetting::EAlgorithm::kLZ4},
+    {"zstd", ROOT::RCompressionSetting::EAlgorithm::kZSTD},
+};
+
+void readRootOutputKeys(const nlohmann::json& node, RootOutputSettings& settings) {
+    if (!node.is_object()) return;
+    if (node.contains("compression")) {
+        std::string name = node.at("compression").get<std::string>();
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "none") {
+            settings.compression_algorithm = ROOT::RCompressionSetting::EAlgorithm::kUseGlobal;
+            settings.compression_level = 0;
+        } else {
+            auto it = std::find_if(compression_algorithms.begin(), compression_algorithms.end(),
+                                   [&](const auto& algorithm) { return algorithm.first == name; });
+            LogThrowIf(it == compression_algorithms.end(), "Unknown compression '" << name << "', expected none, zlib, lzma, lz4 or zstd");
+            settings.compression_algorithm = it->second;
+        }
+    }
+    if (node.contains("compression_level")) settings.compression_level = node.at("compression_level").get<int>();
+    if (node.contains("auto_flush")) settings.auto_flush = node.at("auto_flush").get<Long64_t>();
+    if (node.contains("basket_size")) settings.basket_size = node.at("basket_size").get<int>();
+    LogThrowIf(settings.compression_level > 9, "compression_level must be between 0 and 9");
+}
+
+}
+
+int RootOutputSettings::get_compression_settings() const {
+    int algorithm = compression_algorithm;
+    int level = compression_level;
+    if (algorithm < 0) algorithm = ROOT::RCompressionSetting::EAlgorithm::kUseGlobal;
+    if (level < 0) {
+        // Default level of the algorithm
+        switch (algorithm) {
+            case ROOT::RCompressionSetting::EAlgorithm::kLZ4:  level = ROOT::RCompressionSetting::ELevel::kDefaultLZ4; break;
+            case ROOT::RCompressionSetting::EAlgorithm::kZSTD: level = ROOT::RCompressionSetting::ELevel::kDefaultZSTD; break;
+            case ROOT::RCompressionSetting::EAlgorithm::kLZMA: level = ROOT::RCompressionSetting::ELevel::kDefaultLZMA; break;
+            default: level = ROOT::RCompressionSetting::ELevel::kDefaultZLIB; break;
+        }
+    }
+    if (level == 0) return 0; // uncompressed, whatever the algorithm
+    return algorithm * 100 + level;
+}
+
+std::string RootOutputSettings::get_description() const {
+    std::ostringstream description;
+    if (!has_compression()) {
+        description << "default compression";
+    } else if (compression_level == 0) {
+        description << "no compression";
+    } else {
+        std::string name = "default";
+        for (const auto& algorithm : compression_algorithms) {
+            if (algorithm.second == compression_algorithm) name = algorithm.first;
+        }
+        description << name;
+        if (compression_level > 0) description << " level " << compression_level;
+    }
+    if (auto_flush > 0) description << ", auto_flush " << auto_flush << " entries";
+    else if (auto_flush < 0) description << ", auto_flush " << -auto_flush << " bytes";
+    if (basket_size > 0) description << ", basket_size " << basket_size;
+    return description.str();
+}
+
+RootOutputSettings getRootOutputSettings(const nlohmann::json& j, const std::string& output) {
+    RootOutputSettings settings;
+    if (!j.contains("root_output")) return settings;
+    const nlohmann::json& node = j.at("root_output");
+    readRootOutputKeys(node, settings);
+    if (!output.empty() && node.is_object() && node.contains(output)) readRootOutputKeys(node.at(output), settings);
+    return settings;
+}
+
+void applyRootOutputSettings(TFile* file, const RootOutputSettings& settings) {
+    if (!file || !settings.has_compression()) return;
+    file->SetCompressionSettings(settings.get_compression_settings());
+}
+
+void applyRootOutputSettings(TTree* tree, const RootOutputSettings& settings) {
+    if (!tree) return;
+    if (settings.auto_flush != 0) tree->SetAutoFlush(settings.auto_flush);
+    if (settings.basket_size > 0) tree->SetBasketSize("*", settings.basket_size);
+}
+
 
 std::string getClustersFolder(const nlohmann::json& j) {
     // If explicit clusters_folder provided, use it
@@ -166,6 +257,14 @@ std::string getConditionsString(const nlohmann::json& j) {
 
 // Helper: Get output folder with auto-generation logic
 // Priority: 1) Explicit JSON key, 2) Auto-generate from main_folder/signal_folder
+std::string getTpsFileExtension(const nlohmann::json& j) {
+    std::string format = j.value("tps_format", std::string("root"));
+    std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+    if (format == "binary" || format == "tpb") return ".tpb";
+    LogThrowIf(format != "root", "Unknown tps_format '" << format << "', expected 'root' or 'binary'");
+    return ".root";
+}
+
 std::string getOutputFolder(const nlohmann::json& j, const std::string& folder_type, const std::string& json_key) {
     // If explicit path provided in JSON, use it
     if (j.contains(json_key) && !j[json_key].get<std::string>().empty()) {
@@ -562,6 +661,12 @@ std::vector<std::string> find_input_files(const nlohmann::json& j, const std::st
     auto matches_pattern = [&pattern](const std::string& filename) -> bool {
         std::string base = std::filesystem::path(filename).filename().string();
         if (debugMode) LogDebug << "[find_input_files] Checking if '" << base << "' matches pattern '" << pattern << "'" << std::endl;
+
+        // Binary TP files (*_tps.tpb) are named like their ROOT counterparts
+        if (pattern != "tpstream" && pattern != "clusters" &&
+            base.size() > 4 && base.substr(base.size() - 4) == ".tpb") {
+            base = base.substr(0, base.size() - 4) + ".root";
+        }
         
         // Special handling for sig and bg: they contain tps files
         if (pattern == "sig" || pattern == "bg") {
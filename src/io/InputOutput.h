@@ -25,9 +25,33 @@ std::string resolveFolderAgainstTpstream(const nlohmann::json& j, const std::str
 std::string getClustersFolder(const nlohmann::json& j);
 std::string getConditionsString(const nlohmann::json& j);
 std::string getOutputFolder(const nlohmann::json& j, const std::string& folder_type, const std::string& json_key);
+// Extension of the TP files to write, from "tps_format": ".root" (default) or ".tpb" for "binary"
+std::string getTpsFileExtension(const nlohmann::json& j);
 
 // ROOT helpers
 void bindBranch(TTree* tree, const char* name, void* address);
+
+// Compression and basket layout of the ROOT files we write, from the "root_output" JSON object:
+//   "root_output": { "compression": "lz4", "compression_level": 4, "auto_flush": -30000000, "basket_size": 32000,
+//                    "tps": { ... }, "clusters": { ... } }
+// compression is one of none, zlib, lzma, lz4, zstd; the "tps" and "clusters" objects override the keys for one kind of output.
+// Unset values keep the ROOT defaults
+struct RootOutputSettings {
+    int compression_algorithm = -1; // ROOT::RCompressionSetting::EAlgorithm, -1 for the ROOT default
+    int compression_level = -1;     // 0 (none) to 9
+    Long64_t auto_flush = 0;        // >0 entries, <0 bytes per cluster of baskets, 0 for the ROOT default
+    int basket_size = -1;           // bytes per branch buffer, -1 for the ROOT default
+
+    bool has_compression() const { return compression_algorithm >= 0 || compression_level >= 0; }
+    // algorithm * 100 + level, as TFile::SetCompressionSettings expects
+    int get_compression_settings() const;
+    std::string get_description() const;
+};
+RootOutputSettings getRootOutputSettings(const nlohmann::json& j, const std::string& output = "");
+// Call on a new file before creating its trees (they take the compression of their directory)
+void applyRootOutputSettings(TFile* file, const RootOutputSettings& settings);
+// Call on a new tree once its branches are created
+void applyRootOutputSettings(TTree* tree, const RootOutputSettings& settings);
 template <typename T> bool SetBranchWithFallback(TTree*, std::initializer_list<const char*>, T*, const std::string&);
 
 #endif // INPUT_OUTPUT_H
@@ -2,163 +2,146 @@
 #include "Global.h"
 #include "Utils.h"
 
-float eval_y_knowing_z_U_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign) {
-    z = z - int(tps.at(0)->GetDetectorChannel()) / (APA::total_channels*2) * (apa_lenght_in_cm + offset_between_apa_in_cm); // not sure about the 0 TODO
-    float ordinate;
-    std::vector<float> Y_pred;
-    for (auto& tp : tps) {
-        if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 0) {
-            if (x_sign < 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
-                    } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
-                    }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                }
-            } else if (x_sign > 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    if (z < (799 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
-                    } else {
-                        ordinate = (z - (799 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                    }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                }
-            }
-        } else if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 1) {
-            if (x_sign < 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    if (z < (399 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
-                    } else {
-                        ordinate = (z - (399 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                    }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                }
-            } else if (x_sign > 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels > 399) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
-                    } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 400) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
-                    }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 400) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                }
-            }
-        }
-        if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 < 1) {
-            ordinate = (ordinate) - apa_height_in_cm;
-        } else {
-            ordinate = apa_height_in_cm - (ordinate);
-        }
+#include <cmath>
 
-        Y_pred.push_back(ordinate);
-    }
-    // mean
-    float Y_pred_mean = 0;
-    for (auto& y : Y_pred) {
-        Y_pred_mean += y;
+std::pair<float, float> InductionWire::y_range(float z_min, float z_max) const {
+    float y_first = y_at(z_min);
+    float y_last = y_at(z_max);
+    std::pair<float, float> range(std::min(y_first, y_last), std::max(y_first, y_last));
+    // Both pieces reach the break when it falls inside the range
+    if (z_break > z_min && z_break <= z_max) {
+        const float z = static_cast<float>(z_break);
+        for (float y : {y0_before + slope * z, y0_after + slope * z}) {
+            range.first = std::min(range.first, y);
+            range.second = std::max(range.second, y);
+        }
     }
-    Y_pred_mean = Y_pred_mean / Y_pred.size();
-
-    return Y_pred_mean;
+    return range;
 }
 
-float eval_y_knowing_z_V_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign) {
-    
-    z = z - int(tps.at(0)->GetDetectorChannel()) / (APA::total_channels*2) * (apa_lenght_in_cm + offset_between_apa_in_cm);
-    float ordinate;
-    std::vector<float> Y_pred;
-    for (auto& tp : tps) {
-        if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 0) {
-            if (x_sign < 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    if (z < (1199 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
-                    } else {
-                        ordinate = (z - (1199 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                    }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                }
-            } else if (x_sign > 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+WireGeometry::WireGeometry() {
+    const double apa_length = get_apa_length_cm();
+    const double pitch = get_wire_pitch_induction_cm();
+    const double pitch_collection = get_wire_pitch_collection_cm();
+    const int error_margin = get_backtracker_error_margin();
+    const double k = get_apa_angular_coeff();
+    const double apa_height = get_apa_height_cm();
+    const int n_induction = APA::induction_channels * 2;
+
+    // The pieces of a wire: straight, or wrapped with the piece taken beyond (or before) the turn at T.
+    // y0 values are the ordinates of the original formulas at z = 0, the slope is +-angular_coeff
+    auto straight = [](double y0, double slope) {
+        InductionWire wire;
+        wire.y0_before = wire.y0_after = static_cast<float>(y0);
+        wire.slope = static_cast<float>(slope);
+        return wire;
+    };
+    auto wrapped_after = [](double T, double y0_up_to, double y0_beyond, double slope) { // z > T takes y0_beyond
+        InductionWire wire;
+        wire.z_break = std::nextafter(T, std::numeric_limits<double>::infinity());
+        wire.y0_before = static_cast<float>(y0_up_to);
+        wire.y0_after = static_cast<float>(y0_beyond);
+        wire.slope = static_cast<float>(slope);
+        return wire;
+    };
+    auto wrapped_before = [](double T, double y0_below, double y0_from, double slope) { // z < T takes y0_below
+        InductionWire wire;
+        wire.z_break = T;
+        wire.y0_before = static_cast<float>(y0_below);
+        wire.y0_after = static_cast<float>(y0_from);
+        wire.slope = static_cast<float>(slope);
+        return wire;
+    };
+
+    wires_.resize(2 * 2 * n_induction);
+    for (int parity = 0; parity < 2; ++parity) {
+        for (int side = 0; side < 2; ++side) {
+            for (int c = 0; c < n_induction; ++c) {
+                InductionWire wire;
+                if (c < APA::induction_channels) { // U
+                    if (parity == 0 && side == 0) {
+                        wire = c < 400 ? wrapped_after(c * pitch + error_margin, c * pitch * k, (c * pitch + 2 * apa_length) * k, -k)
+                                       : straight((apa_length + (c - 400) * pitch) * k, -k);
+                    } else if (parity == 0) {
+                        wire = c > 399 ? wrapped_before((799 - c) * pitch - error_margin, ((c - 400) * pitch + apa_length) * k, -(799 - c) * pitch * k, k)
+                                       : straight(c * pitch * k, k);
+                    } else if (side == 0) {
+                        wire = c < 400 ? wrapped_before((399 - c) * pitch - error_margin, (c * pitch + apa_length) * k, -(399 - c) * pitch * k, k)
+                                       : straight((c - 400) * pitch * k, k);
                     } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
+                        wire = c > 399 ? wrapped_after((c - 400) * pitch + error_margin, (c - 400) * pitch * k, ((c - 400) * pitch + 2 * apa_length) * k, -k)
+                                       : straight((apa_length + c * pitch) * k, -k);
                     }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                }
-            } 
-        } else if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 == 1) {
-            if (x_sign < 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    if (z > (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction + backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = apa_lenght_in_cm - z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
+                } else { // V
+                    if (parity == 0 && side == 0) {
+                        wire = c < 1200 ? wrapped_before((1199 - c) * pitch - error_margin, ((c - 800) * pitch + apa_length) * k, -(1199 - c) * pitch * k, k)
+                                        : straight((c - 1200) * pitch * k, k);
+                    } else if (parity == 0) {
+                        wire = c > 1199 ? wrapped_after((c - 1200) * pitch + error_margin, (c - 1200) * pitch * k, ((c - 1200) * pitch + 2 * apa_length) * k, -k)
+                                        : straight((apa_length + (c - 800) * pitch) * k, -k);
+                    } else if (side == 0) {
+                        wire = c < 1200 ? wrapped_after((c - 800) * pitch + error_margin, (c - 800) * pitch * k, ((c - 800) * pitch + 2 * apa_length) * k, -k)
+                                        : straight((apa_length + (c - 1200) * pitch) * k, -k);
                     } else {
-                        ordinate = ((int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction - z) * apa_angular_coeff;
+                        wire = c > 1199 ? wrapped_before((1599 - c) * pitch - error_margin, ((c - 1200) * pitch + apa_length) * k, -(1599 - c) * pitch * k, k)
+                                        : straight((c - 800) * pitch * k, k);
                     }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    ordinate = (apa_lenght_in_cm - z + (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction) * apa_angular_coeff;
                 }
-            } else if (x_sign > 0) {
-                if (int(tp->GetDetectorChannel()) % APA::total_channels > 1199) {
-                    if (z < (1599 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction - backtracker_error_margin) {
-                        float until_turn = (int(tp->GetDetectorChannel()) % APA::total_channels - 1200) * wire_pitch_in_cm_induction;
-                        float all_the_way_behind = apa_lenght_in_cm;
-                        float the_last_piece = z;
-                        ordinate = (until_turn + all_the_way_behind + the_last_piece) * apa_angular_coeff;
-                    } else {
-                        ordinate = (z - (1599 - int(tp->GetDetectorChannel()) % APA::total_channels) * wire_pitch_in_cm_induction) * apa_angular_coeff;
-                    }
-                } else if (int(tp->GetDetectorChannel()) % APA::total_channels < 1200) {
-                    ordinate = (z + (int(tp->GetDetectorChannel()) % APA::total_channels - 800) * wire_pitch_in_cm_induction) * apa_angular_coeff;
+
+                // Even APAs hang below y = 0, odd APAs above it, upside down
+                if (parity == 0) {
+                    wire.y0_before -= apa_height;
+                    wire.y0_after -= apa_height;
+                } else {
+                    wire.y0_before = apa_height - wire.y0_before;
+                    wire.y0_after = apa_height - wire.y0_after;
+                    wire.slope = -wire.slope;
                 }
+                wires_[(parity * 2 + side) * n_induction + c] = wire;
             }
         }
-        if ((int(tp->GetDetectorChannel()) / APA::total_channels) % 2 < 1) {
-            ordinate = (ordinate) - apa_height_in_cm;
-        } else {
-            ordinate = apa_height_in_cm - (ordinate);
-        }
-
-        Y_pred.push_back(ordinate);
     }
-    // mean
-    float Y_pred_mean = 0;
-    for (auto& y : Y_pred) {
-        Y_pred_mean += y;
+
+    // Collection wires: the two faces of an APA cover the same z
+    collection_z_.resize(APA::collection_channels);
+    for (int c = 0; c < APA::collection_channels; ++c) {
+        collection_z_[c] = pitch_collection + (c % (APA::collection_channels / 2)) * pitch_collection;
     }
-    Y_pred_mean = Y_pred_mean / Y_pred.size();
+}
 
-    return Y_pred_mean;
+const InductionWire* WireGeometry::get_wire(int detector_channel, float x_sign) const {
+    const int local = detector_channel % APA::total_channels;
+    const int n_induction = APA::induction_channels * 2;
+    if (detector_channel < 0 || local >= n_induction) return nullptr;
+    const int parity = (detector_channel / APA::total_channels) % 2;
+    const int side = x_sign < 0 ? 0 : 1;
+    return &wires_[(parity * 2 + side) * n_induction + local];
+}
+
+float WireGeometry::get_collection_z(int detector_channel) const {
+    const int local = detector_channel % APA::total_channels - APA::induction_channels * 2;
+    if (detector_channel < 0 || local < 0) return -1.0f;
+    return collection_z_[local];
+}
+
+const WireGeometry& get_wire_geometry() {
+    static const WireGeometry geometry;
+    return geometry;
+}
+
+float eval_y_knowing_z(const std::vector<TriggerPrimitive*>& tps, TPView plane, float z, float x_sign) {
+    const WireGeometry& geometry = get_wire_geometry();
+    z = z - int(tps.at(0)->GetDetectorChannel()) / (APA::total_channels*2) * (get_apa_length_cm() + get_offset_between_apa_cm()); // not sure about the 0 TODO
+    float y_sum = 0;
+    int count = 0;
+    for (auto* tp : tps) {
+        const int local = tp->GetDetectorChannel() % APA::total_channels;
+        const TPView view = local < APA::induction_channels ? TPView::U : TPView::V;
+        if (view != plane) continue;
+        const InductionWire* wire = geometry.get_wire(tp->GetDetectorChannel(), x_sign);
+        if (!wire) continue;
+        y_sum += wire->y_at(z);
+        count++;
+    }
+    return count > 0 ? y_sum / count : 0.0f;
 }
@@ -1,33 +1,68 @@
 #ifndef GEOMETRY_H
 #define GEOMETRY_H
 
+#include <limits>
+#include <utility>
 #include <vector>
 #include "TriggerPrimitive.hpp"
+#include "TPStore.h"
 
 /**
- * @brief Calculate Y coordinate from U-plane wire geometry given Z position
- * 
- * This function computes the Y coordinate using U-plane wire positions.
- * U-plane wires have specific angular orientation relative to the detector axes.
- * 
- * @param tps Vector of trigger primitives from U plane
- * @param z The Z coordinate to evaluate at (in cm)
- * @param x_sign Sign of X coordinate (+1 or -1) to determine which side of APA
- * @return float The predicted Y coordinate in cm
+ * @brief Wire of an induction channel seen from one drift side of its APA, in the (z, y) plane
+ *
+ * z is taken from the upstream edge of the APA pair, as in eval_y_knowing_z(). Induction wires
+ * wrap around the APA, so the part of a wire on one face is at most two straight pieces of the same
+ * slope, on either side of z_break: y = (z < z_break ? y0_before : y0_after) + slope * z
  */
-float eval_y_knowing_z_U_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign);
+struct InductionWire {
+    double z_break = std::numeric_limits<double>::infinity();
+    float y0_before = 0.0f;
+    float y0_after = 0.0f;
+    float slope = 0.0f;
+
+    float y_at(float z) const { return (z < z_break ? y0_before : y0_after) + slope * z; }
+    /// Range of y covered by the wire for z in [z_min, z_max]
+    std::pair<float, float> y_range(float z_min, float z_max) const;
+};
+
+/**
+ * @brief Per-APA wire geometry table, computed once from the detector constants
+ *
+ * Holds the wire of every induction channel for the two kinds of APA (even and odd, mirrored in y)
+ * and the two drift sides, and the z of the collection wires. eval_y_knowing_z() and the U/V/X
+ * compatibility of the matching look wires up in it instead of working out the wrapping of every TP
+ * again. check_wire_geometry (test/check_wire_geometry.sh) compares it with the per-TP formulas of
+ * Backtracking.cpp.
+ */
+class WireGeometry {
+    public:
+        WireGeometry();
+
+        /// Wire of a U or V detector channel seen from the side of x_sign, nullptr for a collection channel
+        const InductionWire* get_wire(int detector_channel, float x_sign) const;
+        /// z of a collection (X) detector channel from the upstream edge of its APA pair, -1 for an induction channel
+        float get_collection_z(int detector_channel) const;
+
+    private:
+        std::vector<InductionWire> wires_; // by APA parity, then side (x < 0, x > 0), then local channel
+        std::vector<float> collection_z_;   // by local collection channel
+};
+
+/// Table of the detector constants, built at the first call (after ParametersManager::loadParameters())
+const WireGeometry& get_wire_geometry();
 
 /**
- * @brief Calculate Y coordinate from V-plane wire geometry given Z position
- * 
- * This function computes the Y coordinate using V-plane wire positions.
- * V-plane wires have specific angular orientation relative to the detector axes.
- * 
- * @param tps Vector of trigger primitives from V plane
+ * @brief Calculate Y coordinate from the induction wires of one plane given Z position
+ *
+ * Averages the y at z of the wires of the TPs of the plane, looked up in the wire geometry table.
+ * TPs of the other planes are ignored.
+ *
+ * @param tps Vector of trigger primitives, of the U or V plane
+ * @param plane TPView::U or TPView::V
  * @param z The Z coordinate to evaluate at (in cm)
  * @param x_sign Sign of X coordinate (+1 or -1) to determine which side of APA
- * @return float The predicted Y coordinate in cm
+ * @return float The predicted Y coordinate in cm, 0 if no TP is of the plane
  */
-float eval_y_knowing_z_V_plane(std::vector<TriggerPrimitive*> tps, float z, float x_sign);
+float eval_y_knowing_z(const std::vector<TriggerPrimitive*>& tps, TPView plane, float z, float x_sign);
 
 #endif // GEOMETRY_H
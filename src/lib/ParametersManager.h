@@ -4,6 +4,33 @@
 #include "std.h"
 #include <cmath>
 
+// Typed snapshot of the detector constants used in the hot paths (per TP or per cluster),
+// built once by loadParameters() so that they are plain loads instead of a map lookup and a stod.
+// complete is false if any of the parameters was missing, the getters then go through the map
+struct DetectorConstants {
+    // Geometry
+    double apa_length_cm = 0;
+    double wire_pitch_collection_cm = 0;
+    double wire_pitch_induction_cm = 0;
+    double wire_pitch_induction_diagonal_cm = 0;
+    double apa_angle_deg = 0;
+    double offset_between_apa_cm = 0;
+    double apa_height_cm = 0;
+    double apa_width_cm = 0;
+    double apa_angular_coeff = 0;
+    // Timing
+    double time_tick_cm = 0;
+    int conversion_tdc_to_tpc = 0;
+    double clock_tick_ns = 0;
+    double tpc_sample_length_ns = 0;
+    int backtracker_error_margin = 0;
+    // Conversion
+    double adc_to_energy_factor_collection = 0;
+    double adc_to_energy_factor_induction = 0;
+
+    bool complete = false;
+};
+
 class ParametersManager {
 public:
     static ParametersManager& getInstance() {
@@ -22,8 +49,12 @@ public:
         
         // Calculate derived parameters
         calculateDerivedParameters();
+
+        buildDetectorConstants();
     }
 
+    const DetectorConstants& getDetectorConstants() const { return constants_; }
+
     double getDouble(const std::string& key) const {
         auto it = parameters_.find(key);
         if (it != parameters_.end()) {
@@ -54,6 +85,7 @@ public:
 
 private:
     std::map<std::string, std::string> parameters_;
+    DetectorConstants constants_;
 
     ParametersManager() = default;
     
@@ -132,6 +164,38 @@ private:
             parameters_["timing.tpc_sample_length_ns"] = std::to_string(tpc_sample_length);
         }
     }
+
+    // Values are read through getDouble/getInt, so they are exactly the ones the map lookups return
+    void buildDetectorConstants() {
+        DetectorConstants dc;
+        bool complete = true;
+        auto read_double = [&](const char* key, double& value) {
+            if (hasParameter(key)) value = getDouble(key);
+            else complete = false;
+        };
+        auto read_int = [&](const char* key, int& value) {
+            if (hasParameter(key)) value = getInt(key);
+            else complete = false;
+        };
+        read_double("geometry.apa_length_cm", dc.apa_length_cm);
+        read_double("geometry.wire_pitch_collection_cm", dc.wire_pitch_collection_cm);
+        read_double("geometry.wire_pitch_induction_cm", dc.wire_pitch_induction_cm);
+        read_double("geometry.wire_pitch_induction_diagonal_cm", dc.wire_pitch_induction_diagonal_cm);
+        read_double("geometry.apa_angle_deg", dc.apa_angle_deg);
+        read_double("geometry.offset_between_apa_cm", dc.offset_between_apa_cm);
+        read_double("geometry.apa_height_cm", dc.apa_height_cm);
+        read_double("geometry.apa_width_cm", dc.apa_width_cm);
+        read_double("geometry.apa_angular_coeff", dc.apa_angular_coeff);
+        read_double("timing.time_tick_cm", dc.time_tick_cm);
+        read_int("timing.conversion_tdc_to_tpc", dc.conversion_tdc_to_tpc);
+        read_double("timing.clock_tick_ns", dc.clock_tick_ns);
+        read_double("timing.tpc_sample_length_ns", dc.tpc_sample_length_ns);
+        read_int("timing.backtracker_error_margin", dc.backtracker_error_margin);
+        read_double("conversion.adc_to_energy_factor_collection", dc.adc_to_energy_factor_collection);
+        read_double("conversion.adc_to_energy_factor_induction", dc.adc_to_energy_factor_induction);
+        dc.complete = complete;
+        constants_ = dc;
+    }
 };
 
 // Convenience macros for accessing parameters
@@ -139,5 +203,6 @@ private:
 #define GET_PARAM_DOUBLE(key) PARAM_MGR.getDouble(key)
 #define GET_PARAM_INT(key) PARAM_MGR.getInt(key)
 #define GET_PARAM_STRING(key) PARAM_MGR.getString(key)
+#define DETECTOR_CONSTANTS PARAM_MGR.getDetectorConstants()
 
 #endif // PARAMETERS_MANAGER_H
\ No newline at end of file
@@ -55,22 +55,56 @@ namespace PDG{
     static const int alpha = 1000020040;
 }
 
-// Geometry parameters - accessed via ParametersManager
-inline double get_apa_length_cm() { return GET_PARAM_DOUBLE("geometry.apa_length_cm"); }
-inline double get_wire_pitch_collection_cm() { return GET_PARAM_DOUBLE("geometry.wire_pitch_collection_cm"); }
-inline double get_wire_pitch_induction_cm() { return GET_PARAM_DOUBLE("geometry.wire_pitch_induction_cm"); }
-inline double get_apa_angle_deg() { return GET_PARAM_DOUBLE("geometry.apa_angle_deg"); }
-inline double get_offset_between_apa_cm() { return GET_PARAM_DOUBLE("geometry.offset_between_apa_cm"); }
-inline double get_apa_height_cm() { return GET_PARAM_DOUBLE("geometry.apa_height_cm"); }
-inline double get_apa_width_cm() { return GET_PARAM_DOUBLE("geometry.apa_width_cm"); }
-inline double get_apa_angular_coeff() { return GET_PARAM_DOUBLE("geometry.apa_angular_coeff"); }
-
-// Timing parameters - accessed via ParametersManager
-inline double get_time_tick_cm() { return GET_PARAM_DOUBLE("timing.time_tick_cm"); }
-inline int get_conversion_tdc_to_tpc() { return GET_PARAM_INT("timing.conversion_tdc_to_tpc"); }
-inline double get_clock_tick_ns() { return GET_PARAM_DOUBLE("timing.clock_tick_ns"); }
-inline double get_tpc_sample_length_ns() { return GET_PARAM_DOUBLE("timing.tpc_sample_length_ns"); }
-inline int get_backtracker_error_margin() { return GET_PARAM_INT("timing.backtracker_error_margin"); }
+// Detector constants - read from the typed snapshot built by ParametersManager::loadParameters(),
+// falling back to the parameter map (and its exception) if some parameter was not loaded.
+// Configuring with -DUSE_CONSTEXPR_FD_CONSTANTS=ON fixes them at compile time to the values
+// of the parameters/ folder (FD APA geometry), for builds that never change them
+#ifdef CONSTEXPR_FD_CONSTANTS
+namespace FDConstants {
+    constexpr double apa_length_cm = 230.0;
+    constexpr double wire_pitch_collection_cm = 0.479;
+    constexpr double wire_pitch_induction_cm = 0.574941;  // 0.4669 / sin(54.3 deg), as stored by calculateDerivedParameters
+    constexpr double wire_pitch_induction_diagonal_cm = 0.4669;
+    constexpr double apa_angle_deg = 54.3;
+    constexpr double offset_between_apa_cm = 2.4;
+    constexpr double apa_height_cm = 598.4;
+    constexpr double apa_width_cm = 4.7;
+    constexpr double apa_angular_coeff = 1.391647;        // tan(54.3 deg)
+    constexpr double time_tick_cm = 0.082;
+    constexpr int conversion_tdc_to_tpc = 32;
+    constexpr double clock_tick_ns = 16.0;
+    constexpr double tpc_sample_length_ns = 512.0;
+    constexpr int backtracker_error_margin = 0;
+    constexpr double adc_to_energy_factor_collection = 3600.0;
+    constexpr double adc_to_energy_factor_induction = 900.0;
+}
+#define DETECTOR_CONSTANT(member, getter, key) FDConstants::member
+#else
+#define DETECTOR_CONSTANT(member, getter, key) (DETECTOR_CONSTANTS.complete ? DETECTOR_CONSTANTS.member : getter(key))
+#endif
+
+// Geometry parameters
+inline double get_apa_length_cm() { return DETECTOR_CONSTANT(apa_length_cm, GET_PARAM_DOUBLE, "geometry.apa_length_cm"); }
+inline double get_wire_pitch_collection_cm() { return DETECTOR_CONSTANT(wire_pitch_collection_cm, GET_PARAM_DOUBLE, "geometry.wire_pitch_collection_cm"); }
+inline double get_wire_pitch_induction_cm() { return DETECTOR_CONSTANT(wire_pitch_induction_cm, GET_PARAM_DOUBLE, "geometry.wire_pitch_induction_cm"); }
+// Distance between neighbouring induction wires, perpendicular to them (the pitch above is along z)
+inline double get_wire_pitch_induction_diagonal_cm() { return DETECTOR_CONSTANT(wire_pitch_induction_diagonal_cm, GET_PARAM_DOUBLE, "geometry.wire_pitch_induction_diagonal_cm"); }
+inline double get_apa_angle_deg() { return DETECTOR_CONSTANT(apa_angle_deg, GET_PARAM_DOUBLE, "geometry.apa_angle_deg"); }
+inline double get_offset_between_apa_cm() { return DETECTOR_CONSTANT(offset_between_apa_cm, GET_PARAM_DOUBLE, "geometry.offset_between_apa_cm"); }
+inline double get_apa_height_cm() { return DETECTOR_CONSTANT(apa_height_cm, GET_PARAM_DOUBLE, "geometry.apa_height_cm"); }
+inline double get_apa_width_cm() { return DETECTOR_CONSTANT(apa_width_cm, GET_PARAM_DOUBLE, "geometry.apa_width_cm"); }
+inline double get_apa_angular_coeff() { return DETECTOR_CONSTANT(apa_angular_coeff, GET_PARAM_DOUBLE, "geometry.apa_angular_coeff"); }
+
+// Timing parameters
+inline double get_time_tick_cm() { return DETECTOR_CONSTANT(time_tick_cm, GET_PARAM_DOUBLE, "timing.time_tick_cm"); }
+inline int get_conversion_tdc_to_tpc() { return DETECTOR_CONSTANT(conversion_tdc_to_tpc, GET_PARAM_INT, "timing.conversion_tdc_to_tpc"); }
+inline double get_clock_tick_ns() { return DETECTOR_CONSTANT(clock_tick_ns, GET_PARAM_DOUBLE, "timing.clock_tick_ns"); }
+inline double get_tpc_sample_length_ns() { return DETECTOR_CONSTANT(tpc_sample_length_ns, GET_PARAM_DOUBLE, "timing.tpc_sample_length_ns"); }
+inline int get_backtracker_error_margin() { return DETECTOR_CONSTANT(backtracker_error_margin, GET_PARAM_INT, "timing.backtracker_error_margin"); }
+
+// Conversion parameters
+inline double get_adc_to_energy_factor_collection() { return DETECTOR_CONSTANT(adc_to_energy_factor_collection, GET_PARAM_DOUBLE, "conversion.adc_to_energy_factor_collection"); }
+inline double get_adc_to_energy_factor_induction() { return DETECTOR_CONSTANT(adc_to_energy_factor_induction, GET_PARAM_DOUBLE, "conversion.adc_to_energy_factor_induction"); }
 
 // Legacy constants for backward compatibility (deprecated - use get_* functions instead)
 #define apa_lenght_in_cm get_apa_length_cm()
@@ -15,5 +15,11 @@
 #include <unordered_map>
 #include <random>
 #include <ctime>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #endif // CPP_H
\ No newline at end of file
@@ -34,9 +34,9 @@ Cluster::Cluster(std::vector<TriggerPrimitive*> tps) {
     // Check if all TPs are from same view (single-plane cluster)
     // If they're not all the same view, this is a multiplane cluster
     bool same_view = true;
-    std::string first_view = tps.at(0)->GetView();
+    const int first_view = tps.at(0)->GetViewId();
     for (auto& tp : tps) {
-        if (tp->GetView() != first_view) {
+        if (tp->GetViewId() != first_view) {
             same_view = false;
             break;
         }
@@ -50,7 +50,7 @@ Cluster::Cluster(std::vector<TriggerPrimitive*> tps) {
         if (debugMode) LogDebug << "Creating multiplane cluster with mixed views" << std::endl;
     }
 
-    tps_ = tps;
+    tps_ = std::move(tps);
     update_cluster_info();
 }
 
@@ -58,17 +58,19 @@ void Cluster::update_cluster_info() {
     total_charge_ = 0.0f;
     total_energy_ = 0.0f;
     
-    // Count TPs by generator to determine dominant truth
-    std::map<std::string, int> generator_counts;
+    // Count TPs by (interned) generator to determine dominant truth
+    std::map<int, int> generator_counts;
     
     // Use a composite key to identify unique particles: (generator, PDG, x, y, z)
+    // Generators are compared by name, so that ties are broken as with plain strings
     struct ParticleKey {
-        std::string generator;
+        int generator_id;
+        const std::string* generator;
         int pdg;
         float x, y, z;
         
         bool operator<(const ParticleKey& other) const {
-            if (generator != other.generator) return generator < other.generator;
+            if (generator_id != other.generator_id) return *generator < *other.generator;
             if (pdg != other.pdg) return pdg < other.pdg;
             if (std::abs(x - other.x) > 0.1) return x < other.x;
             if (std::abs(y - other.y) > 0.1) return y < other.y;
@@ -80,7 +82,7 @@ void Cluster::update_cluster_info() {
     
     // Struct to store neutrino info associated with each particle key
     struct NeutrinoInfo {
-        std::string interaction;
+        int interaction_id;
         float energy;
         float x, y, z;
         float px, py, pz;
@@ -90,25 +92,25 @@ void Cluster::update_cluster_info() {
     int tps_with_truth = 0;
     
     // Get ADC to energy conversion factors
-    const double ADC_TO_MEV_COLLECTION = ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_collection");
-    const double ADC_TO_MEV_INDUCTION = ParametersManager::getInstance().getDouble("conversion.adc_to_energy_factor_induction");
+    const double ADC_TO_MEV_COLLECTION = get_adc_to_energy_factor_collection();
+    const double ADC_TO_MEV_INDUCTION = get_adc_to_energy_factor_induction();
     
     for (auto& tp : tps_) {
         total_charge_ += tp->GetAdcIntegral();
         // Convert ADC to energy using the appropriate conversion factor for the view
-        double adc_to_mev = (tp->GetView() == "X") ? ADC_TO_MEV_COLLECTION : ADC_TO_MEV_INDUCTION;
+        double adc_to_mev = (tp->GetViewId() == interned::view_x_id) ? ADC_TO_MEV_COLLECTION : ADC_TO_MEV_INDUCTION;
         total_energy_ += static_cast<float>(tp->GetAdcIntegral() / adc_to_mev);
         
         // Get truth information from TP embedded data
-        std::string gen_name = tp->GetGeneratorName();
-        if (gen_name != "UNKNOWN") {
+        const int generator_id = tp->GetGeneratorId();
+        if (generator_id != interned::unknown_generator_id) {
             tps_with_truth++;
             
             // Count generators
-            generator_counts[gen_name]++;
+            generator_counts[generator_id]++;
             
             // Create particle key
-            ParticleKey key{gen_name, tp->GetParticlePDG(), 
+            ParticleKey key{generator_id, &tp->GetGeneratorName(), tp->GetParticlePDG(), 
                            tp->GetParticleX(), tp->GetParticleY(), tp->GetParticleZ()};
             
             // Count particles
@@ -117,8 +119,8 @@ void Cluster::update_cluster_info() {
             // Store neutrino info if available (neutrino_energy >= 0 means we have truth)
             // Changed from > 0 to >= 0 because neutrino_energy = 0 is valid for background
             // and the key indicator of truth is generator_name != "UNKNOWN"
-            if (tp->GetNeutrinoEnergy() >= 0 || !tp->GetNeutrinoInteraction().empty()) {
-                neutrino_info_map[key] = {tp->GetNeutrinoInteraction(), tp->GetNeutrinoEnergy(),
+            if (tp->GetNeutrinoEnergy() >= 0 || tp->GetNeutrinoInteractionId() != interned::empty_string_id) {
+                neutrino_info_map[key] = {tp->GetNeutrinoInteractionId(), tp->GetNeutrinoEnergy(),
                                          tp->GetNeutrinoX(), tp->GetNeutrinoY(), tp->GetNeutrinoZ(),
                                          tp->GetNeutrinoPx(), tp->GetNeutrinoPy(), tp->GetNeutrinoPz()};
             }
@@ -128,12 +130,10 @@ void Cluster::update_cluster_info() {
     // Set generator fractions
     // Only recalculate if TPs have truth information, otherwise preserve existing value
     if (tps_.size() > 0 && tps_with_truth > 0) {
-        // Count MARLEY TPs (case-insensitive)
+        // Count MARLEY TPs (case-insensitive, precomputed per generator)
         int marley_count = 0;
         for (const auto& kv : generator_counts) {
-            std::string gen_lower = kv.first;
-            std::transform(gen_lower.begin(), gen_lower.end(), gen_lower.begin(), ::tolower);
-            if (gen_lower.find("marley") != std::string::npos) {
+            if (interned::is_marley_generator(kv.first)) {
                 marley_count += kv.second;
             }
         }
@@ -142,7 +142,7 @@ void Cluster::update_cluster_info() {
     }
     
     // Find dominant particle (most TPs matched to it)
-    ParticleKey dominant_key{"UNKNOWN", 0, 0, 0, 0};
+    ParticleKey dominant_key{interned::unknown_generator_id, &interned::generators().get(interned::unknown_generator_id), 0, 0, 0, 0};
     int max_particle_count = 0;
     for (const auto& kv : particle_counts) {
         if (kv.second > max_particle_count) {
@@ -154,13 +154,13 @@ void Cluster::update_cluster_info() {
     // Debug: Always log for MARLEY clusters
     if (supernova_tp_fraction_ > 0) {
         if (debugMode) LogDebug << "MARLEY cluster: marley_fraction=" << supernova_tp_fraction_ 
-                  << " dominant_gen=" << dominant_key.generator 
+                  << " dominant_gen=" << *dominant_key.generator 
                   << " max_count=" << max_particle_count 
                   << " tps_size=" << tps_.size() << std::endl;
     }
     
     // Set truth information from dominant particle
-    if (dominant_key.generator != "UNKNOWN" && max_particle_count > 0) {
+    if (dominant_key.generator_id != interned::unknown_generator_id && max_particle_count > 0) {
         true_pos_ = {dominant_key.x, dominant_key.y, dominant_key.z};
         
         // Debug: Log attempt to find momentum
@@ -168,7 +168,7 @@ void Cluster::update_cluster_info() {
         
         // Get momentum from any TP with this dominant particle
         for (const auto& tp : tps_) {
-            if (tp->GetGeneratorName() == dominant_key.generator &&
+            if (tp->GetGeneratorId() == dominant_key.generator_id &&
                 tp->GetParticlePDG() == dominant_key.pdg &&
                 std::abs(tp->GetParticleX() - dominant_key.x) < 0.1 &&
                 std::abs(tp->GetParticleY() - dominant_key.y) < 0.1 &&
@@ -188,7 +188,7 @@ void Cluster::update_cluster_info() {
         // Debug: If momentum not found, log first TP's details
         if (!found_momentum && tps_.size() > 0) {
             const auto& first_tp = tps_[0];
-            std::cerr << "WARNING: Could not find momentum for cluster! Dominant: gen=" << dominant_key.generator 
+            std::cerr << "WARNING: Could not find momentum for cluster! Dominant: gen=" << *dominant_key.generator 
                       << " pdg=" << dominant_key.pdg << " pos=(" << dominant_key.x << "," << dominant_key.y << "," << dominant_key.z << ")"
                       << " | First TP: gen=" << first_tp->GetGeneratorName()
                       << " pdg=" << first_tp->GetParticlePDG()
@@ -206,7 +206,7 @@ void Cluster::update_cluster_info() {
         double adc_to_mev = (cluster_view == "X") ? ADC_TO_MEV_COLLECTION : ADC_TO_MEV_INDUCTION;
         
         for (const auto& tp : tps_) {
-            if (tp->GetGeneratorName() == dominant_key.generator &&
+            if (tp->GetGeneratorId() == dominant_key.generator_id &&
                 tp->GetParticlePDG() == dominant_key.pdg &&
                 std::abs(tp->GetParticleX() - dominant_key.x) < 0.1 &&
                 std::abs(tp->GetParticleY() - dominant_key.y) < 0.1 &&
@@ -233,7 +233,7 @@ void Cluster::update_cluster_info() {
             LogInfo << "  (Conversion factor: " << adc_to_mev << " ADC/MeV for " << cluster_view << " plane)" << std::endl;
         }
         
-        true_label_ = dominant_key.generator;
+        true_label_ = *dominant_key.generator;
         true_pdg_ = dominant_key.pdg;
         
         // Set neutrino information from the stored map
@@ -241,7 +241,7 @@ void Cluster::update_cluster_info() {
             const auto& nu_info = neutrino_info_map[dominant_key];
             true_neutrino_energy_ = nu_info.energy;
             true_neutrino_momentum_ = {nu_info.px, nu_info.py, nu_info.pz};
-            is_es_interaction_ = (nu_info.interaction == "ES");
+            is_es_interaction_ = (interned::interactions().get(nu_info.interaction_id) == "ES");
         } else {
             true_neutrino_energy_ = -1.0f;
             true_neutrino_momentum_ = {0.0f, 0.0f, 0.0f};
@@ -250,7 +250,7 @@ void Cluster::update_cluster_info() {
 
         if (debugMode){
             LogInfo << "Information about dominant particle extracted." << std::endl;
-            LogInfo << "  Dominant particle: " << dominant_key.generator
+            LogInfo << "  Dominant particle: " << *dominant_key.generator
                     << " (PDG: " << dominant_key.pdg << ")" << std::endl;
             LogInfo << "  Deposited energy: " << deposited_energy << " MeV" << std::endl;
             LogInfo << "  TPs from dominant particle: " << dominant_tp_count << " / " << tps_.size() << std::endl;
@@ -276,11 +276,11 @@ void Cluster::update_cluster_info() {
     }
 }
 
-float Cluster::get_total_charge() {
+float Cluster::get_total_charge() const {
     return total_charge_;
 }
 
-float Cluster::get_total_energy() {
+float Cluster::get_total_energy() const {
     return total_energy_;
 }
 
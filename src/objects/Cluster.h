@@ -16,30 +16,30 @@ class Cluster {
 
         void update_cluster_info();
         
-        // getters
-        TriggerPrimitive* get_tp(int i) { return tps_.at(i); }
-        int get_size() { return tps_.size(); }
-        std::vector<float> get_true_pos() { return true_pos_; }
-        std::vector<float> get_true_momentum() { return true_momentum_; }
-        std::vector<float> get_true_dir() { return true_dir_; }
-        std::vector<float> get_true_neutrino_momentum() { return true_neutrino_momentum_; }
-        float get_true_neutrino_energy() { return true_neutrino_energy_; }
-        float get_true_particle_energy() { return true_particle_energy_; }
-        std::string get_true_label() { return true_label_; }
+        // getters (the vectors and strings are returned by reference, valid as long as the cluster)
+        TriggerPrimitive* get_tp(int i) const { return tps_.at(i); }
+        int get_size() const { return tps_.size(); }
+        const std::vector<float>& get_true_pos() const { return true_pos_; }
+        const std::vector<float>& get_true_momentum() const { return true_momentum_; }
+        const std::vector<float>& get_true_dir() const { return true_dir_; }
+        const std::vector<float>& get_true_neutrino_momentum() const { return true_neutrino_momentum_; }
+        float get_true_neutrino_energy() const { return true_neutrino_energy_; }
+        float get_true_particle_energy() const { return true_particle_energy_; }
+        const std::string& get_true_label() const { return true_label_; }
         float get_min_distance_from_true_pos() const { return min_distance_from_true_pos_; }
         float get_supernova_tp_fraction() const { return supernova_tp_fraction_; }
         float get_generator_tp_fraction() const { return generator_tp_fraction_; }
         bool get_is_es_interaction() const { return is_es_interaction_; }
-        float get_total_charge(); // { return total_charge_; }
-        float get_total_energy(); // { return total_energy_; }
-        float get_number_of_tps() { return tps_.size(); }
-        int get_event() { return tps_.at(0)->GetEvent(); }
+        float get_total_charge() const; // { return total_charge_; }
+        float get_total_energy() const; // { return total_energy_; }
+        float get_number_of_tps() const { return tps_.size(); }
+        int get_event() const { return tps_.at(0)->GetEvent(); }
         int get_true_pdg() const { return true_pdg_; }
         bool get_is_main_cluster() const { return is_main_cluster_; }
         int get_cluster_id() const { return cluster_id_; }
         
         // setters
-        std::vector<TriggerPrimitive*> get_tps() const { return tps_; }
+        const std::vector<TriggerPrimitive*>& get_tps() const { return tps_; }
         void set_tps(std::vector<TriggerPrimitive*> tps) { tps_ = tps;}; //update_cluster_info();} TODO
         void set_true_pos(std::vector<float> pos) { true_pos_ = pos; }
         void set_true_momentum(std::vector<float> momentum) { true_momentum_ = momentum; }
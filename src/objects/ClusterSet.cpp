@@ -0,0 +1,31 @@
+#include "ClusterSet.h"
+
+void TPArena::reserve(size_t n) {
+    if (!blocks_.empty() && blocks_.back().capacity() - blocks_.back().size() >= n) return;
+    blocks_.emplace_back();
+    blocks_.back().reserve(std::max(n, block_size_));
+}
+
+TriggerPrimitive* TPArena::add(const TriggerPrimitive& tp) {
+    // A full block is never reallocated: the next TPs go to a new one
+    if (blocks_.empty() || blocks_.back().size() == blocks_.back().capacity()) {
+        blocks_.emplace_back();
+        blocks_.back().reserve(block_size_);
+    }
+    blocks_.back().push_back(tp);
+    size_++;
+    return &blocks_.back().back();
+}
+
+void TPArena::clear() {
+    blocks_.clear();
+    blocks_.shrink_to_fit();
+    size_ = 0;
+}
+
+void ClusterSet::clear() {
+    // Clusters first, they point into the arena
+    clusters_.clear();
+    clusters_.shrink_to_fit();
+    tps_.clear();
+}
@@ -0,0 +1,72 @@
+#ifndef CLUSTERSET_H
+#define CLUSTERSET_H
+
+#include "Cluster.h"
+
+// Pool of TPs allocated in a few large blocks. A block never grows past the capacity
+// it was created with, so the pointers handed out stay valid until clear()
+class TPArena {
+    public:
+        explicit TPArena(size_t block_size = 4096) : block_size_(block_size) {}
+        TPArena(TPArena&&) = default;
+        TPArena& operator=(TPArena&&) = default;
+        TPArena(const TPArena&) = delete;
+        TPArena& operator=(const TPArena&) = delete;
+
+        // Makes room for n more TPs in a single block
+        void reserve(size_t n);
+        TriggerPrimitive* add(const TriggerPrimitive& tp);
+
+        size_t size() const { return size_; }
+        size_t get_n_blocks() const { return blocks_.size(); }
+        void clear();
+
+    private:
+        size_t block_size_;
+        size_t size_ = 0;
+        std::vector<std::vector<TriggerPrimitive>> blocks_;
+};
+
+// Clusters read from one file, together with the TPs they point to.
+// The TPs live in the arena of the set: they are all released with it, and the pointers held
+// by the clusters stay valid as long as the set is alive (moving the set is fine, copying
+// the clusters out of it is fine as long as the set outlives the copies)
+class ClusterSet {
+    public:
+        ClusterSet() = default;
+        ClusterSet(ClusterSet&&) = default;
+        ClusterSet& operator=(ClusterSet&&) = default;
+        ClusterSet(const ClusterSet&) = delete;
+        ClusterSet& operator=(const ClusterSet&) = delete;
+
+        // Room for n_tps more TPs without a new allocation
+        void reserve_tps(size_t n_tps) { tps_.reserve(n_tps); }
+        void reserve(size_t n_clusters) { clusters_.reserve(n_clusters); }
+        // Copies the TP in the arena and returns its stable address
+        TriggerPrimitive* add_tp(const TriggerPrimitive& tp) { return tps_.add(tp); }
+        // The TPs of the cluster must come from add_tp
+        void add_cluster(Cluster cluster) { clusters_.push_back(std::move(cluster)); }
+
+        size_t size() const { return clusters_.size(); }
+        bool empty() const { return clusters_.empty(); }
+        size_t get_n_tps() const { return tps_.size(); }
+        const TPArena& get_arena() const { return tps_; }
+
+        Cluster& operator[](size_t i) { return clusters_[i]; }
+        const Cluster& operator[](size_t i) const { return clusters_[i]; }
+        std::vector<Cluster>& clusters() { return clusters_; }
+        const std::vector<Cluster>& clusters() const { return clusters_; }
+        std::vector<Cluster>::iterator begin() { return clusters_.begin(); }
+        std::vector<Cluster>::iterator end() { return clusters_.end(); }
+        std::vector<Cluster>::const_iterator begin() const { return clusters_.begin(); }
+        std::vector<Cluster>::const_iterator end() const { return clusters_.end(); }
+
+        // Drops the clusters and releases all their TPs at once
+        void clear();
+
+    private:
+        TPArena tps_;
+        std::vector<Cluster> clusters_;
+};
+
+#endif // CLUSTERSET_H
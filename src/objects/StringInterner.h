@@ -0,0 +1,118 @@
+#ifndef STRINGINTERNER_H
+#define STRINGINTERNER_H
+
+#include "Global.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+// Table of distinct strings, each identified by a small integer id valid for the whole run.
+// Append-only: strings live in fixed-size chunks that are never moved or freed, and an entry is
+// published by the release store of size_. get() and is_tagged() read published entries without
+// a lock, so the per-TP lookups do not contend; intern() and find() lock to search the id map.
+// Safe to use from several threads (backtracking and clustering run in parallel).
+class StringInterner {
+    public:
+        // preset strings get the ids 0, 1, ... in order; tag is evaluated once per new string
+        explicit StringInterner(std::initializer_list<std::string> preset = {},
+                                std::function<bool(const std::string&)> tag = nullptr)
+            : tag_(std::move(tag)) {
+            for (const auto& s : preset) intern(s);
+        }
+        StringInterner(const StringInterner&) = delete;
+        StringInterner& operator=(const StringInterner&) = delete;
+
+        int intern(const std::string& s) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = ids_.find(s);
+            if (it != ids_.end()) return it->second;
+            const int id = size_.load(std::memory_order_relaxed);
+            if (id >= max_strings) throw std::length_error("StringInterner: more than " + std::to_string(max_strings) + " strings");
+            auto& chunk = chunks_[id / chunk_size];
+            if (!chunk) chunk.reset(new Entry[chunk_size]);
+            chunk[id % chunk_size] = Entry{s, tag_ ? tag_(s) : false};
+            ids_.emplace(s, id);
+            size_.store(id + 1, std::memory_order_release);
+            return id;
+        }
+
+        // -1 if the string was never interned
+        int find(const std::string& s) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = ids_.find(s);
+            return it == ids_.end() ? -1 : it->second;
+        }
+
+        const std::string& get(int id) const { return entry(id).str; }
+
+        bool is_tagged(int id) const { return entry(id).tagged; }
+
+        size_t size() const { return static_cast<size_t>(size_.load(std::memory_order_acquire)); }
+
+    private:
+        struct Entry {
+            std::string str;
+            bool tagged = false;
+        };
+        static constexpr int chunk_size = 256;
+        static constexpr int max_chunks = 4096;
+        static constexpr int max_strings = chunk_size * max_chunks;
+
+        // The acquire load pairs with the release store in intern(): entry and chunk pointer are complete
+        const Entry& entry(int id) const {
+            if (id < 0 || id >= size_.load(std::memory_order_acquire)) throw std::out_of_range("StringInterner: unknown id " + std::to_string(id));
+            return chunks_[id / chunk_size][id % chunk_size];
+        }
+
+        mutable std::mutex mutex_; // serializes intern() and guards ids_
+        std::array<std::unique_ptr<Entry[]>, max_chunks> chunks_;
+        std::atomic<int> size_{0};
+        std::unordered_map<std::string, int> ids_;
+        std::function<bool(const std::string&)> tag_;
+};
+
+// Global tables for the strings of the truth model
+namespace interned {
+
+    // Case-insensitive, like all the MARLEY checks on generator names
+    inline bool contains_marley(const std::string& s) {
+        std::string lower = s;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return lower.find("marley") != std::string::npos;
+    }
+
+    constexpr int unknown_generator_id = 0; // "UNKNOWN"
+    constexpr int empty_string_id = 0;      // "" in processes and interactions
+    // Views are preset so that their ids follow APA::views (and TPView)
+    constexpr int view_u_id = 0;
+    constexpr int view_v_id = 1;
+    constexpr int view_x_id = 2;
+    constexpr int view_unknown_id = 3;      // ""
+
+    // Generator names, tagged when they are MARLEY
+    inline StringInterner& generators() {
+        static StringInterner table({"UNKNOWN"}, contains_marley);
+        return table;
+    }
+    inline StringInterner& processes() {
+        static StringInterner table({""});
+        return table;
+    }
+    inline StringInterner& interactions() {
+        static StringInterner table({""});
+        return table;
+    }
+    inline StringInterner& views() {
+        static StringInterner table({"U", "V", "X", ""});
+        return table;
+    }
+
+    inline bool is_marley_generator(int generator_id) { return generators().is_tagged(generator_id); }
+
+} // namespace interned
+
+#endif // STRINGINTERNER_H
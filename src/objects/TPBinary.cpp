@@ -0,0 +1,370 @@
+#include "TPBinary.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LoggerInit([]{Logger::getUserHeader() << "[" << FILENAME << "]";});
+
+namespace {
+
+inline size_t padded(size_t bytes) {
+    return (bytes + 7) & ~static_cast<size_t>(7);
+}
+
+}
+
+size_t tp_binary::block_size(uint64_t n_tps) {
+    return column_offset(n_tps, n_columns);
+}
+
+size_t tp_binary::column_offset(uint64_t n_tps, size_t column) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < column && i < n_columns; ++i) bytes += padded(n_tps * column_sizes[i]);
+    return bytes;
+}
+
+TPBinaryWriter::TPBinaryWriter(const std::string& out_filename)
+    : out_filename_(out_filename)
+{
+    file_.open(out_filename_, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+        LogError << "Cannot create output file: " << out_filename_ << std::endl;
+        return;
+    }
+
+    // Placeholder, the header is written again by close() once the sections are known
+    TPBinaryHeader header{};
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    offset_ = sizeof(header);
+}
+
+TPBinaryWriter::~TPBinaryWriter() {
+    close();
+}
+
+void TPBinaryWriter::write_padding() {
+    static const char zeros[8] = {};
+    const size_t n_zeros = padded(offset_) - offset_;
+    file_.write(zeros, n_zeros);
+    offset_ += n_zeros;
+}
+
+void TPBinaryWriter::write_event(const std::vector<TriggerPrimitive>& tps) {
+    if (!is_open() || tps.empty()) return;
+    event_tps_.clear();
+    event_tps_.append(tps);
+    write_event(event_tps_, 0, event_tps_.size());
+}
+
+void TPBinaryWriter::write_event(const std::vector<const TriggerPrimitive*>& tps, int event) {
+    if (!is_open() || tps.empty()) return;
+    event_tps_.clear();
+    event_tps_.reserve(tps.size());
+    for (const TriggerPrimitive* tp : tps) event_tps_.push_back(*tp, event);
+    write_event(event_tps_, 0, event_tps_.size());
+}
+
+void TPBinaryWriter::write_event(const TPStore& store, size_t begin, size_t end) {
+    if (!is_open()) return;
+
+    end = std::min(end, store.size());
+    if (begin >= end) return;
+    const size_t n = end - begin;
+
+    TPBinaryEvent event{};
+    event.event = store.get_event(begin);
+    event.offset = offset_;
+    event.n_tps = n;
+    if (store.is_time_sorted(begin, end)) event.flags |= tp_binary::event_time_sorted;
+
+    block_.assign(tp_binary::block_size(n), 0);
+    char* out = block_.data();
+    size_t column = 0;
+    auto put_column = [&](const void* values) {
+        const size_t bytes = n * tp_binary::column_sizes[column++];
+        std::memcpy(out, values, bytes);
+        out += padded(bytes);
+    };
+    put_column(store.time_start().data() + begin);
+    put_column(store.channel().data() + begin);
+    put_column(store.samples_over_threshold().data() + begin);
+    put_column(store.samples_to_peak().data() + begin);
+    put_column(store.adc_integral().data() + begin);
+    put_column(store.adc_peak().data() + begin);
+    put_column(store.detector().data() + begin);
+    put_column(store.detector_channel().data() + begin);
+    put_column(store.view().data() + begin);
+    put_column(store.event().data() + begin);
+    put_column(store.simide_energy().data() + begin);
+
+    // Truth indices of the store become indices in the truth table of the file
+    std::vector<int32_t> truth(n, -1);
+    int32_t last_source = -1;
+    int32_t last_index = -1;
+    for (size_t i = 0; i < n; ++i) {
+        const int32_t source = store.get_truth_index(begin + i);
+        if (source < 0) continue;
+        if (source != last_source) {
+            last_source = source;
+            last_index = truths_.add_truth(store.truths()[source]);
+        }
+        truth[i] = last_index;
+    }
+    put_column(truth.data());
+
+    file_.write(block_.data(), block_.size());
+    offset_ += block_.size();
+    n_tps_ += n;
+    events_.push_back(event);
+}
+
+void TPBinaryWriter::close() {
+    if (!is_open()) return;
+
+    TPBinaryHeader header{};
+    std::memcpy(header.magic, tp_binary::magic, sizeof(header.magic));
+    header.format_version = tp_binary::format_version;
+    header.header_size = sizeof(TPBinaryHeader);
+    header.n_events = events_.size();
+    header.n_tps = n_tps_;
+
+    // Truth table, the strings of the particles go to the dictionary
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> string_index;
+    auto add_string = [&](const std::string& s) -> uint32_t {
+        auto it = string_index.find(s);
+        if (it != string_index.end()) return it->second;
+        strings.push_back(s);
+        string_index.emplace(s, static_cast<uint32_t>(strings.size() - 1));
+        return static_cast<uint32_t>(strings.size() - 1);
+    };
+
+    std::vector<TPBinaryTruth> truths;
+    truths.reserve(truths_.truths().size());
+    for (const TPTruth& truth : truths_.truths()) {
+        TPBinaryTruth record{};
+        record.generator = add_string(interned::generators().get(truth.generator_id));
+        record.particle_process = add_string(interned::processes().get(truth.particle_process_id));
+        record.neutrino_interaction = add_string(interned::interactions().get(truth.neutrino_interaction_id));
+        record.particle_pdg = truth.particle_pdg;
+        record.particle_energy = truth.particle_energy;
+        record.particle_x = truth.particle_x;
+        record.particle_y = truth.particle_y;
+        record.particle_z = truth.particle_z;
+        record.particle_px = truth.particle_px;
+        record.particle_py = truth.particle_py;
+        record.particle_pz = truth.particle_pz;
+        record.neutrino_x = truth.neutrino_x;
+        record.neutrino_y = truth.neutrino_y;
+        record.neutrino_z = truth.neutrino_z;
+        record.neutrino_px = truth.neutrino_px;
+        record.neutrino_py = truth.neutrino_py;
+        record.neutrino_pz = truth.neutrino_pz;
+        record.neutrino_energy = truth.neutrino_energy;
+        truths.push_back(record);
+    }
+    header.n_truths = truths.size();
+    header.truth_offset = offset_;
+    file_.write(reinterpret_cast<const char*>(truths.data()), truths.size() * sizeof(TPBinaryTruth));
+    offset_ += truths.size() * sizeof(TPBinaryTruth);
+
+    // String dictionary: the table, then the characters
+    header.n_strings = strings.size();
+    header.string_offset = offset_;
+    uint64_t chars_offset = offset_ + strings.size() * sizeof(TPBinaryString);
+    for (const auto& s : strings) {
+        TPBinaryString entry{chars_offset, s.size()};
+        file_.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        chars_offset += s.size();
+    }
+    offset_ += strings.size() * sizeof(TPBinaryString);
+    for (const auto& s : strings) {
+        file_.write(s.data(), s.size());
+        offset_ += s.size();
+    }
+    write_padding();
+
+    // Event table
+    header.event_offset = offset_;
+    file_.write(reinterpret_cast<const char*>(events_.data()), events_.size() * sizeof(TPBinaryEvent));
+    offset_ += events_.size() * sizeof(TPBinaryEvent);
+    header.file_size = offset_;
+
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const bool ok = file_.good();
+    file_.close();
+    if (!ok) {
+        LogError << "Failed to write binary TP file: " << out_filename_ << std::endl;
+    }
+
+    events_.clear();
+    truths_.clear();
+    event_tps_.clear();
+    block_.clear();
+}
+
+TPBinaryReader::TPBinaryReader(const std::string& in_filename)
+    : in_filename_(in_filename)
+{
+    const int fd = ::open(in_filename_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LogError << "Cannot open binary TP file: " << in_filename_ << std::endl;
+        return;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size >= static_cast<off_t>(sizeof(TPBinaryHeader))) {
+        void* map = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            data_ = static_cast<const unsigned char*>(map);
+            size_ = file_stat.st_size;
+        }
+    }
+    ::close(fd); // the mapping stays valid without the descriptor
+    if (!is_open()) {
+        LogError << "Cannot map binary TP file: " << in_filename_ << std::endl;
+        return;
+    }
+    if (!validate()) {
+        LogError << "Invalid or truncated binary TP file: " << in_filename_ << std::endl;
+        close();
+        return;
+    }
+    // Events are usually read in order
+    madvise(const_cast<unsigned char*>(data_), size_, MADV_SEQUENTIAL);
+
+    events_ = reinterpret_cast<const TPBinaryEvent*>(data_ + header().event_offset);
+
+    // Decode the truth table once, with its strings interned
+    const auto* strings = reinterpret_cast<const TPBinaryString*>(data_ + header().string_offset);
+    auto get_string = [&](uint32_t index) {
+        if (index >= header().n_strings) return std::string();
+        return std::string(reinterpret_cast<const char*>(data_ + strings[index].offset), strings[index].length);
+    };
+    const auto* records = reinterpret_cast<const TPBinaryTruth*>(data_ + header().truth_offset);
+    truths_.reserve(header().n_truths);
+    for (uint64_t i = 0; i < header().n_truths; ++i) {
+        const TPBinaryTruth& record = records[i];
+        TPTruth truth;
+        truth.generator_id = interned::generators().intern(get_string(record.generator));
+        truth.particle_pdg = record.particle_pdg;
+        truth.particle_process_id = interned::processes().intern(get_string(record.particle_process));
+        truth.particle_energy = record.particle_energy;
+        truth.particle_x = record.particle_x;
+        truth.particle_y = record.particle_y;
+        truth.particle_z = record.particle_z;
+        truth.particle_px = record.particle_px;
+        truth.particle_py = record.particle_py;
+        truth.particle_pz = record.particle_pz;
+        truth.neutrino_interaction_id = interned::interactions().intern(get_string(record.neutrino_interaction));
+        truth.neutrino_x = record.neutrino_x;
+        truth.neutrino_y = record.neutrino_y;
+        truth.neutrino_z = record.neutrino_z;
+        truth.neutrino_px = record.neutrino_px;
+        truth.neutrino_py = record.neutrino_py;
+        truth.neutrino_pz = record.neutrino_pz;
+        truth.neutrino_energy = record.neutrino_energy;
+        truth.is_marley = interned::is_marley_generator(truth.generator_id);
+        truths_.push_back(truth);
+    }
+}
+
+TPBinaryReader::~TPBinaryReader() {
+    close();
+}
+
+bool TPBinaryReader::validate() {
+    const TPBinaryHeader& h = header();
+    if (std::memcmp(h.magic, tp_binary::magic, sizeof(h.magic)) != 0) return false;
+    if (h.format_version != tp_binary::format_version || h.header_size != sizeof(TPBinaryHeader)) {
+        LogError << "Unsupported binary TP format version " << h.format_version << std::endl;
+        return false;
+    }
+    if (h.file_size != size_) return false;
+
+    // Every section must lie inside the file; the counts are checked first so that the products cannot overflow
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t item_size) {
+        return offset <= size_ && count <= (size_ - offset) / item_size;
+    };
+    if (!fits(h.truth_offset, h.n_truths, sizeof(TPBinaryTruth))) return false;
+    if (!fits(h.string_offset, h.n_strings, sizeof(TPBinaryString))) return false;
+    if (!fits(h.event_offset, h.n_events, sizeof(TPBinaryEvent))) return false;
+    if (h.event_offset % 8 != 0 || h.truth_offset % 8 != 0 || h.string_offset % 8 != 0) return false;
+
+    const auto* strings = reinterpret_cast<const TPBinaryString*>(data_ + h.string_offset);
+    for (uint64_t i = 0; i < h.n_strings; ++i) {
+        if (!fits(strings[i].offset, strings[i].length, 1)) return false;
+    }
+
+    // Event blocks are between the header and the truth table
+    const auto* events = reinterpret_cast<const TPBinaryEvent*>(data_ + h.event_offset);
+    uint64_t n_tps = 0;
+    for (uint64_t i = 0; i < h.n_events; ++i) {
+        const TPBinaryEvent& event = events[i];
+        if (event.offset < h.header_size || event.offset % 8 != 0 || event.offset > h.truth_offset) return false;
+        if (event.n_tps > (h.truth_offset - event.offset) / 8) return false;
+        if (tp_binary::block_size(event.n_tps) > h.truth_offset - event.offset) return false;
+        // Views index per-view tables (APA::views): a value beyond TPView::Unknown means a corrupt or foreign file
+        const unsigned char* views = data_ + event.offset + tp_binary::column_offset(event.n_tps, tp_binary::view_column);
+        for (uint64_t j = 0; j < event.n_tps; ++j) {
+            if (views[j] > static_cast<unsigned char>(TPView::Unknown)) {
+                LogError << "Invalid view " << static_cast<int>(views[j]) << " in event " << event.event << std::endl;
+                return false;
+            }
+        }
+        n_tps += event.n_tps;
+    }
+    return n_tps == h.n_tps;
+}
+
+void TPBinaryReader::read_event(size_t i, TPStore& store) const {
+    if (!is_open() || i >= get_n_events()) return;
+
+    const TPBinaryEvent& event = events_[i];
+    const size_t n = event.n_tps;
+    const unsigned char* in = data_ + event.offset;
+    size_t column = 0;
+    auto next_column = [&]() {
+        const unsigned char* values = in;
+        in += padded(n * tp_binary::column_sizes[column++]);
+        return values;
+    };
+
+    TPColumnPointers columns;
+    columns.time_start = reinterpret_cast<const uint64_t*>(next_column());
+    columns.channel = reinterpret_cast<const uint32_t*>(next_column());
+    columns.samples_over_threshold = reinterpret_cast<const uint16_t*>(next_column());
+    columns.samples_to_peak = reinterpret_cast<const uint16_t*>(next_column());
+    columns.adc_integral = reinterpret_cast<const uint32_t*>(next_column());
+    columns.adc_peak = reinterpret_cast<const uint16_t*>(next_column());
+    columns.detector = reinterpret_cast<const int32_t*>(next_column());
+    columns.detector_channel = reinterpret_cast<const int32_t*>(next_column());
+    columns.view = reinterpret_cast<const TPView*>(next_column());
+    columns.event = reinterpret_cast<const int32_t*>(next_column());
+    columns.simide_energy = reinterpret_cast<const double*>(next_column());
+    columns.truth = reinterpret_cast<const int32_t*>(next_column());
+    store.append_columns(columns, n, truths_);
+}
+
+void TPBinaryReader::read(TPStore& store) const {
+    if (!is_open()) return;
+    store.reserve(store.size() + get_n_tps());
+    for (size_t i = 0; i < get_n_events(); ++i) read_event(i, store);
+}
+
+void TPBinaryReader::advise_random_access() const {
+    if (!is_open()) return;
+    madvise(const_cast<unsigned char*>(data_), size_, MADV_RANDOM);
+}
+
+void TPBinaryReader::close() {
+    if (!is_open()) return;
+    munmap(const_cast<unsigned char*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+    events_ = nullptr;
+    truths_.clear();
+}
@@ -0,0 +1,157 @@
+#ifndef TPBINARY_H
+#define TPBINARY_H
+
+#include "TPStore.h"
+
+// Compact binary TP file (*_tps.tpb), an alternative to the tps tree for the files our own apps
+// pass to each other. A file holds the columns of a TPStore, event by event, plus the truth table
+// of its particles (with a string dictionary instead of per-TP strings) and the offset of every event.
+// It is mapped in memory and read without any deserialization: the columns of an event are copied
+// as they are into a TPStore.
+//
+// Layout (native byte order, every section aligned to 8 bytes):
+//   TPBinaryHeader
+//   one block per event: the columns of its TPs, in the order of tp_binary::column_sizes, each padded to 8 bytes
+//   truth table: n_truths TPBinaryTruth, whose strings are indices in the dictionary
+//   string dictionary: n_strings TPBinaryString, then their characters
+//   event table: n_events TPBinaryEvent
+namespace tp_binary {
+    constexpr char magic[8] = {'O', 'P', 'U', 'T', 'P', 'S', 'B', '\0'};
+    constexpr uint32_t format_version = 2; // 2: detector and detector_channel on 4 bytes, simide_energy on 8
+    constexpr const char* extension = ".tpb";
+
+    // Bytes per TP of each column: time_start, channel, samples_over_threshold, samples_to_peak,
+    // adc_integral, adc_peak, detector, detector_channel, view, event, simide_energy, truth
+    constexpr size_t n_columns = 12;
+    constexpr size_t column_sizes[n_columns] = {8, 4, 2, 2, 4, 2, 4, 4, 1, 4, 8, 4};
+    constexpr size_t view_column = 8;
+
+    // Bits of TPBinaryEvent::flags. Files written before the flags have them all unset
+    constexpr uint32_t event_time_sorted = 1u << 0; // the TPs of the event are in time start order
+
+    // Bytes taken by the columns of n TPs
+    size_t block_size(uint64_t n_tps);
+    // Offset of a column in the block of n TPs
+    size_t column_offset(uint64_t n_tps, size_t column);
+
+    inline bool is_binary_filename(const std::string& filename) {
+        const std::string ext = extension;
+        return filename.size() > ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+    }
+}
+
+struct TPBinaryHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t header_size;
+    uint64_t n_events;
+    uint64_t n_tps;
+    uint64_t n_truths;
+    uint64_t n_strings;
+    uint64_t truth_offset;
+    uint64_t string_offset;
+    uint64_t event_offset;
+    uint64_t file_size;
+};
+
+struct TPBinaryEvent {
+    int32_t event;
+    uint32_t flags;   // tp_binary::event_* bits
+    uint64_t offset; // of the block of the event
+    uint64_t n_tps;
+};
+
+struct TPBinaryTruth {
+    uint32_t generator;             // dictionary indices
+    uint32_t particle_process;
+    uint32_t neutrino_interaction;
+    int32_t particle_pdg;
+    float particle_energy;
+    float particle_x, particle_y, particle_z;
+    float particle_px, particle_py, particle_pz;
+    float neutrino_x, neutrino_y, neutrino_z;
+    float neutrino_px, neutrino_py, neutrino_pz;
+    float neutrino_energy;
+};
+
+struct TPBinaryString {
+    uint64_t offset; // of the characters, from the start of the file
+    uint64_t length;
+};
+
+static_assert(sizeof(TPBinaryHeader) % 8 == 0, "TPBinaryHeader must keep the sections aligned");
+static_assert(sizeof(TPBinaryEvent) == 24, "TPBinaryEvent has a fixed size on disk");
+static_assert(sizeof(TPBinaryTruth) == 72, "TPBinaryTruth has a fixed size on disk");
+static_assert(sizeof(TPView) == 1, "the view column is stored on one byte");
+
+// Writes a binary TP file one event at a time, like TpsWriter.
+// The truth table and the event table are written by close(), which the destructor calls if needed
+class TPBinaryWriter {
+    public:
+        explicit TPBinaryWriter(const std::string& out_filename);
+        ~TPBinaryWriter();
+        TPBinaryWriter(const TPBinaryWriter&) = delete;
+        TPBinaryWriter& operator=(const TPBinaryWriter&) = delete;
+
+        bool is_open() const { return file_.is_open(); }
+        void write_event(const std::vector<TriggerPrimitive>& tps);
+        // Writes TPs owned elsewhere as one event, numbered event
+        void write_event(const std::vector<const TriggerPrimitive*>& tps, int event);
+        // Writes the rows [begin, end) of a store as one event
+        void write_event(const TPStore& store, size_t begin, size_t end);
+        size_t get_n_events() const { return events_.size(); }
+        uint64_t get_n_tps() const { return n_tps_; }
+        void close();
+
+    private:
+        void write_padding();
+
+        std::string out_filename_;
+        std::ofstream file_;
+        uint64_t offset_ = 0;
+        uint64_t n_tps_ = 0;
+        std::vector<TPBinaryEvent> events_;
+        TPStore truths_;      // only its (deduplicated) truth table is used: the particles of the whole file
+        TPStore event_tps_;   // TPs of the event being written, when given as TriggerPrimitives
+        std::vector<char> block_;
+};
+
+// Memory-mapped binary TP file. The header, the columns and the event table are used in place;
+// only the truth table is decoded at opening, with its strings interned. The sections and the view column
+// are checked at opening too: a file failing them is not opened
+class TPBinaryReader {
+    public:
+        explicit TPBinaryReader(const std::string& in_filename);
+        ~TPBinaryReader();
+        TPBinaryReader(const TPBinaryReader&) = delete;
+        TPBinaryReader& operator=(const TPBinaryReader&) = delete;
+
+        bool is_open() const { return data_ != nullptr; }
+        size_t get_n_events() const { return is_open() ? header().n_events : 0; }
+        uint64_t get_n_tps() const { return is_open() ? header().n_tps : 0; }
+        int get_event(size_t i) const { return events_[i].event; }
+        uint64_t get_event_n_tps(size_t i) const { return events_[i].n_tps; }
+        // Whether the writer found the TPs of the i-th event in time start order
+        bool is_event_time_sorted(size_t i) const { return (events_[i].flags & tp_binary::event_time_sorted) != 0; }
+        const std::vector<TPTruth>& truths() const { return truths_; }
+
+        // Appends the TPs of the i-th event of the file to the store, one bulk copy per column
+        void read_event(size_t i, TPStore& store) const;
+        // Appends all the TPs of the file
+        void read(TPStore& store) const;
+        // Tells the kernel that events will be read in random order (the default is in file order)
+        void advise_random_access() const;
+        void close();
+
+    private:
+        const TPBinaryHeader& header() const { return *reinterpret_cast<const TPBinaryHeader*>(data_); }
+        bool validate();
+
+        std::string in_filename_;
+        const unsigned char* data_ = nullptr;
+        size_t size_ = 0;
+        const TPBinaryEvent* events_ = nullptr;
+        std::vector<TPTruth> truths_;
+};
+
+#endif // TPBINARY_H
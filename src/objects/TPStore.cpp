@@ -0,0 +1,289 @@
+#include "TPStore.h"
+
+#include <cstring>
+
+LoggerInit([]{Logger::getUserHeader() << "[" << FILENAME << "]";});
+
+TPView tp_view_from_string(const std::string& view) {
+    if (view == "U") return TPView::U;
+    if (view == "V") return TPView::V;
+    if (view == "X") return TPView::X;
+    return TPView::Unknown;
+}
+
+TPView tp_view_from_detector_channel(int detector_channel) {
+    if (detector_channel < 0) return TPView::Unknown;
+    if (detector_channel < APA::induction_channels) return TPView::U;
+    if (detector_channel < APA::induction_channels * 2) return TPView::V;
+    if (detector_channel < APA::induction_channels * 2 + APA::collection_channels) return TPView::X;
+    return TPView::Unknown;
+}
+
+std::string tp_view_name(TPView view) {
+    switch (view) {
+        case TPView::U: return "U";
+        case TPView::V: return "V";
+        case TPView::X: return "X";
+        default: return "";
+    }
+}
+
+bool TPTruth::operator==(const TPTruth& other) const {
+    return generator_id == other.generator_id
+        && particle_pdg == other.particle_pdg
+        && particle_process_id == other.particle_process_id
+        && particle_energy == other.particle_energy
+        && particle_x == other.particle_x && particle_y == other.particle_y && particle_z == other.particle_z
+        && particle_px == other.particle_px && particle_py == other.particle_py && particle_pz == other.particle_pz
+        && neutrino_interaction_id == other.neutrino_interaction_id
+        && neutrino_x == other.neutrino_x && neutrino_y == other.neutrino_y && neutrino_z == other.neutrino_z
+        && neutrino_px == other.neutrino_px && neutrino_py == other.neutrino_py && neutrino_pz == other.neutrino_pz
+        && neutrino_energy == other.neutrino_energy;
+}
+
+namespace {
+
+inline void hash_combine(size_t& seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+inline size_t hash_float(float value) {
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return std::hash<uint32_t>()(bits);
+}
+
+// The position and energy of the particle are enough to tell particles apart
+size_t hash_truth(const TPTruth& truth) {
+    size_t seed = std::hash<int>()(truth.generator_id);
+    hash_combine(seed, std::hash<int>()(truth.particle_pdg));
+    hash_combine(seed, hash_float(truth.particle_energy));
+    hash_combine(seed, hash_float(truth.particle_x));
+    hash_combine(seed, hash_float(truth.particle_y));
+    hash_combine(seed, hash_float(truth.particle_z));
+    hash_combine(seed, hash_float(truth.neutrino_energy));
+    return seed;
+}
+
+}
+
+void TPStore::reserve(size_t n) {
+    time_start_.reserve(n);
+    channel_.reserve(n);
+    samples_over_threshold_.reserve(n);
+    samples_to_peak_.reserve(n);
+    adc_integral_.reserve(n);
+    adc_peak_.reserve(n);
+    detector_.reserve(n);
+    detector_channel_.reserve(n);
+    view_.reserve(n);
+    event_.reserve(n);
+    simide_energy_.reserve(n);
+    truth_.reserve(n);
+}
+
+void TPStore::clear() {
+    time_start_.clear();
+    channel_.clear();
+    samples_over_threshold_.clear();
+    samples_to_peak_.clear();
+    adc_integral_.clear();
+    adc_peak_.clear();
+    detector_.clear();
+    detector_channel_.clear();
+    view_.clear();
+    event_.clear();
+    simide_energy_.clear();
+    truth_.clear();
+    truths_.clear();
+    truths_by_hash_.clear();
+}
+
+int32_t TPStore::add_truth(const TPTruth& truth) {
+    std::vector<int32_t>& bucket = truths_by_hash_[hash_truth(truth)];
+    for (int32_t index : bucket) {
+        if (truths_[index] == truth) return index;
+    }
+    truths_.push_back(truth);
+    truths_.back().is_marley = interned::is_marley_generator(truth.generator_id);
+    bucket.push_back(static_cast<int32_t>(truths_.size() - 1));
+    return bucket.back();
+}
+
+size_t TPStore::push_back(const TPRow& row) {
+    time_start_.push_back(row.time_start);
+    channel_.push_back(row.channel);
+    samples_over_threshold_.push_back(row.samples_over_threshold);
+    samples_to_peak_.push_back(row.samples_to_peak);
+    adc_integral_.push_back(row.adc_integral);
+    adc_peak_.push_back(row.adc_peak);
+    detector_.push_back(row.detector);
+    detector_channel_.push_back(row.detector_channel);
+    view_.push_back(row.view);
+    event_.push_back(row.event);
+    simide_energy_.push_back(row.simide_energy);
+    truth_.push_back(row.truth);
+    return size() - 1;
+}
+
+size_t TPStore::push_back(const TriggerPrimitive& tp) {
+    return push_back(tp, tp.GetEvent());
+}
+
+size_t TPStore::push_back(const TriggerPrimitive& tp, int32_t event) {
+    TPRow row;
+    row.time_start = static_cast<uint64_t>(tp.GetTimeStart());
+    row.channel = tp.GetChannel();
+    row.samples_over_threshold = tp.GetSamplesOverThreshold();
+    row.samples_to_peak = tp.GetSamplesToPeak();
+    row.adc_integral = tp.GetAdcIntegral();
+    row.adc_peak = tp.GetAdcPeak();
+    row.detector = tp.GetDetector();
+    row.detector_channel = tp.GetDetectorChannel();
+    row.view = static_cast<TPView>(tp.GetViewId());
+    row.event = event;
+    row.simide_energy = tp.GetSimideEnergy();
+
+    TPTruth truth;
+    truth.generator_id = tp.GetGeneratorId();
+    truth.particle_pdg = tp.GetParticlePDG();
+    truth.particle_process_id = tp.GetParticleProcessId();
+    truth.particle_energy = tp.GetParticleEnergy();
+    truth.particle_x = tp.GetParticleX();
+    truth.particle_y = tp.GetParticleY();
+    truth.particle_z = tp.GetParticleZ();
+    truth.particle_px = tp.GetParticlePx();
+    truth.particle_py = tp.GetParticlePy();
+    truth.particle_pz = tp.GetParticlePz();
+    truth.neutrino_interaction_id = tp.GetNeutrinoInteractionId();
+    truth.neutrino_x = tp.GetNeutrinoX();
+    truth.neutrino_y = tp.GetNeutrinoY();
+    truth.neutrino_z = tp.GetNeutrinoZ();
+    truth.neutrino_px = tp.GetNeutrinoPx();
+    truth.neutrino_py = tp.GetNeutrinoPy();
+    truth.neutrino_pz = tp.GetNeutrinoPz();
+    truth.neutrino_energy = tp.GetNeutrinoEnergy();
+    row.truth = add_truth(truth);
+
+    return push_back(row);
+}
+
+void TPStore::append(const std::vector<TriggerPrimitive>& tps) {
+    reserve(size() + tps.size());
+    for (const auto& tp : tps) push_back(tp);
+}
+
+void TPStore::append_columns(const TPColumnPointers& columns, size_t n, const std::vector<TPTruth>& truths) {
+    if (n == 0) return;
+    time_start_.insert(time_start_.end(), columns.time_start, columns.time_start + n);
+    channel_.insert(channel_.end(), columns.channel, columns.channel + n);
+    samples_over_threshold_.insert(samples_over_threshold_.end(), columns.samples_over_threshold, columns.samples_over_threshold + n);
+    samples_to_peak_.insert(samples_to_peak_.end(), columns.samples_to_peak, columns.samples_to_peak + n);
+    adc_integral_.insert(adc_integral_.end(), columns.adc_integral, columns.adc_integral + n);
+    adc_peak_.insert(adc_peak_.end(), columns.adc_peak, columns.adc_peak + n);
+    detector_.insert(detector_.end(), columns.detector, columns.detector + n);
+    detector_channel_.insert(detector_channel_.end(), columns.detector_channel, columns.detector_channel + n);
+    view_.insert(view_.end(), columns.view, columns.view + n);
+    event_.insert(event_.end(), columns.event, columns.event + n);
+    simide_energy_.insert(simide_energy_.end(), columns.simide_energy, columns.simide_energy + n);
+
+    // Truth indices are translated, looking a truth up only when the particle changes
+    truth_.reserve(truth_.size() + n);
+    int32_t last_source = -1;
+    int32_t last_index = -1;
+    for (size_t i = 0; i < n; ++i) {
+        const int32_t source = columns.truth[i];
+        if (source < 0 || source >= static_cast<int32_t>(truths.size())) {
+            truth_.push_back(-1);
+            continue;
+        }
+        if (source != last_source) {
+            last_source = source;
+            last_index = add_truth(truths[source]);
+        }
+        truth_.push_back(last_index);
+    }
+}
+
+TPRow TPStore::get_row(size_t i) const {
+    TPRow row;
+    row.time_start = time_start_[i];
+    row.channel = channel_[i];
+    row.samples_over_threshold = samples_over_threshold_[i];
+    row.samples_to_peak = samples_to_peak_[i];
+    row.adc_integral = adc_integral_[i];
+    row.adc_peak = adc_peak_[i];
+    row.detector = detector_[i];
+    row.detector_channel = detector_channel_[i];
+    row.view = view_[i];
+    row.event = event_[i];
+    row.simide_energy = simide_energy_[i];
+    row.truth = truth_[i];
+    return row;
+}
+
+TriggerPrimitive TPStore::get_tp(size_t i) const {
+    TriggerPrimitive tp(TriggerPrimitive::s_trigger_primitive_version, 0, 0,
+        channel_[i], samples_over_threshold_[i], time_start_[i], samples_to_peak_[i], adc_integral_[i], adc_peak_[i]);
+    tp.SetEvent(event_[i]);
+    tp.SetDetector(detector_[i]);
+    tp.SetDetectorChannel(detector_channel_[i]);
+    tp.SetSimideEnergy(simide_energy_[i]);
+
+    const TPTruth& truth = get_truth(i);
+    tp.SetGeneratorId(truth.generator_id);
+    tp.SetParticlePDG(truth.particle_pdg);
+    tp.SetParticleProcess(interned::processes().get(truth.particle_process_id));
+    tp.SetParticleEnergy(truth.particle_energy);
+    tp.SetParticlePosition(truth.particle_x, truth.particle_y, truth.particle_z);
+    tp.SetParticleMomentum(truth.particle_px, truth.particle_py, truth.particle_pz);
+    tp.SetNeutrinoInfo(interned::interactions().get(truth.neutrino_interaction_id), truth.neutrino_x, truth.neutrino_y, truth.neutrino_z,
+                       truth.neutrino_px, truth.neutrino_py, truth.neutrino_pz, truth.neutrino_energy);
+    return tp;
+}
+
+std::vector<TriggerPrimitive> TPStore::get_tps(size_t begin, size_t end) const {
+    std::vector<TriggerPrimitive> tps;
+    end = std::min(end, size());
+    if (begin >= end) return tps;
+    tps.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) tps.push_back(get_tp(i));
+    return tps;
+}
+
+std::vector<TriggerPrimitive> TPStore::get_tps(const std::vector<uint32_t>& rows) const {
+    std::vector<TriggerPrimitive> tps;
+    get_tps(rows, tps);
+    return tps;
+}
+
+void TPStore::get_tps(const std::vector<uint32_t>& rows, std::vector<TriggerPrimitive>& tps) const {
+    tps.clear();
+    tps.reserve(rows.size());
+    for (uint32_t i : rows) tps.push_back(get_tp(i));
+}
+
+std::map<int, std::vector<uint32_t>> TPStore::get_rows_by_event() const {
+    std::map<int, std::vector<uint32_t>> rows_by_event;
+    for (size_t i = 0; i < size(); ++i) {
+        rows_by_event[event_[i]].push_back(static_cast<uint32_t>(i));
+    }
+    return rows_by_event;
+}
+
+size_t TPStore::get_memory_usage() const {
+    size_t bytes = time_start_.capacity() * sizeof(uint64_t)
+        + channel_.capacity() * sizeof(uint32_t)
+        + samples_over_threshold_.capacity() * sizeof(uint16_t)
+        + samples_to_peak_.capacity() * sizeof(uint16_t)
+        + adc_integral_.capacity() * sizeof(uint32_t)
+        + adc_peak_.capacity() * sizeof(uint16_t)
+        + detector_.capacity() * sizeof(int32_t)
+        + detector_channel_.capacity() * sizeof(int32_t)
+        + view_.capacity() * sizeof(TPView)
+        + event_.capacity() * sizeof(int32_t)
+        + simide_energy_.capacity() * sizeof(double)
+        + truth_.capacity() * sizeof(int32_t);
+    bytes += truths_.capacity() * sizeof(TPTruth);
+    return bytes;
+}
@@ -0,0 +1,163 @@
+#ifndef TPSTORE_H
+#define TPSTORE_H
+
+#include "TriggerPrimitive.hpp"
+
+// Compact view id, in the same order as APA::views and the interned view ids
+enum class TPView : uint8_t {
+    U = 0,
+    V = 1,
+    X = 2,
+    Unknown = 3
+};
+
+TPView tp_view_from_string(const std::string& view);
+TPView tp_view_from_detector_channel(int detector_channel);
+std::string tp_view_name(TPView view);
+
+// Truth of one particle, shared by all the TPs it produced. Strings are interned ids (StringInterner.h).
+// Non-MARLEY particles only carry the generator, so they collapse to one entry per generator
+struct TPTruth {
+    int generator_id = interned::unknown_generator_id;
+    int particle_pdg = 0;
+    int particle_process_id = interned::empty_string_id;
+    float particle_energy = 0.0f;
+    float particle_x = 0.0f, particle_y = 0.0f, particle_z = 0.0f;
+    float particle_px = 0.0f, particle_py = 0.0f, particle_pz = 0.0f;
+    int neutrino_interaction_id = interned::empty_string_id;
+    float neutrino_x = 0.0f, neutrino_y = 0.0f, neutrino_z = 0.0f;
+    float neutrino_px = 0.0f, neutrino_py = 0.0f, neutrino_pz = 0.0f;
+    float neutrino_energy = 0.0f;
+    bool is_marley = false;
+
+    bool operator==(const TPTruth& other) const;
+};
+
+// One TP as stored in the columns of a TPStore. Detector, detector channel and SimIDE energy keep the
+// types of TriggerPrimitive, so a TP read back from a store (or a binary file) is the one written
+struct TPRow {
+    uint64_t time_start = 0;
+    uint32_t channel = 0;
+    uint16_t samples_over_threshold = 0;
+    uint16_t samples_to_peak = 0;
+    uint32_t adc_integral = 0;
+    uint16_t adc_peak = 0;
+    int32_t detector = 0;
+    int32_t detector_channel = 0;
+    TPView view = TPView::Unknown;
+    int32_t event = -1;
+    double simide_energy = 0.0;
+    int32_t truth = -1; // index in the truth table, -1 if the TP has no truth
+};
+
+// n consecutive rows given column by column, e.g. straight from a mapped file
+struct TPColumnPointers {
+    const uint64_t* time_start = nullptr;
+    const uint32_t* channel = nullptr;
+    const uint16_t* samples_over_threshold = nullptr;
+    const uint16_t* samples_to_peak = nullptr;
+    const uint32_t* adc_integral = nullptr;
+    const uint16_t* adc_peak = nullptr;
+    const int32_t* detector = nullptr;
+    const int32_t* detector_channel = nullptr;
+    const TPView* view = nullptr;
+    const int32_t* event = nullptr;
+    const double* simide_energy = nullptr;
+    const int32_t* truth = nullptr; // indices in the truth table the rows come with
+};
+
+// Struct-of-arrays container of TPs: one compact column per variable plus a side table
+// with the truth of each particle, instead of a std::vector<TriggerPrimitive> carrying
+// strings and truth for every TP. The hot loops (clustering, histogramming) only touch
+// the columns they need.
+class TPStore {
+    public:
+        size_t size() const { return time_start_.size(); }
+        bool empty() const { return time_start_.empty(); }
+        void reserve(size_t n);
+        void clear();
+
+        // Returns the index of the truth in the table, adding it if not there yet
+        int32_t add_truth(const TPTruth& truth);
+        // Returns the index of the new row
+        size_t push_back(const TPRow& row);
+        size_t push_back(const TriggerPrimitive& tp);
+        // Same, with the event number of the row given instead of taken from the TP
+        size_t push_back(const TriggerPrimitive& tp, int32_t event);
+        void append(const std::vector<TriggerPrimitive>& tps);
+        // Appends n rows with one bulk copy per column. The truth indices of the rows refer to truths,
+        // whose entries are added to the table of the store as needed
+        void append_columns(const TPColumnPointers& columns, size_t n, const std::vector<TPTruth>& truths);
+
+        TPRow get_row(size_t i) const;
+        // Builds the full TriggerPrimitive of a row, with its embedded truth
+        TriggerPrimitive get_tp(size_t i) const;
+        std::vector<TriggerPrimitive> get_tps(size_t begin, size_t end) const;
+        std::vector<TriggerPrimitive> get_tps(const std::vector<uint32_t>& rows) const;
+        // Same into tps, cleared first: a buffer of the caller whose capacity is reused from call to call
+        void get_tps(const std::vector<uint32_t>& rows, std::vector<TriggerPrimitive>& tps) const;
+
+        // Rows of each event, in store order
+        std::map<int, std::vector<uint32_t>> get_rows_by_event() const;
+        // Whether the rows [begin, end) are in time start order
+        bool is_time_sorted(size_t begin, size_t end) const {
+            end = std::min(end, size());
+            return begin >= end || std::is_sorted(time_start_.begin() + begin, time_start_.begin() + end);
+        }
+
+        // Per-row getters
+        uint64_t get_time_start(size_t i)           const { return time_start_[i]; }
+        uint32_t get_channel(size_t i)              const { return channel_[i]; }
+        uint16_t get_samples_over_threshold(size_t i) const { return samples_over_threshold_[i]; }
+        uint16_t get_samples_to_peak(size_t i)      const { return samples_to_peak_[i]; }
+        uint32_t get_adc_integral(size_t i)         const { return adc_integral_[i]; }
+        uint16_t get_adc_peak(size_t i)             const { return adc_peak_[i]; }
+        int32_t get_detector(size_t i)              const { return detector_[i]; }
+        int32_t get_detector_channel(size_t i)      const { return detector_channel_[i]; }
+        TPView get_view(size_t i)                   const { return view_[i]; }
+        int32_t get_event(size_t i)                 const { return event_[i]; }
+        double get_simide_energy(size_t i)          const { return simide_energy_[i]; }
+        int32_t get_truth_index(size_t i)           const { return truth_[i]; }
+        const TPTruth& get_truth(size_t i)          const { return truth_[i] < 0 ? no_truth_ : truths_[truth_[i]]; }
+        const std::string& get_generator_name(size_t i) const { return interned::generators().get(get_truth(i).generator_id); }
+        bool is_marley(size_t i)                    const { return truth_[i] >= 0 && truths_[truth_[i]].is_marley; }
+
+        // Whole columns, for vectorizable loops
+        const std::vector<uint64_t>& time_start()               const { return time_start_; }
+        const std::vector<uint32_t>& channel()                  const { return channel_; }
+        const std::vector<uint16_t>& samples_over_threshold()   const { return samples_over_threshold_; }
+        const std::vector<uint16_t>& samples_to_peak()          const { return samples_to_peak_; }
+        const std::vector<uint32_t>& adc_integral()             const { return adc_integral_; }
+        const std::vector<uint16_t>& adc_peak()                 const { return adc_peak_; }
+        const std::vector<int32_t>& detector()                  const { return detector_; }
+        const std::vector<int32_t>& detector_channel()          const { return detector_channel_; }
+        const std::vector<TPView>& view()                       const { return view_; }
+        const std::vector<int32_t>& event()                     const { return event_; }
+        const std::vector<double>& simide_energy()              const { return simide_energy_; }
+        const std::vector<int32_t>& truth_index()               const { return truth_; }
+        const std::vector<TPTruth>& truths()                    const { return truths_; }
+
+        // Bytes held by the columns and the truth table
+        size_t get_memory_usage() const;
+
+    private:
+        std::vector<uint64_t> time_start_;
+        std::vector<uint32_t> channel_;
+        std::vector<uint16_t> samples_over_threshold_;
+        std::vector<uint16_t> samples_to_peak_;
+        std::vector<uint32_t> adc_integral_;
+        std::vector<uint16_t> adc_peak_;
+        std::vector<int32_t> detector_;
+        std::vector<int32_t> detector_channel_;
+        std::vector<TPView> view_;
+        std::vector<int32_t> event_;
+        std::vector<double> simide_energy_;
+        std::vector<int32_t> truth_;
+
+        // Truth side table, deduplicated through a hash of its content
+        std::vector<TPTruth> truths_;
+        std::unordered_map<size_t, std::vector<int32_t>> truths_by_hash_;
+        TPTruth no_truth_;
+};
+
+#endif // TPSTORE_H
@@ -2,6 +2,7 @@
 #define TRIGGERPRIMITIVE_HPP
 
 #include "TrueParticle.h"
+#include "StringInterner.h"
 #include "Global.h"
 
 class TriggerPrimitive {
@@ -15,7 +16,7 @@ class TriggerPrimitive {
         void SetSamplesToPeak(uint64_t samples_to_peak)               { this->samples_to_peak_ = samples_to_peak; }
         void SetAdcIntegral(uint64_t adc_integral)                    { this->adc_integral_ = adc_integral; }
         void SetAdcPeak(uint64_t adc_peak)                            { this->adc_peak_ = adc_peak; }
-        void SetView(const std::string& view)                         { this->view_ = view; }
+        void SetView(const std::string& view)                         { this->view_id_ = interned::views().intern(view); }
         void SetDetector(int detector)                                { this->detector_ = detector; }
         void SetDetectorChannel(int detector_channel)                 { this->detector_channel_ = detector_channel; }
         void SetEvent(int event)                                      { this->event_ = event; }
@@ -23,17 +24,21 @@ class TriggerPrimitive {
         void AddSimideEnergy(double simide_energy)                    { this->simide_energy_ += simide_energy; }
         
         // Truth setters (always set generator)
-        void SetGeneratorName(const std::string& gen)                 { this->generator_name_ = gen; }
+        void SetGeneratorName(const std::string& gen)                 { SetGeneratorId(interned::generators().intern(gen)); }
+        void SetGeneratorId(int generator_id) {
+            this->generator_id_ = generator_id;
+            this->is_marley_ = interned::is_marley_generator(generator_id);
+        }
         
         // MARLEY-specific particle truth setters (only set when generator is MARLEY)
         void SetParticlePDG(int pdg)                                 { this->particle_pdg_ = pdg; }
-        void SetParticleProcess(const std::string& proc)             { this->particle_process_ = proc; }
+        void SetParticleProcess(const std::string& proc)             { this->particle_process_id_ = interned::processes().intern(proc); }
         void SetParticleEnergy(float energy)                         { this->particle_energy_ = energy; }
         void SetParticlePosition(float x, float y, float z)          { this->particle_x_ = x; this->particle_y_ = y; this->particle_z_ = z; }
         void SetParticleMomentum(float px, float py, float pz)       { this->particle_px_ = px; this->particle_py_ = py; this->particle_pz_ = pz; }
         void SetNeutrinoInfo(const std::string& interaction, float nu_x, float nu_y, float nu_z, 
                             float nu_px, float nu_py, float nu_pz, float nu_energy) {
-            this->neutrino_interaction_ = interaction;
+            this->neutrino_interaction_id_ = interned::interactions().intern(interaction);
             this->neutrino_x_ = nu_x; this->neutrino_y_ = nu_y; this->neutrino_z_ = nu_z;
             this->neutrino_px_ = nu_px; this->neutrino_py_ = nu_py; this->neutrino_pz_ = nu_pz;
             this->neutrino_energy_ = nu_energy;
@@ -43,17 +48,14 @@ class TriggerPrimitive {
         void SetTrueParticle(const TrueParticle* true_particle) {
             temp_true_particle_ = true_particle;  // Store pointer for later generator name update
             if (true_particle == nullptr) {
-                generator_name_ = "UNKNOWN";
+                SetGeneratorId(interned::unknown_generator_id);
                 return;
             }
-            generator_name_ = true_particle->GetGeneratorName();
+            SetGeneratorName(true_particle->GetGeneratorName());
             
-            // Check if MARLEY (case-insensitive)
-            std::string gen_lower = generator_name_;
-            std::transform(gen_lower.begin(), gen_lower.end(), gen_lower.begin(), ::tolower);
-            if (gen_lower.find("marley") != std::string::npos) {
+            if (is_marley_) {
                 particle_pdg_ = true_particle->GetPdg();
-                particle_process_ = true_particle->GetProcess();
+                SetParticleProcess(true_particle->GetProcess());
                 particle_energy_ = true_particle->GetEnergy();
                 particle_x_ = true_particle->GetX();
                 particle_y_ = true_particle->GetY();
@@ -64,7 +66,7 @@ class TriggerPrimitive {
                 
                 const Neutrino* nu = true_particle->GetNeutrino();
                 if (nu != nullptr) {
-                    neutrino_interaction_ = nu->GetInteraction();
+                    neutrino_interaction_id_ = interned::interactions().intern(nu->GetInteraction());
                     neutrino_x_ = nu->GetX();
                     neutrino_y_ = nu->GetY();
                     neutrino_z_ = nu->GetZ();
@@ -76,9 +78,9 @@ class TriggerPrimitive {
             }
         }
         void SetView(int ch) {
-            if (ch < APA::induction_channels)                                      { view_ = "U"; } 
-            else if (ch < APA::induction_channels * 2)                             { view_ = "V"; }
-            else if (ch < APA::induction_channels * 2 + APA::collection_channels)  { view_ = "X"; }
+            if (ch < APA::induction_channels)                                      { view_id_ = interned::view_u_id; } 
+            else if (ch < APA::induction_channels * 2)                             { view_id_ = interned::view_v_id; }
+            else if (ch < APA::induction_channels * 2 + APA::collection_channels)  { view_id_ = interned::view_x_id; }
             else { 
                 LogError << "Channel out of range: " << ch << "! Critical, stopping execution.\n"; 
                 throw std::runtime_error("Channel out of range: ");
@@ -90,7 +92,8 @@ class TriggerPrimitive {
         double GetTimeStart() const     { return time_start_; }
         double GetTimeEnd() const       { return time_start_ + samples_over_threshold_ * TPC_sample_length; }
         double GetTimePeak() const      { return time_start_ + samples_to_peak_ * TPC_sample_length; }
-        std::string GetView() const     { return view_; }
+        const std::string& GetView() const  { return interned::views().get(view_id_); }
+        int GetViewId() const           { return view_id_; }
         int GetDetector()                   const { return detector_; }
         int GetDetectorChannel()            const { return detector_channel_; }
         int GetChannel()                    const { return channel_; } // this is the original channel for larsoft
@@ -102,11 +105,13 @@ class TriggerPrimitive {
         double GetSimideEnergy()            const { return simide_energy_; }
         
         // Truth getters (always available)
-        std::string GetGeneratorName() const { return generator_name_; }
+        const std::string& GetGeneratorName() const { return interned::generators().get(generator_id_); }
+        int GetGeneratorId() const           { return generator_id_; }
         
         // MARLEY-specific particle truth getters (return meaningful values only if generator is MARLEY)
         int GetParticlePDG() const              { return particle_pdg_; }
-        std::string GetParticleProcess() const  { return particle_process_; }
+        const std::string& GetParticleProcess() const { return interned::processes().get(particle_process_id_); }
+        int GetParticleProcessId() const        { return particle_process_id_; }
         float GetParticleEnergy() const         { return particle_energy_; }
         float GetParticleX() const              { return particle_x_; }
         float GetParticleY() const              { return particle_y_; }
@@ -114,7 +119,8 @@ class TriggerPrimitive {
         float GetParticlePx() const             { return particle_px_; }
         float GetParticlePy() const             { return particle_py_; }
         float GetParticlePz() const             { return particle_pz_; }
-        std::string GetNeutrinoInteraction() const { return neutrino_interaction_; }
+        const std::string& GetNeutrinoInteraction() const { return interned::interactions().get(neutrino_interaction_id_); }
+        int GetNeutrinoInteractionId() const    { return neutrino_interaction_id_; }
         float GetNeutrinoX() const              { return neutrino_x_; }
         float GetNeutrinoY() const              { return neutrino_y_; }
         float GetNeutrinoZ() const              { return neutrino_z_; }
@@ -123,12 +129,8 @@ class TriggerPrimitive {
         float GetNeutrinoPz() const             { return neutrino_pz_; }
         float GetNeutrinoEnergy() const         { return neutrino_energy_; }
         
-        // Helper to check if this is MARLEY (case-insensitive)
-        bool IsMarley() const {
-            std::string gen_lower = generator_name_;
-            std::transform(gen_lower.begin(), gen_lower.end(), gen_lower.begin(), ::tolower);
-            return gen_lower.find("marley") != std::string::npos;
-        }
+        // Helper to check if this is MARLEY (case-insensitive, evaluated once per generator name)
+        bool IsMarley() const { return is_marley_; }
         
         // Temporary accessor for backtracking processing (returns temp pointer, not serialized)
         const TrueParticle* GetTrueParticle() const {
@@ -181,7 +183,7 @@ class TriggerPrimitive {
             LogInfo << "  adc_peak: " << adc_peak_ << std::endl;
             LogInfo << "  detector: " << detector_ << std::endl;
             LogInfo << "  detector_channel: " << detector_channel_ << std::endl;
-            LogInfo << "  view: " << view_ << std::endl;
+            LogInfo << "  view: " << GetView() << std::endl;
         }
 
     private:
@@ -201,7 +203,7 @@ class TriggerPrimitive {
         // Additional variables
         int detector_ = -1; // this goes from 0 to the number of APAs 
         int detector_channel_ = -1;
-        std::string view_ = "";
+        int view_id_ = interned::view_unknown_id; // interned, see StringInterner.h
         int event_ = -1;
         
         // SimIDE energy in MeV (sum of all SimIDEs contributing to this TP)
@@ -211,12 +213,13 @@ class TriggerPrimitive {
         const TrueParticle* temp_true_particle_ = nullptr;
         
         // ===== Embedded truth information =====
-        // Always stored: generator name for all TPs (from MC truth, not Geant4)
-        std::string generator_name_ = "UNKNOWN";
+        // Always stored: generator name for all TPs (from MC truth, not Geant4), as interned ids
+        int generator_id_ = interned::unknown_generator_id;
+        bool is_marley_ = false;
         
         // MARLEY-specific particle truth (only filled when generator is MARLEY)
         int particle_pdg_ = 0;
-        std::string particle_process_ = "";
+        int particle_process_id_ = interned::empty_string_id;
         float particle_energy_ = 0.0f;
         float particle_x_ = 0.0f;
         float particle_y_ = 0.0f;
@@ -226,7 +229,7 @@ class TriggerPrimitive {
         float particle_pz_ = 0.0f;
         
         // Neutrino information (only filled for MARLEY TPs with neutrino association)
-        std::string neutrino_interaction_ = "";
+        int neutrino_interaction_id_ = interned::empty_string_id;
         float neutrino_x_ = 0.0f;
         float neutrino_y_ = 0.0f;
         float neutrino_z_ = 0.0f;
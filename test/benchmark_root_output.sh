@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# Output policy benchmark: backtrack and cluster the tpstream files of test/data,
+# then write and read back their TPs and clusters with several compression and
+# basket settings (benchmark_root_output), reporting size, write and read time.
+# Extra arguments are passed to benchmark_root_output (e.g. -j <json> -n 5).
+#
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ROOT_DIR="$(dirname "${SCRIPT_DIR}")"
+
+BLUE='\033[0;34m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+
+SETTINGS_JSON="json/test_settings.json"
+OUTPUT_DIR="test/output/benchmark"
+BUILD_DIR="${BUILD_DIR:-${ROOT_DIR}/build}"
+APP_DIR="${BUILD_DIR}/src/app"
+
+cd "${ROOT_DIR}"
+mkdir -p "${OUTPUT_DIR}"
+
+for tpstream in test/data/*_tpstream.root; do
+  name="$(basename "${tpstream}" _tpstream.root)"
+  echo -e "${BLUE}========================================${NC}"
+  echo "  ${name}"
+  echo -e "${BLUE}========================================${NC}"
+
+  "${APP_DIR}/backtrack_tpstream" -j "${SETTINGS_JSON}" -i "${tpstream}" --output-folder "${OUTPUT_DIR}" -f
+  tps_file="$(ls "${OUTPUT_DIR}/${name}"_tps*.root | head -n 1)"
+
+  "${APP_DIR}/make_clusters" -j "${SETTINGS_JSON}" -i "${tps_file}" -f
+  clusters_file="$(ls test/output/clusters/"${name}"_clusters*.root 2>/dev/null | head -n 1 || true)"
+
+  if [[ -n "${clusters_file}" ]]; then
+    "${APP_DIR}/benchmark_root_output" -i "${tps_file}" -c "${clusters_file}" --output-folder "${OUTPUT_DIR}" "$@"
+  else
+    "${APP_DIR}/benchmark_root_output" -i "${tps_file}" --output-folder "${OUTPUT_DIR}" "$@"
+  fi
+done
+
+echo -e "\n${GREEN}Benchmark completed.${NC}"
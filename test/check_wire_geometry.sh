@@ -0,0 +1,24 @@
+#!/bin/bash
+#
+# Wire geometry check: the y of the induction wires in the precomputed table
+# (WireGeometry, src/lib/Geometry.h) must match the per-TP formulas of
+# Backtracking.cpp within 1e-3 cm on random channels, z and drift sides.
+# Extra arguments are passed to check_wire_geometry (e.g. -n 1000000 --seed 7).
+#
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ROOT_DIR="$(dirname "${SCRIPT_DIR}")"
+
+GREEN='\033[0;32m'
+NC='\033[0m'
+
+BUILD_DIR="${BUILD_DIR:-${ROOT_DIR}/build}"
+APP_DIR="${BUILD_DIR}/src/app"
+
+cd "${ROOT_DIR}"
+
+"${APP_DIR}/check_wire_geometry" -n 200000 --tolerance 1e-3 "$@"
+
+echo -e "\n${GREEN}Wire geometry check completed.${NC}"